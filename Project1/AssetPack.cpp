@@ -0,0 +1,398 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include "ImageLoader.h"
+#include "Lz4.h"
+#include "ThreadPool.h"
+
+uint64_t hashAssetName(const char* name, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ (uint8_t)name[i]) * 1099511628211ull;
+    return hash;
+}
+
+AssetType assetTypeFromPath(const std::string& path)
+{
+    const size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    for (char& c : extension)
+        c = (char)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+
+    if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga")
+        return kAssetImage;
+    if (extension == "dds" || extension == "ktx")
+        return kAssetCompressedTexture;
+    if (extension == "vert" || extension == "frag" || extension == "glsl")
+        return kAssetShader;
+    if (extension == "obj" || extension == "gltf" || extension == "glb")
+        return kAssetMesh;
+    return kAssetRaw;
+}
+
+bool readPackPayload(const PackEntry& entry, uint32_t blockSize, const uint8_t* stored, uint64_t offset, size_t size,
+    uint8_t* out, ThreadPool* pool, std::string& log)
+{
+    if (offset > entry.size || entry.size - offset < size)
+    {
+        log = "read past the end";
+        return false;
+    }
+    /* out may be NULL then, e.g. the data() of an empty vector. */
+    if (size == 0)
+        return true;
+    if (entry.compression == kPackStored)
+    {
+        memcpy(out, stored + offset, size);
+        return true;
+    }
+
+    const uint64_t blockCount = (entry.size + blockSize - 1) / blockSize;
+    const uint8_t* blocks = stored + blockCount * 4;
+    const uint64_t blocksSize = entry.storedSize - blockCount * 4;
+    const uint64_t first = offset / blockSize;
+    const uint64_t last = (offset + size - 1) / blockSize;
+
+    /* Each block lands straight in out unless the range cuts it, in which
+       case it goes through a scratch buffer. */
+    std::atomic<bool> ok(true);
+    auto decodeBlock = [&](size_t index)
+    {
+        const uint64_t block = first + index;
+        uint32_t begin = 0;
+        uint32_t end;
+        if (block > 0)
+            memcpy(&begin, stored + (block - 1) * 4, 4);
+        memcpy(&end, stored + block * 4, 4);
+        const uint64_t blockStart = block * blockSize;
+        const size_t rawLength = (size_t)std::min<uint64_t>(blockSize, entry.size - blockStart);
+        if (begin > end || end > blocksSize)
+        {
+            ok = false;
+            return;
+        }
+
+        const uint64_t from = std::max(offset, blockStart);
+        const uint64_t to = std::min<uint64_t>(offset + size, blockStart + rawLength);
+        uint8_t* target = out + (from - offset);
+        const uint8_t* source = blocks + begin;
+        if (end - begin == rawLength)
+            memcpy(target, source + (from - blockStart), (size_t)(to - from));
+        else if (from == blockStart && to == blockStart + rawLength)
+            ok = lz4Decompress(source, end - begin, target, rawLength) && ok;
+        else
+        {
+            std::vector<uint8_t> scratch(rawLength);
+            if (lz4Decompress(source, end - begin, scratch.data(), rawLength))
+                memcpy(target, scratch.data() + (from - blockStart), (size_t)(to - from));
+            else
+                ok = false;
+        }
+    };
+    const size_t count = (size_t)(last - first + 1);
+    if (pool && count > 1)
+        pool->parallelFor(count, decodeBlock);
+    else
+        for (size_t i = 0; i < count; ++i)
+            decodeBlock(i);
+
+    if (!ok)
+        log = "corrupt compressed block";
+    return ok;
+}
+
+AssetPack::AssetPack()
+    : m_header(NULL)
+    , m_entries(NULL)
+    , m_names(NULL)
+{
+}
+
+bool AssetPack::open(const std::string& path, std::string& log)
+{
+    close();
+    if (!m_file.open(path))
+    {
+        log = "cannot map " + path;
+        return false;
+    }
+
+    const uint8_t* base = m_file.data();
+    const uint64_t size = m_file.size();
+    const PackHeader* header = (const PackHeader*)base;
+    if (size < sizeof(PackHeader) || memcmp(header->magic, "APAK", 4) != 0 || header->version != kPackVersion)
+    {
+        log = path + ": not a version " + std::to_string(kPackVersion) + " asset pack";
+        m_file.close();
+        return false;
+    }
+    if (header->fileSize != size || header->tocOffset % 8 != 0
+        || header->tocOffset > size || (size - header->tocOffset) / sizeof(PackEntry) < header->entryCount
+        || header->namesOffset > size || size - header->namesOffset < header->namesSize)
+    {
+        log = path + ": truncated or inconsistent header";
+        m_file.close();
+        return false;
+    }
+
+    /* Block tables are checked as blocks are read, so opening does not touch
+       any payload. */
+    const PackEntry* entries = (const PackEntry*)(base + header->tocOffset);
+    const char* names = (const char*)(base + header->namesOffset);
+    for (uint32_t i = 0; i < header->entryCount; ++i)
+    {
+        const PackEntry& entry = entries[i];
+        bool inBounds = entry.offset <= size && size - entry.offset >= entry.storedSize
+            && (uint64_t)entry.nameOffset + entry.nameLength <= header->namesSize;
+        if (entry.compression == kPackStored)
+            inBounds = inBounds && entry.storedSize == entry.size;
+        else if (entry.compression == kPackLz4)
+            inBounds = inBounds && header->blockSize != 0
+                && (entry.size + header->blockSize - 1) / header->blockSize * 4 <= entry.storedSize;
+        else
+            inBounds = false;
+        const bool sorted = i == 0 || entries[i - 1].hash <= entry.hash;
+        if (!inBounds || !sorted || entry.hash != hashAssetName(names + entry.nameOffset, entry.nameLength))
+        {
+            log = path + ": table of contents entry " + std::to_string(i) + " is corrupt";
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_header = header;
+    m_entries = entries;
+    m_names = names;
+    return true;
+}
+
+void AssetPack::close()
+{
+    m_file.close();
+    m_header = NULL;
+    m_entries = NULL;
+    m_names = NULL;
+}
+
+const PackEntry* AssetPack::find(const std::string& name) const
+{
+    if (!m_header)
+        return NULL;
+
+    const uint64_t hash = hashAssetName(name.data(), name.size());
+    const PackEntry* end = m_entries + m_header->entryCount;
+    const PackEntry* entry = std::lower_bound(m_entries, end, hash,
+        [](const PackEntry& e, uint64_t h) { return e.hash < h; });
+    for (; entry != end && entry->hash == hash; ++entry)
+    {
+        if (entry->nameLength == name.size() && memcmp(m_names + entry->nameOffset, name.data(), name.size()) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+std::string AssetPack::name(const PackEntry& entry) const
+{
+    return std::string(m_names + entry.nameOffset, entry.nameLength);
+}
+
+bool AssetPack::read(const PackEntry& entry, uint64_t offset, size_t size, uint8_t* out, ThreadPool* pool, std::string& log) const
+{
+    if (readPackPayload(entry, m_header->blockSize, data(entry), offset, size, out, pool, log))
+        return true;
+    log = name(entry) + ": " + log;
+    return false;
+}
+
+bool AssetPack::read(const PackEntry& entry, std::vector<uint8_t>& out, ThreadPool* pool, std::string& log) const
+{
+    out.resize((size_t)entry.size);
+    return read(entry, 0, out.size(), out.data(), pool, log);
+}
+
+namespace
+{
+    struct PackSource
+    {
+        std::string name;
+        std::filesystem::path path;
+        PackEntry entry;
+    };
+
+    bool writePadding(FILE* file, uint64_t& position, uint64_t target)
+    {
+        static const uint8_t zeros[4096] = {};
+        while (position < target)
+        {
+            const size_t chunk = (size_t)std::min<uint64_t>(sizeof(zeros), target - position);
+            if (fwrite(zeros, 1, chunk, file) != chunk)
+                return false;
+            position += chunk;
+        }
+        return true;
+    }
+
+    /* Appends one file to the pack in fixed-size pieces. */
+    bool copyPayload(FILE* file, const std::filesystem::path& path, uint64_t size, uint64_t& position)
+    {
+        FILE* input = fopen(path.string().c_str(), "rb");
+        if (!input)
+            return false;
+        std::vector<uint8_t> buffer(1 << 20);
+        uint64_t remaining = size;
+        bool ok = true;
+        while (ok && remaining > 0)
+        {
+            const size_t chunk = (size_t)std::min<uint64_t>(buffer.size(), remaining);
+            ok = fread(buffer.data(), 1, chunk, input) == chunk && fwrite(buffer.data(), 1, chunk, file) == chunk;
+            remaining -= chunk;
+        }
+        fclose(input);
+        position += size - remaining;
+        return ok;
+    }
+
+    /* Compresses data block by block into a block table followed by the
+       blocks. Returns false, leaving out unspecified, when the result would
+       not be at least an eighth smaller. */
+    bool compressPayload(const std::vector<uint8_t>& data, uint32_t blockSize, ThreadPool& pool, std::vector<uint8_t>& out)
+    {
+        const size_t blockCount = (data.size() + blockSize - 1) / blockSize;
+        std::vector<std::vector<uint8_t>> blocks(blockCount);
+        pool.parallelFor(blockCount, [&](size_t block)
+        {
+            const size_t begin = block * blockSize;
+            const size_t length = std::min<size_t>(blockSize, data.size() - begin);
+            lz4Compress(data.data() + begin, length, blocks[block]);
+            if (blocks[block].size() >= length)
+                blocks[block].assign(data.begin() + begin, data.begin() + begin + length);
+        });
+
+        size_t total = blockCount * 4;
+        for (const std::vector<uint8_t>& block : blocks)
+            total += block.size();
+        if (total > data.size() - data.size() / 8 || total - blockCount * 4 > UINT32_MAX)
+            return false;
+
+        out.resize(blockCount * 4);
+        uint32_t end = 0;
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            end += (uint32_t)blocks[block].size();
+            memcpy(out.data() + block * 4, &end, 4);
+        }
+        for (const std::vector<uint8_t>& block : blocks)
+            out.insert(out.end(), block.begin(), block.end());
+        return true;
+    }
+}
+
+bool buildAssetPack(const std::string& directory, const std::string& output, uint32_t alignment,
+    PackCompression compression, ThreadPool& pool, std::string& log)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        log = "pack alignment must be a power of two";
+        return false;
+    }
+
+    std::vector<PackSource> sources;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        if (!it->is_regular_file(error))
+            continue;
+        PackSource source;
+        source.path = it->path();
+        source.name = it->path().lexically_relative(directory).generic_string();
+        source.entry = PackEntry();
+        source.entry.hash = hashAssetName(source.name.data(), source.name.size());
+        source.entry.size = it->file_size(error);
+        source.entry.storedSize = source.entry.size;
+        source.entry.type = assetTypeFromPath(source.name);
+        source.entry.compression = kPackStored;
+        sources.push_back(std::move(source));
+    }
+    if (error)
+    {
+        log = "cannot list " + directory + ": " + error.message();
+        return false;
+    }
+
+    std::sort(sources.begin(), sources.end(), [](const PackSource& a, const PackSource& b)
+    {
+        return a.entry.hash != b.entry.hash ? a.entry.hash < b.entry.hash : a.name < b.name;
+    });
+
+    PackHeader header = PackHeader();
+    memcpy(header.magic, "APAK", 4);
+    header.version = kPackVersion;
+    header.entryCount = (uint32_t)sources.size();
+    header.alignment = alignment;
+    header.blockSize = kPackDefaultBlockSize;
+    header.tocOffset = sizeof(PackHeader);
+    header.namesOffset = header.tocOffset + sources.size() * sizeof(PackEntry);
+    std::string names;
+    for (PackSource& source : sources)
+    {
+        source.entry.nameOffset = (uint32_t)names.size();
+        source.entry.nameLength = (uint32_t)source.name.size();
+        names += source.name;
+    }
+    header.namesSize = names.size();
+
+    /* Stored sizes are only known once each file has been compressed, so the
+       header and table are written twice: as placeholders first and for real
+       once the payloads are in. */
+    FILE* file = fopen(output.c_str(), "wb");
+    if (!file)
+    {
+        log = "cannot create " + output;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < sources.size(); ++i)
+        ok = fwrite(&sources[i].entry, sizeof(PackEntry), 1, file) == 1;
+    ok = ok && fwrite(names.data(), 1, names.size(), file) == names.size();
+
+    uint64_t position = header.namesOffset + header.namesSize;
+    std::vector<uint8_t> contents;
+    std::vector<uint8_t> packed;
+    for (size_t i = 0; ok && i < sources.size(); ++i)
+    {
+        PackEntry& entry = sources[i].entry;
+        entry.offset = (position + alignment - 1) / alignment * alignment;
+        ok = writePadding(file, position, entry.offset);
+        if (ok && compression == kPackLz4 && entry.size > 0)
+        {
+            ok = readBinaryFile(sources[i].path.string(), contents) && contents.size() == entry.size;
+            const bool shrunk = ok && compressPayload(contents, header.blockSize, pool, packed);
+            const std::vector<uint8_t>& payload = shrunk ? packed : contents;
+            ok = ok && fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+            entry.compression = shrunk ? kPackLz4 : kPackStored;
+            entry.storedSize = payload.size();
+            position += payload.size();
+        }
+        else
+            ok = ok && copyPayload(file, sources[i].path, entry.size, position);
+        if (!ok)
+            log = "cannot pack " + sources[i].path.string();
+    }
+    header.fileSize = position;
+
+    rewind(file);
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < sources.size(); ++i)
+        ok = fwrite(&sources[i].entry, sizeof(PackEntry), 1, file) == 1;
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok && log.empty())
+        log = "cannot write " + output;
+    return ok;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+class ThreadPool;
+
+/* Single-file asset archive, memory mapped and used in place.
+
+   Layout (little-endian, read by casting the mapped bytes):
+
+       PackHeader                       64 bytes
+       PackEntry[entryCount]            sorted by (hash, name)
+       names                            entry paths back to back, no terminators
+       payloads                         each starting on a header.alignment boundary
+
+   Names are paths relative to the packed directory with '/' separators, e.g.
+   "textures/stone.dds". Lookups hash the name (FNV-1a, 64-bit), binary search
+   the table of contents and compare the name to rule out collisions, so
+   opening a pack costs one mapping and a validation pass over the table, not
+   a file open per asset. Payloads are page aligned by default, which keeps
+   them usable for unbuffered reads and lets the OS fault each in on its own.
+
+   A payload is either stored as is, and used in place through data(), or
+   LZ4 compressed in independent blocks of header.blockSize bytes (see Lz4.h).
+   A compressed payload starts with a uint32 per block giving where that block
+   ends, counted from the end of this table; a block whose stored length
+   equals its decompressed length did not compress and is kept raw. Blocks
+   give random access into large assets and let read() decompress one asset
+   on several threads at once, so loading keeps up with the disk instead of a
+   single core. */
+
+const uint32_t kPackVersion = 2;
+const uint32_t kPackDefaultAlignment = 4096;
+const uint32_t kPackDefaultBlockSize = 64 * 1024;
+
+enum AssetType
+{
+    kAssetRaw,
+    kAssetImage,             /* PNG, JPEG, TGA */
+    kAssetCompressedTexture, /* DDS, KTX */
+    kAssetShader,            /* GLSL */
+    kAssetMesh,              /* OBJ, glTF */
+};
+
+enum PackCompression
+{
+    kPackStored,
+    kPackLz4,
+};
+
+struct PackHeader
+{
+    char magic[4];          /* "APAK" */
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+    uint64_t fileSize;
+    uint32_t blockSize;     /* decompressed bytes per LZ4 block */
+    uint8_t reserved[12];
+};
+
+struct PackEntry
+{
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;          /* decompressed */
+    uint64_t storedSize;    /* in the file, block table included */
+    uint32_t nameOffset;    /* into the names block */
+    uint32_t nameLength;
+    uint32_t type;          /* AssetType */
+    uint32_t compression;   /* PackCompression */
+};
+
+static_assert(sizeof(PackHeader) == 64, "PackHeader layout");
+static_assert(sizeof(PackEntry) == 48, "PackEntry layout");
+
+uint64_t hashAssetName(const char* name, size_t length);
+
+/* Classifies a path by its extension. */
+AssetType assetTypeFromPath(const std::string& path);
+
+class AssetPack
+{
+public:
+    AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    /* Maps the file and checks the header and every entry's bounds. */
+    bool open(const std::string& path, std::string& log);
+    void close();
+
+    bool isOpen() const { return m_header != NULL; }
+    size_t count() const { return m_header ? m_header->entryCount : 0; }
+    const PackEntry& entry(size_t index) const { return m_entries[index]; }
+
+    /* NULL when the pack has no such asset. */
+    const PackEntry* find(const std::string& name) const;
+
+    /* Pointer into the mapping, valid while the pack is open. For stored
+       entries this is the asset itself; compressed ones go through read(). */
+    const uint8_t* data(const PackEntry& entry) const { return m_file.data() + entry.offset; }
+    bool compressed(const PackEntry& entry) const { return entry.compression != kPackStored; }
+    std::string name(const PackEntry& entry) const;
+
+    /* Copies bytes [offset, offset + size) of the decompressed asset to out,
+       which may be any writable memory, including a mapped staging buffer
+       when the asset is already in its GPU layout.
+       Only the blocks covering the range are decompressed, spread over pool
+       when one is given (safe from inside a pool job). Returns false with a
+       message on a range outside the asset or corrupt data. */
+    bool read(const PackEntry& entry, uint64_t offset, size_t size, uint8_t* out, ThreadPool* pool, std::string& log) const;
+
+    /* The whole asset into a vector; see above. */
+    bool read(const PackEntry& entry, std::vector<uint8_t>& out, ThreadPool* pool, std::string& log) const;
+
+    uint32_t blockSize() const { return m_header ? m_header->blockSize : 0; }
+
+    /* Starts reading an asset in ahead of use. */
+    void prefetch(const PackEntry& entry) const { m_file.prefetch((size_t)entry.offset, (size_t)entry.storedSize); }
+
+private:
+    MappedFile m_file;
+    const PackHeader* m_header;
+    const PackEntry* m_entries;
+    const char* m_names;
+};
+
+/* AssetPack::read() for a payload fetched some other way, e.g. through
+   AssetReader: stored holds the entry's storedSize bytes and blockSize comes
+   from the pack header. */
+bool readPackPayload(const PackEntry& entry, uint32_t blockSize, const uint8_t* stored, uint64_t offset, size_t size,
+    uint8_t* out, ThreadPool* pool, std::string& log);
+
+/* Packs every regular file below directory into output. With kPackLz4 each
+   file is compressed block by block on pool and kept compressed only when
+   that saves at least an eighth, so already-compressed formats such as PNG
+   and JPEG stay zero-copy. Stored files are streamed, so the pack may be
+   larger than memory; compressed ones are read whole. */
+bool buildAssetPack(const std::string& directory, const std::string& output, uint32_t alignment,
+    PackCompression compression, ThreadPool& pool, std::string& log);
@@ -0,0 +1,413 @@
+#include "AssetReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ASSET_READER_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+/* The shared rings, mapped from the kernel. The kernel advances the
+   submission head and the completion tail; we own the other two. */
+struct AssetReader::Ring
+{
+#ifdef ASSET_READER_IO_URING
+    int fd;
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    io_uring_cqe* cqes;
+    unsigned cqMask;
+    unsigned toSubmit;
+    std::vector<iovec> iovecs;  /* by slot; older kernels read them after submission */
+#endif
+};
+
+AssetReader::AssetReader(ThreadPool& pool, unsigned queueDepth)
+    : m_pool(pool)
+    , m_queueDepth(queueDepth > 0 ? queueDepth : 1)
+    , m_inFlight(0)
+    , m_inFlightPrefetch(0)
+    , m_ring(NULL)
+{
+    if (setupRing(m_queueDepth))
+    {
+        m_slots.resize(m_queueDepth);
+        for (size_t slot = m_queueDepth; slot-- > 0;)
+            m_freeSlots.push_back(slot);
+    }
+}
+
+AssetReader::~AssetReader()
+{
+    m_queued[kReadVisible].clear();
+    m_queued[kReadPrefetch].clear();
+
+    /* The kernel or a worker may still be writing into request buffers. */
+    if (m_ring)
+    {
+        std::vector<Request> finished;
+        while (m_inFlight > 0 && enterRing(true))
+        {
+            reapRing(finished);
+            m_inFlight -= finished.size();
+            finished.clear();
+        }
+        destroyRing();
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this]() { return m_done.size() == m_inFlight; });
+    }
+
+#ifdef _WIN32
+    for (void* handle : m_files)
+        CloseHandle((HANDLE)handle);
+#else
+    for (int fd : m_files)
+        ::close(fd);
+#endif
+}
+
+int AssetReader::openFile(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return -1;
+    m_files.push_back(handle);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    m_files.push_back(fd);
+#endif
+    return (int)m_files.size() - 1;
+}
+
+void AssetReader::read(int file, uint64_t offset, size_t size, Priority priority, Completion completion)
+{
+    Request request;
+    request.file = file;
+    request.offset = offset;
+    request.size = size;
+    request.done = 0;
+    request.priority = priority;
+    request.completion = completion;
+    request.ok = false;
+    m_queued[priority].push_back(std::move(request));
+}
+
+void AssetReader::poll()
+{
+    std::vector<Request> finished;
+    if (m_ring)
+        reapRing(finished);
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Request& request : m_done)
+            finished.push_back(std::move(request));
+        m_done.clear();
+    }
+    for (const Request& request : finished)
+    {
+        m_inFlight--;
+        if (request.priority == kReadPrefetch)
+            m_inFlightPrefetch--;
+    }
+
+    /* Buffers are only allocated once a read is actually issued. */
+    const size_t prefetchLimit = std::max(1u, m_queueDepth / 2);
+    while (m_inFlight < m_queueDepth)
+    {
+        std::deque<Request>* queue = NULL;
+        if (!m_queued[kReadVisible].empty())
+            queue = &m_queued[kReadVisible];
+        else if (!m_queued[kReadPrefetch].empty() && m_inFlightPrefetch < prefetchLimit)
+            queue = &m_queued[kReadPrefetch];
+        else
+            break;
+        Request request = std::move(queue->front());
+        queue->pop_front();
+
+        const bool isOpen = request.file >= 0 && request.file < (int)m_files.size();
+        if (!isOpen || request.size == 0)
+        {
+            request.ok = isOpen;
+            request.log = isOpen ? "" : "read from a file that is not open";
+            finished.push_back(std::move(request));
+            continue;
+        }
+
+        m_inFlight++;
+        if (request.priority == kReadPrefetch)
+            m_inFlightPrefetch++;
+        if (m_ring)
+        {
+            const size_t slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+            m_slots[slot] = std::move(request);
+            m_slots[slot].data.resize(m_slots[slot].size);
+            submitToRing(m_slots[slot], slot);
+        }
+        else
+            startOnPool(request);
+    }
+    if (m_ring)
+        enterRing(false);
+
+    for (Request& request : finished)
+    {
+        if (!request.ok)
+            request.data.clear();
+        request.completion(request.ok, request.data, request.log);
+    }
+}
+
+void AssetReader::wait()
+{
+    for (;;)
+    {
+        poll();
+        if (pending() == 0)
+            return;
+        if (m_ring)
+        {
+            if (!enterRing(true))
+                return;
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_finished.wait(lock, [this]() { return !m_done.empty(); });
+        }
+    }
+}
+
+void AssetReader::startOnPool(Request& request)
+{
+    /* Copied out, as openFile() may grow m_files meanwhile. */
+    const auto file = m_files[request.file];
+    m_pool.enqueue([this, file, request]() mutable
+    {
+        request.data.resize(request.size);
+        while (request.done < request.size)
+        {
+            const uint64_t position = request.offset + request.done;
+            const size_t remaining = request.size - request.done;
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)position;
+            overlapped.OffsetHigh = (DWORD)(position >> 32);
+            DWORD got = 0;
+            if (!ReadFile((HANDLE)file, request.data.data() + request.done, (DWORD)std::min<size_t>(remaining, 1 << 30),
+                &got, &overlapped) || got == 0)
+                break;
+#else
+            const ssize_t got = pread(file, request.data.data() + request.done, remaining, (off_t)position);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+#endif
+            request.done += (size_t)got;
+        }
+        request.ok = request.done == request.size;
+        if (!request.ok)
+            request.log = "read failed after " + std::to_string(request.done) + " of " + std::to_string(request.size) + " bytes";
+
+        /* The destructor may be waiting on this; nothing touches the reader
+           after the lock is released. */
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done.push_back(std::move(request));
+        m_finished.notify_all();
+    });
+}
+
+#ifdef ASSET_READER_IO_URING
+
+bool AssetReader::setupRing(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return false;
+
+    Ring* ring = new Ring();
+    ring->fd = fd;
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+        ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cqMap = singleMap ? ring->sqMap
+        : mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    ring->sqes = sqes == MAP_FAILED ? NULL : (io_uring_sqe*)sqes;
+    m_ring = ring;
+    if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED || !ring->sqes)
+    {
+        destroyRing();
+        return false;
+    }
+
+    uint8_t* sq = (uint8_t*)ring->sqMap;
+    ring->sqHead = (unsigned*)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    uint8_t* cq = (uint8_t*)ring->cqMap;
+    ring->cqHead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->toSubmit = 0;
+    ring->iovecs.resize(entries);
+    return true;
+}
+
+void AssetReader::destroyRing()
+{
+    Ring* ring = m_ring;
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqMap != MAP_FAILED && ring->cqMap != ring->sqMap)
+        munmap(ring->cqMap, ring->cqMapSize);
+    if (ring->sqMap != MAP_FAILED)
+        munmap(ring->sqMap, ring->sqMapSize);
+    ::close(ring->fd);
+    delete ring;
+    m_ring = NULL;
+}
+
+void AssetReader::submitToRing(Request& request, size_t slot)
+{
+    Ring& ring = *m_ring;
+    const unsigned tail = *ring.sqTail;
+    const unsigned index = tail & ring.sqMask;
+
+    iovec& iov = ring.iovecs[slot];
+    iov.iov_base = request.data.data() + request.done;
+    iov.iov_len = request.size - request.done;
+
+    io_uring_sqe& sqe = ring.sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = m_files[request.file];
+    sqe.off = request.offset + request.done;
+    sqe.addr = (uint64_t)(uintptr_t)&iov;
+    sqe.len = 1;
+    sqe.user_data = slot;
+    ring.sqArray[index] = index;
+
+    /* Publishes the entry to the kernel. */
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring.toSubmit++;
+}
+
+bool AssetReader::enterRing(bool wait)
+{
+    Ring& ring = *m_ring;
+    if (ring.toSubmit == 0 && !wait)
+        return true;
+    int result;
+    do
+    {
+        result = (int)syscall(__NR_io_uring_enter, ring.fd, ring.toSubmit, wait ? 1 : 0,
+            wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0)
+        return false;
+    ring.toSubmit -= std::min<unsigned>(ring.toSubmit, (unsigned)result);
+    return true;
+}
+
+void AssetReader::reapRing(std::vector<Request>& finished)
+{
+    Ring& ring = *m_ring;
+    unsigned head = *ring.cqHead;
+    const unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+        const size_t slot = (size_t)cqe.user_data;
+        Request& request = m_slots[slot];
+        if (cqe.res > 0)
+        {
+            /* Short reads happen at the end of a file and on some file
+               systems; ask for the rest. */
+            request.done += (size_t)cqe.res;
+            if (request.done < request.size)
+            {
+                submitToRing(request, slot);
+                continue;
+            }
+            request.ok = true;
+        }
+        else
+        {
+            request.ok = false;
+            request.log = cqe.res < 0 ? std::string("read failed: ") + strerror(-cqe.res) : "unexpected end of file";
+        }
+        finished.push_back(std::move(request));
+        m_freeSlots.push_back(slot);
+    }
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool AssetReader::setupRing(unsigned)
+{
+    return false;
+}
+
+void AssetReader::destroyRing()
+{
+}
+
+void AssetReader::submitToRing(Request&, size_t)
+{
+}
+
+bool AssetReader::enterRing(bool)
+{
+    return false;
+}
+
+void AssetReader::reapRing(std::vector<Request>&)
+{
+}
+
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/* Asynchronous reads of file ranges, for streaming assets without stalling
+   the frame.
+
+   On Linux reads go through an io_uring set up with the raw system calls:
+   poll() fills the submission ring and reaps the completion ring, one
+   io_uring_enter per call however many reads are in flight. Elsewhere, and
+   where the kernel refuses io_uring (older than 5.1, or blocked by a
+   container's seccomp profile), each read runs as a pread (ReadFile on
+   Windows) job on the thread pool instead.
+
+   Reads come in two priority classes. Visible reads are always submitted
+   before prefetches, and prefetches may only take half the queue depth, so a
+   visible read never waits behind more than that. Completion callbacks run
+   inside poll() on the calling thread, the GL thread in the demo, where they
+   can hand the data straight to the TextureStreamer. */
+class AssetReader
+{
+public:
+    enum Priority
+    {
+        kReadVisible,   /* needed for the frames being drawn now */
+        kReadPrefetch,  /* likely needed soon */
+    };
+
+    /* data holds the bytes read and may be moved from; on failure it is
+       empty and log says why. */
+    typedef std::function<void(bool ok, std::vector<uint8_t>& data, const std::string& log)> Completion;
+
+    explicit AssetReader(ThreadPool& pool, unsigned queueDepth = 32);
+
+    /* Waits for reads in flight and drops queued ones without running their
+       callbacks. */
+    ~AssetReader();
+
+    AssetReader(const AssetReader&) = delete;
+    AssetReader& operator=(const AssetReader&) = delete;
+
+    /* Returns a handle for read(), or -1 when the file cannot be opened.
+       Files stay open until the reader is destroyed. */
+    int openFile(const std::string& path);
+
+    /* Queues a read of size bytes at offset; see poll(). */
+    void read(int file, uint64_t offset, size_t size, Priority priority, Completion completion);
+
+    /* Collects finished reads, submits queued ones and runs the callbacks of
+       the finished ones, in that order so the disk stays busy while they run.
+       Never blocks. */
+    void poll();
+
+    /* Blocks until every read has completed and its callback has run. */
+    void wait();
+
+    /* Reads queued or in flight. */
+    size_t pending() const { return m_queued[kReadVisible].size() + m_queued[kReadPrefetch].size() + m_inFlight; }
+
+    bool usesIoUring() const { return m_ring != NULL; }
+
+private:
+    struct Request
+    {
+        int file;
+        uint64_t offset;
+        size_t size;
+        size_t done;        /* bytes read so far; reads may come back short */
+        Priority priority;
+        Completion completion;
+        std::vector<uint8_t> data;
+        bool ok;
+        std::string log;
+    };
+
+    struct Ring;
+
+    bool setupRing(unsigned entries);
+    void destroyRing();
+    void submitToRing(Request& request, size_t slot);
+
+    /* Submits what submitToRing() queued and, with wait, blocks until at
+       least one read completes. */
+    bool enterRing(bool wait);
+    void reapRing(std::vector<Request>& finished);
+
+    void startOnPool(Request& request);
+
+    ThreadPool& m_pool;
+    unsigned m_queueDepth;
+    std::deque<Request> m_queued[2];
+    size_t m_inFlight;
+    size_t m_inFlightPrefetch;
+#ifdef _WIN32
+    std::vector<void*> m_files;
+#else
+    std::vector<int> m_files;
+#endif
+
+    /* io_uring: reads in flight by slot, the slot index being the user data. */
+    Ring* m_ring;
+    std::vector<Request> m_slots;
+    std::vector<size_t> m_freeSlots;
+
+    /* Pool fallback: finished reads waiting for poll(). */
+    std::mutex m_mutex;
+    std::condition_variable m_finished;
+    std::vector<Request> m_done;
+};
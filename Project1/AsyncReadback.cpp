@@ -0,0 +1,136 @@
+#include "AsyncReadback.h"
+
+#include "Timer.h"
+
+#include <cstdio>
+
+AsyncReadback::AsyncReadback(int bufferCount, Callback callback)
+    : m_slots(bufferCount > 0 ? bufferCount : 1)
+    , m_next(0)
+    , m_oldest(0)
+    , m_pending(0)
+    , m_waitWhenFull(false)
+    , m_callback(callback)
+    , m_stats()
+{
+    for (Slot& slot : m_slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        slot.capacity = 0;
+        slot.fence = NULL;
+        slot.width = slot.height = 0;
+        slot.frameIndex = 0;
+    }
+}
+
+AsyncReadback::~AsyncReadback()
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+bool AsyncReadback::capture(int width, int height, uint64_t frameIndex)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    const double start = nowSeconds();
+    if (m_pending == m_slots.size())
+    {
+        if (!m_waitWhenFull)
+        {
+            m_stats.dropped++;
+            m_stats.cpuSeconds += nowSeconds() - start;
+            return false;
+        }
+        m_stats.waits++;
+        m_stats.cpuSeconds += nowSeconds() - start;
+        deliver(m_slots[m_oldest], true);
+    }
+
+    Slot& slot = m_slots[m_next];
+    const size_t bytes = (size_t)width * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (bytes > slot.capacity)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+
+    /* With a pack buffer bound the pointer is an offset and the call returns
+       without waiting for rendering to finish. */
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.frameIndex = frameIndex;
+
+    m_next = (m_next + 1) % m_slots.size();
+    m_pending++;
+    m_stats.cpuSeconds += nowSeconds() - start;
+    return true;
+}
+
+void AsyncReadback::poll()
+{
+    while (m_pending > 0 && deliver(m_slots[m_oldest], false))
+        ;
+}
+
+void AsyncReadback::drain()
+{
+    while (m_pending > 0 && deliver(m_slots[m_oldest], true))
+        ;
+}
+
+bool AsyncReadback::deliver(Slot& slot, bool wait)
+{
+    const double start = nowSeconds();
+    GLenum state = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+    if (state == GL_WAIT_FAILED)
+    {
+        /* The fence will never signal, so waiting again would spin; give
+           up on this frame and free its buffer. */
+        fprintf(stderr, "readback: waiting for frame %llu failed, dropping it\n",
+            (unsigned long long)slot.frameIndex);
+        glDeleteSync(slot.fence);
+        slot.fence = NULL;
+        m_oldest = (m_oldest + 1) % m_slots.size();
+        m_pending--;
+        m_stats.cpuSeconds += nowSeconds() - start;
+        return false;
+    }
+    if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+    {
+        m_stats.cpuSeconds += nowSeconds() - start;
+        return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = NULL;
+
+    const size_t bytes = (size_t)slot.width * slot.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const uint8_t* pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    m_stats.cpuSeconds += nowSeconds() - start;
+
+    if (pixels)
+    {
+        ReadbackFrame frame = { pixels, slot.width, slot.height, (size_t)slot.width * 4, slot.frameIndex };
+        if (m_callback)
+            m_callback(frame);
+        m_stats.captured++;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_oldest = (m_oldest + 1) % m_slots.size();
+    m_pending--;
+    return true;
+}
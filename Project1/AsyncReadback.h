@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* A captured frame as delivered to an AsyncReadback callback. Pixels are
+   tightly packed RGBA8 rows, bottom row first as GL returns them, and are only
+   valid during the callback. */
+struct ReadbackFrame
+{
+    const uint8_t* pixels;
+    int width;
+    int height;
+    size_t stride;
+    uint64_t frameIndex;
+};
+
+/* Reads the framebuffer back without stalling the pipeline.
+
+   capture() issues glReadPixels into one of a rotating set of
+   GL_PIXEL_PACK_BUFFER objects, which returns immediately, and fences it.
+   poll() checks the oldest fence without waiting and, once the copy has
+   finished, maps the buffer and hands the pixels to the callback, typically
+   a couple of frames later. When every buffer is still in flight the capture
+   is dropped rather than waited for, unless setWaitWhenFull() asks for every
+   frame to be kept. */
+class AsyncReadback
+{
+public:
+    typedef std::function<void(const ReadbackFrame&)> Callback;
+
+    struct Stats
+    {
+        uint64_t captured;   /* frames handed to the callback */
+        uint64_t dropped;    /* captures skipped because all buffers were busy */
+        uint64_t waits;      /* captures that waited for a busy buffer instead */
+        double cpuSeconds;   /* spent in capture() and poll(), excluding the callback */
+    };
+
+    AsyncReadback(int bufferCount, Callback callback);
+    ~AsyncReadback();
+
+    AsyncReadback(const AsyncReadback&) = delete;
+    AsyncReadback& operator=(const AsyncReadback&) = delete;
+
+    /* Recording needs every frame: wait for the oldest buffer instead of
+       dropping when all of them are in flight. */
+    void setWaitWhenFull(bool wait) { m_waitWhenFull = wait; }
+
+    /* Queues a readback of the current read framebuffer. Call after rendering
+       and before swapping. Returns false if the capture was dropped. */
+    bool capture(int width, int height, uint64_t frameIndex);
+
+    /* Delivers every finished readback to the callback. Never blocks. */
+    void poll();
+
+    /* Blocks until every queued readback has been delivered, or dropped if
+       its fence cannot be waited on; for shutdown. */
+    void drain();
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Slot
+    {
+        GLuint buffer;
+        size_t capacity;
+        GLsync fence;
+        int width;
+        int height;
+        uint64_t frameIndex;
+    };
+
+    bool deliver(Slot& slot, bool wait);
+
+    std::vector<Slot> m_slots;
+    size_t m_next;    /* slot the next capture goes into */
+    size_t m_oldest;  /* oldest slot in flight */
+    size_t m_pending;
+    bool m_waitWhenFull;
+    Callback m_callback;
+    Stats m_stats;
+};
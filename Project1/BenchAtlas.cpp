@@ -0,0 +1,229 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "Shader.h"
+#include "TextureAtlas.h"
+#include "Timer.h"
+
+/* A sprite batch through TextureAtlas against one texture per sprite.
+   kSprites images of random size are made at run time and added to the
+   atlas in a single frame, so one flush() has to bring them all to the GPU;
+   then every frame draws the whole batch with one glDrawArrays from one
+   vertex buffer. The baseline uploads each image into its own texture and
+   binds it before its own draw. Reports the upload calls and bytes, the
+   CPU cost of adding and uploading, and the per-frame submit and GPU time. */
+
+static const int kAtlasSize = 2048;
+static const int kSprites = 400;
+static const int kMinSide = 8;
+static const int kMaxSide = 64;
+static const int kFrames = 300;
+static const int kFloatsPerVertex = 4;      /* position xy, texcoord uv */
+
+static const char* kVertex =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 aPosition;\n"
+    "layout(location = 1) in vec2 aTexcoord;\n"
+    "out vec2 vTexcoord;\n"
+    "void main() { vTexcoord = aTexcoord; gl_Position = vec4(aPosition, 0.0, 1.0); }\n";
+
+static const char* kFragment =
+    "#version 330 core\n"
+    "in vec2 vTexcoord;\n"
+    "out vec4 fragColor;\n"
+    "uniform sampler2D sprite;\n"
+    "void main() { fragColor = texture(sprite, vTexcoord); }\n";
+
+static int randomInt(int low, int high)
+{
+    return low + rand() % (high - low + 1);
+}
+
+/* A tinted diagonal gradient with a one-texel dark frame, so bleeding from
+   a neighbour would show on screen. */
+static void makeSprite(Image& image)
+{
+    image.width = randomInt(kMinSide, kMaxSide);
+    image.height = randomInt(kMinSide, kMaxSide);
+    image.pixels.resize((size_t)image.width * image.height * 4);
+    const int tint[3] = { randomInt(64, 255), randomInt(64, 255), randomInt(64, 255) };
+    for (int y = 0; y < image.height; ++y)
+    {
+        for (int x = 0; x < image.width; ++x)
+        {
+            uint8_t* p = &image.pixels[((size_t)y * image.width + x) * 4];
+            const bool frame = x == 0 || y == 0 || x == image.width - 1 || y == image.height - 1;
+            const int shade = frame ? 32 : 128 + 127 * (x + y) / (image.width + image.height);
+            for (int c = 0; c < 3; ++c)
+                p[c] = (uint8_t)(tint[c] * shade / 255);
+            p[3] = 255;
+        }
+    }
+}
+
+/* Two triangles at a random spot on screen, the sprite's size in texels at
+   a 1280 x 720 viewport. */
+static void appendQuad(const Image& image, float u0, float v0, float u1, float v1, std::vector<float>& vertices)
+{
+    const float x0 = (float)rand() / RAND_MAX * 1.8f - 0.9f;
+    const float y0 = (float)rand() / RAND_MAX * 1.8f - 0.9f;
+    const float x1 = x0 + image.width * 2.0f / 1280.0f;
+    const float y1 = y0 + image.height * 2.0f / 720.0f;
+    /* v0 is the image's top row, drawn at the top of the quad. */
+    const float quad[6][kFloatsPerVertex] = {
+        { x0, y1, u0, v0 }, { x0, y0, u0, v1 }, { x1, y0, u1, v1 },
+        { x0, y1, u0, v0 }, { x1, y0, u1, v1 }, { x1, y1, u1, v0 },
+    };
+    vertices.insert(vertices.end(), &quad[0][0], &quad[0][0] + 6 * kFloatsPerVertex);
+}
+
+static void report(const char* label, size_t uploads, size_t bytes, double addSeconds, double uploadSeconds,
+    int drawsPerFrame, double submitSeconds, double totalSeconds)
+{
+    printf("%-9s %4zu uploads %6.2f MB  add %6.3f ms  upload %6.3f ms  %4d draws/frame  submit %6.3f ms/frame, "
+        "with GPU %6.3f ms/frame\n",
+        label, uploads, bytes / 1e6, addSeconds * 1e3, uploadSeconds * 1e3, drawsPerFrame,
+        submitSeconds * 1e3 / kFrames, totalSeconds * 1e3 / kFrames);
+}
+
+int benchAtlas(GLFWwindow* window)
+{
+    std::string log;
+    GLuint program = buildProgram(kVertex, kFragment, log);
+    if (!program)
+    {
+        fprintf(stderr, "benchmark shaders failed:\n%s\n", log.c_str());
+        return -1;
+    }
+
+    srand(11);
+    std::vector<Image> sprites(kSprites);
+    for (Image& sprite : sprites)
+        makeSprite(sprite);
+
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, kFloatsPerVertex * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, kFloatsPerVertex * sizeof(float), (void*)(2 * sizeof(float)));
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "sprite"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glFinish();
+
+    /* Atlas: every image added in one frame, one flush, one draw. */
+    std::vector<float> vertices;
+    int result = 0;
+    {
+        TextureAtlas atlas(kAtlasSize, kAtlasSize);
+        glFinish();
+        double start = nowSeconds();
+        for (const Image& sprite : sprites)
+        {
+            TextureAtlas::Region region;
+            if (!atlas.add(sprite, region))
+            {
+                fprintf(stderr, "atlas: sprite %zu does not fit\n", vertices.size() / (6 * kFloatsPerVertex));
+                result = 1;
+                break;
+            }
+            appendQuad(sprite, region.u0, region.v0, region.u1, region.v1, vertices);
+        }
+        const double addSeconds = nowSeconds() - start;
+        start = nowSeconds();
+        atlas.flush();
+        glFinish();
+        const double uploadSeconds = nowSeconds() - start;
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+        const GLsizei vertexCount = (GLsizei)(vertices.size() / kFloatsPerVertex);
+        double submit = 0.0;
+        start = nowSeconds();
+        for (int f = 0; f < kFrames; ++f)
+        {
+            const double frameStart = nowSeconds();
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBindTexture(GL_TEXTURE_2D, atlas.texture());
+            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+            submit += nowSeconds() - frameStart;
+            glfwSwapBuffers(window);
+        }
+        glFinish();
+        const TextureAtlas::Stats stats = atlas.stats();
+        report("atlas", stats.uploads, stats.bytesUploaded, addSeconds, uploadSeconds, 1, submit, nowSeconds() - start);
+        printf("          %zu images, %.1f%% of the %d x %d page used\n", stats.images, 100.0f * stats.occupancy,
+            kAtlasSize, kAtlasSize);
+    }
+
+    /* Baseline: a texture per sprite, bound before each of its draws. The
+       quads keep their screen positions, with texcoords over the whole
+       texture. */
+    if (result == 0)
+    {
+        std::vector<GLuint> textures(kSprites);
+        glGenTextures(kSprites, textures.data());
+        size_t bytes = 0;
+        glFinish();
+        double start = nowSeconds();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (int i = 0; i < kSprites; ++i)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sprites[i].width, sprites[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                sprites[i].pixels.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            bytes += sprites[i].pixels.size();
+        }
+        glFinish();
+        const double uploadSeconds = nowSeconds() - start;
+        for (int i = 0; i < kSprites; ++i)
+        {
+            float* quad = &vertices[(size_t)i * 6 * kFloatsPerVertex];
+            const float texcoords[6][2] = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 1, 0 } };
+            for (int v = 0; v < 6; ++v)
+            {
+                quad[v * kFloatsPerVertex + 2] = texcoords[v][0];
+                quad[v * kFloatsPerVertex + 3] = texcoords[v][1];
+            }
+        }
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+        double submit = 0.0;
+        start = nowSeconds();
+        for (int f = 0; f < kFrames; ++f)
+        {
+            const double frameStart = nowSeconds();
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (int i = 0; i < kSprites; ++i)
+            {
+                glBindTexture(GL_TEXTURE_2D, textures[i]);
+                glDrawArrays(GL_TRIANGLES, i * 6, 6);
+            }
+            submit += nowSeconds() - frameStart;
+            glfwSwapBuffers(window);
+        }
+        glFinish();
+        report("separate", kSprites, bytes, 0.0, uploadSeconds, kSprites, submit, nowSeconds() - start);
+        glDeleteTextures(kSprites, textures.data());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    return result;
+}
@@ -0,0 +1,181 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/* Block compression: encoder throughput and quality per format and mode, one
+   thread against the whole pool, then the GL cost of uploading the result
+   next to the same image as RGBA8. The source is a 1024x1024 synthetic
+   image with gradients, hard edges and a varying alpha ramp. */
+
+static const int kSize = 1024;
+static const int kUploadRounds = 20;
+
+static void makeSource(Image& image)
+{
+    image.width = image.height = kSize;
+    image.pixels.resize((size_t)kSize * kSize * 4);
+    for (int y = 0; y < kSize; ++y)
+    {
+        for (int x = 0; x < kSize; ++x)
+        {
+            uint8_t* p = &image.pixels[((size_t)y * kSize + x) * 4];
+            const float wave = std::sin(x * 0.021f) * std::cos(y * 0.017f);
+            p[0] = (uint8_t)(127.5f + 127.0f * wave);
+            p[1] = (uint8_t)(128.0f + 100.0f * std::sin((x + y) * 0.013f));
+            p[2] = (uint8_t)(((x >> 5) + (y >> 5)) & 1 ? 210 : 50);
+            p[3] = (uint8_t)(x * 255 / (kSize - 1));
+        }
+    }
+}
+
+/* compressImage() without the pool, for the single-thread figure. */
+static void compressSerial(const Image& image, BlockFormat format, BlockQuality quality, std::vector<uint8_t>& out)
+{
+    out.resize(compressedSize(format, image.width, image.height));
+    uint8_t texels[64];
+    uint8_t* block = out.data();
+    for (int by = 0; by < image.height; by += 4)
+    {
+        for (int bx = 0; bx < image.width; bx += 4, block += blockBytes(format))
+        {
+            for (int y = 0; y < 4; ++y)
+                memcpy(texels + y * 16, &image.pixels[((size_t)(by + y) * image.width + bx) * 4], 16);
+            compressBlock(format, quality, texels, block);
+        }
+    }
+}
+
+/* PSNR over the channels the format stores. */
+static double psnr(const Image& a, const Image& b, int channels)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < a.pixels.size(); i += 4)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            const double d = (double)a.pixels[i + c] - b.pixels[i + c];
+            sum += d * d;
+        }
+    }
+    const double mse = sum / ((double)a.width * a.height * channels);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+/* Milliseconds per upload of a whole level, GPU work included. */
+static double timeUpload(GLenum internalFormat, bool compressed, const std::vector<uint8_t>& data)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    auto upload = [&]()
+    {
+        if (compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, kSize, kSize, 0, (GLsizei)data.size(), data.data());
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, kSize, kSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+    };
+    upload();
+    glFinish();
+
+    const double start = nowSeconds();
+    for (int round = 0; round < kUploadRounds; ++round)
+        upload();
+    glFinish();
+    const double elapsed = (nowSeconds() - start) / kUploadRounds;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+    return elapsed * 1000.0;
+}
+
+int benchCompress(GLFWwindow*)
+{
+    static const struct { const char* name; BlockFormat format; int channels; } kFormats[] = {
+        { "BC1", kBC1, 3 }, { "BC3", kBC3, 4 }, { "BC4", kBC4, 1 }, { "BC5", kBC5, 2 }, { "BC7", kBC7, 4 },
+    };
+    static const char* kQualityNames[] = { "fast", "high" };
+
+    Image source;
+    makeSource(source);
+    Image opaque = source;
+    for (size_t i = 3; i < opaque.pixels.size(); i += 4)
+        opaque.pixels[i] = 255;
+
+    ThreadPool& pool = ThreadPool::shared();
+    const double megapixels = (double)kSize * kSize / 1e6;
+    printf("%dx%d source, %u threads\n", kSize, kSize, pool.size() + 1);
+    printf("format  mode   1 thread      %2u threads    PSNR\n", pool.size() + 1);
+
+    std::vector<uint8_t> encoded[5];
+    for (const auto& entry : kFormats)
+    {
+        /* BC1 alpha is 1-bit; measure its colour on the opaque variant. */
+        const Image& input = entry.format == kBC1 ? opaque : source;
+        for (int quality = kBlockFast; quality <= kBlockHigh; ++quality)
+        {
+            std::vector<uint8_t> blocks;
+            double start = nowSeconds();
+            compressSerial(input, entry.format, (BlockQuality)quality, blocks);
+            const double one = nowSeconds() - start;
+            start = nowSeconds();
+            compressImage(input, entry.format, (BlockQuality)quality, pool, blocks);
+            const double all = nowSeconds() - start;
+
+            Image decoded;
+            decompressImage(entry.format, blocks.data(), kSize, kSize, pool, decoded);
+            printf("%-6s  %-4s  %7.1f Mpx/s  %7.1f Mpx/s  %5.2f dB\n", entry.name, kQualityNames[quality],
+                megapixels / one, megapixels / all, psnr(input, decoded, entry.channels));
+            encoded[entry.format] = std::move(blocks);
+        }
+    }
+
+    /* Opaque input must decode fully opaque, or alpha testing and blending
+       see holes. */
+    for (BlockFormat format : { kBC3, kBC7 })
+    {
+        for (int quality = kBlockFast; quality <= kBlockHigh; ++quality)
+        {
+            std::vector<uint8_t> blocks;
+            Image decoded;
+            compressImage(opaque, format, (BlockQuality)quality, pool, blocks);
+            decompressImage(format, blocks.data(), kSize, kSize, pool, decoded);
+            size_t translucent = 0;
+            for (size_t i = 3; i < decoded.pixels.size(); i += 4)
+                translucent += decoded.pixels[i] != 255;
+            if (translucent)
+            {
+                fprintf(stderr, "%s %s: %zu texels of an opaque image decode with alpha below 255\n",
+                    format == kBC3 ? "BC3" : "BC7", kQualityNames[quality], translucent);
+                return 1;
+            }
+        }
+    }
+
+    const double rgbaMs = timeUpload(GL_RGBA8, false, source.pixels);
+    printf("\nupload   size      ms/level\n");
+    printf("RGBA8   %5zu KiB  %7.3f\n", source.pixels.size() / 1024, rgbaMs);
+    for (const auto& entry : kFormats)
+    {
+        if (!compressedFormatSupported(entry.format, false))
+        {
+            printf("%-6s  %5zu KiB  not supported by the driver\n", entry.name, encoded[entry.format].size() / 1024);
+            continue;
+        }
+        const double ms = timeUpload(compressedGlFormat(entry.format, false), true, encoded[entry.format]);
+        printf("%-6s  %5zu KiB  %7.3f  (%.1fx smaller)\n", entry.name, encoded[entry.format].size() / 1024, ms,
+            (double)source.pixels.size() / encoded[entry.format].size());
+    }
+    return 0;
+}
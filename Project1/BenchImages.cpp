@@ -0,0 +1,161 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ImageLoader.h"
+#include "PngEncoder.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/* Image decoding throughput, one thread against the whole pool. The corpus is
+   synthetic PNG (RGB and RGBA) and RLE TGA, plus every .png, .jpg and .tga
+   found in an images/ directory, which is how JPEG gets covered. Decoding
+   includes conversion to premultiplied sRGB RGBA. */
+
+static const int kGeneratedImages = 48;
+static const int kRounds = 3;
+
+struct EncodedImage
+{
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+static void makePixels(int seed, int width, int height, std::vector<uint8_t>& rgba)
+{
+    rgba.resize((size_t)width * height * 4);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+            const float wave = std::sin(x * 0.031f + seed) * std::cos(y * 0.027f - seed);
+            p[0] = (uint8_t)(127.5f + 127.0f * wave);
+            p[1] = (uint8_t)((x ^ y) + seed * 17);
+            p[2] = (uint8_t)(((x >> 4) + (y >> 4) + seed) & 1 ? 220 : 40);
+            p[3] = (uint8_t)(255 - ((x * 255 / width) & 0xf0));
+        }
+    }
+}
+
+/* Bottom-up 24-bit RLE TGA. */
+static void encodeTga(const std::vector<uint8_t>& rgba, int width, int height, std::vector<uint8_t>& out)
+{
+    const uint8_t header[18] = { 0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        (uint8_t)width, (uint8_t)(width >> 8), (uint8_t)height, (uint8_t)(height >> 8), 24, 0 };
+    out.assign(header, header + 18);
+    for (int y = height - 1; y >= 0; --y)
+    {
+        const uint8_t* row = &rgba[(size_t)y * width * 4];
+        for (int x = 0; x < width; )
+        {
+            int run = 1;
+            while (x + run < width && run < 128 && memcmp(row + (x + run) * 4, row + x * 4, 3) == 0)
+                ++run;
+            out.push_back((uint8_t)(0x80 | (run - 1)));
+            out.push_back(row[x * 4 + 2]);
+            out.push_back(row[x * 4 + 1]);
+            out.push_back(row[x * 4 + 0]);
+            x += run;
+        }
+    }
+}
+
+static void buildCorpus(std::vector<EncodedImage>& corpus)
+{
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<uint8_t> rgba;
+    for (int i = 0; i < kGeneratedImages; ++i)
+    {
+        const int width = 256 << (i % 3);
+        const int height = 256 << ((i + 1) % 3);
+        makePixels(i, width, height, rgba);
+
+        EncodedImage image;
+        switch (i % 3)
+        {
+        case 0:
+            image.name = "generated.png (RGBA)";
+            encodePng(rgba.data(), (size_t)width * 4, width, height, false, true, 6, pool, image.data);
+            break;
+        case 1:
+            image.name = "generated.png (RGB)";
+            encodePng(rgba.data(), (size_t)width * 4, width, height, false, false, 6, pool, image.data);
+            break;
+        default:
+            image.name = "generated.tga";
+            encodeTga(rgba, width, height, image.data);
+            break;
+        }
+        corpus.push_back(std::move(image));
+    }
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("images", error))
+    {
+        const std::string extension = entry.path().extension().string();
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga")
+            continue;
+        EncodedImage image;
+        image.name = entry.path().string();
+        if (readBinaryFile(image.name, image.data))
+            corpus.push_back(std::move(image));
+    }
+}
+
+int benchImages(GLFWwindow*)
+{
+    std::vector<EncodedImage> corpus;
+    buildCorpus(corpus);
+
+    const ImageOptions options = { true, true };
+    std::vector<Image> decoded(corpus.size());
+    std::vector<std::string> errors(corpus.size());
+    std::vector<char> ok(corpus.size());
+
+    auto decodeOne = [&](size_t i)
+    {
+        ok[i] = decodeImage(corpus[i].data.data(), corpus[i].data.size(), options, decoded[i], errors[i]);
+    };
+
+    /* Warm up allocations and tables once. */
+    for (size_t i = 0; i < corpus.size(); ++i)
+        decodeOne(i);
+    size_t pixels = 0;
+    for (size_t i = 0; i < corpus.size(); ++i)
+    {
+        if (!ok[i])
+        {
+            fprintf(stderr, "%s: %s\n", corpus[i].name.c_str(), errors[i].c_str());
+            return 1;
+        }
+        pixels += (size_t)decoded[i].width * decoded[i].height;
+    }
+
+    double start = nowSeconds();
+    for (int round = 0; round < kRounds; ++round)
+        for (size_t i = 0; i < corpus.size(); ++i)
+            decodeOne(i);
+    const double single = (nowSeconds() - start) / kRounds;
+
+    ThreadPool& pool = ThreadPool::shared();
+    start = nowSeconds();
+    for (int round = 0; round < kRounds; ++round)
+        pool.parallelFor(corpus.size(), decodeOne);
+    const double parallel = (nowSeconds() - start) / kRounds;
+
+    const double megapixels = pixels / 1e6;
+    printf("%zu images, %.1f Mpixel\n", corpus.size(), megapixels);
+    printf("1 thread    %8.1f images/s  %7.1f Mpixel/s\n", corpus.size() / single, megapixels / single);
+    printf("%2u threads  %8.1f images/s  %7.1f Mpixel/s  (%.2fx)\n", pool.size() + 1,
+        corpus.size() / parallel, megapixels / parallel, single / parallel);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Timer.h"
+#include "VectorMath.h"
+
+/* The math library's batched kernels against the plain loops they replace,
+   on instance-sized batches: a view-projection applied to every model
+   matrix, parent-times-local concatenation, points through one matrix,
+   quaternion products and TRS composition. The largest difference between
+   the two results is reported with each pair. composeTransforms() has no
+   SIMD path, so its row compares two scalar versions, the library's
+   makeTrs() against a textbook one, and is labelled so.
+
+   The reference loops are plain C++, so a compiler that vectorizes on its
+   own (GCC and Clang at -O2 and above) turns the simplest of them, points
+   and quaternion products, into SIMD code too; the gap there shows what
+   hand-written kernels add over the vectorizer, not over scalar code. */
+
+static const size_t kMatrices = 4096;
+static const size_t kPoints = 4096;
+static const int kRounds = 200;
+
+#if SIMD_AVX2
+static const char* kSimdName = "AVX2";
+#elif SIMD_SSE2
+static const char* kSimdName = "SSE2";
+#else
+static const char* kSimdName = "scalar";
+#endif
+
+/* Textbook column-major product, one element at a time. */
+static void scalarMultiply(const float* a, const float* b, float* out)
+{
+    float r[16];
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            r[column * 4 + row] = sum;
+        }
+    }
+    for (int i = 0; i < 16; ++i)
+        out[i] = r[i];
+}
+
+static void scalarQuatMultiply(const float* a, const float* b, float* out)
+{
+    const float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+    const float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+    const float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+    const float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+    out[3] = w;
+}
+
+/* Rotation matrix from the quaternion, then translation * rotation * scale
+   as two full products. */
+static void scalarCompose(const Vec3& t, const Quat& q, const Vec3& s, float* out)
+{
+    float translation[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, t.x, t.y, t.z, 1 };
+    float scale[16] = { s.x, 0, 0, 0, 0, s.y, 0, 0, 0, 0, s.z, 0, 0, 0, 0, 1 };
+    float rotation[16] = {
+        1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z), 2 * (q.x * q.z - q.w * q.y), 0,
+        2 * (q.x * q.y - q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x), 0,
+        2 * (q.x * q.z + q.w * q.y), 2 * (q.y * q.z - q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y), 0,
+        0, 0, 0, 1,
+    };
+    float rs[16];
+    scalarMultiply(rotation, scale, rs);
+    scalarMultiply(translation, rs, out);
+}
+
+static float random1()
+{
+    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static float maxDifference(const float* a, const float* b, size_t count)
+{
+    float difference = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+        difference = std::max(difference, std::fabs(a[i] - b[i]));
+    return difference;
+}
+
+/* Nanoseconds per item of the best of kRounds, which keeps the noise of a
+   busy desktop out. */
+template <typename Kernel>
+static double bestNanoseconds(size_t items, Kernel kernel)
+{
+    double best = 1e30;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        const double start = nowSeconds();
+        kernel();
+        best = std::min(best, nowSeconds() - start);
+    }
+    return best * 1e9 / items;
+}
+
+/* kernel names the second column: the SIMD flavour, or "scalar" for a
+   kernel without a SIMD path. */
+static void report(const char* name, double scalar, double simd, float difference, const char* kernel = kSimdName)
+{
+    printf("%-22s scalar %7.2f ns  %-6s %7.2f ns  %5.2fx  max difference %.2g\n", name, scalar, kernel, simd,
+        scalar / simd, difference);
+}
+
+int benchMath(GLFWwindow*)
+{
+    srand(7);
+    std::vector<Mat4> models(kMatrices), parents(kMatrices), scalarOut(kMatrices), simdOut(kMatrices);
+    std::vector<Vec3> translations(kMatrices), scales(kMatrices);
+    std::vector<Quat> rotations(kMatrices), quatA(kPoints), quatB(kPoints), quatScalar(kPoints), quatSimd(kPoints);
+    std::vector<Vec3> points(kPoints), pointsScalar(kPoints), pointsSimd(kPoints);
+    for (size_t i = 0; i < kMatrices; ++i)
+    {
+        translations[i] = Vec3{ random1() * 100.0f, random1() * 100.0f, random1() * 100.0f };
+        rotations[i] = makeQuat(Vec3{ random1(), random1(), random1() + 2.0f }, random1() * 3.0f);
+        scales[i] = Vec3{ 1.0f + random1() * 0.5f, 1.0f + random1() * 0.5f, 1.0f + random1() * 0.5f };
+        models[i] = makeTrs(translations[i], rotations[i], scales[i]);
+        parents[i] = makeTrs(translations[(i * 7) % kMatrices], rotations[(i * 13) % kMatrices], Vec3{ 1.0f, 1.0f, 1.0f });
+    }
+    for (size_t i = 0; i < kPoints; ++i)
+    {
+        points[i] = Vec3{ random1() * 10.0f, random1() * 10.0f, random1() * 10.0f };
+        quatA[i] = rotations[i % kMatrices];
+        quatB[i] = rotations[(i * 31 + 5) % kMatrices];
+    }
+    const Mat4 viewProjection = makePerspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f)
+        * makeLookAt(Vec3{ 0.0f, 50.0f, 200.0f }, Vec3{ 0.0f, 0.0f, 0.0f }, Vec3{ 0.0f, 1.0f, 0.0f });
+    const float* matrices[2] = { scalarOut[0].m, simdOut[0].m };
+
+    double scalar = bestNanoseconds(kMatrices, [&]() {
+        for (size_t i = 0; i < kMatrices; ++i)
+            scalarMultiply(viewProjection.m, models[i].m, scalarOut[i].m);
+    });
+    double simd = bestNanoseconds(kMatrices, [&]() { multiplyMatrices(viewProjection, models.data(), simdOut.data(), kMatrices); });
+    report("view-projection * M", scalar, simd, maxDifference(matrices[0], matrices[1], kMatrices * 16));
+
+    scalar = bestNanoseconds(kMatrices, [&]() {
+        for (size_t i = 0; i < kMatrices; ++i)
+            scalarMultiply(parents[i].m, models[i].m, scalarOut[i].m);
+    });
+    simd = bestNanoseconds(kMatrices, [&]() { multiplyMatrices(parents.data(), models.data(), simdOut.data(), kMatrices); });
+    report("parent[i] * local[i]", scalar, simd, maxDifference(matrices[0], matrices[1], kMatrices * 16));
+
+    scalar = bestNanoseconds(kMatrices, [&]() {
+        for (size_t i = 0; i < kMatrices; ++i)
+            scalarCompose(translations[i], rotations[i], scales[i], scalarOut[i].m);
+    });
+    simd = bestNanoseconds(kMatrices, [&]() {
+        composeTransforms(translations.data(), rotations.data(), scales.data(), simdOut.data(), kMatrices);
+    });
+    report("compose TRS", scalar, simd, maxDifference(matrices[0], matrices[1], kMatrices * 16), "scalar");
+
+    const Mat4& model = models[0];
+    scalar = bestNanoseconds(kPoints, [&]() {
+        for (size_t i = 0; i < kPoints; ++i)
+        {
+            const Vec3& p = points[i];
+            const float* m = model.m;
+            pointsScalar[i] = Vec3{ m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12], m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14] };
+        }
+    });
+    simd = bestNanoseconds(kPoints, [&]() { transformPoints(model, points.data(), pointsSimd.data(), kPoints); });
+    report("transform points", scalar, simd, maxDifference(&pointsScalar[0].x, &pointsSimd[0].x, kPoints * 3));
+
+    scalar = bestNanoseconds(kPoints, [&]() {
+        for (size_t i = 0; i < kPoints; ++i)
+            scalarQuatMultiply(&quatA[i].x, &quatB[i].x, &quatScalar[i].x);
+    });
+    simd = bestNanoseconds(kPoints, [&]() { multiplyQuats(quatA.data(), quatB.data(), quatSimd.data(), kPoints); });
+    report("quaternion product", scalar, simd, maxDifference(&quatScalar[0].x, &quatSimd[0].x, kPoints * 4));
+    return 0;
+}
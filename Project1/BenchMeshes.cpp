@@ -0,0 +1,343 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "IndexCodec.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "QuantizedMesh.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/* OBJ import throughput in MB/s of text: a straightforward getline /
+   istringstream / std::map importer against loadObj() on one thread and on
+   the pool, then the cost of uploading the result. The input is a generated
+   torus with positions, texcoords and normals, written to a temporary file
+   so the mapped path is measured too; the texture seam makes deduplication
+   do real work. Last, the mesh optimizer: vertex cache statistics and GPU
+   draw time of the imported order against the optimized one, and of the
+   optimized mesh in the 16-byte quantized vertex format; then the index
+   side: 16-bit clusters against 32-bit indices, and the compressed index
+   encoding with its decode rate. */
+
+static const int kRings = 768;
+static const int kSides = 384;
+static const int kDrawRepeats = 20;
+
+/* Enough per-vertex work that the vertex stage, not rasterization, bounds
+   the draw. POSITION is defined ahead of it for either vertex format. */
+static const char* kVertex =
+    "layout(location = 0) in vec3 aPosition;\n"
+    "layout(location = 2) in vec3 aNormal;\n"
+    "out vec3 vColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 p = POSITION;\n"
+    "    for (int i = 0; i < 16; ++i)\n"
+    "        p = p * 0.999 + sin(p.yzx) * 0.001;\n"
+    "    vColor = aNormal * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(p.xy * 0.35, p.z * 0.2, 1.0);\n"
+    "}\n";
+
+static const char* kFragment =
+    "#version 330 core\n"
+    "in vec3 vColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() { fragColor = vec4(vColor, 1.0); }\n";
+
+static void writeTorus(const std::string& path)
+{
+    std::ofstream out(path, std::ios::binary);
+    char line[128];
+    const float pi = 3.14159265f;
+    for (int i = 0; i <= kRings; ++i)
+    {
+        const float u = 2.0f * pi * i / kRings;
+        for (int j = 0; j <= kSides; ++j)
+        {
+            const float v = 2.0f * pi * j / kSides;
+            const float nx = std::cos(u) * std::cos(v);
+            const float ny = std::sin(u) * std::cos(v);
+            const float nz = std::sin(v);
+            snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                std::cos(u) * 2.0f + nx * 0.5f, std::sin(u) * 2.0f + ny * 0.5f, nz * 0.5f,
+                (float)i / kRings, (float)j / kSides, nx, ny, nz);
+            out << line;
+        }
+    }
+    for (int i = 0; i < kRings; ++i)
+    {
+        for (int j = 0; j < kSides; ++j)
+        {
+            const int a = i * (kSides + 1) + j + 1;
+            const int b = a + kSides + 1;
+            snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+            out << line;
+        }
+    }
+}
+
+/* The importer this replaces, in the usual textbook form. */
+static bool naiveLoadObj(const std::string& path, MeshData& mesh)
+{
+    std::ifstream in(path);
+    std::vector<float> positions, texcoords, normals;
+    std::map<std::tuple<int, int, int>, uint32_t> seen;
+    std::vector<std::tuple<int, int, int>> order;
+    mesh.indices.clear();
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        if (type == "v" && stream >> x >> y >> z)
+            positions.insert(positions.end(), { x, y, z });
+        else if (type == "vt" && stream >> x >> y)
+            texcoords.insert(texcoords.end(), { x, y });
+        else if (type == "vn" && stream >> x >> y >> z)
+            normals.insert(normals.end(), { x, y, z });
+        else if (type == "f")
+        {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while (stream >> corner)
+            {
+                int p = 0, t = 0, n = 0;
+                if (sscanf(corner.c_str(), "%d/%d/%d", &p, &t, &n) != 3)
+                    return false;
+                const std::tuple<int, int, int> key(p - 1, t - 1, n - 1);
+                auto found = seen.find(key);
+                if (found == seen.end())
+                {
+                    found = seen.emplace(key, (uint32_t)order.size()).first;
+                    order.push_back(key);
+                }
+                polygon.push_back(found->second);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i)
+                mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+        }
+    }
+    mesh.vertices.clear();
+    for (const std::tuple<int, int, int>& key : order)
+    {
+        const float* p = &positions[std::get<0>(key) * 3];
+        const float* t = &texcoords[std::get<1>(key) * 2];
+        const float* n = &normals[std::get<2>(key) * 3];
+        mesh.vertices.insert(mesh.vertices.end(), { p[0], p[1], p[2], t[0], t[1], n[0], n[1], n[2] });
+    }
+    return true;
+}
+
+/* The whole mesh on 32-bit indices, the baseline for the 16-bit clusters. */
+static Mesh createMesh32(const MeshData& data)
+{
+    return createMesh(data.vertices.data(), data.vertices.size() * sizeof(float), kMeshVertexFloats * sizeof(float),
+        kMeshDataAttributes, 3, data.indices.data(), (GLsizei)data.indices.size(), GL_UNSIGNED_INT);
+}
+
+static void drawMesh(const Mesh& mesh)
+{
+    glBindVertexArray(mesh.vao);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void*)0);
+}
+
+static void drawMesh(const ClusteredMesh& mesh)
+{
+    drawClusteredMesh(mesh);
+}
+
+/* Milliseconds per draw of the whole mesh, averaged over kDrawRepeats. */
+template <typename GpuMesh>
+static double drawMilliseconds(GLuint program, const GpuMesh& mesh, GLFWwindow* window)
+{
+    glUseProgram(program);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawMesh(mesh);
+    glFinish();
+
+    const double start = nowSeconds();
+    for (int i = 0; i < kDrawRepeats; ++i)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawMesh(mesh);
+    }
+    glFinish();
+    const double seconds = nowSeconds() - start;
+    glfwSwapBuffers(window);
+
+    glBindVertexArray(0);
+    glDisable(GL_DEPTH_TEST);
+    return seconds * 1000.0 / kDrawRepeats;
+}
+
+static bool sameMesh(const MeshData& a, const MeshData& b)
+{
+    if (a.indices != b.indices || a.vertices.size() != b.vertices.size())
+        return false;
+    for (size_t i = 0; i < a.vertices.size(); ++i)
+        if (std::fabs(a.vertices[i] - b.vertices[i]) > 1e-6f)
+            return false;
+    return true;
+}
+
+int benchMeshes(GLFWwindow* window)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_torus.obj").string();
+    writeTorus(path);
+    const double megabytes = std::filesystem::file_size(path) / 1e6;
+
+    MeshData reference;
+    double start = nowSeconds();
+    const bool naiveOk = naiveLoadObj(path, reference);
+    const double naive = nowSeconds() - start;
+
+    ThreadPool& pool = ThreadPool::shared();
+    MeshData mesh;
+    std::string log;
+    double seconds[2];
+    for (int threaded = 0; threaded < 2; ++threaded)
+    {
+        start = nowSeconds();
+        if (!loadObj(path, threaded ? &pool : NULL, mesh, log))
+        {
+            fprintf(stderr, "%s\n", log.c_str());
+            std::filesystem::remove(path);
+            return 1;
+        }
+        seconds[threaded] = nowSeconds() - start;
+    }
+    std::filesystem::remove(path);
+    if (!naiveOk || !sameMesh(mesh, reference))
+    {
+        fprintf(stderr, "loadObj and the reference importer disagree\n");
+        return 1;
+    }
+
+    printf("%.1f MB of OBJ, %zu vertices, %zu triangles\n", megabytes,
+        mesh.vertices.size() / kMeshVertexFloats, mesh.indices.size() / 3);
+    printf("naive        %8.1f ms  %7.1f MB/s\n", naive * 1000.0, megabytes / naive);
+    printf("1 thread     %8.1f ms  %7.1f MB/s  (%.1fx)\n", seconds[0] * 1000.0, megabytes / seconds[0], naive / seconds[0]);
+    printf("%2u threads   %8.1f ms  %7.1f MB/s  (%.1fx)\n", pool.size() + 1, seconds[1] * 1000.0,
+        megabytes / seconds[1], naive / seconds[1]);
+
+    start = nowSeconds();
+    ClusteredMesh uploaded = createClusteredMesh(mesh);
+    glFinish();
+    printf("upload       %8.1f ms  %7.1f MB of vertices and indices\n", (nowSeconds() - start) * 1000.0,
+        (uploaded.vertexCount * kMeshVertexFloats * sizeof(float) + mesh.indices.size() * sizeof(uint16_t)) / 1e6);
+    destroyMesh(uploaded.mesh);
+
+    std::string shaderLog;
+    const std::string version = "#version 330 core\n";
+    GLuint program = buildProgram(version + "#define POSITION aPosition\n" + kVertex, kFragment, shaderLog);
+    GLuint quantizedProgram = buildProgram(version + kPositionDecodeGlsl + "#define POSITION decodePosition(aPosition)\n"
+        + kVertex, kFragment, shaderLog);
+    if (!program || !quantizedProgram)
+    {
+        glDeleteProgram(program);
+        glDeleteProgram(quantizedProgram);
+        fprintf(stderr, "benchmark shaders failed:\n%s\n", shaderLog.c_str());
+        return 1;
+    }
+
+    const size_t vertexCount = mesh.vertices.size() / kMeshVertexFloats;
+    const VertexCacheStats before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+    Mesh gpuMesh = createMesh32(mesh);
+    const double beforeMs = drawMilliseconds(program, gpuMesh, window);
+    destroyMesh(gpuMesh);
+    MeshData optimized = mesh;
+    start = nowSeconds();
+    optimizeMesh(optimized);
+    const double optimizeSeconds = nowSeconds() - start;
+    const VertexCacheStats after = analyzeVertexCache(optimized.indices.data(), optimized.indices.size(), vertexCount);
+    gpuMesh = createMesh32(optimized);
+    const double afterMs = drawMilliseconds(program, gpuMesh, window);
+    destroyMesh(gpuMesh);
+
+    QuantizedMeshData quantized;
+    start = nowSeconds();
+    quantizeMesh(optimized, quantized);
+    const double quantizeSeconds = nowSeconds() - start;
+    ClusteredMesh quantizedMesh = createClusteredMesh(quantized);
+    glUseProgram(quantizedProgram);
+    setPositionDecode(quantizedProgram, quantized.decode);
+    const double quantizedMs = drawMilliseconds(quantizedProgram, quantizedMesh, window);
+    destroyMesh(quantizedMesh.mesh);
+
+    ClusteredMesh clustered = createClusteredMesh(optimized);
+    const double clusteredMs = drawMilliseconds(program, clustered, window);
+    destroyMesh(clustered.mesh);
+    glDeleteProgram(program);
+    glDeleteProgram(quantizedProgram);
+
+    std::vector<uint8_t> encoded;
+    encodeIndices(optimized.indices.data(), optimized.indices.size(), encoded);
+    std::vector<uint32_t> decodedIndices(optimized.indices.size());
+    const int kDecodeRepeats = 10;
+    bool decodeOk = true;
+    start = nowSeconds();
+    for (int i = 0; i < kDecodeRepeats; ++i)
+        decodeOk &= decodeIndices(encoded.data(), encoded.size(), decodedIndices.data(), decodedIndices.size());
+    const double decodeSeconds = (nowSeconds() - start) / kDecodeRepeats;
+    if (!decodeOk || decodedIndices != optimized.indices)
+    {
+        fprintf(stderr, "index decode does not round-trip\n");
+        return 1;
+    }
+
+    /* Worst position error relative to the largest extent, and worst normal
+       error in degrees. */
+    MeshData decoded;
+    dequantizeMesh(quantized, decoded);
+    const float extent = 2.0f * std::max(quantized.decode.scale[0], std::max(quantized.decode.scale[1], quantized.decode.scale[2]));
+    float positionError = 0.0f, normalError = 0.0f;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float* a = &optimized.vertices[v * kMeshVertexFloats];
+        const float* b = &decoded.vertices[v * kMeshVertexFloats];
+        float dot = 0.0f, length = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            positionError = std::max(positionError, std::fabs(a[k] - b[k]) / extent);
+            dot += a[5 + k] * b[5 + k];
+            length += b[5 + k] * b[5 + k];
+        }
+        normalError = std::max(normalError, std::acos(std::min(dot / std::sqrt(length), 1.0f)) * 57.29578f);
+    }
+
+    printf("imported     ACMR %.3f  ATVR %.3f  draw %7.2f ms\n", before.acmr, before.atvr, beforeMs);
+    printf("optimized    ACMR %.3f  ATVR %.3f  draw %7.2f ms  (%.2fx, optimizer %.1f ms)\n", after.acmr, after.atvr,
+        afterMs, beforeMs / afterMs, optimizeSeconds * 1000.0);
+    printf("float        %7.1f MB of vertices\n", optimized.vertices.size() * sizeof(float) / 1e6);
+    printf("quantized    %7.1f MB of vertices                draw %7.2f ms  (%.2fx over 16-bit float, quantizer %.1f ms)\n",
+        quantized.vertices.size() * sizeof(QuantizedVertex) / 1e6, quantizedMs, clusteredMs / quantizedMs, quantizeSeconds * 1000.0);
+    printf("32-bit       %7.1f MB of indices                 draw %7.2f ms\n",
+        optimized.indices.size() * sizeof(uint32_t) / 1e6, afterMs);
+    printf("16-bit       %7.1f MB of indices, %zu clusters, %.2f%% vertices duplicated  draw %7.2f ms  (%.2fx)\n",
+        optimized.indices.size() * sizeof(uint16_t) / 1e6, clustered.clusters.size(),
+        100.0 * (clustered.vertexCount - vertexCount) / vertexCount, clusteredMs, afterMs / clusteredMs);
+    printf("encoded      %7.1f MB of indices (%.2f bytes each), decode %.1f ms  %.0f M indices/s\n",
+        encoded.size() / 1e6, (double)encoded.size() / optimized.indices.size(), decodeSeconds * 1000.0,
+        optimized.indices.size() / decodeSeconds / 1e6);
+    printf("quantized    max position error %.2g of extent, max normal error %.3f degrees\n", positionError, normalError);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "AsyncReadback.h"
+#include "Timer.h"
+
+/* Frame-time impact of capturing every frame: no capture, a plain
+   glReadPixels into client memory (waits for the GPU each frame), and the PBO
+   ring of AsyncReadback. */
+
+static const int kFrames = 300;
+
+enum Mode
+{
+    kNoCapture,
+    kSyncCapture,
+    kAsyncCapture,
+};
+
+static double runFrames(GLFWwindow* window, Mode mode, AsyncReadback& readback)
+{
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+    glFinish();
+    const double start = nowSeconds();
+    for (int f = 0; f < kFrames; ++f)
+    {
+        glClearColor((f % 64) / 64.0f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (mode == kSyncCapture)
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        else if (mode == kAsyncCapture)
+        {
+            readback.poll();
+            readback.capture(width, height, f);
+        }
+
+        glfwSwapBuffers(window);
+    }
+    readback.drain();
+    glFinish();
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    return (nowSeconds() - start) * 1e3 / kFrames;
+}
+
+int benchReadback(GLFWwindow* window)
+{
+    uint64_t checksum = 0;
+    AsyncReadback readback(3, [&checksum](const ReadbackFrame& frame)
+    {
+        checksum += frame.pixels[0] + frame.pixels[frame.stride * frame.height - 1];
+    });
+
+    const double none = runFrames(window, kNoCapture, readback);
+    const double sync = runFrames(window, kSyncCapture, readback);
+    const double async = runFrames(window, kAsyncCapture, readback);
+
+    const AsyncReadback::Stats& stats = readback.stats();
+    printf("no capture    %7.3f ms/frame\n", none);
+    printf("glReadPixels  %7.3f ms/frame (+%.3f)\n", sync, sync - none);
+    printf("PBO readback  %7.3f ms/frame (+%.3f), %.3f ms/frame CPU in readback, %llu captured, %llu dropped\n",
+        async, async - none, stats.cpuSeconds * 1e3 / kFrames,
+        (unsigned long long)stats.captured, (unsigned long long)stats.dropped);
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "TextureResidency.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/* Texture residency under a video memory budget. A row of 1024^2 textures
+   with full mip chains passes a moving camera: each frame the ones in view
+   report their screen size, shrinking with distance, and update() streams
+   levels in and out. The same flight runs with no effective budget and with
+   two smaller ones, reporting the memory actually resident, the traffic and
+   how many textures the budget held below the detail they wanted. */
+
+static const int kTextures = 48;
+static const int kTextureSize = 1024;
+static const int kFrames = 480;
+static const float kViewDistance = 6.0f;
+static const size_t kUploadBudget = 4 << 20;
+
+static void makeTexture(int seed, ThreadPool& pool, std::vector<Image>& levels)
+{
+    Image base;
+    base.width = kTextureSize;
+    base.height = kTextureSize;
+    base.pixels.resize((size_t)kTextureSize * kTextureSize * 4);
+    for (int y = 0; y < kTextureSize; ++y)
+    {
+        for (int x = 0; x < kTextureSize; ++x)
+        {
+            uint8_t* p = &base.pixels[((size_t)y * kTextureSize + x) * 4];
+            p[0] = (uint8_t)(x + seed * 29);
+            p[1] = (uint8_t)(y ^ seed);
+            p[2] = (uint8_t)(((x >> 5) + (y >> 5) + seed) & 1 ? 200 : 50);
+            p[3] = 255;
+        }
+    }
+    const MipOptions options = { kMipBox, false, true };
+    std::vector<Image> mips;
+    generateMips(base, options, pool, mips);
+    levels.clear();
+    levels.push_back(std::move(base));
+    for (Image& mip : mips)
+        levels.push_back(std::move(mip));
+}
+
+static void runFlight(GLFWwindow* window, size_t budget, const char* label)
+{
+    ThreadPool& pool = ThreadPool::shared();
+    TextureResidency residency(budget);
+    std::vector<GLuint> textures;
+    std::vector<Image> levels;
+    for (int i = 0; i < kTextures; ++i)
+    {
+        makeTexture(i, pool, levels);
+        textures.push_back(residency.add(levels));
+    }
+    glFinish();
+
+    size_t peak = 0;
+    double resident = 0.0;
+    double reduced = 0.0;
+    const double start = nowSeconds();
+    for (int f = 0; f < kFrames; ++f)
+    {
+        /* Near textures fill the screen, the far ones shrink to a few pixels. */
+        const float camera = -kViewDistance + (kTextures + 2.0f * kViewDistance) * f / kFrames;
+        for (int i = 0; i < kTextures; ++i)
+        {
+            const float distance = std::fabs(i - camera);
+            if (distance < kViewDistance)
+                residency.demand(textures[i], 2048.0f / (1.0f + distance * 3.0f));
+        }
+        residency.update(kUploadBudget);
+        glfwSwapBuffers(window);
+
+        const TextureResidency::Stats stats = residency.stats();
+        peak = std::max(peak, stats.residentBytes);
+        resident += stats.residentBytes;
+        reduced += stats.reduced;
+    }
+    glFinish();
+    const double seconds = nowSeconds() - start;
+
+    const TextureResidency::Stats stats = residency.stats();
+    printf("%-10s resident %6.1f MB mean, %6.1f MB peak, of %.1f MB  "
+        "%5.1f held coarser  %5llu in %5llu out  %7.1f MB uploaded  update %.3f ms  %.2f ms/frame\n",
+        label, resident / kFrames / 1e6, peak / 1e6, stats.fullBytes / 1e6, reduced / kFrames,
+        (unsigned long long)stats.levelsLoaded, (unsigned long long)stats.levelsReleased, stats.bytesUploaded / 1e6,
+        stats.cpuSeconds * 1e3 / kFrames, seconds * 1e3 / kFrames);
+}
+
+int benchResidency(GLFWwindow* window)
+{
+    runFlight(window, (size_t)-1, "unlimited");
+    runFlight(window, 48 << 20, "48 MiB");
+    runFlight(window, 16 << 20, "16 MiB");
+    return 0;
+}
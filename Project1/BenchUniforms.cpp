@@ -0,0 +1,148 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <string>
+
+#include "Shader.h"
+#include "Timer.h"
+#include "Transform.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+
+/* Per-draw uniform cost: one glUniformMatrix4fv/glUniform4fv pair per draw
+   against all draws written into the UBO ring and selected with
+   glBindBufferRange. Both paths compute the same matrices and issue the same
+   draws; only the uniform traffic differs. */
+
+static const int kDraws = 10000;
+static const int kFrames = 200;
+
+static const char* kNaiveVertex =
+    "#version 330 core\n"
+    "uniform mat4 projection;\n"
+    "uniform mat4 model;\n"
+    "uniform vec4 tint;\n"
+    "layout(location = 0) in vec2 aPosition;\n"
+    "out vec3 vColor;\n"
+    "void main() { vColor = tint.rgb; gl_Position = projection * model * vec4(aPosition, 0.0, 1.0); }\n";
+
+static const char* kBlockVertex =
+    "#version 330 core\n"
+    "layout(std140) uniform Frame { mat4 projection; float time; };\n"
+    "layout(std140) uniform Draw { mat4 model; vec4 tint; };\n"
+    "layout(location = 0) in vec2 aPosition;\n"
+    "out vec3 vColor;\n"
+    "void main() { vColor = tint.rgb; gl_Position = projection * model * vec4(aPosition, 0.0, 1.0); }\n";
+
+static const char* kFragment =
+    "#version 330 core\n"
+    "in vec3 vColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() { fragColor = vec4(vColor, 1.0); }\n";
+
+static void report(const char* label, double submitSeconds, double totalSeconds)
+{
+    printf("%-8s submit %7.3f ms/frame (%6.1f ns/draw), with GPU %7.3f ms/frame\n", label,
+        submitSeconds * 1e3 / kFrames, submitSeconds * 1e9 / ((double)kFrames * kDraws), totalSeconds * 1e3 / kFrames);
+}
+
+int benchUniforms(GLFWwindow* window)
+{
+    std::string log;
+    GLuint naive = buildProgram(kNaiveVertex, kFragment, log);
+    GLuint blocks = buildProgram(kBlockVertex, kFragment, log);
+    if (!naive || !blocks || !setupUniformBlocks(blocks, log))
+    {
+        fprintf(stderr, "benchmark shaders failed:\n%s\n", log.c_str());
+        glDeleteProgram(naive);
+        glDeleteProgram(blocks);
+        return -1;
+    }
+
+    const float vertices[] = { -0.01f, -0.01f, 0.01f, -0.01f, 0.0f, 0.01f };
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const size_t slot = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+    UniformBuffer ring(3 * (kDraws + 1) * slot);
+
+    FrameUniforms frame = {};
+    makeTransform(0.0f, 1.0f, 0.0f, 0.0f, frame.projection.m);
+    const float tint[4] = { 1.0f, 0.5f, 0.25f, 1.0f };
+
+    /* Naive path */
+    GLint projectionLocation = glGetUniformLocation(naive, "projection");
+    GLint modelLocation = glGetUniformLocation(naive, "model");
+    GLint tintLocation = glGetUniformLocation(naive, "tint");
+    double submit = 0.0;
+    double start = nowSeconds();
+    for (int f = 0; f < kFrames; ++f)
+    {
+        double frameStart = nowSeconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(naive);
+        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, frame.projection.m);
+        for (int i = 0; i < kDraws; ++i)
+        {
+            float model[16];
+            makeTransform(i * 0.001f + f * 0.01f, 1.0f, (i % 100) * 0.02f - 1.0f, (i / 100) * 0.02f - 1.0f, model);
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, model);
+            glUniform4fv(tintLocation, 1, tint);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        submit += nowSeconds() - frameStart;
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+    report("naive", submit, nowSeconds() - start);
+
+    /* UBO ring path */
+    static GLintptr offsets[kDraws];
+    submit = 0.0;
+    start = nowSeconds();
+    for (int f = 0; f < kFrames; ++f)
+    {
+        double frameStart = nowSeconds();
+        ring.begin();
+        GLintptr frameOffset = ring.push(frame);
+        for (int i = 0; i < kDraws; ++i)
+        {
+            DrawUniforms draw;
+            makeTransform(i * 0.001f + f * 0.01f, 1.0f, (i % 100) * 0.02f - 1.0f, (i / 100) * 0.02f - 1.0f, draw.model.m);
+            draw.tint = { tint[0], tint[1], tint[2], tint[3] };
+            offsets[i] = ring.push(draw);
+        }
+        ring.end();
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(blocks);
+        ring.bind<FrameUniforms>(kFrameBinding, frameOffset);
+        for (int i = 0; i < kDraws; ++i)
+        {
+            ring.bind<DrawUniforms>(kDrawBinding, offsets[i]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        submit += nowSeconds() - frameStart;
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+    report("ubo ring", submit, nowSeconds() - start);
+    printf("ubo ring fence stalls: %zu\n", ring.stats().stalls);
+
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(naive);
+    glDeleteProgram(blocks);
+    return 0;
+}
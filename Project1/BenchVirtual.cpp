@@ -0,0 +1,183 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "VirtualTexture.h"
+
+/* Sparse virtual texturing over a flight above a 32768^2 ground plane: each
+   frame renders the feedback pass, updates the texture and draws the view.
+   Pages come from a procedural source on the pool, so the numbers measure
+   the streaming machinery rather than a disk. Reports the page traffic, the
+   memory against a fully resident mip chain, how many requested pages were
+   still missing and the CPU cost of update(). */
+
+static const int kVirtualSize = 32768;
+static const int kCachePagesPerSide = 32;
+static const int kFrames = 600;
+static const int kUploadBudget = 16;
+
+/* A full-screen triangle; the fragment shader intersects the view ray with
+   the ground plane, so one frame touches many levels at once. */
+static const char* kVertex =
+    "#version 330 core\n"
+    "out vec2 vNdc;\n"
+    "void main()\n"
+    "{\n"
+    "    vNdc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;\n"
+    "    gl_Position = vec4(vNdc, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* kFragment =
+    "in vec2 vNdc;\n"
+    "out vec4 fragColor;\n"
+    "uniform vec3 camera;     /* position over the plane in uv, height in uv */\n"
+    "uniform vec2 heading;\n"
+    "uniform float aspect;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 ray = vec3(vNdc.x * aspect, vNdc.y * 0.8 - 0.5, 1.0);\n"
+    "    float t = camera.z / max(-ray.y, 1e-4);\n"
+    "    vec2 side = vec2(heading.y, -heading.x);\n"
+    "    vec2 uv = camera.xy + (heading * ray.z + side * ray.x) * t;\n"
+    "#ifdef FEEDBACK\n"
+    "    fragColor = vtFeedback(uv);\n"
+    "#else\n"
+    "    fragColor = vtSample(uv);\n"
+    "#endif\n"
+    "    if (ray.y > -0.02 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))\n"
+    "        fragColor = vec4(0.0);\n"
+    "}\n";
+
+/* Grid lines every page and every 16 pages, tinted by level, over hashed
+   noise so neighbouring texels differ. Border texels come from the
+   neighbouring pages, clamped at the edge of the texture. */
+static bool proceduralPage(int level, int pageX, int pageY, uint8_t* rgba)
+{
+    const int size = kVirtualSize >> level;
+    const int slot = VirtualTexture::kSlotSize;
+    for (int y = 0; y < slot; ++y)
+    {
+        const int ty = std::min(std::max(pageY * VirtualTexture::kPageSize + y - VirtualTexture::kPageBorder, 0), size - 1);
+        const int vy = ty << level;
+        for (int x = 0; x < slot; ++x)
+        {
+            const int tx = std::min(std::max(pageX * VirtualTexture::kPageSize + x - VirtualTexture::kPageBorder, 0), size - 1);
+            const int vx = tx << level;
+            uint32_t hash = (uint32_t)(vx >> 4) * 73856093u ^ (uint32_t)(vy >> 4) * 19349663u;
+            hash ^= hash >> 13;
+            hash *= 0x5bd1e995u;
+            const int noise = (int)(hash >> 27);
+            const bool fine = (vx & 127) < (1 << level) || (vy & 127) < (1 << level);
+            const bool coarse = (vx & 2047) < (8 << level) || (vy & 2047) < (8 << level);
+            uint8_t* texel = rgba + ((size_t)y * slot + x) * 4;
+            texel[0] = (uint8_t)(coarse ? 255 : 60 + level * 12 + noise);
+            texel[1] = (uint8_t)(fine ? 220 : 90 + noise);
+            texel[2] = (uint8_t)(coarse ? 40 : 140 - level * 8 + noise);
+            texel[3] = 255;
+        }
+    }
+    return true;
+}
+
+int benchVirtual(GLFWwindow* window)
+{
+    std::string log;
+    const std::string fragment = std::string(VirtualTexture::kGlsl) + kFragment;
+    GLuint program = buildProgram(kVertex, "#version 330 core\n" + fragment, log);
+    GLuint feedbackProgram = buildProgram(kVertex, "#version 330 core\n#define FEEDBACK\n" + fragment, log);
+    if (!program || !feedbackProgram)
+    {
+        fprintf(stderr, "benchmark shaders failed:\n%s\n", log.c_str());
+        glDeleteProgram(program);
+        glDeleteProgram(feedbackProgram);
+        return 1;
+    }
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    int result = 0;
+    {
+        VirtualTexture texture(kVirtualSize, kCachePagesPerSide, proceduralPage, ThreadPool::shared());
+        double updateSeconds = 0.0;
+        double missing = 0.0;
+        double wanted = 0.0;
+        const double start = nowSeconds();
+        for (int f = 0; f < kFrames; ++f)
+        {
+            /* Sweep across the texture while the height rises and falls
+               between 16 and 2048 texels, turning slowly. */
+            const float s = (float)f / kFrames;
+            const float cameraHeight = std::exp2(4.0f + 7.0f * (0.5f + 0.5f * std::cos(s * 6.2831853f * 2.0f))) / kVirtualSize;
+            const float angle = 0.6f + s * 1.5f;
+            const float cameraX = 0.15f + 0.7f * s;
+            const float cameraY = 0.2f + 0.5f * s * s;
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                const GLuint current = pass == 0 ? feedbackProgram : program;
+                if (pass == 0)
+                    texture.beginFeedback(width, height);
+                else
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glUseProgram(current);
+                texture.setUniforms(current, 0, 1, pass == 0);
+                glUniform3f(glGetUniformLocation(current, "camera"), cameraX, cameraY, cameraHeight);
+                glUniform2f(glGetUniformLocation(current, "heading"), std::cos(angle), std::sin(angle));
+                glUniform1f(glGetUniformLocation(current, "aspect"), (float)width / height);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                if (pass == 0)
+                    texture.endFeedback();
+                else
+                    glfwSwapBuffers(window);
+            }
+
+            const double updateStart = nowSeconds();
+            texture.update(kUploadBudget);
+            updateSeconds += nowSeconds() - updateStart;
+
+            const VirtualTexture::Stats stats = texture.stats();
+            missing += stats.missingPages;
+            wanted += stats.wantedPages;
+        }
+        glFinish();
+        const double seconds = nowSeconds() - start;
+
+        const VirtualTexture::Stats stats = texture.stats();
+        double fullChain = 0.0;
+        for (int size = kVirtualSize; size >= 1; size >>= 1)
+            fullChain += (double)size * size * 4;
+        printf("%d^2 virtual, %zu-page cache, %d frames in %.2f s (%.2f ms/frame)\n", kVirtualSize, stats.capacity,
+            kFrames, seconds, seconds * 1e3 / kFrames);
+        printf("pages        %llu loaded, %llu evicted, %llu discarded, %llu failed, %zu resident\n",
+            (unsigned long long)stats.loaded, (unsigned long long)stats.evicted,
+            (unsigned long long)stats.discarded, (unsigned long long)stats.failed, stats.resident);
+        printf("memory       %.1f MB cache + %.2f MB page table, %.1f MB as a full mip chain (%.1f%%)\n",
+            stats.cacheBytes / 1e6, stats.pageTableBytes / 1e6, fullChain / 1e6,
+            (stats.cacheBytes + stats.pageTableBytes) * 100.0 / fullChain);
+        printf("feedback     %llu frames read back, %.0f pages wanted, %.1f%% missing at their own level\n",
+            (unsigned long long)stats.feedbackFrames, wanted / kFrames, wanted > 0.0 ? missing * 100.0 / wanted : 0.0);
+        printf("update       %.3f ms/frame, %.3f ms/frame CPU in the texture\n",
+            updateSeconds * 1e3 / kFrames, stats.cpuSeconds * 1e3 / kFrames);
+        if (stats.loaded == 0)
+            result = 1;
+    }
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    glDeleteProgram(feedbackProgram);
+    return result;
+}
@@ -0,0 +1,44 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark
+{
+    const char* name;
+    int (*run)(GLFWwindow* window);
+};
+
+static const Benchmark kBenchmarks[] = {
+    { "uniforms", benchUniforms },
+    { "readback", benchReadback },
+    { "images", benchImages },
+    { "compress", benchCompress },
+    { "meshes", benchMeshes },
+    { "virtual", benchVirtual },
+    { "residency", benchResidency },
+    { "math", benchMath },
+    { "atlas", benchAtlas },
+};
+
+int runBenchmark(const char* name, GLFWwindow* window)
+{
+    for (const Benchmark& benchmark : kBenchmarks)
+    {
+        if (strcmp(benchmark.name, name) == 0)
+        {
+            /* Measure submission cost, not the display refresh rate. */
+            glfwSwapInterval(0);
+            return benchmark.run(window);
+        }
+    }
+
+    fprintf(stderr, "unknown benchmark '%s', available:", name);
+    for (const Benchmark& benchmark : kBenchmarks)
+        fprintf(stderr, " %s", benchmark.name);
+    fprintf(stderr, "\n");
+    return -1;
+}
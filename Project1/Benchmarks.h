@@ -0,0 +1,18 @@
+#pragma once
+
+struct GLFWwindow;
+
+/* Microbenchmarks, selected on the command line with --bench <name>. Each one
+   prints its own report and returns 0 on success. The window's context is
+   current when they run. */
+int runBenchmark(const char* name, GLFWwindow* window);
+
+int benchUniforms(GLFWwindow* window);
+int benchReadback(GLFWwindow* window);
+int benchImages(GLFWwindow* window);
+int benchCompress(GLFWwindow* window);
+int benchMeshes(GLFWwindow* window);
+int benchVirtual(GLFWwindow* window);
+int benchResidency(GLFWwindow* window);
+int benchMath(GLFWwindow* window);
+int benchAtlas(GLFWwindow* window);
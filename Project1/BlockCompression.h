@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Image.h"
+
+class ThreadPool;
+
+/* Block-compressed texture formats, each coding 4x4 texels into a fixed
+   number of bytes:
+
+     BC1  RGB with optional 1-bit alpha, 8 bytes (DXT1)
+     BC3  RGBA, BC1 colour plus a BC4 alpha block, 16 bytes (DXT5)
+     BC4  one channel (red), 8 bytes
+     BC5  two channels (red, green), two BC4 blocks, 16 bytes; normal maps
+     BC7  RGBA, 16 bytes, the best quality of the set
+
+   Blocks are stored left to right, top block row first. Levels whose size is
+   not a multiple of 4 are padded by repeating the edge texels. */
+enum BlockFormat
+{
+    kBC1,
+    kBC3,
+    kBC4,
+    kBC5,
+    kBC7,
+};
+
+enum BlockQuality
+{
+    /* Endpoints from the principal axis of each block. */
+    kBlockFast,
+
+    /* Additionally refines endpoints by least squares against the chosen
+       indices and, for BC4/BC5, searches the neighbouring endpoint pairs and
+       the 6-value mode. About 1.5-2x slower for BC1/BC3/BC7 and several times
+       slower for BC4/BC5, which are cheap to begin with. */
+    kBlockHigh,
+};
+
+/* Bytes per 4x4 block: 8 for BC1 and BC4, 16 for the others. */
+size_t blockBytes(BlockFormat format);
+
+/* Compressed size of a width x height level. */
+size_t compressedSize(BlockFormat format, int width, int height);
+
+/* Encodes one block of 16 RGBA8 texels, row by row. Index fitting uses SSE2
+   or AVX2 where the build allows. BC7 is always written in mode 6 (one
+   subset, 7.7.7.7 endpoints with p-bits, 4-bit indices); see the .cpp. */
+void compressBlock(BlockFormat format, BlockQuality quality, const uint8_t* rgba, uint8_t* block);
+
+/* Decodes one block to 16 RGBA8 texels. Handles every BC7 mode. Channels a
+   format does not store come back as 0, and alpha as 255. */
+void decompressBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba);
+
+/* Compresses a whole RGBA8 image, one block row per parallelFor index. */
+void compressImage(const Image& image, BlockFormat format, BlockQuality quality, ThreadPool& pool,
+    std::vector<uint8_t>& out);
+
+/* Expands a compressed level back to RGBA8, for drivers without the format. */
+void decompressImage(BlockFormat format, const uint8_t* data, int width, int height, ThreadPool& pool, Image& image);
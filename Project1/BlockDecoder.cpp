@@ -0,0 +1,364 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ThreadPool.h"
+
+namespace
+{
+    /* Little-endian bit reader over one 16-byte block. */
+    class BlockBits
+    {
+    public:
+        explicit BlockBits(const uint8_t* block)
+            : m_low(0)
+            , m_high(0)
+            , m_position(0)
+        {
+            for (int i = 7; i >= 0; --i)
+            {
+                m_low = m_low << 8 | block[i];
+                m_high = m_high << 8 | block[i + 8];
+            }
+        }
+
+        unsigned read(int count)
+        {
+            unsigned value = 0;
+            for (int i = 0; i < count; ++i, ++m_position)
+            {
+                const uint64_t word = m_position < 64 ? m_low : m_high;
+                value |= (unsigned)(word >> (m_position & 63) & 1) << i;
+            }
+            return value;
+        }
+
+    private:
+        uint64_t m_low;
+        uint64_t m_high;
+        int m_position;
+    };
+
+    void expand565(unsigned color, uint8_t* rgb)
+    {
+        const unsigned r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+        rgb[0] = (uint8_t)(r << 3 | r >> 2);
+        rgb[1] = (uint8_t)(g << 2 | g >> 4);
+        rgb[2] = (uint8_t)(b << 3 | b >> 2);
+    }
+
+    /* BC1 colour; BC3 colour blocks are always read in four-colour mode. */
+    void decodeColor(const uint8_t* block, bool alwaysFourColors, uint8_t* rgba)
+    {
+        const unsigned c0 = block[0] | block[1] << 8;
+        const unsigned c1 = block[2] | block[3] << 8;
+        uint8_t palette[4][4];
+        expand565(c0, palette[0]);
+        expand565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        for (int c = 0; c < 3; ++c)
+        {
+            if (c0 > c1 || alwaysFourColors)
+            {
+                palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c]) / 3);
+                palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c]) / 3);
+            }
+            else
+            {
+                palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+                palette[3][c] = 0;
+            }
+        }
+        if (c0 <= c1 && !alwaysFourColors)
+            palette[3][3] = 0;
+
+        const uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+        for (int i = 0; i < 16; ++i)
+            memcpy(rgba + i * 4, palette[indices >> (i * 2) & 3], 4);
+    }
+
+    /* BC4 block into one channel of 16 RGBA texels. */
+    void decodeChannel(const uint8_t* block, uint8_t* rgba, int channel)
+    {
+        const unsigned a0 = block[0], a1 = block[1];
+        uint8_t palette[8] = { (uint8_t)a0, (uint8_t)a1 };
+        if (a0 > a1)
+        {
+            for (int i = 2; i < 8; ++i)
+                palette[i] = (uint8_t)(((8 - i) * a0 + (i - 1) * a1) / 7);
+        }
+        else
+        {
+            for (int i = 2; i < 6; ++i)
+                palette[i] = (uint8_t)(((6 - i) * a0 + (i - 1) * a1) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 7; i >= 2; --i)
+            indices = indices << 8 | block[i];
+        for (int i = 0; i < 16; ++i)
+            rgba[i * 4 + channel] = palette[indices >> (i * 3) & 7];
+    }
+
+    /* BC7 mode table, see the D3D11 format specification. */
+    struct Bc7Mode
+    {
+        int subsets;
+        int partitionBits;
+        int rotationBits;
+        int indexSelectionBits;
+        int colorBits;
+        int alphaBits;
+        int endpointPBits;
+        int sharedPBits;
+        int indexBits;
+        int secondaryIndexBits;
+    };
+
+    const Bc7Mode kBc7Modes[8] = {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    /* Two-subset partitions, one bit per texel (texel 0 in bit 0). */
+    const uint16_t kPartitions2[64] = {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+        0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+        0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+        0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+        0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+    };
+
+    /* Three-subset partitions, two bits per texel. */
+    const uint32_t kPartitions3[64] = {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+        0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+        0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+        0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+        0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+        0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+    };
+
+    /* Texel holding the implicit-zero index bit of subset 1 (two subsets) and
+       of subsets 1 and 2 (three subsets). Subset 0 always anchors at texel 0. */
+    const uint8_t kAnchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+    };
+
+    const uint8_t kAnchors3a[64] = {
+        3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+        3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+        8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+        3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+    };
+
+    const uint8_t kAnchors3b[64] = {
+        15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+        15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+        15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+        15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+    };
+
+    const uint8_t kWeights2[4] = { 0, 21, 43, 64 };
+    const uint8_t kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint8_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    const uint8_t* bc7Weights(int bits)
+    {
+        return bits == 2 ? kWeights2 : bits == 3 ? kWeights3 : kWeights4;
+    }
+
+    inline uint8_t bc7Interpolate(int e0, int e1, int weight)
+    {
+        return (uint8_t)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+    }
+
+    void decodeBc7(const uint8_t* block, uint8_t* rgba)
+    {
+        int mode = 0;
+        while (mode < 8 && !(block[0] >> mode & 1))
+            ++mode;
+        if (mode == 8)
+        {
+            /* Reserved mode: the specification asks for transparent black. */
+            memset(rgba, 0, 64);
+            return;
+        }
+
+        const Bc7Mode& m = kBc7Modes[mode];
+        BlockBits bits(block);
+        bits.read(mode + 1);
+        const unsigned partition = bits.read(m.partitionBits);
+        const unsigned rotation = bits.read(m.rotationBits);
+        const unsigned indexSelection = bits.read(m.indexSelectionBits);
+
+        /* endpoints[subset * 2 + end][channel] */
+        int endpoints[6][4];
+        const int endpointCount = m.subsets * 2;
+        for (int c = 0; c < 3; ++c)
+            for (int e = 0; e < endpointCount; ++e)
+                endpoints[e][c] = (int)bits.read(m.colorBits);
+        for (int e = 0; e < endpointCount; ++e)
+            endpoints[e][3] = m.alphaBits ? (int)bits.read(m.alphaBits) : 255;
+
+        int colorBits = m.colorBits;
+        int alphaBits = m.alphaBits;
+        if (m.endpointPBits || m.sharedPBits)
+        {
+            int pbits[6];
+            if (m.endpointPBits)
+            {
+                for (int e = 0; e < endpointCount; ++e)
+                    pbits[e] = (int)bits.read(1);
+            }
+            else
+            {
+                for (int s = 0; s < m.subsets; ++s)
+                    pbits[s * 2] = pbits[s * 2 + 1] = (int)bits.read(1);
+            }
+            for (int e = 0; e < endpointCount; ++e)
+            {
+                for (int c = 0; c < 3; ++c)
+                    endpoints[e][c] = endpoints[e][c] << 1 | pbits[e];
+                if (m.alphaBits)
+                    endpoints[e][3] = endpoints[e][3] << 1 | pbits[e];
+            }
+            colorBits++;
+            if (alphaBits)
+                alphaBits++;
+        }
+        for (int e = 0; e < endpointCount; ++e)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const int v = endpoints[e][c] << (8 - colorBits);
+                endpoints[e][c] = v | v >> colorBits;
+            }
+            if (alphaBits)
+            {
+                const int v = endpoints[e][3] << (8 - alphaBits);
+                endpoints[e][3] = v | v >> alphaBits;
+            }
+        }
+
+        int subsetOf[16];
+        bool anchor[16] = { true };
+        for (int i = 0; i < 16; ++i)
+        {
+            if (m.subsets == 2)
+                subsetOf[i] = kPartitions2[partition] >> i & 1;
+            else if (m.subsets == 3)
+                subsetOf[i] = kPartitions3[partition] >> (i * 2) & 3;
+            else
+                subsetOf[i] = 0;
+        }
+        if (m.subsets == 2)
+            anchor[kAnchors2[partition]] = true;
+        else if (m.subsets == 3)
+            anchor[kAnchors3a[partition]] = anchor[kAnchors3b[partition]] = true;
+
+        int indices[16];
+        int secondary[16];
+        for (int i = 0; i < 16; ++i)
+            indices[i] = (int)bits.read(m.indexBits - (anchor[i] ? 1 : 0));
+        for (int i = 0; m.secondaryIndexBits && i < 16; ++i)
+            secondary[i] = (int)bits.read(m.secondaryIndexBits - (i == 0 ? 1 : 0));
+
+        const uint8_t* colorWeights = bc7Weights(m.indexBits);
+        const uint8_t* alphaWeights = colorWeights;
+        const int* colorIndices = indices;
+        const int* alphaIndices = indices;
+        if (m.secondaryIndexBits)
+        {
+            alphaWeights = bc7Weights(m.secondaryIndexBits);
+            alphaIndices = secondary;
+            if (indexSelection)
+            {
+                std::swap(colorWeights, alphaWeights);
+                std::swap(colorIndices, alphaIndices);
+            }
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int* e0 = endpoints[subsetOf[i] * 2];
+            const int* e1 = endpoints[subsetOf[i] * 2 + 1];
+            uint8_t* texel = rgba + i * 4;
+            for (int c = 0; c < 3; ++c)
+                texel[c] = bc7Interpolate(e0[c], e1[c], colorWeights[colorIndices[i]]);
+            texel[3] = m.alphaBits ? bc7Interpolate(e0[3], e1[3], alphaWeights[alphaIndices[i]]) : 255;
+            if (rotation)
+                std::swap(texel[3], texel[rotation - 1]);
+        }
+    }
+}
+
+void decompressBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba)
+{
+    switch (format)
+    {
+    case kBC1:
+        decodeColor(block, false, rgba);
+        break;
+    case kBC3:
+        decodeColor(block + 8, true, rgba);
+        decodeChannel(block, rgba, 3);
+        break;
+    case kBC4:
+    case kBC5:
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        decodeChannel(block, rgba, 0);
+        if (format == kBC5)
+            decodeChannel(block + 8, rgba, 1);
+        break;
+    case kBC7:
+        decodeBc7(block, rgba);
+        break;
+    }
+}
+
+void decompressImage(BlockFormat format, const uint8_t* data, int width, int height, ThreadPool& pool, Image& image)
+{
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t)width * height * 4);
+
+    const int blocksWide = (width + 3) / 4;
+    const int blocksHigh = (height + 3) / 4;
+    const size_t bytes = blockBytes(format);
+    pool.parallelFor((size_t)blocksHigh, [&](size_t by)
+    {
+        uint8_t texels[64];
+        for (int bx = 0; bx < blocksWide; ++bx)
+        {
+            decompressBlock(format, data + (by * blocksWide + bx) * bytes, texels);
+            const int columns = std::min(4, width - bx * 4);
+            const int rows = std::min(4, height - (int)by * 4);
+            for (int y = 0; y < rows; ++y)
+            {
+                memcpy(&image.pixels[(((size_t)by * 4 + y) * width + bx * 4) * 4], texels + y * 16, (size_t)columns * 4);
+            }
+        }
+    });
+}
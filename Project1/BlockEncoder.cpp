@@ -0,0 +1,634 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+/* Block encoders.
+
+   Every format is fitted the same way: pick endpoints along the principal
+   axis of the block's texels, quantise them the way the format stores them,
+   rebuild the palette exactly as a decoder would, and give each texel the
+   index of its closest palette entry. The last step dominates and runs on
+   four (SSE2) or eight (AVX2) texels at once. In high quality mode the
+   endpoints are then solved again by least squares against those indices and
+   kept when the error drops.
+
+   BC7 uses mode 6 only: a single subset with 7.7.7.7 endpoints plus a p-bit
+   each and 4-bit indices. Partitioned modes would help blocks with two
+   distinct colours, at many times the search cost. */
+
+namespace
+{
+    /* The 16 texels of a block as floats, one array per channel. */
+    struct Texels
+    {
+        alignas(32) float c[4][16];
+    };
+
+    void loadTexels(const uint8_t* rgba, Texels& texels)
+    {
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 4; ++c)
+                texels.c[c][i] = rgba[i * 4 + c];
+    }
+
+    /* Picks the nearest of paletteSize entries (only the first channels count)
+       for each texel. Returns the summed squared error. */
+    float fitIndices(const Texels& texels, int channels, const float (*palette)[4], int paletteSize, int* indices)
+    {
+        float total = 0.0f;
+        int i = 0;
+#ifdef SIMD_AVX2
+        for (; i < 16; i += 8)
+        {
+            __m256 best = _mm256_set1_ps(FLT_MAX);
+            __m256i bestIndex = _mm256_setzero_si256();
+            for (int p = 0; p < paletteSize; ++p)
+            {
+                __m256 error = _mm256_setzero_ps();
+                for (int c = 0; c < channels; ++c)
+                {
+                    const __m256 d = _mm256_sub_ps(_mm256_load_ps(texels.c[c] + i), _mm256_set1_ps(palette[p][c]));
+                    error = _mm256_add_ps(error, _mm256_mul_ps(d, d));
+                }
+                const __m256 better = _mm256_cmp_ps(error, best, _CMP_LT_OQ);
+                best = _mm256_min_ps(error, best);
+                bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(p), _mm256_castps_si256(better));
+            }
+            alignas(32) float errors[8];
+            _mm256_store_ps(errors, best);
+            _mm256_storeu_si256((__m256i*)(indices + i), bestIndex);
+            for (int k = 0; k < 8; ++k)
+                total += errors[k];
+        }
+#elif defined(SIMD_SSE2)
+        for (; i < 16; i += 4)
+        {
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int p = 0; p < paletteSize; ++p)
+            {
+                __m128 error = _mm_setzero_ps();
+                for (int c = 0; c < channels; ++c)
+                {
+                    const __m128 d = _mm_sub_ps(_mm_load_ps(texels.c[c] + i), _mm_set1_ps(palette[p][c]));
+                    error = _mm_add_ps(error, _mm_mul_ps(d, d));
+                }
+                const __m128i better = _mm_castps_si128(_mm_cmplt_ps(error, best));
+                best = _mm_min_ps(error, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(p)), _mm_andnot_si128(better, bestIndex));
+            }
+            alignas(16) float errors[4];
+            _mm_store_ps(errors, best);
+            _mm_storeu_si128((__m128i*)(indices + i), bestIndex);
+            total += errors[0] + errors[1] + errors[2] + errors[3];
+        }
+#endif
+        for (; i < 16; ++i)
+        {
+            float best = FLT_MAX;
+            for (int p = 0; p < paletteSize; ++p)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < channels; ++c)
+                {
+                    const float d = texels.c[c][i] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best)
+                {
+                    best = error;
+                    indices[i] = p;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    /* Endpoints at the extremes of the texels' projection onto their principal
+       axis, found by power iteration on the covariance matrix. Texels with
+       include[i] false are ignored. */
+    void principalEndpoints(const Texels& texels, int channels, const bool* include, float* e0, float* e1)
+    {
+        float mean[4] = {};
+        int count = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!include[i])
+                continue;
+            for (int c = 0; c < channels; ++c)
+                mean[c] += texels.c[c][i];
+            ++count;
+        }
+        for (int c = 0; c < channels; ++c)
+            mean[c] /= count;
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!include[i])
+                continue;
+            for (int a = 0; a < channels; ++a)
+                for (int b = a; b < channels; ++b)
+                    covariance[a][b] += (texels.c[a][i] - mean[a]) * (texels.c[b][i] - mean[b]);
+        }
+        for (int a = 0; a < channels; ++a)
+            for (int b = 0; b < a; ++b)
+                covariance[a][b] = covariance[b][a];
+
+        /* Start from the row of the widest channel; it cannot be orthogonal
+           to the principal axis unless the block is flat. */
+        int widest = 0;
+        for (int c = 1; c < channels; ++c)
+            if (covariance[c][c] > covariance[widest][widest])
+                widest = c;
+        float axis[4];
+        for (int c = 0; c < channels; ++c)
+            axis[c] = covariance[widest][c];
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float largest = 0.0f;
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = 0; b < channels; ++b)
+                    next[a] += covariance[a][b] * axis[b];
+                largest = std::max(largest, std::fabs(next[a]));
+            }
+            if (largest == 0.0f)
+                break;
+            for (int c = 0; c < channels; ++c)
+                axis[c] = next[c] / largest;
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; ++c)
+            axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+
+        float low = 0.0f, high = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!include[i])
+                continue;
+            float t = 0.0f;
+            for (int c = 0; c < channels; ++c)
+                t += (texels.c[c][i] - mean[c]) * axis[c];
+            low = std::min(low, t);
+            high = std::max(high, t);
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            e0[c] = std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f);
+            e1[c] = std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f);
+        }
+    }
+
+    /* Solves for the endpoints that best reproduce the texels given each
+       texel's position t in [0, 1] between them (t < 0 skips the texel).
+       Returns false when the system is singular, e.g. every t is the same. */
+    bool solveEndpoints(const Texels& texels, int channels, const float* t, float* e0, float* e1)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            if (t[i] < 0.0f)
+                continue;
+            const float a = 1.0f - t[i];
+            const float b = t[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; ++c)
+            {
+                ax[c] += a * texels.c[c][i];
+                bx[c] += b * texels.c[c][i];
+            }
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return false;
+        for (int c = 0; c < channels; ++c)
+        {
+            e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    /* BC1 colour ------------------------------------------------------------ */
+
+    unsigned quantize565(const float* rgb)
+    {
+        const unsigned r = (unsigned)(rgb[0] * 31.0f / 255.0f + 0.5f);
+        const unsigned g = (unsigned)(rgb[1] * 63.0f / 255.0f + 0.5f);
+        const unsigned b = (unsigned)(rgb[2] * 31.0f / 255.0f + 0.5f);
+        return r << 11 | g << 5 | b;
+    }
+
+    void expand565(unsigned color, int* rgb)
+    {
+        const int r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+        rgb[0] = r << 3 | r >> 2;
+        rgb[1] = g << 2 | g >> 4;
+        rgb[2] = b << 3 | b >> 2;
+    }
+
+    struct ColorBlock
+    {
+        unsigned c0;
+        unsigned c1;
+        int indices[16];
+        float error;
+    };
+
+    /* Quantises a pair of endpoints and fits indices. In three-colour mode
+       (transparent texels present) index 3 is transparent black and c0 <= c1;
+       otherwise c0 > c1 selects four colours. */
+    void fitColor(const Texels& texels, const float* e0, const float* e1, bool threeColor, const bool* transparent,
+        ColorBlock& out)
+    {
+        unsigned c0 = quantize565(e0);
+        unsigned c1 = quantize565(e1);
+        if (threeColor ? c0 > c1 : c0 < c1)
+            std::swap(c0, c1);
+        out.c0 = c0;
+        out.c1 = c1;
+
+        int p0[3], p1[3];
+        expand565(c0, p0);
+        expand565(c1, p1);
+        float palette[4][4] = {};
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[0][c] = (float)p0[c];
+            palette[1][c] = (float)p1[c];
+            if (threeColor)
+            {
+                palette[2][c] = (float)((p0[c] + p1[c]) / 2);
+            }
+            else
+            {
+                palette[2][c] = (float)((2 * p0[c] + p1[c]) / 3);
+                palette[3][c] = (float)((p0[c] + 2 * p1[c]) / 3);
+            }
+        }
+
+        /* c0 == c1 reads as three-colour mode, where index 0 is still c0. */
+        const int paletteSize = c0 == c1 ? 1 : threeColor ? 3 : 4;
+        out.error = fitIndices(texels, 3, palette, paletteSize, out.indices);
+        for (int i = 0; threeColor && i < 16; ++i)
+        {
+            if (transparent[i])
+                out.indices[i] = 3;
+        }
+    }
+
+    void encodeColor(const uint8_t* rgba, BlockQuality quality, bool allowTransparent, uint8_t* block)
+    {
+        Texels texels;
+        loadTexels(rgba, texels);
+
+        bool transparent[16];
+        bool opaque[16];
+        bool anyTransparent = false;
+        bool anyOpaque = false;
+        for (int i = 0; i < 16; ++i)
+        {
+            transparent[i] = allowTransparent && rgba[i * 4 + 3] < 128;
+            opaque[i] = !transparent[i];
+            anyTransparent |= transparent[i];
+            anyOpaque |= opaque[i];
+        }
+
+        ColorBlock best;
+        if (!anyOpaque)
+        {
+            best.c0 = best.c1 = 0;
+            for (int i = 0; i < 16; ++i)
+                best.indices[i] = 3;
+        }
+        else
+        {
+            float e0[4], e1[4];
+            principalEndpoints(texels, 3, opaque, e0, e1);
+            fitColor(texels, e0, e1, anyTransparent, transparent, best);
+
+            for (int iteration = 0; quality == kBlockHigh && iteration < 2; ++iteration)
+            {
+                /* Positions of the palette entries between c0 and c1. */
+                static const float kFour[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+                static const float kThree[4] = { 0.0f, 1.0f, 0.5f, -1.0f };
+                float t[16];
+                for (int i = 0; i < 16; ++i)
+                    t[i] = anyTransparent ? kThree[best.indices[i]] : kFour[best.indices[i]];
+                if (!solveEndpoints(texels, 3, t, e0, e1))
+                    break;
+                ColorBlock candidate;
+                fitColor(texels, e0, e1, anyTransparent, transparent, candidate);
+                if (candidate.error >= best.error)
+                    break;
+                best = candidate;
+            }
+        }
+
+        block[0] = (uint8_t)best.c0;
+        block[1] = (uint8_t)(best.c0 >> 8);
+        block[2] = (uint8_t)best.c1;
+        block[3] = (uint8_t)(best.c1 >> 8);
+        uint32_t indices = 0;
+        for (int i = 15; i >= 0; --i)
+            indices = indices << 2 | (uint32_t)best.indices[i];
+        for (int i = 0; i < 4; ++i)
+            block[4 + i] = (uint8_t)(indices >> (i * 8));
+    }
+
+    /* BC4 channel ----------------------------------------------------------- */
+
+    /* Fits one channel with endpoints a0, a1: eight interpolated values when
+       a0 > a1, otherwise six plus 0 and 255. */
+    float fitChannel(const Texels& texels, int a0, int a1, int* indices)
+    {
+        float palette[8][4] = {};
+        palette[0][0] = (float)a0;
+        palette[1][0] = (float)a1;
+        if (a0 > a1)
+        {
+            for (int i = 2; i < 8; ++i)
+                palette[i][0] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+        }
+        else
+        {
+            for (int i = 2; i < 6; ++i)
+                palette[i][0] = (float)(((6 - i) * a0 + (i - 1) * a1) / 5);
+            palette[6][0] = 0.0f;
+            palette[7][0] = 255.0f;
+        }
+        return fitIndices(texels, 1, palette, 8, indices);
+    }
+
+    void encodeChannel(const uint8_t* rgba, int channel, BlockQuality quality, uint8_t* block)
+    {
+        Texels texels;
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            texels.c[0][i] = rgba[i * 4 + channel];
+            low = std::min(low, (int)rgba[i * 4 + channel]);
+            high = std::max(high, (int)rgba[i * 4 + channel]);
+        }
+
+        int bestA0 = high, bestA1 = low;
+        int bestIndices[16];
+        float bestError = fitChannel(texels, high, low, bestIndices);
+        if (quality == kBlockHigh && bestError > 0.0f)
+        {
+            int indices[16];
+            /* Pulling the endpoints in a little often lands the interior
+               values closer to the texels. */
+            for (int a0 = std::max(high - 2, 0); a0 <= high; ++a0)
+            {
+                for (int a1 = low; a1 <= std::min(low + 2, 255); ++a1)
+                {
+                    if (a0 <= a1)
+                        continue;
+                    const float error = fitChannel(texels, a0, a1, indices);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        bestA0 = a0;
+                        bestA1 = a1;
+                        memcpy(bestIndices, indices, sizeof(indices));
+                    }
+                }
+            }
+
+            /* Six-value mode, with the extremes left to the explicit 0 and 255. */
+            int innerLow = 255, innerHigh = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                const int v = rgba[i * 4 + channel];
+                if (v > 8 && v < 247)
+                {
+                    innerLow = std::min(innerLow, v);
+                    innerHigh = std::max(innerHigh, v);
+                }
+            }
+            if (innerLow <= innerHigh)
+            {
+                const float error = fitChannel(texels, innerLow, innerHigh, indices);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestA0 = innerLow;
+                    bestA1 = innerHigh;
+                    memcpy(bestIndices, indices, sizeof(indices));
+                }
+            }
+        }
+
+        block[0] = (uint8_t)bestA0;
+        block[1] = (uint8_t)bestA1;
+        uint64_t indices = 0;
+        for (int i = 15; i >= 0; --i)
+            indices = indices << 3 | (uint64_t)bestIndices[i];
+        for (int i = 0; i < 6; ++i)
+            block[2 + i] = (uint8_t)(indices >> (i * 8));
+    }
+
+    /* BC7 mode 6 ------------------------------------------------------------ */
+
+    const int kBc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Bc7Block
+    {
+        int q0[4];    /* 7-bit endpoints */
+        int q1[4];
+        int p0;
+        int p1;
+        int indices[16];
+        float error;
+    };
+
+    void fitBc7(const Texels& texels, const float* e0, const float* e1, int p0, int p1, Bc7Block& out)
+    {
+        out.p0 = p0;
+        out.p1 = p1;
+        int full0[4], full1[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            out.q0[c] = std::min(std::max((int)std::floor((e0[c] - p0) * 0.5f + 0.5f), 0), 127);
+            out.q1[c] = std::min(std::max((int)std::floor((e1[c] - p1) * 0.5f + 0.5f), 0), 127);
+            full0[c] = out.q0[c] << 1 | p0;
+            full1[c] = out.q1[c] << 1 | p1;
+        }
+
+        float palette[16][4];
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 4; ++c)
+                palette[i][c] = (float)(((64 - kBc7Weights[i]) * full0[c] + kBc7Weights[i] * full1[c] + 32) >> 6);
+        out.error = fitIndices(texels, 4, palette, 16, out.indices);
+    }
+
+    /* Tries the four p-bit combinations for a pair of endpoints. Opaque
+       blocks keep both alpha endpoints at 255, which needs both p-bits set:
+       a colour-driven choice of p = 0 would decode alpha as 254. */
+    void fitBc7Best(const Texels& texels, bool opaque, const float* e0, const float* e1, Bc7Block& best)
+    {
+        float opaque0[4] = { e0[0], e0[1], e0[2], 255.0f };
+        float opaque1[4] = { e1[0], e1[1], e1[2], 255.0f };
+        best.error = FLT_MAX;
+        for (int p = opaque ? 3 : 0; p < 4; ++p)
+        {
+            Bc7Block candidate;
+            fitBc7(texels, opaque ? opaque0 : e0, opaque ? opaque1 : e1, p & 1, p >> 1, candidate);
+            if (candidate.error < best.error)
+                best = candidate;
+        }
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* out)
+            : m_out(out)
+            , m_position(0)
+        {
+            memset(out, 0, 16);
+        }
+
+        void write(unsigned value, int count)
+        {
+            for (int i = 0; i < count; ++i, ++m_position)
+                m_out[m_position >> 3] |= (uint8_t)((value >> i & 1) << (m_position & 7));
+        }
+
+    private:
+        uint8_t* m_out;
+        int m_position;
+    };
+
+    void encodeBc7(const uint8_t* rgba, BlockQuality quality, uint8_t* block)
+    {
+        Texels texels;
+        loadTexels(rgba, texels);
+
+        bool all[16];
+        std::fill(all, all + 16, true);
+        float e0[4], e1[4];
+        principalEndpoints(texels, 4, all, e0, e1);
+
+        bool opaque = true;
+        for (int i = 0; i < 16; ++i)
+            opaque = opaque && rgba[i * 4 + 3] == 255;
+
+        Bc7Block best;
+        fitBc7Best(texels, opaque, e0, e1, best);
+        for (int iteration = 0; quality == kBlockHigh && iteration < 2; ++iteration)
+        {
+            float t[16];
+            for (int i = 0; i < 16; ++i)
+                t[i] = kBc7Weights[best.indices[i]] / 64.0f;
+            if (!solveEndpoints(texels, 4, t, e0, e1))
+                break;
+            Bc7Block candidate;
+            fitBc7Best(texels, opaque, e0, e1, candidate);
+            if (candidate.error >= best.error)
+                break;
+            best = candidate;
+        }
+
+        /* Texel 0's index has an implicit zero top bit; flip the block if it
+           needs it set. */
+        if (best.indices[0] & 8)
+        {
+            std::swap(best.q0, best.q1);
+            std::swap(best.p0, best.p1);
+            for (int i = 0; i < 16; ++i)
+                best.indices[i] = 15 - best.indices[i];
+        }
+
+        BitWriter bits(block);
+        bits.write(1 << 6, 7);
+        for (int c = 0; c < 4; ++c)
+        {
+            bits.write((unsigned)best.q0[c], 7);
+            bits.write((unsigned)best.q1[c], 7);
+        }
+        bits.write((unsigned)best.p0, 1);
+        bits.write((unsigned)best.p1, 1);
+        bits.write((unsigned)best.indices[0], 3);
+        for (int i = 1; i < 16; ++i)
+            bits.write((unsigned)best.indices[i], 4);
+    }
+}
+
+size_t blockBytes(BlockFormat format)
+{
+    return format == kBC1 || format == kBC4 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void compressBlock(BlockFormat format, BlockQuality quality, const uint8_t* rgba, uint8_t* block)
+{
+    switch (format)
+    {
+    case kBC1:
+        encodeColor(rgba, quality, true, block);
+        break;
+    case kBC3:
+        encodeChannel(rgba, 3, quality, block);
+        encodeColor(rgba, quality, false, block + 8);
+        break;
+    case kBC4:
+        encodeChannel(rgba, 0, quality, block);
+        break;
+    case kBC5:
+        encodeChannel(rgba, 0, quality, block);
+        encodeChannel(rgba, 1, quality, block + 8);
+        break;
+    case kBC7:
+        encodeBc7(rgba, quality, block);
+        break;
+    }
+}
+
+void compressImage(const Image& image, BlockFormat format, BlockQuality quality, ThreadPool& pool,
+    std::vector<uint8_t>& out)
+{
+    const int blocksWide = (image.width + 3) / 4;
+    const int blocksHigh = (image.height + 3) / 4;
+    const size_t bytes = blockBytes(format);
+    out.resize(compressedSize(format, image.width, image.height));
+
+    pool.parallelFor((size_t)blocksHigh, [&](size_t by)
+    {
+        uint8_t texels[64];
+        for (int bx = 0; bx < blocksWide; ++bx)
+        {
+            /* Edge blocks repeat the last row and column. */
+            for (int y = 0; y < 4; ++y)
+            {
+                const int sy = std::min((int)by * 4 + y, image.height - 1);
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int sx = std::min(bx * 4 + x, image.width - 1);
+                    memcpy(texels + (y * 4 + x) * 4, &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+                }
+            }
+            compressBlock(format, quality, texels, &out[(by * blocksWide + bx) * bytes]);
+        }
+    });
+}
@@ -0,0 +1,124 @@
+#include "ColorConvert.h"
+
+#include "Simd.h"
+
+/* Fixed-point BT.601 coefficients, scaled by 256. */
+static inline uint8_t lumaOf(int r, int g, int b)
+{
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t chromaUOf(int r, int g, int b)
+{
+    return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t chromaVOf(int r, int g, int b)
+{
+    return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+#ifdef SIMD_SSE2
+/* Weighted sum of R, G, B for four RGBA pixels, as four 32-bit lanes. */
+static inline __m128i weightedSum4(__m128i pixels, __m128i weights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+    /* Each pixel produced two partial sums (r+g, b+a); add them. */
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+    return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+/* (sum + 128) >> 8 plus bias, for two groups of four, packed to 16-bit lanes. */
+static inline __m128i finish8(__m128i a, __m128i b, int bias)
+{
+    const __m128i round = _mm_set1_epi32(128);
+    a = _mm_srai_epi32(_mm_add_epi32(a, round), 8);
+    b = _mm_srai_epi32(_mm_add_epi32(b, round), 8);
+    return _mm_add_epi16(_mm_packs_epi32(a, b), _mm_set1_epi16((short)bias));
+}
+#endif
+
+static void lumaRow(const uint8_t* src, int width, uint8_t* dst)
+{
+    int x = 0;
+#ifdef SIMD_SSE2
+    const __m128i weights = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i* p = (const __m128i*)(src + x * 4);
+        __m128i s0 = weightedSum4(_mm_loadu_si128(p + 0), weights);
+        __m128i s1 = weightedSum4(_mm_loadu_si128(p + 1), weights);
+        __m128i s2 = weightedSum4(_mm_loadu_si128(p + 2), weights);
+        __m128i s3 = weightedSum4(_mm_loadu_si128(p + 3), weights);
+        __m128i y = _mm_packus_epi16(finish8(s0, s1, 16), finish8(s2, s3, 16));
+        _mm_storeu_si128((__m128i*)(dst + x), y);
+    }
+#endif
+    for (; x < width; ++x)
+        dst[x] = lumaOf(src[x * 4], src[x * 4 + 1], src[x * 4 + 2]);
+}
+
+/* Chroma for one pair of source rows (row1 may equal row0 for odd heights). */
+static void chromaRow(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* u, uint8_t* v)
+{
+    int x = 0;
+#ifdef SIMD_SSE2
+    const __m128i weightsU = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+    const __m128i weightsV = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i averaged[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            const __m128i* a = (const __m128i*)(row0 + (x + half * 8) * 4);
+            const __m128i* b = (const __m128i*)(row1 + (x + half * 8) * 4);
+            /* Vertical average, then average each pixel with its right neighbour;
+               the results land in pixels 0 and 2 of each register. */
+            __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(a), _mm_loadu_si128(b));
+            __m128i v1 = _mm_avg_epu8(_mm_loadu_si128(a + 1), _mm_loadu_si128(b + 1));
+            v0 = _mm_avg_epu8(v0, _mm_srli_epi64(v0, 32));
+            v1 = _mm_avg_epu8(v1, _mm_srli_epi64(v1, 32));
+            averaged[half] = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+        __m128i us = finish8(weightedSum4(averaged[0], weightsU), weightedSum4(averaged[1], weightsU), 128);
+        __m128i vs = finish8(weightedSum4(averaged[0], weightsV), weightedSum4(averaged[1], weightsV), 128);
+        _mm_storel_epi64((__m128i*)(u + x / 2), _mm_packus_epi16(us, us));
+        _mm_storel_epi64((__m128i*)(v + x / 2), _mm_packus_epi16(vs, vs));
+    }
+#endif
+    for (; x < width; x += 2)
+    {
+        const int x1 = x + 1 < width ? x + 1 : x;
+        int r = 0, g = 0, b = 0;
+        const uint8_t* pixels[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+        for (const uint8_t* p : pixels)
+        {
+            r += p[0];
+            g += p[1];
+            b += p[2];
+        }
+        r = (r + 2) >> 2;
+        g = (g + 2) >> 2;
+        b = (b + 2) >> 2;
+        u[x / 2] = chromaUOf(r, g, b);
+        v[x / 2] = chromaVOf(r, g, b);
+    }
+}
+
+void rgbaToI420Flipped(const uint8_t* rgba, size_t stride, int width, int height,
+    uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    const int chromaWidth = (width + 1) / 2;
+    for (int row = 0; row < height; ++row)
+        lumaRow(rgba + stride * (height - 1 - row), width, y + (size_t)width * row);
+
+    for (int row = 0; row < height; row += 2)
+    {
+        const uint8_t* row0 = rgba + stride * (height - 1 - row);
+        const uint8_t* row1 = row + 1 < height ? rgba + stride * (height - 2 - row) : row0;
+        chromaRow(row0, row1, width, u + (size_t)chromaWidth * (row / 2), v + (size_t)chromaWidth * (row / 2));
+    }
+}
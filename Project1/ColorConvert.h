@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Converts an RGBA8 image to planar 4:2:0 YUV (BT.601, limited range), with
+   chroma taken from the average of each 2x2 block. Rows are read bottom-up, as
+   glReadPixels returns them, and written top-down. Odd sizes are supported;
+   chroma planes are (width + 1) / 2 by (height + 1) / 2. */
+void rgbaToI420Flipped(const uint8_t* rgba, size_t stride, int width, int height,
+    uint8_t* y, uint8_t* u, uint8_t* v);
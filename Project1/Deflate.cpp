@@ -0,0 +1,910 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace
+{
+    const int kWindowSize = 32768;
+    const int kHashBits = 15;
+    const int kMinMatch = 3;
+    const int kMaxMatch = 258;
+    const size_t kTokensPerBlock = 1 << 16;
+
+    const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    /* Symbol lookup for match lengths 0..258 and distances 1..32768. */
+    struct CodeTables
+    {
+        uint8_t lengthCode[kMaxMatch + 1];
+        uint8_t distanceCode[kWindowSize + 1];
+
+        CodeTables()
+        {
+            for (int code = 0; code < 29; ++code)
+            {
+                const int last = code == 28 ? kMaxMatch : kLengthBase[code + 1] - 1;
+                for (int length = kLengthBase[code]; length <= last; ++length)
+                    lengthCode[length] = (uint8_t)code;
+            }
+            lengthCode[kMaxMatch] = 28;
+            for (int code = 0; code < 30; ++code)
+            {
+                const int last = code == 29 ? kWindowSize : kDistanceBase[code + 1] - 1;
+                for (int distance = kDistanceBase[code]; distance <= last; ++distance)
+                    distanceCode[distance] = (uint8_t)code;
+            }
+        }
+    };
+
+    const CodeTables& codeTables()
+    {
+        static const CodeTables tables;
+        return tables;
+    }
+
+    /* A literal (distance 0) or a match. */
+    struct Token
+    {
+        uint16_t value;
+        uint16_t distance;
+    };
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_bits(0), m_count(0) {}
+
+        void put(uint32_t value, int count)
+        {
+            m_bits |= (uint64_t)value << m_count;
+            m_count += count;
+            while (m_count >= 8)
+            {
+                m_out.push_back((uint8_t)m_bits);
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void alignToByte()
+        {
+            if (m_count > 0)
+                put(0, 8 - m_count);
+        }
+
+    private:
+        std::vector<uint8_t>& m_out;
+        uint64_t m_bits;
+        int m_count;
+    };
+
+    uint32_t reverseBits(uint32_t code, int length)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i)
+        {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+        return reversed;
+    }
+
+    /* Huffman code lengths limited to maxBits, following the usual approach:
+       build an unrestricted tree, fold overlong codes into maxBits while
+       keeping the Kraft sum at one, then hand the shortest codes to the most
+       frequent symbols. */
+    void buildLengths(const uint32_t* frequencies, int count, int maxBits, uint8_t* lengths)
+    {
+        std::fill(lengths, lengths + count, (uint8_t)0);
+
+        std::vector<int> used;
+        for (int i = 0; i < count; ++i)
+            if (frequencies[i])
+                used.push_back(i);
+
+        /* A code needs two symbols to be complete; pad with unused ones. */
+        for (int i = 0; used.size() < 2 && i < count; ++i)
+            if (!frequencies[i])
+                used.push_back(i);
+        if (used.size() < 2)
+            return;
+
+        struct Node
+        {
+            uint64_t weight;
+            int parent;
+        };
+        std::vector<Node> nodes(used.size());
+        typedef std::pair<uint64_t, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        for (size_t i = 0; i < used.size(); ++i)
+        {
+            nodes[i].weight = frequencies[used[i]] ? frequencies[used[i]] : 1;
+            nodes[i].parent = -1;
+            heap.push(Entry(nodes[i].weight, (int)i));
+        }
+        while (heap.size() > 1)
+        {
+            Entry a = heap.top();
+            heap.pop();
+            Entry b = heap.top();
+            heap.pop();
+            Node parent = { a.first + b.first, -1 };
+            nodes.push_back(parent);
+            const int index = (int)nodes.size() - 1;
+            nodes[a.second].parent = index;
+            nodes[b.second].parent = index;
+            heap.push(Entry(parent.weight, index));
+        }
+
+        int lengthCounts[64] = {};
+        for (size_t i = 0; i < used.size(); ++i)
+        {
+            int depth = 0;
+            for (int node = (int)i; nodes[node].parent >= 0; node = nodes[node].parent)
+                ++depth;
+            lengthCounts[std::min(depth, 63)]++;
+        }
+
+        for (int i = maxBits + 1; i < 64; ++i)
+        {
+            lengthCounts[maxBits] += lengthCounts[i];
+            lengthCounts[i] = 0;
+        }
+        uint32_t total = 0;
+        for (int i = maxBits; i > 0; --i)
+            total += (uint32_t)lengthCounts[i] << (maxBits - i);
+        while (total != (1u << maxBits))
+        {
+            lengthCounts[maxBits]--;
+            for (int i = maxBits - 1; i > 0; --i)
+            {
+                if (lengthCounts[i])
+                {
+                    lengthCounts[i]--;
+                    lengthCounts[i + 1] += 2;
+                    break;
+                }
+            }
+            total--;
+        }
+
+        std::sort(used.begin(), used.end(), [frequencies](int a, int b)
+        {
+            return frequencies[a] != frequencies[b] ? frequencies[a] > frequencies[b] : a < b;
+        });
+        size_t next = 0;
+        for (int length = 1; length <= maxBits; ++length)
+            for (int i = 0; i < lengthCounts[length]; ++i)
+                lengths[used[next++]] = (uint8_t)length;
+    }
+
+    void buildCodes(const uint8_t* lengths, int count, uint16_t* codes)
+    {
+        int lengthCounts[16] = {};
+        for (int i = 0; i < count; ++i)
+            lengthCounts[lengths[i]]++;
+        lengthCounts[0] = 0;
+
+        uint32_t nextCode[16] = {};
+        uint32_t code = 0;
+        for (int bits = 1; bits < 16; ++bits)
+        {
+            code = (code + lengthCounts[bits - 1]) << 1;
+            nextCode[bits] = code;
+        }
+        for (int i = 0; i < count; ++i)
+            codes[i] = lengths[i] ? (uint16_t)reverseBits(nextCode[lengths[i]]++, lengths[i]) : 0;
+    }
+
+    void writeBlock(BitWriter& writer, const Token* tokens, size_t tokenCount, bool final)
+    {
+        const CodeTables& tables = codeTables();
+
+        uint32_t literalFrequencies[286] = {};
+        uint32_t distanceFrequencies[30] = {};
+        for (size_t i = 0; i < tokenCount; ++i)
+        {
+            if (tokens[i].distance == 0)
+                literalFrequencies[tokens[i].value]++;
+            else
+            {
+                literalFrequencies[257 + tables.lengthCode[tokens[i].value]]++;
+                distanceFrequencies[tables.distanceCode[tokens[i].distance]]++;
+            }
+        }
+        literalFrequencies[256] = 1;
+
+        uint8_t literalLengths[286], distanceLengths[30];
+        uint16_t literalCodes[286], distanceCodes[30];
+        buildLengths(literalFrequencies, 286, 15, literalLengths);
+        buildLengths(distanceFrequencies, 30, 15, distanceLengths);
+        buildCodes(literalLengths, 286, literalCodes);
+        buildCodes(distanceLengths, 30, distanceCodes);
+
+        int literalCount = 286;
+        while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+            --literalCount;
+        int distanceCount = 30;
+        while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+            --distanceCount;
+
+        /* Run-length encode both length tables with symbols 16, 17 and 18. */
+        uint8_t all[286 + 30];
+        memcpy(all, literalLengths, literalCount);
+        memcpy(all + literalCount, distanceLengths, distanceCount);
+        const int allCount = literalCount + distanceCount;
+
+        std::vector<uint8_t> symbols, extras;
+        for (int i = 0; i < allCount; )
+        {
+            const uint8_t value = all[i];
+            int run = 1;
+            while (i + run < allCount && all[i + run] == value)
+                ++run;
+            i += run;
+
+            if (value == 0)
+            {
+                while (run >= 11)
+                {
+                    const int n = std::min(run, 138);
+                    symbols.push_back(18);
+                    extras.push_back((uint8_t)(n - 11));
+                    run -= n;
+                }
+                if (run >= 3)
+                {
+                    symbols.push_back(17);
+                    extras.push_back((uint8_t)(run - 3));
+                    run = 0;
+                }
+            }
+            else
+            {
+                symbols.push_back(value);
+                extras.push_back(0);
+                --run;
+                while (run >= 3)
+                {
+                    const int n = std::min(run, 6);
+                    symbols.push_back(16);
+                    extras.push_back((uint8_t)(n - 3));
+                    run -= n;
+                }
+            }
+            for (; run > 0; --run)
+            {
+                symbols.push_back(value);
+                extras.push_back(0);
+            }
+        }
+
+        uint32_t codeLengthFrequencies[19] = {};
+        for (uint8_t symbol : symbols)
+            codeLengthFrequencies[symbol]++;
+        uint8_t codeLengthLengths[19];
+        uint16_t codeLengthCodes[19];
+        buildLengths(codeLengthFrequencies, 19, 7, codeLengthLengths);
+        buildCodes(codeLengthLengths, 19, codeLengthCodes);
+
+        int codeLengthCount = 19;
+        while (codeLengthCount > 4 && codeLengthLengths[kCodeLengthOrder[codeLengthCount - 1]] == 0)
+            --codeLengthCount;
+
+        writer.put(final ? 1 : 0, 1);
+        writer.put(2, 2);
+        writer.put(literalCount - 257, 5);
+        writer.put(distanceCount - 1, 5);
+        writer.put(codeLengthCount - 4, 4);
+        for (int i = 0; i < codeLengthCount; ++i)
+            writer.put(codeLengthLengths[kCodeLengthOrder[i]], 3);
+        for (size_t i = 0; i < symbols.size(); ++i)
+        {
+            writer.put(codeLengthCodes[symbols[i]], codeLengthLengths[symbols[i]]);
+            if (symbols[i] == 16)
+                writer.put(extras[i], 2);
+            else if (symbols[i] == 17)
+                writer.put(extras[i], 3);
+            else if (symbols[i] == 18)
+                writer.put(extras[i], 7);
+        }
+
+        for (size_t i = 0; i < tokenCount; ++i)
+        {
+            const Token& token = tokens[i];
+            if (token.distance == 0)
+            {
+                writer.put(literalCodes[token.value], literalLengths[token.value]);
+                continue;
+            }
+            const int lengthCode = tables.lengthCode[token.value];
+            writer.put(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+            writer.put(token.value - kLengthBase[lengthCode], kLengthExtra[lengthCode]);
+            const int distanceCode = tables.distanceCode[token.distance];
+            writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+            writer.put(token.distance - kDistanceBase[distanceCode], kDistanceExtra[distanceCode]);
+        }
+        writer.put(literalCodes[256], literalLengths[256]);
+    }
+
+    inline uint32_t hash3(const uint8_t* p)
+    {
+        const uint32_t value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        return (value * 2654435761u) >> (32 - kHashBits);
+    }
+}
+
+void deflateRange(const uint8_t* data, size_t begin, size_t end, bool final, int level, std::vector<uint8_t>& out)
+{
+    const int maxChain = level <= 1 ? 4 : level >= 9 ? 256 : 4 << (level / 2);
+    std::vector<int32_t> head((size_t)1 << kHashBits, -1);
+    std::vector<int32_t> previous(kWindowSize, -1);
+
+    /* Positions are stored relative to the start of the usable history. */
+    const size_t origin = begin > (size_t)kWindowSize ? begin - kWindowSize : 0;
+    const uint8_t* base = data + origin;
+    const int32_t start = (int32_t)(begin - origin);
+    const int32_t limit = (int32_t)(end - origin);
+
+    auto insert = [&](int32_t position)
+    {
+        const uint32_t h = hash3(base + position);
+        previous[position & (kWindowSize - 1)] = head[h];
+        head[h] = position;
+    };
+
+    for (int32_t position = 0; position < start && position + kMinMatch <= limit; ++position)
+        insert(position);
+
+    BitWriter writer(out);
+    std::vector<Token> tokens;
+    tokens.reserve(kTokensPerBlock);
+
+    bool closed = false;
+    int32_t position = start;
+    while (position < limit)
+    {
+        int bestLength = 0;
+        int bestDistance = 0;
+        if (position + kMinMatch <= limit)
+        {
+            const int maxLength = std::min(kMaxMatch, (int)(limit - position));
+            int32_t candidate = head[hash3(base + position)];
+            for (int chain = maxChain; candidate >= 0 && chain > 0; --chain)
+            {
+                const int distance = position - candidate;
+                if (distance > kWindowSize)
+                    break;
+                if (base[candidate + bestLength] == base[position + bestLength])
+                {
+                    int length = 0;
+                    while (length < maxLength && base[candidate + length] == base[position + length])
+                        ++length;
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == maxLength)
+                            break;
+                    }
+                }
+                const int32_t next = previous[candidate & (kWindowSize - 1)];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+            insert(position);
+        }
+
+        Token token;
+        if (bestLength >= kMinMatch)
+        {
+            token.value = (uint16_t)bestLength;
+            token.distance = (uint16_t)bestDistance;
+            for (int32_t i = 1; i < bestLength; ++i)
+                if (position + i + kMinMatch <= limit)
+                    insert(position + i);
+            position += bestLength;
+        }
+        else
+        {
+            token.value = base[position];
+            token.distance = 0;
+            ++position;
+        }
+        tokens.push_back(token);
+
+        if (tokens.size() == kTokensPerBlock)
+        {
+            closed = final && position >= limit;
+            writeBlock(writer, tokens.data(), tokens.size(), closed);
+            tokens.clear();
+        }
+    }
+
+    if (!tokens.empty() || (final && !closed))
+        writeBlock(writer, tokens.data(), tokens.size(), final);
+
+    if (!final)
+    {
+        /* Sync flush: empty stored block, which also byte-aligns. */
+        writer.put(0, 3);
+        writer.alignToByte();
+        out.push_back(0x00);
+        out.push_back(0x00);
+        out.push_back(0xff);
+        out.push_back(0xff);
+    }
+    writer.alignToByte();
+}
+
+uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size)
+{
+    const uint32_t kBase = 65521;
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        /* 5552 is the most bytes that cannot overflow b before the modulo. */
+        size_t chunk = size < 5552 ? size : 5552;
+        size -= chunk;
+        while (chunk--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= kBase;
+        b %= kBase;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize)
+{
+    const uint32_t kBase = 65521;
+    const uint32_t remainder = (uint32_t)(secondSize % kBase);
+    uint32_t sum1 = first & 0xffff;
+    uint32_t sum2 = (uint32_t)(((uint64_t)remainder * sum1) % kBase);
+    sum1 += (second & 0xffff) + kBase - 1;
+    sum2 += ((first >> 16) & 0xffff) + ((second >> 16) & 0xffff) + kBase - remainder;
+    if (sum1 >= kBase)
+        sum1 -= kBase;
+    if (sum1 >= kBase)
+        sum1 -= kBase;
+    if (sum2 >= (kBase << 1))
+        sum2 -= (kBase << 1);
+    if (sum2 >= kBase)
+        sum2 -= kBase;
+    return sum1 | (sum2 << 16);
+}
+
+namespace
+{
+    /* Slicing-by-8 tables for the reflected CRC-32 polynomial. */
+    struct CrcTables
+    {
+        uint32_t table[8][256];
+
+        CrcTables()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+                for (int slice = 1; slice < 8; ++slice)
+                    table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+        }
+    };
+}
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static const CrcTables tables;
+    const uint32_t (*t)[256] = tables.table;
+
+    crc = ~crc;
+    while (size >= 8)
+    {
+        const uint32_t low = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+            ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+namespace
+{
+    /* Codes up to this many bits resolve with one table lookup. */
+    const int kFastBits = 10;
+
+    struct Huffman
+    {
+        uint16_t fast[1 << kFastBits];   /* (length << 9) | symbol, 0 for longer codes */
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    /* Canonical decoding table from code lengths. Incomplete codes are
+       allowed (a single distance code is legal), over-subscribed ones are not. */
+    bool buildHuffman(Huffman& table, const uint8_t* lengths, int count)
+    {
+        memset(table.counts, 0, sizeof(table.counts));
+        for (int i = 0; i < count; ++i)
+            table.counts[lengths[i]]++;
+        table.counts[0] = 0;
+
+        int left = 1;
+        for (int bits = 1; bits < 16; ++bits)
+        {
+            left = (left << 1) - table.counts[bits];
+            if (left < 0)
+                return false;
+        }
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int bits = 1; bits < 15; ++bits)
+            offsets[bits + 1] = offsets[bits] + table.counts[bits];
+        for (int i = 0; i < count; ++i)
+            if (lengths[i])
+                table.symbols[offsets[lengths[i]]++] = (uint16_t)i;
+
+        memset(table.fast, 0, sizeof(table.fast));
+        uint32_t code = 0;
+        int index = 0;
+        for (int bits = 1; bits <= kFastBits; ++bits)
+        {
+            for (int i = 0; i < table.counts[bits]; ++i, ++code, ++index)
+            {
+                const uint16_t entry = (uint16_t)((bits << 9) | table.symbols[index]);
+                for (uint32_t slot = reverseBits(code, bits); slot < (1u << kFastBits); slot += 1u << bits)
+                    table.fast[slot] = entry;
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t size) : m_data(data), m_end(data + size), m_bits(0), m_count(0), m_overrun(0) {}
+
+        void refill()
+        {
+            while (m_count <= 56)
+            {
+                if (m_data < m_end)
+                    m_bits |= (uint64_t)*m_data++ << m_count;
+                else
+                    m_overrun++;
+                m_count += 8;
+            }
+        }
+
+        uint32_t peek(int count) const { return (uint32_t)(m_bits & ((1ull << count) - 1)); }
+
+        void consume(int count)
+        {
+            m_bits >>= count;
+            m_count -= count;
+        }
+
+        uint32_t get(int count)
+        {
+            if (m_count < count)
+                refill();
+            const uint32_t value = peek(count);
+            consume(count);
+            return value;
+        }
+
+        void alignToByte() { consume(m_count & 7); }
+
+        /* Bytes actually consumed, once aligned; the rest of the bit buffer is returned. */
+        const uint8_t* position() const { return m_data - (m_count / 8 - m_overrun); }
+
+        void seek(const uint8_t* position)
+        {
+            m_data = position;
+            m_bits = 0;
+            m_count = 0;
+            m_overrun = 0;
+        }
+
+        /* True once more zero bytes were made up past the end than could still be buffered. */
+        bool exhausted() const { return m_overrun * 8 > m_count; }
+
+    private:
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+        uint64_t m_bits;
+        int m_count;
+        int m_overrun;
+    };
+
+    int decodeSymbol(BitReader& reader, const Huffman& table)
+    {
+        reader.refill();
+        const uint16_t entry = table.fast[reader.peek(kFastBits)];
+        if (entry)
+        {
+            reader.consume(entry >> 9);
+            return entry & 511;
+        }
+
+        /* Longer code: walk the canonical code one bit at a time. */
+        const uint32_t bits = reader.peek(15);
+        int code = 0, first = 0, index = 0;
+        for (int length = 1; length < 16; ++length)
+        {
+            code |= (bits >> (length - 1)) & 1;
+            const int count = table.counts[length];
+            if (code - first < count)
+            {
+                reader.consume(length);
+                return table.symbols[index + code - first];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    struct FixedTables
+    {
+        Huffman literals;
+        Huffman distances;
+
+        FixedTables()
+        {
+            uint8_t lengths[288];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            buildHuffman(literals, lengths, 288);
+            memset(lengths, 5, 30);
+            buildHuffman(distances, lengths, 30);
+        }
+    };
+
+    bool readDynamicTables(BitReader& reader, Huffman& literals, Huffman& distances, std::string& log)
+    {
+        const int literalCount = reader.get(5) + 257;
+        const int distanceCount = reader.get(5) + 1;
+        const int codeLengthCount = reader.get(4) + 4;
+        if (literalCount > 286 || distanceCount > 30)
+        {
+            log = "deflate: too many length or distance codes";
+            return false;
+        }
+
+        uint8_t codeLengthLengths[19] = {};
+        for (int i = 0; i < codeLengthCount; ++i)
+            codeLengthLengths[kCodeLengthOrder[i]] = (uint8_t)reader.get(3);
+        Huffman codeLengths;
+        if (!buildHuffman(codeLengths, codeLengthLengths, 19))
+        {
+            log = "deflate: invalid code length code";
+            return false;
+        }
+
+        uint8_t lengths[286 + 30];
+        for (int i = 0; i < literalCount + distanceCount; )
+        {
+            const int symbol = decodeSymbol(reader, codeLengths);
+            if (symbol < 0)
+            {
+                log = "deflate: invalid code length symbol";
+                return false;
+            }
+            if (symbol < 16)
+            {
+                lengths[i++] = (uint8_t)symbol;
+                continue;
+            }
+
+            uint8_t value = 0;
+            int repeat;
+            if (symbol == 16)
+            {
+                if (i == 0)
+                {
+                    log = "deflate: length repeat with no previous length";
+                    return false;
+                }
+                value = lengths[i - 1];
+                repeat = 3 + reader.get(2);
+            }
+            else if (symbol == 17)
+                repeat = 3 + reader.get(3);
+            else
+                repeat = 11 + reader.get(7);
+
+            if (i + repeat > literalCount + distanceCount)
+            {
+                log = "deflate: code lengths overflow";
+                return false;
+            }
+            memset(lengths + i, value, repeat);
+            i += repeat;
+        }
+
+        if (lengths[256] == 0)
+        {
+            log = "deflate: no end-of-block code";
+            return false;
+        }
+        if (!buildHuffman(literals, lengths, literalCount) || !buildHuffman(distances, lengths + literalCount, distanceCount))
+        {
+            log = "deflate: over-subscribed Huffman code";
+            return false;
+        }
+        return true;
+    }
+}
+
+bool inflateZlib(const uint8_t* data, size_t size, size_t sizeHint, std::vector<uint8_t>& out, std::string& log)
+{
+    if (size < 6 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0)
+    {
+        log = "zlib: bad header";
+        return false;
+    }
+    if (data[1] & 0x20)
+    {
+        log = "zlib: preset dictionaries are not supported";
+        return false;
+    }
+
+    static const FixedTables fixed;
+    Huffman literals, distances;
+
+    /* Output grows by doubling and is trimmed at the end, which keeps the
+       match copy loop free of per-byte capacity checks. */
+    const size_t start = out.size();
+    size_t position = start;
+    out.resize(start + std::max<size_t>(sizeHint, 1024));
+
+    BitReader reader(data + 2, size - 2);
+    bool last = false;
+    while (!last)
+    {
+        last = reader.get(1) != 0;
+        const uint32_t type = reader.get(2);
+
+        if (type == 0)
+        {
+            reader.alignToByte();
+            const uint8_t* block = reader.position();
+            if (data + size - block < 4)
+            {
+                log = "deflate: truncated stored block";
+                return false;
+            }
+            const uint32_t length = block[0] | (block[1] << 8);
+            const uint32_t inverse = block[2] | (block[3] << 8);
+            if ((length ^ 0xffff) != inverse || (size_t)(data + size - block - 4) < length)
+            {
+                log = "deflate: corrupt stored block";
+                return false;
+            }
+            if (position + length > out.size())
+                out.resize(std::max(out.size() * 2, position + length));
+            memcpy(out.data() + position, block + 4, length);
+            position += length;
+            reader.seek(block + 4 + length);
+            continue;
+        }
+
+        const Huffman* literalTable = &fixed.literals;
+        const Huffman* distanceTable = &fixed.distances;
+        if (type == 2)
+        {
+            if (!readDynamicTables(reader, literals, distances, log))
+                return false;
+            literalTable = &literals;
+            distanceTable = &distances;
+        }
+        else if (type != 1)
+        {
+            log = "deflate: invalid block type";
+            return false;
+        }
+
+        for (;;)
+        {
+            const int symbol = decodeSymbol(reader, *literalTable);
+            if (reader.exhausted())
+            {
+                log = "deflate: unexpected end of data";
+                return false;
+            }
+            if (symbol < 256)
+            {
+                if (symbol < 0)
+                {
+                    log = "deflate: invalid literal/length code";
+                    return false;
+                }
+                if (position == out.size())
+                    out.resize(out.size() * 2);
+                out[position++] = (uint8_t)symbol;
+                continue;
+            }
+            if (symbol == 256)
+                break;
+
+            const int lengthCode = symbol - 257;
+            if (lengthCode >= 29)
+            {
+                log = "deflate: invalid length code";
+                return false;
+            }
+            const size_t length = kLengthBase[lengthCode] + reader.get(kLengthExtra[lengthCode]);
+            const int distanceCode = decodeSymbol(reader, *distanceTable);
+            if (distanceCode < 0 || distanceCode >= 30)
+            {
+                log = "deflate: invalid distance code";
+                return false;
+            }
+            const size_t distance = kDistanceBase[distanceCode] + reader.get(kDistanceExtra[distanceCode]);
+            if (distance > position - start)
+            {
+                log = "deflate: distance reaches before the start of the stream";
+                return false;
+            }
+
+            if (position + length > out.size())
+                out.resize(std::max(out.size() * 2, position + length));
+            uint8_t* target = out.data() + position;
+            const uint8_t* source = target - distance;
+            if (distance >= length)
+                memcpy(target, source, length);
+            else
+            {
+                /* Overlapping copy repeats the last distance bytes. */
+                for (size_t i = 0; i < length; ++i)
+                    target[i] = source[i];
+            }
+            position += length;
+        }
+    }
+
+    reader.alignToByte();
+    const uint8_t* trailer = reader.position();
+    out.resize(position);
+    if (data + size - trailer < 4)
+    {
+        log = "zlib: missing checksum";
+        return false;
+    }
+    const uint32_t expected = (uint32_t)trailer[0] << 24 | (uint32_t)trailer[1] << 16 | (uint32_t)trailer[2] << 8 | trailer[3];
+    if (adler32(1, out.data() + start, position - start) != expected)
+    {
+        log = "zlib: checksum mismatch";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Raw deflate (RFC 1951) of data[begin, end), appended to out.
+
+   Matches may reach back into the 32 KiB before begin, so neighbouring ranges
+   compressed independently (and in parallel) still share history. The output
+   always ends on a byte boundary: with final set it closes the stream,
+   otherwise it ends in an empty stored block (a sync flush) so the pieces can
+   be concatenated in order into one valid stream. level runs from 1 (fastest)
+   to 9 (smallest). */
+void deflateRange(const uint8_t* data, size_t begin, size_t end, bool final, int level, std::vector<uint8_t>& out);
+
+/* Decodes a zlib stream (RFC 1950) and appends it to out, checking the
+   Adler-32 trailer. sizeHint reserves space up front when the size is known.
+   Returns false with a message in log on malformed input. */
+bool inflateZlib(const uint8_t* data, size_t size, size_t sizeHint, std::vector<uint8_t>& out, std::string& log);
+
+uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size);
+
+/* Adler-32 of A followed by B, from the checksums of A and B and the size of B. */
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize);
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size);
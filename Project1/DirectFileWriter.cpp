@@ -0,0 +1,175 @@
+#include "DirectFileWriter.h"
+
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DirectFileWriter::DirectFileWriter(size_t bufferSize)
+    : m_buffer(NULL)
+    , m_capacity((bufferSize + kAlignment - 1) / kAlignment * kAlignment)
+    , m_fill(0)
+    , m_written(0)
+    , m_unbuffered(false)
+    , m_failed(false)
+#ifdef _WIN32
+    , m_handle(INVALID_HANDLE_VALUE)
+#else
+    , m_fd(-1)
+#endif
+{
+    m_buffer = (uint8_t*)::operator new(m_capacity, std::align_val_t(kAlignment));
+}
+
+DirectFileWriter::~DirectFileWriter()
+{
+    close();
+    ::operator delete(m_buffer, std::align_val_t(kAlignment));
+}
+
+bool DirectFileWriter::isOpen() const
+{
+#ifdef _WIN32
+    return m_handle != INVALID_HANDLE_VALUE;
+#else
+    return m_fd >= 0;
+#endif
+}
+
+bool DirectFileWriter::open(const std::string& path)
+{
+    close();
+    m_fill = 0;
+    m_written = 0;
+    m_failed = false;
+
+#ifdef _WIN32
+    m_handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    m_unbuffered = m_handle != INVALID_HANDLE_VALUE;
+    if (!m_unbuffered)
+        m_handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    m_fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    m_unbuffered = m_fd >= 0;
+#endif
+    if (m_fd < 0)
+        m_fd = ::open(path.c_str(), flags, 0644);
+#endif
+    return isOpen();
+}
+
+bool DirectFileWriter::write(const void* data, size_t size)
+{
+    if (!isOpen() || m_failed)
+        return false;
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0)
+    {
+        const size_t chunk = size < m_capacity - m_fill ? size : m_capacity - m_fill;
+        memcpy(m_buffer + m_fill, bytes, chunk);
+        m_fill += chunk;
+        bytes += chunk;
+        size -= chunk;
+
+        if (m_fill == m_capacity)
+        {
+            if (!writeBlock(m_buffer, m_capacity))
+                return false;
+            m_written += m_capacity;
+            m_fill = 0;
+        }
+    }
+    return true;
+}
+
+bool DirectFileWriter::writeBlock(const uint8_t* data, size_t size)
+{
+#ifdef _WIN32
+    while (size > 0)
+    {
+        DWORD done = 0;
+        const DWORD request = size > (1u << 30) ? (1u << 30) : (DWORD)size;
+        if (!WriteFile((HANDLE)m_handle, data, request, &done, NULL) || done == 0)
+        {
+            m_failed = true;
+            return false;
+        }
+        data += done;
+        size -= done;
+    }
+#else
+    while (size > 0)
+    {
+        ssize_t done = ::write(m_fd, data, size);
+#ifdef O_DIRECT
+        if (done < 0 && errno == EINVAL && m_unbuffered)
+        {
+            /* Opened fine but the file system rejects direct writes. */
+            fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+            m_unbuffered = false;
+            continue;
+        }
+#endif
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+        {
+            m_failed = true;
+            return false;
+        }
+        data += done;
+        size -= (size_t)done;
+    }
+#endif
+    return true;
+}
+
+bool DirectFileWriter::close()
+{
+    if (!isOpen())
+        return true;
+
+    /* Unbuffered writes must cover whole sectors: pad, then cut the file back. */
+    bool ok = !m_failed;
+    const uint64_t logicalSize = m_written + m_fill;
+    if (ok && m_fill > 0)
+    {
+        const size_t padded = (m_fill + kAlignment - 1) / kAlignment * kAlignment;
+        memset(m_buffer + m_fill, 0, padded - m_fill);
+        ok = writeBlock(m_buffer, m_unbuffered ? padded : m_fill);
+    }
+
+#ifdef _WIN32
+    if (ok)
+    {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)logicalSize;
+        ok = SetFilePointerEx((HANDLE)m_handle, end, NULL, FILE_BEGIN) && SetEndOfFile((HANDLE)m_handle);
+    }
+    CloseHandle((HANDLE)m_handle);
+    m_handle = INVALID_HANDLE_VALUE;
+#else
+    if (ok)
+        ok = ftruncate(m_fd, (off_t)logicalSize) == 0;
+    ::close(m_fd);
+    m_fd = -1;
+#endif
+
+    m_fill = 0;
+    return ok;
+}
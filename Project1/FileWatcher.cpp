@@ -0,0 +1,147 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/* Editors often write a file in several steps (truncate, write, rename). Events
+   that arrive within this window after the first one are merged. */
+static const int kCoalesceMs = 30;
+
+static fs::file_time_type modificationTime(const std::string& path)
+{
+    std::error_code error;
+    fs::file_time_type stamp = fs::last_write_time(path, error);
+    return error ? fs::file_time_type::min() : stamp;
+}
+
+FileWatcher::FileWatcher()
+    : m_fd(-1)
+{
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+}
+
+bool FileWatcher::watch(const std::string& path)
+{
+    fs::path full = fs::absolute(path);
+
+    Entry entry;
+    entry.path = path;
+    entry.directory = full.parent_path().string();
+    entry.name = full.filename().string();
+    entry.stamp = modificationTime(path);
+    entry.descriptor = -1;
+
+#ifdef __linux__
+    if (m_fd >= 0)
+    {
+        /* inotify returns the same descriptor for a directory that is already
+           watched, so several files in one folder share a watch. */
+        entry.descriptor = inotify_add_watch(m_fd, entry.directory.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (entry.descriptor < 0)
+            return false;
+    }
+#endif
+
+    m_entries.push_back(entry);
+    return true;
+}
+
+bool FileWatcher::wait(int timeoutMs, std::vector<std::string>& changed)
+{
+    std::vector<bool> hit(m_entries.size(), false);
+    bool any = false;
+
+#ifdef __linux__
+    if (m_fd >= 0)
+    {
+        int timeout = timeoutMs;
+        for (;;)
+        {
+            pollfd descriptor = { m_fd, POLLIN, 0 };
+            if (poll(&descriptor, 1, timeout) <= 0)
+                break;
+
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(m_fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* cursor = buffer; cursor < buffer + length; )
+                {
+                    const inotify_event* event = (const inotify_event*)cursor;
+                    cursor += sizeof(inotify_event) + event->len;
+                    if (event->len == 0)
+                        continue;
+                    for (size_t i = 0; i < m_entries.size(); ++i)
+                    {
+                        if (m_entries[i].descriptor == event->wd && m_entries[i].name == event->name)
+                        {
+                            hit[i] = true;
+                            any = true;
+                        }
+                    }
+                }
+            }
+
+            if (!any)
+                break;
+            timeout = kCoalesceMs;
+        }
+
+        for (size_t i = 0; i < m_entries.size(); ++i)
+            if (hit[i])
+                changed.push_back(m_entries[i].path);
+        return any;
+    }
+#endif
+
+    /* Polling fallback: check timestamps a few times within the timeout. */
+    const int sliceMs = std::max(1, std::min(timeoutMs, 100));
+    for (int waited = 0; ; waited += sliceMs)
+    {
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            fs::file_time_type stamp = modificationTime(m_entries[i].path);
+            if (stamp != m_entries[i].stamp)
+            {
+                m_entries[i].stamp = stamp;
+                hit[i] = true;
+                any = true;
+            }
+        }
+        if (any || waited >= timeoutMs)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(sliceMs));
+    }
+
+    if (any)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kCoalesceMs));
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            m_entries[i].stamp = modificationTime(m_entries[i].path);
+            if (hit[i])
+                changed.push_back(m_entries[i].path);
+        }
+    }
+    return any;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* Watches a set of files for modification. On Linux this is backed by inotify
+   watches on the parent directories, so editors that save through a rename are
+   picked up as well. Other platforms fall back to polling modification times. */
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /* Starts watching path. Returns false if it cannot be watched. */
+    bool watch(const std::string& path);
+
+    /* Blocks for at most timeoutMs. Returns true and appends the watched paths
+       that changed since the last call. Bursts of events for the same save are
+       coalesced into a single report. */
+    bool wait(int timeoutMs, std::vector<std::string>& changed);
+
+private:
+    struct Entry
+    {
+        std::string path;
+        std::string directory;
+        std::string name;
+        std::filesystem::file_time_type stamp;
+        int descriptor;
+    };
+
+    std::vector<Entry> m_entries;
+    int m_fd;
+};
@@ -0,0 +1,763 @@
+#include "GltfModel.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "MappedFile.h"
+
+namespace
+{
+    const uint32_t kGlbMagic = 0x46546C67;      /* "glTF" */
+    const uint32_t kChunkJson = 0x4E4F534A;     /* "JSON" */
+    const uint32_t kChunkBin = 0x004E4942;      /* "BIN\0" */
+    const int kMaxDepth = 64;
+
+    /* A sparse accessor without a buffer view is all zeros apart from its
+       sparse values, so nothing in the file bounds its size; expanding one
+       larger than this fails the load instead. */
+    const size_t kMaxExpandedBytes = (size_t)1 << 28;
+
+    /* What JsonValue::integer() returns for a number that is not a whole
+       value in the range a double holds exactly. Negative, so every check
+       that rejects a negative index, count or offset rejects it too. */
+    const int64_t kBadInteger = INT64_MIN;
+
+    /* Just enough JSON for glTF: a DOM of values, objects keeping their
+       members in order. */
+    struct JsonValue
+    {
+        enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+        Type type = kNull;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> items;
+        std::vector<std::string> keys;  /* parallel to items for objects */
+
+        const JsonValue* member(const char* key) const
+        {
+            for (size_t i = 0; i < keys.size(); ++i)
+                if (keys[i] == key)
+                    return &items[i];
+            return NULL;
+        }
+
+        /* The number as an integer, or kBadInteger when it has a fraction
+           or lies outside +-2^53, where the cast would be undefined or
+           inexact. */
+        int64_t asInteger() const
+        {
+            const double limit = 9007199254740992.0;
+            if (!(number >= -limit && number <= limit) || number != std::floor(number))
+                return kBadInteger;
+            return (int64_t)number;
+        }
+
+        /* Integer member, or fallback when absent or not a number. */
+        int64_t integer(const char* key, int64_t fallback) const
+        {
+            const JsonValue* value = member(key);
+            return value && value->type == kNumber ? value->asInteger() : fallback;
+        }
+
+        size_t size() const { return type == kArray ? items.size() : 0; }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char* text, size_t size) : m_p(text), m_end(text + size) {}
+
+        bool parse(JsonValue& value)
+        {
+            return parseValue(value, 0) && (skipSpaces(), m_p == m_end);
+        }
+
+    private:
+        void skipSpaces()
+        {
+            while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+                ++m_p;
+        }
+
+        bool literal(const char* word)
+        {
+            const size_t length = strlen(word);
+            if ((size_t)(m_end - m_p) < length || memcmp(m_p, word, length) != 0)
+                return false;
+            m_p += length;
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t code)
+        {
+            if (code < 0x80)
+                out += (char)code;
+            else if (code < 0x800)
+            {
+                out += (char)(0xC0 | (code >> 6));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                out += (char)(0xE0 | (code >> 12));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += (char)(0xF0 | (code >> 18));
+                out += (char)(0x80 | ((code >> 12) & 0x3F));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool hex4(uint32_t& code)
+        {
+            if (m_end - m_p < 4)
+                return false;
+            code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const char c = *m_p++;
+                const int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                    : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (digit < 0)
+                    return false;
+                code = code << 4 | (uint32_t)digit;
+            }
+            return true;
+        }
+
+        bool parseString(std::string& out)
+        {
+            ++m_p;
+            while (m_p < m_end && *m_p != '"')
+            {
+                if (*m_p != '\\')
+                {
+                    out += *m_p++;
+                    continue;
+                }
+                if (++m_p == m_end)
+                    return false;
+                const char escape = *m_p++;
+                switch (escape)
+                {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    uint32_t code;
+                    if (!hex4(code))
+                        return false;
+                    if (code >= 0xD800 && code < 0xDC00)
+                    {
+                        uint32_t low;
+                        if (!literal("\\u") || !hex4(low) || low < 0xDC00 || low >= 0xE000)
+                            return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+            if (m_p == m_end)
+                return false;
+            ++m_p;
+            return true;
+        }
+
+        bool parseNumber(double& number)
+        {
+            /* strtod needs a terminator; numbers are short. */
+            char buffer[64];
+            size_t length = 0;
+            while (m_p + length < m_end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", m_p[length]))
+                ++length;
+            if (length == 0)
+                return false;
+            memcpy(buffer, m_p, length);
+            buffer[length] = 0;
+            char* stop;
+            number = strtod(buffer, &stop);
+            if (stop != buffer + length)
+                return false;
+            m_p += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue& value, int depth)
+        {
+            skipSpaces();
+            if (m_p == m_end || depth > kMaxDepth)
+                return false;
+            switch (*m_p)
+            {
+            case '{':
+            {
+                value.type = JsonValue::kObject;
+                ++m_p;
+                skipSpaces();
+                if (m_p < m_end && *m_p == '}')
+                {
+                    ++m_p;
+                    return true;
+                }
+                for (;;)
+                {
+                    skipSpaces();
+                    value.keys.emplace_back();
+                    if (m_p == m_end || *m_p != '"' || !parseString(value.keys.back()))
+                        return false;
+                    skipSpaces();
+                    if (m_p == m_end || *m_p++ != ':')
+                        return false;
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back(), depth + 1))
+                        return false;
+                    skipSpaces();
+                    if (m_p == m_end)
+                        return false;
+                    const char next = *m_p++;
+                    if (next == '}')
+                        return true;
+                    if (next != ',')
+                        return false;
+                }
+            }
+            case '[':
+            {
+                value.type = JsonValue::kArray;
+                ++m_p;
+                skipSpaces();
+                if (m_p < m_end && *m_p == ']')
+                {
+                    ++m_p;
+                    return true;
+                }
+                for (;;)
+                {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back(), depth + 1))
+                        return false;
+                    skipSpaces();
+                    if (m_p == m_end)
+                        return false;
+                    const char next = *m_p++;
+                    if (next == ']')
+                        return true;
+                    if (next != ',')
+                        return false;
+                }
+            }
+            case '"':
+                value.type = JsonValue::kString;
+                return parseString(value.string);
+            case 't':
+                value.type = JsonValue::kBool;
+                value.number = 1.0;
+                return literal("true");
+            case 'f':
+                value.type = JsonValue::kBool;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default:
+                value.type = JsonValue::kNumber;
+                return parseNumber(value.number);
+            }
+        }
+
+        const char* m_p;
+        const char* m_end;
+    };
+
+    uint32_t read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        return value;
+    }
+
+    int componentCount(const std::string& type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4" || type == "MAT2")
+            return 4;
+        if (type == "MAT3")
+            return 9;
+        if (type == "MAT4")
+            return 16;
+        return 0;
+    }
+
+    /* glTF component types are the GL enums themselves. */
+    size_t componentSize(int64_t componentType)
+    {
+        switch (componentType)
+        {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    struct AttributeSlot
+    {
+        const char* name;
+        GLuint location;
+    };
+
+    const AttributeSlot kAttributeSlots[] = {
+        { "POSITION", 0 }, { "TEXCOORD_0", 1 }, { "NORMAL", 2 }, { "TANGENT", 3 },
+        { "COLOR_0", 4 }, { "JOINTS_0", 5 }, { "WEIGHTS_0", 6 },
+    };
+
+    /* Where an accessor's data ended up on the GPU, and where the same
+       bytes are on the CPU for checking them. */
+    struct ResolvedAccessor
+    {
+        GLuint buffer;
+        size_t offset;
+        GLsizei stride;     /* 0 when tightly packed */
+        GLenum componentType;
+        int components;
+        bool normalized;
+        size_t count;
+        const uint8_t* data;    /* first element, in the mapping or the sparse expansion */
+    };
+
+    /* One load: the parsed document, the BIN chunk and the buffers made so
+       far, so each buffer view and sparse accessor is uploaded once. */
+    class Loader
+    {
+    public:
+        Loader(const JsonValue& document, const uint8_t* bin, size_t binSize,
+            std::vector<GLuint>& buffers, GltfModel::Stats& stats, std::string& log)
+            : m_document(document)
+            , m_bin(bin)
+            , m_binSize(binSize)
+            , m_buffers(buffers)
+            , m_stats(stats)
+            , m_log(log)
+        {
+            const JsonValue* views = document.member("bufferViews");
+            const JsonValue* accessors = document.member("accessors");
+            m_viewBuffers.assign(views ? views->size() : 0, 0);
+            m_sparseBuffers.assign(accessors ? accessors->size() : 0, 0);
+            m_sparseData.resize(m_sparseBuffers.size());
+        }
+
+        bool resolve(int64_t index, ResolvedAccessor& out)
+        {
+            const JsonValue* accessors = m_document.member("accessors");
+            if (!accessors || index < 0 || (size_t)index >= accessors->size())
+                return fail("accessor " + std::to_string(index) + " does not exist");
+            const JsonValue& accessor = accessors->items[(size_t)index];
+
+            out.componentType = (GLenum)accessor.integer("componentType", 0);
+            const JsonValue* type = accessor.member("type");
+            out.components = type && type->type == JsonValue::kString ? componentCount(type->string) : 0;
+            const JsonValue* normalized = accessor.member("normalized");
+            out.normalized = normalized && normalized->type == JsonValue::kBool && normalized->number != 0.0;
+            const int64_t count = accessor.integer("count", -1);
+            const size_t elementSize = componentSize(out.componentType) * out.components;
+            if (elementSize == 0 || count < 0 || count > INT_MAX)
+                return fail("accessor " + std::to_string(index) + " has an invalid type or count");
+            out.count = (size_t)count;
+
+            const int64_t viewIndex = accessor.integer("bufferView", -1);
+            const size_t byteOffset = (size_t)accessor.integer("byteOffset", 0);
+            const uint8_t* base = NULL;
+            size_t stride = elementSize;
+            if (viewIndex >= 0)
+            {
+                size_t viewSize;
+                if (!viewData(viewIndex, base, viewSize, stride))
+                    return false;
+                stride = stride ? stride : elementSize;
+                if (stride < elementSize)
+                    return fail("accessor " + std::to_string(index) + " has a byte stride smaller than its elements");
+                if (out.count > 0 && (byteOffset > viewSize || viewSize - byteOffset < elementSize
+                    || (viewSize - byteOffset - elementSize) / stride < out.count - 1))
+                    return fail("accessor " + std::to_string(index) + " overruns its buffer view");
+                if (byteOffset % componentSize(out.componentType) != 0)
+                    return fail("accessor " + std::to_string(index) + " is misaligned");
+            }
+
+            const JsonValue* sparse = accessor.member("sparse");
+            if (!sparse)
+            {
+                if (viewIndex < 0)
+                    return fail("accessor " + std::to_string(index) + " has no data");
+                out.buffer = m_viewBuffers[(size_t)viewIndex];
+                out.offset = byteOffset;
+                out.stride = stride == elementSize ? 0 : (GLsizei)stride;
+                out.data = base + byteOffset;
+                return true;
+            }
+
+            if (!m_sparseBuffers[(size_t)index] && !expandSparse(*sparse, base ? base + byteOffset : NULL, stride,
+                elementSize, out.count, m_sparseData[(size_t)index], m_sparseBuffers[(size_t)index]))
+                return false;
+            out.buffer = m_sparseBuffers[(size_t)index];
+            out.offset = 0;
+            out.stride = 0;
+            out.data = m_sparseData[(size_t)index].data();
+            return true;
+        }
+
+    private:
+        bool fail(const std::string& message)
+        {
+            m_log = message;
+            return false;
+        }
+
+        /* Creates the view's buffer on first use, straight from the mapping. */
+        bool viewData(int64_t index, const uint8_t*& data, size_t& size, size_t& stride)
+        {
+            const JsonValue* views = m_document.member("bufferViews");
+            if (!views || (size_t)index >= views->size())
+                return fail("buffer view " + std::to_string(index) + " does not exist");
+            const JsonValue& view = views->items[(size_t)index];
+            if (view.integer("buffer", -1) != 0 || !m_bin)
+                return fail("buffer view " + std::to_string(index) + " is not in the GLB binary chunk");
+            const int64_t offset = view.integer("byteOffset", 0);
+            const int64_t length = view.integer("byteLength", -1);
+            if (offset < 0 || length < 0 || (uint64_t)offset > m_binSize || (uint64_t)length > m_binSize - (uint64_t)offset)
+                return fail("buffer view " + std::to_string(index) + " is out of bounds");
+            data = m_bin + offset;
+            size = (size_t)length;
+            const int64_t byteStride = view.integer("byteStride", 0);
+            if (byteStride != 0 && (byteStride < 4 || byteStride > 252 || byteStride % 4 != 0))
+                return fail("buffer view " + std::to_string(index) + " has an invalid byte stride");
+            stride = (size_t)byteStride;
+
+            GLuint& buffer = m_viewBuffers[(size_t)index];
+            if (!buffer)
+            {
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, data, GL_STATIC_DRAW);
+                m_buffers.push_back(buffer);
+                m_stats.buffers++;
+                m_stats.bytesUploaded += size;
+            }
+            return true;
+        }
+
+        /* Dense copy of the base data (zeros without a view) with the sparse
+           values written over it, uploaded as a tightly packed buffer. The
+           copy is kept in dense for checking index values. */
+        bool expandSparse(const JsonValue& sparse, const uint8_t* base, size_t stride, size_t elementSize,
+            size_t count, std::vector<uint8_t>& dense, GLuint& buffer)
+        {
+            const int64_t sparseCount = sparse.integer("count", -1);
+            const JsonValue* indices = sparse.member("indices");
+            const JsonValue* values = sparse.member("values");
+            if (sparseCount < 0 || (size_t)sparseCount > count || !indices || !values)
+                return fail("malformed sparse accessor");
+            if (count > kMaxExpandedBytes / elementSize)
+                return fail("sparse accessor of " + std::to_string(count) + " elements is too large to expand");
+            const size_t indexSize = componentSize(indices->integer("componentType", 0));
+            if (indexSize != 1 && indexSize != 2 && (indexSize != 4 || indices->integer("componentType", 0) != GL_UNSIGNED_INT))
+                return fail("malformed sparse accessor");
+
+            const uint8_t* indexData;
+            const uint8_t* valueData;
+            size_t indexViewSize, valueViewSize, unused;
+            if (!sparseView(indices->integer("bufferView", -1), indexData, indexViewSize, unused)
+                || !sparseView(values->integer("bufferView", -1), valueData, valueViewSize, unused))
+                return false;
+            const size_t indexOffset = (size_t)indices->integer("byteOffset", 0);
+            const size_t valueOffset = (size_t)values->integer("byteOffset", 0);
+            if (indexOffset > indexViewSize || (indexViewSize - indexOffset) / indexSize < (size_t)sparseCount
+                || valueOffset > valueViewSize || (valueViewSize - valueOffset) / elementSize < (size_t)sparseCount)
+                return fail("sparse accessor overruns its buffer views");
+
+            dense.assign(count * elementSize, 0);
+            for (size_t i = 0; base && i < count; ++i)
+                memcpy(&dense[i * elementSize], base + i * stride, elementSize);
+            for (size_t i = 0; i < (size_t)sparseCount; ++i)
+            {
+                const uint8_t* p = indexData + indexOffset + i * indexSize;
+                const size_t target = indexSize == 1 ? *p : indexSize == 2 ? (size_t)(p[0] | p[1] << 8) : (size_t)read32(p);
+                if (target >= count)
+                    return fail("sparse index out of range");
+                memcpy(&dense[target * elementSize], valueData + valueOffset + i * elementSize, elementSize);
+            }
+
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)dense.size(), dense.data(), GL_STATIC_DRAW);
+            m_buffers.push_back(buffer);
+            m_stats.buffers++;
+            m_stats.bytesCopied += dense.size();
+            return true;
+        }
+
+        /* Sparse index and value views are read on the CPU only. */
+        bool sparseView(int64_t index, const uint8_t*& data, size_t& size, size_t& stride)
+        {
+            const JsonValue* views = m_document.member("bufferViews");
+            if (!views || index < 0 || (size_t)index >= views->size())
+                return fail("buffer view " + std::to_string(index) + " does not exist");
+            const JsonValue& view = views->items[(size_t)index];
+            const int64_t offset = view.integer("byteOffset", 0);
+            const int64_t length = view.integer("byteLength", -1);
+            if (view.integer("buffer", -1) != 0 || !m_bin || offset < 0 || length < 0
+                || (uint64_t)offset > m_binSize || (uint64_t)length > m_binSize - (uint64_t)offset)
+                return fail("buffer view " + std::to_string(index) + " is out of bounds");
+            data = m_bin + offset;
+            size = (size_t)length;
+            stride = 0;
+            return true;
+        }
+
+        const JsonValue& m_document;
+        const uint8_t* m_bin;
+        size_t m_binSize;
+        std::vector<GLuint>& m_buffers;
+        GltfModel::Stats& m_stats;
+        std::string& m_log;
+        std::vector<GLuint> m_viewBuffers;
+        std::vector<GLuint> m_sparseBuffers;
+        std::vector<std::vector<uint8_t>> m_sparseData;
+    };
+
+    /* Largest value in a tightly packed index accessor. */
+    uint32_t maxIndex(const ResolvedAccessor& accessor)
+    {
+        uint32_t largest = 0;
+        for (size_t i = 0; i < accessor.count; ++i)
+        {
+            const uint8_t* p = accessor.data + i * componentSize(accessor.componentType);
+            const uint32_t value = accessor.componentType == GL_UNSIGNED_BYTE ? *p
+                : accessor.componentType == GL_UNSIGNED_SHORT ? (uint32_t)(p[0] | p[1] << 8) : read32(p);
+            largest = std::max(largest, value);
+        }
+        return largest;
+    }
+}
+
+GltfModel::GltfModel()
+    : m_stats()
+{
+}
+
+GltfModel::~GltfModel()
+{
+    destroy();
+}
+
+void GltfModel::destroy()
+{
+    for (Mesh& mesh : m_meshes)
+        for (Primitive& primitive : mesh.primitives)
+            glDeleteVertexArrays(1, &primitive.vao);
+    if (!m_buffers.empty())
+        glDeleteBuffers((GLsizei)m_buffers.size(), m_buffers.data());
+    m_buffers.clear();
+    m_meshes.clear();
+    m_stats = Stats();
+}
+
+bool GltfModel::load(const std::string& path, std::string& log)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        log = path + ": cannot open";
+        return false;
+    }
+    if (!load(file.data(), file.size(), log))
+    {
+        log = path + ": " + log;
+        return false;
+    }
+    return true;
+}
+
+bool GltfModel::load(const uint8_t* data, size_t size, std::string& log)
+{
+    destroy();
+
+    /* 12-byte header, then chunks of length, type and payload. */
+    if (size < 20 || read32(data) != kGlbMagic || read32(data + 4) != 2 || read32(data + 8) > size)
+    {
+        log = "not a glTF 2.0 binary";
+        return false;
+    }
+    const size_t length = read32(data + 8);
+    const uint8_t* json = NULL;
+    size_t jsonSize = 0;
+    const uint8_t* bin = NULL;
+    size_t binSize = 0;
+    for (size_t offset = 12; offset + 8 <= length;)
+    {
+        const size_t chunkSize = read32(data + offset);
+        const uint32_t chunkType = read32(data + offset + 4);
+        if (chunkSize > length - offset - 8)
+        {
+            log = "truncated chunk";
+            return false;
+        }
+        if (chunkType == kChunkJson && !json)
+        {
+            json = data + offset + 8;
+            jsonSize = chunkSize;
+        }
+        else if (chunkType == kChunkBin && !bin)
+        {
+            bin = data + offset + 8;
+            binSize = chunkSize;
+        }
+        offset += 8 + ((chunkSize + 3) & ~(size_t)3);
+    }
+
+    JsonValue document;
+    if (!json || !JsonParser((const char*)json, jsonSize).parse(document) || document.type != JsonValue::kObject)
+    {
+        log = "missing or malformed JSON chunk";
+        return false;
+    }
+
+    Loader loader(document, bin, binSize, m_buffers, m_stats, log);
+    const JsonValue* meshes = document.member("meshes");
+    for (size_t m = 0; meshes && m < meshes->size(); ++m)
+    {
+        const JsonValue& source = meshes->items[m];
+        m_meshes.emplace_back();
+        Mesh& mesh = m_meshes.back();
+        const JsonValue* name = source.member("name");
+        if (name && name->type == JsonValue::kString)
+            mesh.name = name->string;
+
+        const JsonValue* primitives = source.member("primitives");
+        for (size_t p = 0; primitives && p < primitives->size(); ++p)
+        {
+            const JsonValue& primitiveSource = primitives->items[p];
+            const JsonValue* attributes = primitiveSource.member("attributes");
+            Primitive primitive = {};
+            const int64_t mode = primitiveSource.integer("mode", GL_TRIANGLES);
+            const int64_t material = primitiveSource.integer("material", -1);
+            primitive.mode = (GLenum)mode;
+            primitive.material = (int)material;
+            if (mode < 0 || mode > GL_TRIANGLE_FAN || material < -1 || material > INT_MAX
+                || !attributes || !attributes->member("POSITION"))
+            {
+                log = "mesh " + std::to_string(m) + " primitive " + std::to_string(p) + " has no positions or an unknown mode";
+                destroy();
+                return false;
+            }
+
+            glGenVertexArrays(1, &primitive.vao);
+            mesh.primitives.push_back(primitive);
+            Primitive& target = mesh.primitives.back();
+            glBindVertexArray(target.vao);
+
+            bool ok = true;
+            size_t vertexCount = 0;
+            for (const AttributeSlot& slot : kAttributeSlots)
+            {
+                const JsonValue* index = attributes->member(slot.name);
+                ResolvedAccessor accessor;
+                if (!index)
+                    continue;
+                if (index->type != JsonValue::kNumber || !loader.resolve(index->asInteger(), accessor) || accessor.components > 4)
+                {
+                    ok = false;
+                    break;
+                }
+                /* POSITION comes first; every attribute must match its count. */
+                if (slot.location == 0)
+                    vertexCount = accessor.count;
+                else if (accessor.count != vertexCount)
+                {
+                    log = std::string(slot.name) + " has " + std::to_string(accessor.count) + " elements, POSITION "
+                        + std::to_string(vertexCount);
+                    ok = false;
+                    break;
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, accessor.buffer);
+                glEnableVertexAttribArray(slot.location);
+                glVertexAttribPointer(slot.location, accessor.components, accessor.componentType,
+                    accessor.normalized ? GL_TRUE : GL_FALSE, accessor.stride, (void*)accessor.offset);
+            }
+
+            const JsonValue* indices = primitiveSource.member("indices");
+            ResolvedAccessor indexAccessor;
+            if (ok && indices)
+            {
+                ok = indices->type == JsonValue::kNumber && loader.resolve(indices->asInteger(), indexAccessor)
+                    && indexAccessor.components == 1 && indexAccessor.stride == 0
+                    && (indexAccessor.componentType == GL_UNSIGNED_BYTE || indexAccessor.componentType == GL_UNSIGNED_SHORT
+                        || indexAccessor.componentType == GL_UNSIGNED_INT);
+                if (ok && indexAccessor.count > 0 && maxIndex(indexAccessor) >= vertexCount)
+                {
+                    log = "index accessor points past the " + std::to_string(vertexCount) + " vertices";
+                    ok = false;
+                }
+                else if (ok)
+                {
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexAccessor.buffer);
+                    target.count = (GLsizei)indexAccessor.count;
+                    target.indexType = indexAccessor.componentType;
+                    target.indexOffset = indexAccessor.offset;
+                }
+                else if (log.empty())
+                    log = "unusable index accessor";
+            }
+            else
+                target.count = (GLsizei)vertexCount;
+
+            glBindVertexArray(0);
+            if (!ok)
+            {
+                log = "mesh " + std::to_string(m) + " primitive " + std::to_string(p) + ": " + log;
+                destroy();
+                return false;
+            }
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+void GltfModel::draw(const Primitive& primitive)
+{
+    glBindVertexArray(primitive.vao);
+    if (primitive.indexType)
+        glDrawElements(primitive.mode, primitive.count, primitive.indexType, (void*)primitive.indexOffset);
+    else
+        glDrawArrays(primitive.mode, 0, primitive.count);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* glTF 2.0 binary (.glb) meshes, uploaded straight from the file.
+
+   The GLB is memory mapped and every buffer view that an accessor reads is
+   handed to glBufferData as a pointer into the mapped BIN chunk, so vertex
+   and index data go from the page cache to the driver without passing
+   through an intermediate copy. Accessors then become vertex attribute
+   pointers into those buffers, keeping the view's byte stride, which is how
+   interleaved layouts are used as stored. Only sparse accessors are
+   materialised on the CPU: the base data (or zeros) is copied out, the
+   sparse values are written over it and the result gets a buffer of its own.
+
+   Nothing in the file is trusted: accessors must stay inside their views,
+   every attribute must have as many elements as POSITION and every index
+   must name one of them, or the load fails with a message.
+
+   Attributes go to fixed locations, the first three matching MeshData:
+   POSITION 0, TEXCOORD_0 1, NORMAL 2, TANGENT 3, COLOR_0 4, JOINTS_0 5,
+   WEIGHTS_0 6; other attributes are ignored. Every primitive of every mesh
+   gets its own VAO. External or data: URI buffers, images, materials and
+   the node hierarchy are not read. */
+class GltfModel
+{
+public:
+    struct Primitive
+    {
+        GLuint vao;
+        GLenum mode;            /* GL_TRIANGLES and so on */
+        GLsizei count;          /* indices, or vertices for unindexed primitives */
+        GLenum indexType;       /* 0 when unindexed */
+        size_t indexOffset;     /* bytes into the element buffer bound to vao */
+        int material;           /* -1 when unset */
+    };
+
+    struct Mesh
+    {
+        std::string name;
+        std::vector<Primitive> primitives;
+    };
+
+    struct Stats
+    {
+        size_t buffers;         /* GL buffers created */
+        size_t bytesUploaded;   /* from the mapping, without a copy */
+        size_t bytesCopied;     /* expanded on the CPU for sparse accessors */
+    };
+
+    GltfModel();
+    ~GltfModel();
+
+    GltfModel(const GltfModel&) = delete;
+    GltfModel& operator=(const GltfModel&) = delete;
+
+    /* GL thread. Replaces whatever was loaded before. */
+    bool load(const std::string& path, std::string& log);
+
+    /* As above, for a GLB already in memory, e.g. an AssetPack entry. */
+    bool load(const uint8_t* data, size_t size, std::string& log);
+
+    void destroy();
+
+    const std::vector<Mesh>& meshes() const { return m_meshes; }
+    const Stats& stats() const { return m_stats; }
+
+    /* Binds the primitive's VAO and issues its draw. */
+    static void draw(const Primitive& primitive);
+
+private:
+    std::vector<GLuint> m_buffers;
+    std::vector<Mesh> m_meshes;
+    Stats m_stats;
+};
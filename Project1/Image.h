@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* A decoded image: 8-bit RGBA, tightly packed rows, top row first. */
+struct Image
+{
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+};
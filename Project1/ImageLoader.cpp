@@ -0,0 +1,48 @@
+#include "ImageLoader.h"
+
+#include <cstdio>
+#include <cstring>
+
+bool decodeImage(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log)
+{
+    static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (size >= 8 && memcmp(data, kPngSignature, 8) == 0)
+        return decodePng(data, size, options, image, log);
+    if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff)
+        return decodeJpeg(data, size, options, image, log);
+    return decodeTga(data, size, options, image, log);
+}
+
+bool readBinaryFile(const std::string& path, std::vector<uint8_t>& out)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    const long size = ok ? ftell(file) : -1;
+    ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (ok)
+    {
+        out.resize((size_t)size);
+        ok = fread(out.data(), 1, out.size(), file) == out.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+bool loadImage(const std::string& path, const ImageOptions& options, Image& image, std::string& log)
+{
+    std::vector<uint8_t> data;
+    if (!readBinaryFile(path, data))
+    {
+        log = "cannot read " + path;
+        return false;
+    }
+    if (!decodeImage(data.data(), data.size(), options, image, log))
+    {
+        log = path + ": " + log;
+        return false;
+    }
+    return true;
+}
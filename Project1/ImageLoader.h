@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "PixelConvert.h"
+
+/* Image decoding for textures.
+
+   Each decoder turns a file in memory into upload-ready RGBA8: decoded rows
+   go through convertRow() straight into Image::pixels, so RGB expansion,
+   swizzling and premultiplication cost no extra pass or buffer. Decoders keep
+   no global state and are meant to run one image per ThreadPool job, e.g. as
+   TextureStreamer decoders.
+
+   Supported: PNG (all colour types and bit depths, interlaced or not; 16-bit
+   channels are reduced to 8), baseline JPEG (greyscale or 3 components, any
+   sampling factors, restart markers; not progressive or arithmetic coded),
+   and TGA (true colour, greyscale and colour mapped, raw or RLE). */
+
+/* Largest width or height accepted, which also bounds memory use. */
+const int kMaxImageDimension = 32768;
+
+bool decodePng(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log);
+bool decodeJpeg(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log);
+bool decodeTga(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log);
+
+/* Picks the decoder from the file signature; TGA, which has none, is the fallback. */
+bool decodeImage(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log);
+
+/* Reads a whole file into out. Returns false if it cannot be read. */
+bool readBinaryFile(const std::string& path, std::vector<uint8_t>& out);
+
+/* readBinaryFile() followed by decodeImage(); log is prefixed with the path. */
+bool loadImage(const std::string& path, const ImageOptions& options, Image& image, std::string& log);
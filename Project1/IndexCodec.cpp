@@ -0,0 +1,173 @@
+#include "IndexCodec.h"
+
+#include <cstring>
+
+#include "Simd.h"
+
+namespace
+{
+    uint32_t zigzag(uint32_t delta)
+    {
+        return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+    }
+
+    uint32_t unzigzag(uint32_t value)
+    {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    template <typename Index>
+    void encode(const Index* indices, size_t count, std::vector<uint8_t>& out)
+    {
+        const size_t controlBytes = (count + 3) / 4;
+        const size_t start = out.size();
+        out.resize(start + controlBytes, 0);
+        out.reserve(start + indexEncodeBound(count));
+
+        uint32_t previous = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t value = zigzag((uint32_t)indices[i] - previous);
+            previous = indices[i];
+            const uint32_t length = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+            out[start + i / 4] |= (uint8_t)((length - 1) << ((i % 4) * 2));
+            for (uint32_t b = 0; b < length; ++b)
+                out.push_back((uint8_t)(value >> (8 * b)));
+        }
+    }
+
+    /* Narrowing is checked on the running value, which is what is stored. */
+    bool store(uint32_t* out, uint32_t value)
+    {
+        *out = value;
+        return true;
+    }
+
+    bool store(uint16_t* out, uint32_t value)
+    {
+        *out = (uint16_t)value;
+        return value <= 0xFFFF;
+    }
+
+#if SIMD_SSSE3
+    /* Shuffle that spreads the 4-16 value bytes of a group to four 32-bit
+       lanes, and the number of value bytes, for each control byte. */
+    struct GroupTables
+    {
+        uint8_t shuffle[256][16];
+        uint8_t length[256];
+
+        GroupTables()
+        {
+            for (int control = 0; control < 256; ++control)
+            {
+                int source = 0;
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    const int bytes = ((control >> (lane * 2)) & 3) + 1;
+                    for (int b = 0; b < 4; ++b)
+                        shuffle[control][lane * 4 + b] = b < bytes ? (uint8_t)source++ : 0x80;
+                }
+                length[control] = (uint8_t)source;
+            }
+        }
+    };
+
+    const GroupTables kGroups;
+
+    /* Zigzag decode and prefix sum of four lanes, continuing from the last
+       lane of previous. */
+    inline __m128i decodeGroup(__m128i values, __m128i previous)
+    {
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i deltas = _mm_xor_si128(_mm_srli_epi32(values, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, one)));
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+        return _mm_add_epi32(deltas, _mm_shuffle_epi32(previous, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+
+    inline void storeGroup(uint32_t* out, __m128i values, __m128i&)
+    {
+        _mm_storeu_si128((__m128i*)out, values);
+    }
+
+    /* The low halves are kept; any lane above 65535 marks the group bad. */
+    inline void storeGroup(uint16_t* out, __m128i values, __m128i& overflow)
+    {
+        overflow = _mm_or_si128(overflow, _mm_srli_epi32(values, 16));
+        const __m128i low = _mm_shuffle_epi8(values, _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+        _mm_storel_epi64((__m128i*)out, low);
+    }
+#endif
+
+    template <typename Index>
+    bool decode(const uint8_t* data, size_t size, Index* indices, size_t count)
+    {
+        const size_t controlBytes = (count + 3) / 4;
+        if (size < controlBytes)
+            return false;
+        const uint8_t* controls = data;
+        const uint8_t* p = data + controlBytes;
+        const uint8_t* end = data + size;
+        size_t i = 0;
+        uint32_t previous = 0;
+
+#if SIMD_SSSE3
+        /* Whole groups while a 16-byte load stays inside the stream. */
+        __m128i running = _mm_setzero_si128();
+        __m128i overflow = _mm_setzero_si128();
+        for (; i + 4 <= count && end - p >= 16; i += 4)
+        {
+            const uint8_t control = controls[i / 4];
+            const __m128i bytes = _mm_loadu_si128((const __m128i*)p);
+            const __m128i values = _mm_shuffle_epi8(bytes, _mm_loadu_si128((const __m128i*)kGroups.shuffle[control]));
+            running = decodeGroup(values, running);
+            storeGroup(indices + i, running, overflow);
+            p += kGroups.length[control];
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(overflow, _mm_setzero_si128())) != 0xFFFF)
+            return false;
+        previous = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(running, _MM_SHUFFLE(3, 3, 3, 3)));
+#endif
+
+        for (; i < count; ++i)
+        {
+            const uint32_t length = ((controls[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+            if ((size_t)(end - p) < length)
+                return false;
+            uint32_t value = 0;
+            for (uint32_t b = 0; b < length; ++b)
+                value |= (uint32_t)p[b] << (8 * b);
+            p += length;
+            previous += unzigzag(value);
+            if (!store(indices + i, previous))
+                return false;
+        }
+        return p == end;
+    }
+}
+
+size_t indexEncodeBound(size_t count)
+{
+    return (count + 3) / 4 + count * 4;
+}
+
+void encodeIndices(const uint32_t* indices, size_t count, std::vector<uint8_t>& out)
+{
+    encode(indices, count, out);
+}
+
+void encodeIndices(const uint16_t* indices, size_t count, std::vector<uint8_t>& out)
+{
+    encode(indices, count, out);
+}
+
+bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t count)
+{
+    return decode(data, size, indices, count);
+}
+
+bool decodeIndices(const uint8_t* data, size_t size, uint16_t* indices, size_t count)
+{
+    return decode(data, size, indices, count);
+}
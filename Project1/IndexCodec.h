@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Compressed index buffers for storage on disk.
+
+   Each index is coded as the zigzagged difference from the previous one,
+   which after optimizeVertexCache() and optimizeVertexFetch() is nearly
+   always small, and the differences are packed in the Stream VByte layout:
+   a control byte per group of four gives each value's length in bytes
+   (1 to 4), and all the control bytes come first, followed by the value
+   bytes. Typical triangle lists come out at 1.3-1.6 bytes an index.
+
+   The layout is byte aligned so the decoder can take a whole group per
+   step: with SSSE3 one table-driven shuffle expands four values, and the
+   zigzag and the running sum are undone in the same registers. The scalar
+   decoder reads the same stream.
+
+   The stream does not store the count; keep it alongside. */
+
+/* Upper bound on the encoded size of count indices. */
+size_t indexEncodeBound(size_t count);
+
+/* Appends the encoding of indices to out. */
+void encodeIndices(const uint32_t* indices, size_t count, std::vector<uint8_t>& out);
+void encodeIndices(const uint16_t* indices, size_t count, std::vector<uint8_t>& out);
+
+/* Decodes exactly count indices. Returns false if size does not match the
+   stream or a 16-bit decode meets a value above 65535. */
+bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t count);
+bool decodeIndices(const uint8_t* data, size_t size, uint16_t* indices, size_t count);
@@ -0,0 +1,134 @@
+#include "InstancedRenderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+InstancedRenderer::InstancedRenderer()
+    : m_instanceBuffer(0)
+    , m_instanceCapacity(0)
+    , m_minInstances(2)
+    , m_maxBatch(4096)
+    , m_stats()
+{
+    glGenBuffers(1, &m_instanceBuffer);
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+    glDeleteBuffers(1, &m_instanceBuffer);
+}
+
+void InstancedRenderer::setThresholds(size_t minInstances, size_t maxBatch)
+{
+    m_minInstances = std::max<size_t>(minInstances, 1);
+    m_maxBatch = std::max<size_t>(maxBatch, 1);
+}
+
+void InstancedRenderer::submit(const Mesh* mesh, const Material* material, const float transform[16], const float tint[4])
+{
+    Instance instance;
+    memcpy(instance.model, transform, sizeof(instance.model));
+    memcpy(instance.tint, tint, sizeof(instance.tint));
+
+    Draw draw = { mesh, material, m_submitted.size() };
+    m_draws.push_back(draw);
+    m_submitted.push_back(instance);
+}
+
+void InstancedRenderer::flush()
+{
+    m_stats = Stats();
+    m_stats.submitted = m_draws.size();
+    if (m_draws.empty())
+        return;
+
+    /* Group by material first (program switches are the expensive part), then by mesh. */
+    std::sort(m_draws.begin(), m_draws.end(), [](const Draw& a, const Draw& b)
+    {
+        if (a.material != b.material)
+            return a.material < b.material;
+        return a.mesh < b.mesh;
+    });
+
+    m_sorted.resize(m_draws.size());
+    for (size_t i = 0; i < m_draws.size(); ++i)
+        m_sorted[i] = m_submitted[m_draws[i].instance];
+
+    /* Stream the whole frame's instances in one upload, orphaning last frame's storage. */
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    const size_t bytes = m_sorted.size() * sizeof(Instance);
+    if (bytes > m_instanceCapacity)
+        m_instanceCapacity = std::max(bytes, m_instanceCapacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_sorted.data());
+
+    const Material* currentMaterial = NULL;
+    for (size_t first = 0; first < m_draws.size(); )
+    {
+        const Mesh* mesh = m_draws[first].mesh;
+        const Material* material = m_draws[first].material;
+        size_t last = first + 1;
+        while (last < m_draws.size() && m_draws[last].mesh == mesh && m_draws[last].material == material)
+            ++last;
+
+        if (material != currentMaterial)
+        {
+            glUseProgram(material->program);
+            currentMaterial = material;
+        }
+        glBindVertexArray(mesh->vao);
+
+        const size_t count = last - first;
+        if (count < m_minInstances)
+        {
+            /* Disabled arrays read the current generic attribute value instead. */
+            for (int i = 0; i < 5; ++i)
+                glDisableVertexAttribArray(kInstanceLocation + i);
+            for (size_t d = first; d < last; ++d)
+            {
+                const Instance& instance = m_sorted[d];
+                for (int column = 0; column < 4; ++column)
+                    glVertexAttrib4fv(kInstanceLocation + column, instance.model + column * 4);
+                glVertexAttrib4fv(kInstanceLocation + 4, instance.tint);
+                glDrawElements(GL_TRIANGLES, mesh->indexCount, mesh->indexType, NULL);
+                m_stats.drawCalls++;
+            }
+        }
+        else
+        {
+            for (size_t batch = first; batch < last; batch += m_maxBatch)
+            {
+                const size_t batchCount = std::min(m_maxBatch, last - batch);
+                bindInstanceStream(batch);
+                glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, mesh->indexType, NULL, (GLsizei)batchCount);
+                m_stats.drawCalls++;
+                m_stats.instancedBatches++;
+            }
+        }
+        first = last;
+    }
+
+    glBindVertexArray(0);
+    m_stats.collapsed = m_stats.submitted - m_stats.drawCalls;
+    m_draws.clear();
+    m_submitted.clear();
+}
+
+void InstancedRenderer::bindInstanceStream(size_t firstInstance)
+{
+    /* GL 3.3 has no base instance, so the attribute pointers are offset instead. */
+    const size_t base = firstInstance * sizeof(Instance);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    for (int column = 0; column < 4; ++column)
+    {
+        const GLuint location = kInstanceLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+            (void*)(base + offsetof(Instance, model) + column * 4 * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+    }
+    const GLuint tintLocation = kInstanceLocation + 4;
+    glEnableVertexAttribArray(tintLocation);
+    glVertexAttribPointer(tintLocation, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, tint)));
+    glVertexAttribDivisor(tintLocation, 1);
+}
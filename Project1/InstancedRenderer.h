@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+/* Shading state shared by a group of draws. */
+struct Material
+{
+    GLuint program;
+};
+
+/* Collects the draws of a frame and submits repeated mesh+material pairs with
+   glDrawElementsInstanced.
+
+   Per-instance data (model matrix and tint) is written into one streamed
+   instance buffer and read through attributes with glVertexAttribDivisor 1 at
+   kInstanceLocation..kInstanceLocation+4. Groups smaller than the instancing
+   threshold are drawn one by one with the attributes set as constants, which
+   skips the buffer write; groups larger than the batch limit are split. */
+class InstancedRenderer
+{
+public:
+    /* Attribute locations used by the instance stream: four matrix columns, then the tint. */
+    enum { kInstanceLocation = 4 };
+
+    struct Stats
+    {
+        size_t submitted;        /* draws submitted this frame */
+        size_t drawCalls;        /* GL draw calls issued */
+        size_t instancedBatches; /* of which glDrawElementsInstanced */
+        size_t collapsed;        /* submitted - drawCalls */
+    };
+
+    InstancedRenderer();
+    ~InstancedRenderer();
+
+    InstancedRenderer(const InstancedRenderer&) = delete;
+    InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+    /* Groups with fewer instances than minInstances are drawn without
+       instancing; groups above maxBatch are split into several calls. */
+    void setThresholds(size_t minInstances, size_t maxBatch);
+
+    /* Queues one draw. The mesh and material must stay alive until flush(). */
+    void submit(const Mesh* mesh, const Material* material, const float transform[16], const float tint[4]);
+
+    /* Sorts the queued draws, uploads the instance stream and issues the
+       draws. Uniform blocks the programs use must already be bound. */
+    void flush();
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Instance
+    {
+        float model[16];
+        float tint[4];
+    };
+
+    struct Draw
+    {
+        const Mesh* mesh;
+        const Material* material;
+        size_t instance;
+    };
+
+    void bindInstanceStream(size_t firstInstance);
+
+    GLuint m_instanceBuffer;
+    size_t m_instanceCapacity;
+    size_t m_minInstances;
+    size_t m_maxBatch;
+
+    std::vector<Draw> m_draws;
+    std::vector<Instance> m_submitted;
+    std::vector<Instance> m_sorted;
+    Stats m_stats;
+};
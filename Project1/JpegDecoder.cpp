@@ -0,0 +1,672 @@
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    /* Zigzag position to natural (row-major) block index; the tail absorbs
+       corrupt run lengths that step past the last coefficient. */
+    const uint8_t kZigzag[64 + 16] = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+        63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63,
+    };
+
+    const int kFastBits = 9;
+
+    struct HuffmanTable
+    {
+        uint16_t fast[1 << kFastBits];   /* (length << 8) | symbol, 0 for longer codes */
+        int32_t maxCode[18];             /* largest code of each length, -1 if none */
+        int32_t valueOffset[17];
+        uint8_t values[256];
+        bool defined;
+    };
+
+    /* Fails on an over-subscribed table, before writing any of its codes:
+       a length with more codes than are left would index past fast[]. */
+    bool buildTable(HuffmanTable& table, const uint8_t* counts, const uint8_t* values, int valueCount)
+    {
+        table.defined = false;
+        memcpy(table.values, values, valueCount);
+        memset(table.fast, 0, sizeof(table.fast));
+
+        int code = 0;
+        int index = 0;
+        for (int length = 1; length <= 16; ++length)
+        {
+            if (code + counts[length - 1] > (1 << length) || index + counts[length - 1] > valueCount)
+                return false;
+            table.valueOffset[length] = index - code;
+            for (int i = 0; i < counts[length - 1]; ++i, ++code, ++index)
+            {
+                if (length <= kFastBits)
+                {
+                    const int first = code << (kFastBits - length);
+                    for (int slot = 0; slot < 1 << (kFastBits - length); ++slot)
+                        table.fast[first + slot] = (uint16_t)(length << 8 | values[index]);
+                }
+            }
+            table.maxCode[length] = counts[length - 1] ? code - 1 : -1;
+            code <<= 1;
+        }
+        table.maxCode[17] = 0x7fffffff;
+        table.defined = true;
+        return true;
+    }
+
+    /* Entropy-coded segment reader: MSB first, 0xFF00 unstuffed, stops at
+       markers and feeds zeros past them. */
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, const uint8_t* end) : m_data(data), m_end(end), m_bits(0), m_count(0), m_atMarker(false) {}
+
+        void refill()
+        {
+            while (m_count <= 24)
+            {
+                uint32_t byte = 0;
+                if (!m_atMarker && m_data < m_end)
+                {
+                    if (*m_data != 0xff)
+                        byte = *m_data++;
+                    else if (m_data + 1 < m_end && m_data[1] == 0x00)
+                    {
+                        byte = 0xff;
+                        m_data += 2;
+                    }
+                    else
+                        m_atMarker = true;
+                }
+                m_bits |= byte << (24 - m_count);
+                m_count += 8;
+            }
+        }
+
+        uint32_t get(int count)
+        {
+            if (count == 0)
+                return 0;
+            if (m_count < count)
+                refill();
+            const uint32_t value = m_bits >> (32 - count);
+            m_bits <<= count;
+            m_count -= count;
+            return value;
+        }
+
+        /* Huffman-coded magnitude category followed by its extra bits. */
+        int receiveExtend(int size)
+        {
+            if (size == 0)
+                return 0;
+            const int value = (int)get(size);
+            return value < 1 << (size - 1) ? value - (1 << size) + 1 : value;
+        }
+
+        int decode(const HuffmanTable& table)
+        {
+            if (m_count < 16)
+                refill();
+            const uint16_t entry = table.fast[m_bits >> (32 - kFastBits)];
+            if (entry)
+            {
+                const int length = entry >> 8;
+                m_bits <<= length;
+                m_count -= length;
+                return entry & 0xff;
+            }
+
+            int length = kFastBits + 1;
+            while ((int32_t)(m_bits >> (32 - length)) > table.maxCode[length])
+                ++length;
+            if (length > 16)
+                return -1;
+            const int code = (int)(m_bits >> (32 - length));
+            m_bits <<= length;
+            m_count -= length;
+            return table.values[code + table.valueOffset[length]];
+        }
+
+        /* Skips an expected RSTn marker and starts a fresh bit stream after it. */
+        bool restart()
+        {
+            m_bits = 0;
+            m_count = 0;
+            m_atMarker = false;
+            while (m_data + 1 < m_end && !(m_data[0] == 0xff && m_data[1] >= 0xd0 && m_data[1] <= 0xd7))
+                ++m_data;
+            if (m_data + 1 >= m_end)
+                return false;
+            m_data += 2;
+            return true;
+        }
+
+        /* Position of the marker that ended the segment. */
+        const uint8_t* markerPosition() const
+        {
+            const uint8_t* p = m_data;
+            while (p + 1 < m_end && !(p[0] == 0xff && p[1] != 0x00))
+                ++p;
+            return p;
+        }
+
+    private:
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+        uint32_t m_bits;
+        int m_count;
+        bool m_atMarker;
+    };
+
+    inline int clamp16(int value)
+    {
+        return value < -32768 ? -32768 : value > 32767 ? 32767 : value;
+    }
+
+    inline uint8_t clamp255(int value)
+    {
+        return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+
+    /* Integer IDCT after Loeffler, Ligtenberg and Moschytz, as in the IJG
+       "islow" method: 12-bit fixed-point constants, two extra bits kept
+       between the column and row passes. Inputs are clamped to 16 bits, which
+       keeps the column pass within int; the row pass widens to 64 bits so
+       corrupt files cannot overflow either. */
+#define JPEG_FIX(x) ((int)((x) * 4096 + 0.5))
+#define JPEG_IDCT_1D(Value, s0, s1, s2, s3, s4, s5, s6, s7) \
+    Value p1 = (((Value)(s2)) + ((Value)(s6))) * JPEG_FIX(0.5411961); \
+    Value t2 = p1 + ((Value)(s6)) * -JPEG_FIX(1.847759065); \
+    Value t3 = p1 + ((Value)(s2)) * JPEG_FIX(0.765366865); \
+    Value t0 = (((Value)(s0)) + ((Value)(s4))) * 4096; \
+    Value t1 = (((Value)(s0)) - ((Value)(s4))) * 4096; \
+    const Value x0 = t0 + t3, x3 = t0 - t3, x1 = t1 + t2, x2 = t1 - t2; \
+    t0 = ((Value)(s7)); t1 = ((Value)(s5)); t2 = ((Value)(s3)); t3 = ((Value)(s1)); \
+    Value p3 = t0 + t2, p4 = t1 + t3; \
+    p1 = t0 + t3; \
+    Value p2 = t1 + t2; \
+    const Value p5 = (p3 + p4) * JPEG_FIX(1.175875602); \
+    t0 *= JPEG_FIX(0.298631336); \
+    t1 *= JPEG_FIX(2.053119869); \
+    t2 *= JPEG_FIX(3.072711026); \
+    t3 *= JPEG_FIX(1.501321110); \
+    p1 = p5 + p1 * -JPEG_FIX(0.899976223); \
+    p2 = p5 + p2 * -JPEG_FIX(2.562915447); \
+    p3 *= -JPEG_FIX(1.961570560); \
+    p4 *= -JPEG_FIX(0.390180644); \
+    t3 += p1 + p4; \
+    t2 += p2 + p3; \
+    t1 += p2 + p4; \
+    t0 += p1 + p3;
+
+    void idctBlock(const int* coefficients, uint8_t* out, size_t stride)
+    {
+        int temp[64];
+        for (int column = 0; column < 8; ++column)
+        {
+            const int* c = coefficients + column;
+            int* v = temp + column;
+            if (!c[8] && !c[16] && !c[24] && !c[32] && !c[40] && !c[48] && !c[56])
+            {
+                /* DC only: the column is flat. */
+                const int dc = c[0] * 4;
+                for (int i = 0; i < 8; ++i)
+                    v[i * 8] = dc;
+                continue;
+            }
+            JPEG_IDCT_1D(int, c[0], c[8], c[16], c[24], c[32], c[40], c[48], c[56])
+            v[0] = (x0 + t3 + 512) >> 10;
+            v[56] = (x0 - t3 + 512) >> 10;
+            v[8] = (x1 + t2 + 512) >> 10;
+            v[48] = (x1 - t2 + 512) >> 10;
+            v[16] = (x2 + t1 + 512) >> 10;
+            v[40] = (x2 - t1 + 512) >> 10;
+            v[24] = (x3 + t0 + 512) >> 10;
+            v[32] = (x3 - t0 + 512) >> 10;
+        }
+
+        for (int row = 0; row < 8; ++row, out += stride)
+        {
+            const int* v = temp + row * 8;
+            JPEG_IDCT_1D(int64_t, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+            /* Remove 12 + 2 + 3 bits of scale, rounding, and re-centre on 128. */
+            const int64_t bias = 65536 + (128 << 17);
+            out[0] = clamp255((int)((x0 + t3 + bias) >> 17));
+            out[7] = clamp255((int)((x0 - t3 + bias) >> 17));
+            out[1] = clamp255((int)((x1 + t2 + bias) >> 17));
+            out[6] = clamp255((int)((x1 - t2 + bias) >> 17));
+            out[2] = clamp255((int)((x2 + t1 + bias) >> 17));
+            out[5] = clamp255((int)((x2 - t1 + bias) >> 17));
+            out[3] = clamp255((int)((x3 + t0 + bias) >> 17));
+            out[4] = clamp255((int)((x3 - t0 + bias) >> 17));
+        }
+    }
+#undef JPEG_IDCT_1D
+#undef JPEG_FIX
+
+    struct Component
+    {
+        int id;
+        int h, v;
+        int quantTable;
+        int dcTable, acTable;
+        int dcPredictor;
+        int planeWidth, planeHeight;   /* whole blocks covering every MCU */
+        std::vector<uint8_t> plane;
+    };
+
+    struct JpegState
+    {
+        uint16_t quant[4][64];   /* zigzag order, as stored */
+        HuffmanTable dc[4];
+        HuffmanTable ac[4];
+        std::vector<Component> components;
+        int width, height;
+        int maxH, maxV;
+        int mcusX, mcusY;
+        int restartInterval;
+        int adobeTransform;      /* -1 without an Adobe APP14 marker */
+        bool sawFrame;
+    };
+
+    bool decodeBlock(BitReader& reader, JpegState& state, Component& component, int blockX, int blockY)
+    {
+        int coefficients[64];
+        memset(coefficients, 0, sizeof(coefficients));
+        const uint16_t* quant = state.quant[component.quantTable];
+
+        const int category = reader.decode(state.dc[component.dcTable]);
+        if (category < 0 || category > 11)
+            return false;
+        component.dcPredictor = clamp16(component.dcPredictor + reader.receiveExtend(category));
+        coefficients[0] = clamp16(component.dcPredictor * quant[0]);
+
+        const HuffmanTable& ac = state.ac[component.acTable];
+        for (int k = 1; k < 64; )
+        {
+            const int symbol = reader.decode(ac);
+            if (symbol < 0)
+                return false;
+            const int run = symbol >> 4;
+            const int size = symbol & 15;
+            if (size == 0)
+            {
+                if (run != 15)
+                    break;
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63)
+                return false;
+            coefficients[kZigzag[k]] = clamp16(reader.receiveExtend(size) * quant[k]);
+            ++k;
+        }
+
+        idctBlock(coefficients, component.plane.data() + (size_t)blockY * 8 * component.planeWidth + blockX * 8, component.planeWidth);
+        return true;
+    }
+
+    bool decodeScan(const uint8_t*& cursor, const uint8_t* end, JpegState& state, const std::vector<int>& scan, std::string& log)
+    {
+        BitReader reader(cursor, end);
+        for (int index : scan)
+            state.components[index].dcPredictor = 0;
+
+        /* A scan with one component is not interleaved: its MCU is one block
+           and it covers only the blocks inside that component's image area. */
+        const bool single = scan.size() == 1;
+        int mcusX = state.mcusX, mcusY = state.mcusY;
+        if (single)
+        {
+            const Component& component = state.components[scan[0]];
+            const int componentWidth = (state.width * component.h + state.maxH - 1) / state.maxH;
+            const int componentHeight = (state.height * component.v + state.maxV - 1) / state.maxV;
+            mcusX = (componentWidth + 7) / 8;
+            mcusY = (componentHeight + 7) / 8;
+        }
+
+        int untilRestart = state.restartInterval;
+        for (int mcuY = 0; mcuY < mcusY; ++mcuY)
+        {
+            for (int mcuX = 0; mcuX < mcusX; ++mcuX)
+            {
+                if (state.restartInterval && untilRestart-- == 0)
+                {
+                    if (!reader.restart())
+                    {
+                        log = "jpeg: missing restart marker";
+                        return false;
+                    }
+                    for (int index : scan)
+                        state.components[index].dcPredictor = 0;
+                    untilRestart = state.restartInterval - 1;
+                }
+
+                bool ok = true;
+                if (single)
+                    ok = decodeBlock(reader, state, state.components[scan[0]], mcuX, mcuY);
+                else
+                {
+                    for (int index : scan)
+                    {
+                        Component& component = state.components[index];
+                        for (int y = 0; y < component.v && ok; ++y)
+                            for (int x = 0; x < component.h && ok; ++x)
+                                ok = decodeBlock(reader, state, component, mcuX * component.h + x, mcuY * component.v + y);
+                    }
+                }
+                if (!ok)
+                {
+                    log = "jpeg: corrupt entropy-coded data";
+                    return false;
+                }
+            }
+        }
+
+        cursor = reader.markerPosition();
+        return true;
+    }
+
+    bool readFrame(const uint8_t* body, size_t length, JpegState& state, std::string& log)
+    {
+        if (length < 6 || body[0] != 8)
+        {
+            log = "jpeg: only 8-bit samples are supported";
+            return false;
+        }
+        state.height = body[1] << 8 | body[2];
+        state.width = body[3] << 8 | body[4];
+        const int count = body[5];
+        if (state.width <= 0 || state.height <= 0 || state.width > kMaxImageDimension || state.height > kMaxImageDimension)
+        {
+            log = "jpeg: bad dimensions";
+            return false;
+        }
+        if ((count != 1 && count != 3) || length < 6 + (size_t)count * 3)
+        {
+            log = "jpeg: only greyscale and three-component images are supported";
+            return false;
+        }
+
+        state.maxH = state.maxV = 1;
+        state.components.resize(count);
+        for (int i = 0; i < count; ++i)
+        {
+            Component& component = state.components[i];
+            const uint8_t* p = body + 6 + i * 3;
+            component.id = p[0];
+            component.h = p[1] >> 4;
+            component.v = p[1] & 15;
+            component.quantTable = p[2];
+            if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantTable > 3)
+            {
+                log = "jpeg: bad component parameters";
+                return false;
+            }
+            state.maxH = std::max(state.maxH, component.h);
+            state.maxV = std::max(state.maxV, component.v);
+        }
+
+        state.mcusX = (state.width + 8 * state.maxH - 1) / (8 * state.maxH);
+        state.mcusY = (state.height + 8 * state.maxV - 1) / (8 * state.maxV);
+        for (Component& component : state.components)
+        {
+            if (state.maxH % component.h || state.maxV % component.v)
+            {
+                log = "jpeg: fractional sampling factors are not supported";
+                return false;
+            }
+            component.planeWidth = state.mcusX * component.h * 8;
+            component.planeHeight = state.mcusY * component.v * 8;
+            component.plane.assign((size_t)component.planeWidth * component.planeHeight, 0);
+        }
+        state.sawFrame = true;
+        return true;
+    }
+
+    bool readHuffmanTables(const uint8_t* body, size_t length, JpegState& state, std::string& log)
+    {
+        while (length > 0)
+        {
+            if (length < 17)
+            {
+                log = "jpeg: truncated Huffman table";
+                return false;
+            }
+            const int tableClass = body[0] >> 4;
+            const int id = body[0] & 15;
+            const uint8_t* counts = body + 1;
+            int total = 0;
+            for (int i = 0; i < 16; ++i)
+                total += counts[i];
+            if (tableClass > 1 || id > 3 || total > 256 || length < 17 + (size_t)total)
+            {
+                log = "jpeg: bad Huffman table";
+                return false;
+            }
+            HuffmanTable& table = tableClass == 0 ? state.dc[id] : state.ac[id];
+            if (!buildTable(table, counts, body + 17, total))
+            {
+                log = "jpeg: over-subscribed Huffman table";
+                return false;
+            }
+            body += 17 + total;
+            length -= 17 + total;
+        }
+        return true;
+    }
+
+    bool readQuantTables(const uint8_t* body, size_t length, JpegState& state, std::string& log)
+    {
+        while (length > 0)
+        {
+            const int precision = body[0] >> 4;
+            const int id = body[0] & 15;
+            const size_t size = 1 + 64 * (precision ? 2 : 1);
+            if (id > 3 || precision > 1 || length < size)
+            {
+                log = "jpeg: bad quantisation table";
+                return false;
+            }
+            for (int i = 0; i < 64; ++i)
+                state.quant[id][i] = precision ? (uint16_t)(body[1 + i * 2] << 8 | body[2 + i * 2]) : body[1 + i];
+            body += size;
+            length -= size;
+        }
+        return true;
+    }
+
+    /* Upsamples by replication and converts to RGB (or keeps greyscale). */
+    void outputImage(const JpegState& state, const ImageOptions& options, Image& image)
+    {
+        image.width = state.width;
+        image.height = state.height;
+        image.pixels.resize((size_t)state.width * state.height * 4);
+
+        const bool gray = state.components.size() == 1;
+        /* Adobe transform 0, or components literally named R, G, B, mean no YCbCr. */
+        const bool rgb = !gray && (state.adobeTransform == 0
+            || (state.adobeTransform < 0 && state.components[0].id == 'R' && state.components[1].id == 'G' && state.components[2].id == 'B'));
+
+        std::vector<uint8_t> row((size_t)state.width * 3);
+        for (int y = 0; y < state.height; ++y)
+        {
+            uint8_t* out = image.pixels.data() + (size_t)y * state.width * 4;
+            const uint8_t* lines[3];
+            for (size_t c = 0; c < state.components.size(); ++c)
+            {
+                const Component& component = state.components[c];
+                lines[c] = component.plane.data() + (size_t)(y * component.v / state.maxV) * component.planeWidth;
+            }
+
+            if (gray)
+            {
+                convertRow(kGray8, lines[0], state.width, options, out);
+                continue;
+            }
+
+            const int shiftX[3] = {
+                state.maxH / state.components[0].h, state.maxH / state.components[1].h, state.maxH / state.components[2].h };
+            for (int x = 0; x < state.width; ++x)
+            {
+                const int c0 = lines[0][x / shiftX[0]];
+                const int c1 = lines[1][x / shiftX[1]];
+                const int c2 = lines[2][x / shiftX[2]];
+                uint8_t* pixel = row.data() + x * 3;
+                if (rgb)
+                {
+                    pixel[0] = (uint8_t)c0;
+                    pixel[1] = (uint8_t)c1;
+                    pixel[2] = (uint8_t)c2;
+                    continue;
+                }
+                /* JFIF YCbCr to RGB, 16.16 fixed point as in libjpeg. */
+                const int cb = c1 - 128;
+                const int cr = c2 - 128;
+                pixel[0] = clamp255(c0 + ((91881 * cr + 32768) >> 16));
+                pixel[1] = clamp255(c0 + ((-22554 * cb - 46802 * cr + 32768) >> 16));
+                pixel[2] = clamp255(c0 + ((116130 * cb + 32768) >> 16));
+            }
+            convertRow(kRgb8, row.data(), state.width, options, out);
+        }
+    }
+}
+
+bool decodeJpeg(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log)
+{
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8)
+    {
+        log = "jpeg: missing SOI marker";
+        return false;
+    }
+
+    /* Large (Huffman tables and planes), so on the heap rather than a worker's stack. */
+    std::unique_ptr<JpegState> owner(new JpegState());
+    JpegState& state = *owner;
+    state.adobeTransform = -1;
+
+    const uint8_t* cursor = data + 2;
+    const uint8_t* end = data + size;
+    bool decodedScan = false;
+    for (;;)
+    {
+        while (cursor < end && *cursor != 0xff)
+            ++cursor;
+        while (cursor < end && *cursor == 0xff)
+            ++cursor;
+        if (cursor >= end)
+            break;
+        const int marker = *cursor++;
+
+        if (marker == 0xd9)
+            break;
+        if ((marker >= 0xd0 && marker <= 0xd7) || marker == 0x01)
+            continue;
+
+        if (end - cursor < 2)
+        {
+            log = "jpeg: truncated marker";
+            return false;
+        }
+        const size_t length = (size_t)(cursor[0] << 8 | cursor[1]);
+        if (length < 2 || (size_t)(end - cursor) < length)
+        {
+            log = "jpeg: truncated segment";
+            return false;
+        }
+        const uint8_t* body = cursor + 2;
+        const size_t bodyLength = length - 2;
+        cursor += length;
+
+        bool ok = true;
+        switch (marker)
+        {
+        case 0xc0:
+        case 0xc1:
+            if (state.sawFrame)
+            {
+                log = "jpeg: more than one frame";
+                return false;
+            }
+            ok = readFrame(body, bodyLength, state, log);
+            break;
+        case 0xc4:
+            ok = readHuffmanTables(body, bodyLength, state, log);
+            break;
+        case 0xdb:
+            ok = readQuantTables(body, bodyLength, state, log);
+            break;
+        case 0xdd:
+            state.restartInterval = bodyLength >= 2 ? body[0] << 8 | body[1] : 0;
+            break;
+        case 0xee:
+            if (bodyLength >= 12 && memcmp(body, "Adobe", 5) == 0)
+                state.adobeTransform = body[11];
+            break;
+        case 0xda:
+        {
+            if (!state.sawFrame || bodyLength < 1)
+            {
+                log = "jpeg: scan before frame header";
+                return false;
+            }
+            const int count = body[0];
+            if (count < 1 || count > (int)state.components.size() || bodyLength < 4 + (size_t)count * 2)
+            {
+                log = "jpeg: bad scan header";
+                return false;
+            }
+            std::vector<int> scan;
+            for (int i = 0; i < count; ++i)
+            {
+                const int id = body[1 + i * 2];
+                const int tables = body[2 + i * 2];
+                size_t index = 0;
+                while (index < state.components.size() && state.components[index].id != id)
+                    ++index;
+                if (index == state.components.size() || (tables >> 4) > 3 || (tables & 15) > 3)
+                {
+                    log = "jpeg: bad scan component";
+                    return false;
+                }
+                Component& component = state.components[index];
+                component.dcTable = tables >> 4;
+                component.acTable = tables & 15;
+                if (!state.dc[component.dcTable].defined || !state.ac[component.acTable].defined)
+                {
+                    log = "jpeg: scan uses an undefined Huffman table";
+                    return false;
+                }
+                scan.push_back((int)index);
+            }
+            ok = decodeScan(cursor, end, state, scan, log);
+            decodedScan = decodedScan || ok;
+            break;
+        }
+        default:
+            if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+            {
+                log = "jpeg: progressive, lossless and arithmetic-coded files are not supported";
+                return false;
+            }
+            break;
+        }
+        if (!ok)
+            return false;
+    }
+
+    if (!decodedScan)
+    {
+        log = "jpeg: no image data";
+        return false;
+    }
+    outputImage(state, options, image);
+    return true;
+}
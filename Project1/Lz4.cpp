@@ -0,0 +1,203 @@
+#include "Lz4.h"
+
+#include <cstring>
+
+namespace
+{
+    const size_t kMinMatch = 4;
+    const size_t kLastLiterals = 5;     /* the block always ends in at least this many literals */
+    const size_t kMatchStartLimit = 12; /* and no match starts in its last 12 bytes */
+    const size_t kMaxOffset = 65535;
+    const int kHashBits = 14;
+    const int kSkipTrigger = 6;         /* search step grows by one every 2^6 misses */
+
+    uint32_t read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash4(uint32_t value)
+    {
+        return (value * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void putLength(std::vector<uint8_t>& out, size_t length)
+    {
+        while (length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back((uint8_t)length);
+    }
+
+    void putSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        const size_t matchCode = matchLength - kMinMatch;
+        const uint8_t token = (uint8_t)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+        out.push_back(token);
+        if (literalCount >= 15)
+            putLength(out, literalCount - 15);
+        out.insert(out.end(), literals, literals + literalCount);
+        out.push_back((uint8_t)offset);
+        out.push_back((uint8_t)(offset >> 8));
+        if (matchCode >= 15)
+            putLength(out, matchCode - 15);
+    }
+
+    /* Reads the 255-terminated continuation of a length. */
+    bool getLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (in == end)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+size_t lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+void lz4Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    out.reserve(out.size() + lz4CompressBound(size));
+
+    size_t anchor = 0;
+    if (size > kMatchStartLimit)
+    {
+        /* Positions are stored plus one so that zero means empty. */
+        std::vector<uint32_t> table((size_t)1 << kHashBits, 0);
+        const size_t searchEnd = size - kMatchStartLimit;
+        const size_t matchEnd = size - kLastLiterals;
+        size_t ip = 0;
+        while (ip < searchEnd)
+        {
+            /* Probe one earlier position per step, striding further through
+               data that keeps failing to match. */
+            size_t match = 0;
+            bool found = false;
+            unsigned misses = 1 << kSkipTrigger;
+            while (ip < searchEnd)
+            {
+                const uint32_t sequence = read32(data + ip);
+                uint32_t& slot = table[hash4(sequence)];
+                const size_t candidate = slot;
+                slot = (uint32_t)(ip + 1);
+                if (candidate != 0 && ip - (candidate - 1) <= kMaxOffset && read32(data + candidate - 1) == sequence)
+                {
+                    match = candidate - 1;
+                    found = true;
+                    break;
+                }
+                ip += misses++ >> kSkipTrigger;
+            }
+            if (!found)
+                break;
+
+            while (ip > anchor && match > 0 && data[ip - 1] == data[match - 1])
+            {
+                --ip;
+                --match;
+            }
+            size_t length = kMinMatch;
+            while (ip + length < matchEnd && data[ip + length] == data[match + length])
+                ++length;
+
+            putSequence(out, data + anchor, ip - anchor, ip - match, length);
+            ip += length;
+            anchor = ip;
+
+            /* Seed the table just behind the match so runs chain together. */
+            if (ip - 2 < searchEnd)
+                table[hash4(read32(data + ip - 2))] = (uint32_t)(ip - 2 + 1);
+        }
+    }
+
+    /* Closing literals: a token with no match. */
+    const size_t literalCount = size - anchor;
+    out.push_back((uint8_t)((literalCount < 15 ? literalCount : 15) << 4));
+    if (literalCount >= 15)
+        putLength(out, literalCount - 15);
+    out.insert(out.end(), data + anchor, data + size);
+}
+
+bool lz4Decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+{
+    const uint8_t* in = data;
+    const uint8_t* inEnd = data + size;
+    uint8_t* op = out;
+    uint8_t* const opEnd = out + outSize;
+
+    for (;;)
+    {
+        if (in == inEnd)
+            return false;
+        const uint8_t token = *in++;
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !getLength(in, inEnd, literalCount))
+            return false;
+        if (literalCount > (size_t)(inEnd - in) || literalCount > (size_t)(opEnd - op))
+            return false;
+        if (literalCount <= 16 && inEnd - in >= 16 && opEnd - op >= 16)
+            memcpy(op, in, 16);     /* fixed size, so it compiles to two moves */
+        else if (literalCount > 0)
+            memcpy(op, in, literalCount);
+        op += literalCount;
+        in += literalCount;
+
+        /* The last sequence has literals only. */
+        if (in == inEnd)
+            return op == opEnd;
+
+        if (inEnd - in < 2)
+            return false;
+        const size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        if (offset == 0 || offset > (size_t)(op - out))
+            return false;
+
+        size_t length = token & 15;
+        if (length == 15 && !getLength(in, inEnd, length))
+            return false;
+        length += kMinMatch;
+        if (length > (size_t)(opEnd - op))
+            return false;
+
+        /* Matches may overlap their own output (offset < length repeats a
+           pattern), so only copy eight at a time when the source stays at
+           least eight behind and there is room to overshoot. */
+        const uint8_t* match = op - offset;
+        if (offset >= 16 && length <= 16 && opEnd - op >= 16)
+        {
+            memcpy(op, match, 16);
+            op += length;
+        }
+        else if (offset >= 8 && (size_t)(opEnd - op) >= length + 8)
+        {
+            uint8_t* const end = op + length;
+            do
+            {
+                memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+            } while (op < end);
+            op = end;
+        }
+        else
+        {
+            for (size_t i = 0; i < length; ++i)
+                op[i] = match[i];
+            op += length;
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* LZ4 block format: a sequence of (literal run, match) pairs with 16-bit
+   offsets and no entropy coding, so decoding is little more than memcpy and
+   runs at several GB/s per core. There is no frame, checksum or stored size;
+   callers keep the decompressed size next to the block. The output of
+   lz4Compress() is readable by any LZ4 block decoder and vice versa. */
+
+/* Appends the compressed form of data to out. Greedy single-probe matching,
+   as in the reference "fast" mode. */
+void lz4Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+/* Largest output lz4Compress() can produce for size input bytes. */
+size_t lz4CompressBound(size_t size);
+
+/* Decodes exactly outSize bytes into out. Returns false on malformed input,
+   or when the block does not decode to exactly outSize bytes; never reads or
+   writes outside the given ranges. */
+bool lz4Decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
@@ -0,0 +1,119 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(NULL)
+    , m_size(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx((HANDLE)m_file, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    m_mapping = CreateFileMappingA((HANDLE)m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!m_mapping)
+    {
+        close();
+        return false;
+    }
+    m_data = (const uint8_t*)MapViewOfFile((HANDLE)m_mapping, FILE_MAP_READ, 0, 0, 0);
+    m_size = (size_t)size.QuadPart;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* The mapping holds its own reference to the file. */
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    m_data = (const uint8_t*)mapped;
+    m_size = (size_t)info.st_size;
+#endif
+
+    if (!m_data)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle((HANDLE)m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle((HANDLE)m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data)
+        munmap((void*)m_data, m_size);
+#endif
+    m_data = NULL;
+    m_size = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const
+{
+    if (!m_data || offset >= m_size)
+        return;
+    if (size > m_size - offset)
+        size = m_size - offset;
+
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (void*)(m_data + offset);
+    range.NumberOfBytes = size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+    /* madvise wants a page-aligned start. */
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = offset / page * page;
+    madvise((void*)(m_data + start), size + (offset - start), MADV_WILLNEED);
+#endif
+}
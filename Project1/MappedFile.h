@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Read-only memory mapping of a whole file.
+
+   Pages are loaded by the OS on first touch and shared with the page cache,
+   so data can be used in place without a read() copy. The mapping stays valid
+   until close() or destruction. */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    /* Asks the OS to start reading a range in ahead of use. Advisory only. */
+    void prefetch(size_t offset, size_t size) const;
+
+    bool isOpen() const { return m_data != NULL; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
@@ -0,0 +1,137 @@
+#include "Mesh.h"
+
+#include <cstring>
+
+const VertexAttribute kMeshDataAttributes[3] = {
+    { 0, 3, GL_FLOAT, GL_FALSE, 0 },
+    { 1, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float) },
+    { 2, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float) },
+};
+
+Mesh createMesh(const void* vertices, size_t vertexBytes, GLsizei stride,
+    const VertexAttribute* attributes, int attributeCount,
+    const void* indices, GLsizei indexCount, GLenum indexType)
+{
+    Mesh mesh = {};
+    mesh.indexCount = indexCount;
+    mesh.indexType = indexType;
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vertexBuffer);
+    glGenBuffers(1, &mesh.indexBuffer);
+
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(indexType), indices, GL_STATIC_DRAW);
+
+    for (int i = 0; i < attributeCount; ++i)
+    {
+        const VertexAttribute& attribute = attributes[i];
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+            attribute.normalized, stride, (void*)attribute.offset);
+    }
+
+    glBindVertexArray(0);
+    return mesh;
+}
+
+void destroyMesh(Mesh& mesh)
+{
+    glDeleteBuffers(1, &mesh.indexBuffer);
+    glDeleteBuffers(1, &mesh.vertexBuffer);
+    glDeleteVertexArrays(1, &mesh.vao);
+    mesh = Mesh();
+}
+
+void splitIndices16(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    std::vector<uint16_t>& localIndices, std::vector<uint32_t>& vertexRemap, std::vector<IndexCluster>& clusters)
+{
+    const size_t kClusterVertices = 65536;
+    const size_t triangleCount = indexCount / 3;
+    localIndices.resize(triangleCount * 3);
+    vertexRemap.clear();
+    clusters.clear();
+
+    /* local[v] is valid while owner[v] is the current cluster's number. */
+    std::vector<uint32_t> owner(vertexCount, UINT32_MAX);
+    std::vector<uint16_t> local(vertexCount);
+    uint32_t cluster = 0;
+    size_t base = 0;
+    size_t start = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t* corners = indices + t * 3;
+        const size_t added = (owner[corners[0]] != cluster)
+            + (owner[corners[1]] != cluster && corners[1] != corners[0])
+            + (owner[corners[2]] != cluster && corners[2] != corners[0] && corners[2] != corners[1]);
+        if (vertexRemap.size() - base + added > kClusterVertices)
+        {
+            IndexCluster closed = { start, (GLsizei)(t * 3 - start), (GLint)base };
+            clusters.push_back(closed);
+            cluster++;
+            base = vertexRemap.size();
+            start = t * 3;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = corners[c];
+            if (owner[v] != cluster)
+            {
+                owner[v] = cluster;
+                local[v] = (uint16_t)(vertexRemap.size() - base);
+                vertexRemap.push_back(v);
+            }
+            localIndices[t * 3 + c] = local[v];
+        }
+    }
+    if (start < triangleCount * 3)
+    {
+        IndexCluster last = { start, (GLsizei)(triangleCount * 3 - start), (GLint)base };
+        clusters.push_back(last);
+    }
+}
+
+ClusteredMesh createClusteredMesh(const void* vertices, size_t vertexCount, GLsizei stride,
+    const VertexAttribute* attributes, int attributeCount, const uint32_t* indices, size_t indexCount)
+{
+    ClusteredMesh result;
+    if (vertexCount <= 65536)
+    {
+        std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+        IndexCluster whole = { 0, (GLsizei)indexCount, 0 };
+        result.clusters.push_back(whole);
+        result.vertexCount = vertexCount;
+        result.mesh = createMesh(vertices, vertexCount * stride, stride, attributes, attributeCount,
+            shortIndices.data(), (GLsizei)indexCount, GL_UNSIGNED_SHORT);
+        return result;
+    }
+
+    std::vector<uint16_t> localIndices;
+    std::vector<uint32_t> vertexRemap;
+    splitIndices16(indices, indexCount, vertexCount, localIndices, vertexRemap, result.clusters);
+    result.vertexCount = vertexRemap.size();
+
+    std::vector<uint8_t> remapped(vertexRemap.size() * stride);
+    for (size_t i = 0; i < vertexRemap.size(); ++i)
+        memcpy(&remapped[i * stride], (const uint8_t*)vertices + (size_t)vertexRemap[i] * stride, stride);
+    result.mesh = createMesh(remapped.data(), remapped.size(), stride, attributes, attributeCount,
+        localIndices.data(), (GLsizei)localIndices.size(), GL_UNSIGNED_SHORT);
+    return result;
+}
+
+ClusteredMesh createClusteredMesh(const MeshData& data)
+{
+    return createClusteredMesh(data.vertices.data(), data.vertices.size() / kMeshVertexFloats,
+        kMeshVertexFloats * sizeof(float), kMeshDataAttributes, 3, data.indices.data(), data.indices.size());
+}
+
+void drawClusteredMesh(const ClusteredMesh& mesh)
+{
+    glBindVertexArray(mesh.mesh.vao);
+    for (const IndexCluster& cluster : mesh.clusters)
+        glDrawElementsBaseVertex(GL_TRIANGLES, cluster.indexCount, GL_UNSIGNED_SHORT,
+            (void*)(cluster.firstIndex * sizeof(uint16_t)), cluster.baseVertex);
+}
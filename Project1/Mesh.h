@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* One vertex attribute inside an interleaved vertex buffer. */
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+/* An indexed mesh in its own vertex array object. */
+struct Mesh
+{
+    GLuint vao;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLsizei indexCount;
+    GLenum indexType;
+};
+
+/* An imported mesh on the CPU: interleaved vertices of kMeshVertexFloats
+   floats each (position xyz, texcoord uv, normal xyz, at attribute locations
+   0, 1 and 2) and a 32-bit triangle list. */
+const int kMeshVertexFloats = 8;
+
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+extern const VertexAttribute kMeshDataAttributes[3];
+
+/* Uploads interleaved vertices and indices (GL_UNSIGNED_SHORT or
+   GL_UNSIGNED_INT) into a new mesh. The VAO is left unbound. */
+Mesh createMesh(const void* vertices, size_t vertexBytes, GLsizei stride,
+    const VertexAttribute* attributes, int attributeCount,
+    const void* indices, GLsizei indexCount, GLenum indexType);
+
+void destroyMesh(Mesh& mesh);
+
+/* A run of 16-bit indices, drawn relative to its own base vertex. */
+struct IndexCluster
+{
+    size_t firstIndex;
+    GLsizei indexCount;
+    GLint baseVertex;
+};
+
+/* A mesh of any size on 16-bit indices. Up to 65536 vertices it is one
+   cluster over the vertices as given. Larger meshes are cut into clusters
+   that each touch at most 65536 vertices, and every cluster gets its own
+   copy of the vertices it uses. Vertices shared across a cut are
+   duplicated, which for a mesh in vertex cache order is a few percent.
+   mesh.indexType is GL_UNSIGNED_SHORT and mesh.indexCount covers all
+   clusters. This is how imported meshes go to the GPU. */
+struct ClusteredMesh
+{
+    Mesh mesh;
+    std::vector<IndexCluster> clusters;
+    size_t vertexCount;     /* uploaded, duplicates included */
+};
+
+/* Splits a triangle list in order. vertexRemap receives the source vertex of
+   every output vertex; output vertex i of a cluster is at baseVertex + i. */
+void splitIndices16(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    std::vector<uint16_t>& localIndices, std::vector<uint32_t>& vertexRemap, std::vector<IndexCluster>& clusters);
+
+/* Splits indices when needed and uploads the vertices, stride bytes each. */
+ClusteredMesh createClusteredMesh(const void* vertices, size_t vertexCount, GLsizei stride,
+    const VertexAttribute* attributes, int attributeCount, const uint32_t* indices, size_t indexCount);
+
+ClusteredMesh createClusteredMesh(const MeshData& data);
+
+/* One glDrawElementsBaseVertex per cluster. */
+void drawClusteredMesh(const ClusteredMesh& mesh);
+
+/* Size in bytes of one index of the given type. */
+inline size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_INT ? 4 : indexType == GL_UNSIGNED_SHORT ? 2 : 1;
+}
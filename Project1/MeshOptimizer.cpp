@@ -0,0 +1,348 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    /* Forsyth's constants. */
+    const int kCacheSize = 32;
+    const float kCacheDecayPower = 1.5f;
+    const float kLastTriangleScore = 0.75f;
+    const float kValenceBoostScale = 2.0f;
+    const float kValenceBoostPower = 0.5f;
+    const int kMaxValence = 64;     /* beyond this the boost is negligible */
+
+    struct ScoreTables
+    {
+        float cache[kCacheSize];
+        float valence[kMaxValence + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < kCacheSize; ++i)
+                cache[i] = i < 3 ? kLastTriangleScore
+                    : std::pow(1.0f - (float)(i - 3) / (kCacheSize - 3), kCacheDecayPower);
+            valence[0] = 0.0f;
+            for (int i = 1; i <= kMaxValence; ++i)
+                valence[i] = kValenceBoostScale * std::pow((float)i, -kValenceBoostPower);
+        }
+    };
+
+    const ScoreTables kScores;
+
+    float vertexScore(int cachePosition, uint32_t remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+        const float score = cachePosition >= 0 ? kScores.cache[cachePosition] : 0.0f;
+        return score + kScores.valence[std::min(remaining, (uint32_t)kMaxValence)];
+    }
+
+    /* FIFO cache simulation: a vertex is resident while fewer than cacheSize
+       misses have happened since it was loaded. */
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, int cacheSize)
+            : m_loaded(vertexCount, 0)
+            , m_time((uint64_t)cacheSize + 1)
+            , m_size(cacheSize)
+        {
+        }
+
+        /* Returns 1 on a miss. */
+        unsigned access(uint32_t vertex)
+        {
+            if (m_time - m_loaded[vertex] <= (uint64_t)m_size)
+                return 0;
+            m_loaded[vertex] = ++m_time;
+            return 1;
+        }
+
+        void flush() { m_time += (uint64_t)m_size + 1; }
+
+    private:
+        std::vector<uint64_t> m_loaded;
+        uint64_t m_time;
+        int m_size;
+    };
+
+    struct Cluster
+    {
+        size_t first;   /* triangle */
+        size_t count;
+        float sortKey;
+    };
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (indexCount < 3)
+        return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0;
+    size_t distinct = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        misses += cache.access(indices[i]);
+        if (!referenced[indices[i]])
+        {
+            referenced[indices[i]] = true;
+            distinct++;
+        }
+    }
+    stats.acmr = (float)misses / (float)(indexCount / 3);
+    stats.atvr = (float)misses / (float)distinct;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    /* Triangles around each vertex; the first remaining[v] entries of a
+       vertex's range are the ones not emitted yet. */
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        remaining[indices[i]]++;
+    std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> output(triangleCount * 3);
+    uint32_t cache[kCacheSize + 3];
+    int cacheCount = 0;
+    size_t cursor = 0;
+    size_t best = SIZE_MAX;
+
+    for (size_t written = 0; written < triangleCount; ++written)
+    {
+        /* Nothing in the cache scores: continue with the next triangle in
+           input order, which keeps the whole pass linear. */
+        if (best == SIZE_MAX)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const uint32_t* corners = indices + best * 3;
+        memcpy(&output[written * 3], corners, 3 * sizeof(uint32_t));
+        emitted[best] = 1;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = corners[c];
+            uint32_t* triangles = &adjacency[firstTriangle[v]];
+            for (uint32_t k = 0; k < remaining[v]; ++k)
+                if (triangles[k] == best)
+                {
+                    triangles[k] = triangles[--remaining[v]];
+                    triangles[remaining[v]] = (uint32_t)best;
+                    break;
+                }
+        }
+
+        /* The triangle's vertices move to the front of the LRU cache. */
+        uint32_t next[kCacheSize + 3];
+        int nextCount = 0;
+        for (int c = 0; c < 3; ++c)
+            if (std::find(next, next + nextCount, corners[c]) == next + nextCount)
+                next[nextCount++] = corners[c];
+        for (int i = 0; i < cacheCount; ++i)
+            if (std::find(next, next + nextCount, cache[i]) == next + nextCount)
+                next[nextCount++] = cache[i];
+        for (int i = kCacheSize; i < nextCount; ++i)
+        {
+            cachePosition[next[i]] = -1;
+            score[next[i]] = vertexScore(-1, remaining[next[i]]);
+        }
+        cacheCount = std::min(nextCount, kCacheSize);
+        memcpy(cache, next, cacheCount * sizeof(uint32_t));
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            cachePosition[cache[i]] = i;
+            score[cache[i]] = vertexScore(i, remaining[cache[i]]);
+        }
+
+        /* Only triangles touching the cache changed score. */
+        best = SIZE_MAX;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            const uint32_t* triangles = &adjacency[firstTriangle[v]];
+            for (uint32_t k = 0; k < remaining[v]; ++k)
+            {
+                const uint32_t* t = indices + (size_t)triangles[k] * 3;
+                const float triangleScore = score[t[0]] + score[t[1]] + score[t[2]];
+                if (triangleScore > bestScore)
+                {
+                    bestScore = triangleScore;
+                    best = triangles[k];
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), triangleCount * 3 * sizeof(uint32_t));
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+    size_t strideFloats, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    /* Hard boundaries: triangles that miss on all three vertices, where the
+       cache is cold whatever comes before them. */
+    std::vector<size_t> hard;
+    {
+        FifoCache cache(vertexCount, kVertexCacheFifoSize);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const unsigned misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1])
+                + cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3)
+                hard.push_back(t);
+        }
+        hard.push_back(triangleCount);
+    }
+
+    /* Soft boundaries: within each hard cluster, close a cluster as soon as
+       its ACMR, counted from a cold cache, is within threshold of the whole
+       hard cluster's. */
+    std::vector<Cluster> clusters;
+    FifoCache cache(vertexCount, kVertexCacheFifoSize);
+    for (size_t h = 0; h + 1 < hard.size(); ++h)
+    {
+        cache.flush();
+        size_t misses = 0;
+        for (size_t i = hard[h] * 3; i < hard[h + 1] * 3; ++i)
+            misses += cache.access(indices[i]);
+        const float limit = threshold * (float)misses / (float)(hard[h + 1] - hard[h]);
+
+        cache.flush();
+        size_t start = hard[h];
+        misses = 0;
+        for (size_t t = hard[h]; t < hard[h + 1]; ++t)
+        {
+            misses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (t + 1 == hard[h + 1] || (float)misses <= limit * (float)(t + 1 - start))
+            {
+                Cluster cluster = { start, t + 1 - start, 0.0f };
+                clusters.push_back(cluster);
+                start = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    /* Clusters facing away from the mesh centre are likely to occlude the
+       rest, so they are drawn first: the key is the distance of the
+       cluster's centroid from the mesh centroid along its average normal. */
+    std::vector<float> clusterData(clusters.size() * 6, 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        float* centroid = &clusterData[c * 6];
+        float* normal = centroid + 3;
+        float area = 0.0f;
+        for (size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t)
+        {
+            const float* a = positions + indices[t * 3] * strideFloats;
+            const float* b = positions + indices[t * 3 + 1] * strideFloats;
+            const float* p = positions + indices[t * 3 + 2] * strideFloats;
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float weight = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                centroid[k] += (a[k] + b[k] + p[k]) * weight;
+                normal[k] += n[k];
+            }
+            area += weight;
+        }
+        for (int k = 0; k < 3; ++k)
+            meshCentroid[k] += centroid[k];
+        meshArea += area;
+        const float scale = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+        for (int k = 0; k < 3; ++k)
+            centroid[k] *= scale;
+    }
+    const float meshScale = meshArea > 0.0f ? 1.0f / (3.0f * meshArea) : 0.0f;
+    for (int k = 0; k < 3; ++k)
+        meshCentroid[k] *= meshScale;
+
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        const float* centroid = &clusterData[c * 6];
+        const float* normal = centroid + 3;
+        const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+        for (int k = 0; k < 3; ++k)
+            key += (centroid[k] - meshCentroid[k]) * normal[k];
+        clusters[c].sortKey = length > 0.0f ? key / length : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (const Cluster& cluster : clusters)
+        output.insert(output.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t optimizeVertexFetch(MeshData& mesh)
+{
+    const size_t vertexCount = mesh.vertices.size() / kMeshVertexFloats;
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    uint32_t next = 0;
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = next++;
+            const float* source = &mesh.vertices[(size_t)index * kMeshVertexFloats];
+            vertices.insert(vertices.end(), source, source + kMeshVertexFloats);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+    return next;
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+    const size_t vertexCount = mesh.vertices.size() / kMeshVertexFloats;
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+    optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), vertexCount, kMeshVertexFloats, 1.05f);
+    optimizeVertexFetch(mesh);
+}
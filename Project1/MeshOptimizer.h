@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Mesh.h"
+
+/* Offline reordering of indexed triangle lists for vertex throughput.
+
+   The three passes are meant to run in this order, each keeping what the
+   previous one gained:
+
+     optimizeVertexCache  reorders triangles so recently transformed vertices
+                          are reused, after Tom Forsyth's "Linear-Speed
+                          Vertex Cache Optimisation" (LRU cache of 32, the
+                          published scoring constants)
+     optimizeOverdraw     cuts that order into clusters at the points where
+                          the cache starts cold anyway and sorts the clusters
+                          front to back from outside the mesh, after Sander,
+                          Nehab and Barczak's "Fast Triangle Reordering for
+                          Vertex Locality and Reduced Overdraw"
+     optimizeVertexFetch  renumbers vertices in first-use order so vertex
+                          fetches walk memory forwards
+
+   None of them changes what is drawn, only the order. */
+
+/* Post-transform cache efficiency of an index buffer, simulated with a FIFO
+   cache of cacheSize entries, which is how most hardware behaves:
+
+     acmr  average cache miss ratio, transformed vertices per triangle;
+           0.5 is the ideal for large regular meshes, 3 the worst case
+     atvr  average transform to vertex ratio, transformed vertices per
+           referenced vertex; 1 is ideal */
+struct VertexCacheStats
+{
+    float acmr;
+    float atvr;
+};
+
+const int kVertexCacheFifoSize = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    int cacheSize = kVertexCacheFifoSize);
+
+/* Reorders the triangles of indices in place. Indices must be below
+   vertexCount. */
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/* Reorders the triangles of an already cache-optimized list in place.
+   positions points at the xyz of the first vertex, strideFloats apart.
+   threshold (at least 1) is how much the ACMR of each cluster may grow to
+   let it be split into smaller clusters, which sort better; 1.05 keeps
+   almost all of the cache gains. */
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+    size_t strideFloats, float threshold);
+
+/* Renumbers the vertices of mesh in the order the indices first use them,
+   dropping unreferenced ones. Returns the new vertex count. */
+size_t optimizeVertexFetch(MeshData& mesh);
+
+/* The three passes above, with a threshold of 1.05. */
+void optimizeMesh(MeshData& mesh);
@@ -0,0 +1,178 @@
+#include "MeshPool.h"
+
+MeshPool::MeshPool(GLsizei stride, const VertexAttribute* attributes, int attributeCount,
+    size_t vertexCapacity, size_t indexCapacity, GLenum indexType)
+    : m_vao(0)
+    , m_vertexBuffer(0)
+    , m_indexBuffer(0)
+    , m_scratchBuffer(0)
+    , m_scratchSize(0)
+    , m_stride(stride)
+    , m_indexType(indexType)
+    , m_vertexAllocator(vertexCapacity)
+    , m_indexAllocator(indexCapacity)
+    , m_bytesMoved(0)
+{
+    Mesh storage = createMesh(NULL, vertexCapacity * stride, stride, attributes, attributeCount,
+        NULL, (GLsizei)indexCapacity, indexType);
+    m_vao = storage.vao;
+    m_vertexBuffer = storage.vertexBuffer;
+    m_indexBuffer = storage.indexBuffer;
+    glGenBuffers(1, &m_scratchBuffer);
+}
+
+MeshPool::~MeshPool()
+{
+    glDeleteBuffers(1, &m_scratchBuffer);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteBuffers(1, &m_vertexBuffer);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+MeshHandle MeshPool::add(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount)
+{
+    RangeAllocator::Allocation vertexRange = m_vertexAllocator.allocate(vertexCount);
+    if (vertexRange == RangeAllocator::kInvalid)
+        return kInvalidMesh;
+    RangeAllocator::Allocation indexRange = m_indexAllocator.allocate(indexCount);
+    if (indexRange == RangeAllocator::kInvalid)
+    {
+        m_vertexAllocator.free(vertexRange);
+        return kInvalidMesh;
+    }
+
+    const size_t indexBytes = indexSize(m_indexType);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_vertexAllocator.offset(vertexRange) * m_stride, vertexCount * m_stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_indexAllocator.offset(indexRange) * indexBytes, indexCount * indexBytes, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Entry entry = { vertexRange, indexRange };
+    if (!m_freeHandles.empty())
+    {
+        MeshHandle handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_entries[handle] = entry;
+        return handle;
+    }
+    m_entries.push_back(entry);
+    return (MeshHandle)(m_entries.size() - 1);
+}
+
+void MeshPool::remove(MeshHandle handle)
+{
+    if (handle == kInvalidMesh)
+        return;
+
+    Entry& entry = m_entries[handle];
+    m_vertexAllocator.free(entry.vertices);
+    m_indexAllocator.free(entry.indices);
+    entry.vertices = RangeAllocator::kInvalid;
+    entry.indices = RangeAllocator::kInvalid;
+    m_freeHandles.push_back(handle);
+}
+
+PooledMesh MeshPool::mesh(MeshHandle handle) const
+{
+    const Entry& entry = m_entries[handle];
+    PooledMesh mesh;
+    mesh.indexCount = (GLsizei)m_indexAllocator.size(entry.indices);
+    mesh.firstIndex = m_indexAllocator.offset(entry.indices);
+    mesh.baseVertex = (GLint)m_vertexAllocator.offset(entry.vertices);
+    return mesh;
+}
+
+size_t MeshPool::defragment(size_t byteBudget)
+{
+    size_t moved = 0;
+    while (moved < byteBudget)
+    {
+        RangeAllocator::Allocation vertexRange = m_vertexAllocator.movable();
+        RangeAllocator::Allocation indexRange = m_indexAllocator.movable();
+        if (vertexRange == RangeAllocator::kInvalid && indexRange == RangeAllocator::kInvalid)
+            break;
+
+        if (vertexRange != RangeAllocator::kInvalid)
+            moved += relocate(m_vertexBuffer, m_vertexAllocator, vertexRange, m_stride);
+        if (indexRange != RangeAllocator::kInvalid)
+            moved += relocate(m_indexBuffer, m_indexAllocator, indexRange, indexSize(m_indexType));
+    }
+
+    m_bytesMoved += moved;
+    return moved;
+}
+
+size_t MeshPool::relocate(GLuint buffer, RangeAllocator& allocator, RangeAllocator::Allocation allocation, size_t unitSize)
+{
+    const size_t source = allocator.slideDown(allocation) * unitSize;
+    const size_t destination = allocator.offset(allocation) * unitSize;
+    const size_t bytes = allocator.size(allocation) * unitSize;
+
+    if (destination + bytes <= source)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, destination, bytes);
+    }
+    else
+    {
+        /* Overlapping copies within one buffer are undefined; bounce through scratch. */
+        if (bytes > m_scratchSize)
+        {
+            m_scratchSize = bytes;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_scratchBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, m_scratchSize, NULL, GL_STREAM_COPY);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_scratchBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, 0, bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_scratchBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destination, bytes);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return bytes;
+}
+
+MeshPool::Stats MeshPool::stats() const
+{
+    Stats stats;
+    stats.vertices = m_vertexAllocator.stats();
+    stats.indices = m_indexAllocator.stats();
+    stats.bytesMoved = m_bytesMoved;
+    return stats;
+}
+
+MultiDrawBatch::MultiDrawBatch(const MeshPool& pool)
+    : m_pool(pool)
+{
+}
+
+void MultiDrawBatch::add(MeshHandle handle)
+{
+    PooledMesh mesh = m_pool.mesh(handle);
+    m_counts.push_back(mesh.indexCount);
+    m_offsets.push_back((const void*)(mesh.firstIndex * indexSize(m_pool.indexType())));
+    m_baseVertices.push_back(mesh.baseVertex);
+}
+
+void MultiDrawBatch::clear()
+{
+    m_counts.clear();
+    m_offsets.clear();
+    m_baseVertices.clear();
+}
+
+void MultiDrawBatch::submit() const
+{
+    if (m_counts.empty())
+        return;
+
+    glBindVertexArray(m_pool.vao());
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_counts.data(), m_pool.indexType(),
+        m_offsets.data(), (GLsizei)m_counts.size(), m_baseVertices.data());
+    glBindVertexArray(0);
+}
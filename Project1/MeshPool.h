@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+#include "RangeAllocator.h"
+
+/* Stable reference to a mesh inside a MeshPool. */
+typedef uint32_t MeshHandle;
+static const MeshHandle kInvalidMesh = 0xffffffffu;
+
+/* Current location of a pooled mesh, as consumed by the base vertex draws.
+   It changes when the pool compacts, so query it per frame. */
+struct PooledMesh
+{
+    GLsizei indexCount;
+    size_t firstIndex;
+    GLint baseVertex;
+};
+
+/* Static meshes that share one vertex format, suballocated from a single
+   vertex buffer and a single index buffer behind one VAO. Indices stay local
+   to their mesh and are rebased with the base vertex at draw time, so 16-bit
+   indices can be used for any pool size.
+
+   Vertex and index ranges come from TLSF allocators. Removing meshes leaves
+   holes; defragment() closes them a few moves per call by sliding meshes down
+   with glCopyBufferSubData. The copies are ordered with the draws on the GPU,
+   so nothing waits, and handles stay valid across moves. */
+class MeshPool
+{
+public:
+    struct Stats
+    {
+        RangeAllocator::Stats vertices;
+        RangeAllocator::Stats indices;
+        size_t bytesMoved; /* by defragment(), total */
+    };
+
+    MeshPool(GLsizei stride, const VertexAttribute* attributes, int attributeCount,
+        size_t vertexCapacity, size_t indexCapacity, GLenum indexType);
+    ~MeshPool();
+
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    /* Copies a mesh into the pool. Returns kInvalidMesh when it does not fit. */
+    MeshHandle add(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount);
+    void remove(MeshHandle handle);
+
+    PooledMesh mesh(MeshHandle handle) const;
+
+    /* Moves meshes towards the start of the buffers until about byteBudget
+       bytes have been copied or both buffers are compact. Returns the bytes
+       copied. Call once per frame. */
+    size_t defragment(size_t byteBudget);
+
+    GLuint vao() const { return m_vao; }
+    GLenum indexType() const { return m_indexType; }
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        RangeAllocator::Allocation vertices;
+        RangeAllocator::Allocation indices;
+    };
+
+    size_t relocate(GLuint buffer, RangeAllocator& allocator, RangeAllocator::Allocation allocation, size_t unitSize);
+
+    GLuint m_vao;
+    GLuint m_vertexBuffer;
+    GLuint m_indexBuffer;
+    GLuint m_scratchBuffer;
+    size_t m_scratchSize;
+    GLsizei m_stride;
+    GLenum m_indexType;
+
+    RangeAllocator m_vertexAllocator;
+    RangeAllocator m_indexAllocator;
+    std::vector<Entry> m_entries;
+    std::vector<MeshHandle> m_freeHandles;
+    size_t m_bytesMoved;
+};
+
+/* A list of pooled meshes drawn with the same state, submitted with one
+   glMultiDrawElementsBaseVertex call. */
+class MultiDrawBatch
+{
+public:
+    explicit MultiDrawBatch(const MeshPool& pool);
+
+    void add(MeshHandle handle);
+    void clear();
+
+    /* Binds the pool's VAO and draws everything added since clear(). The
+       program and uniform state must already be set. */
+    void submit() const;
+
+    size_t size() const { return m_counts.size(); }
+
+private:
+    const MeshPool& m_pool;
+    std::vector<GLsizei> m_counts;
+    std::vector<const void*> m_offsets;
+    std::vector<GLint> m_baseVertices;
+};
@@ -0,0 +1,367 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    /* Rows per parallelFor index; small levels stay on the calling thread. */
+    const int kRowsPerBand = 16;
+
+    /* Taps of the Kaiser filter, at source offsets -2.5 .. 2.5 from the centre
+       of the destination texel. */
+    const int kKaiserTaps = 6;
+
+    const int kEncodeTableSize = 8192;
+
+    struct Tables
+    {
+        float srgbToLinear[256];
+        uint8_t linearToSrgb[kEncodeTableSize + 1];
+        float kaiser[kKaiserTaps];
+
+        Tables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const double c = i / 255.0;
+                srgbToLinear[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            for (int i = 0; i <= kEncodeTableSize; ++i)
+            {
+                const double linear = (double)i / kEncodeTableSize;
+                const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                linearToSrgb[i] = (uint8_t)(c * 255.0 + 0.5);
+            }
+
+            /* sinc at half the source rate, windowed by a Kaiser window
+               (alpha 4) reaching three source texels either side. */
+            const double kPi = 3.14159265358979323846;
+            const double alpha = 4.0;
+            auto besselI0 = [](double x)
+            {
+                double sum = 1.0, term = 1.0;
+                for (int k = 1; k < 32; ++k)
+                {
+                    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                    sum += term;
+                }
+                return sum;
+            };
+            double total = 0.0;
+            double weights[kKaiserTaps];
+            for (int k = 0; k < kKaiserTaps; ++k)
+            {
+                const double d = k - 2.5;
+                const double x = d / 2.0;
+                const double sinc = std::sin(kPi * x) / (kPi * x);
+                const double r = d / 3.0;
+                const double window = besselI0(alpha * std::sqrt(1.0 - r * r)) / besselI0(alpha);
+                weights[k] = sinc * window;
+                total += weights[k];
+            }
+            for (int k = 0; k < kKaiserTaps; ++k)
+                kaiser[k] = (float)(weights[k] / total);
+        }
+    };
+
+    const Tables& tables()
+    {
+        static const Tables instance;
+        return instance;
+    }
+
+    /* Float RGBA, linear and premultiplied. */
+    struct Plane
+    {
+        int width;
+        int height;
+        std::vector<float> texels;
+
+        float* row(int y) { return texels.data() + (size_t)y * width * 4; }
+        const float* row(int y) const { return texels.data() + (size_t)y * width * 4; }
+    };
+
+    void forBands(ThreadPool& pool, int rows, const std::function<void(int, int)>& body)
+    {
+        const int bands = (rows + kRowsPerBand - 1) / kRowsPerBand;
+        if (bands <= 1)
+        {
+            body(0, rows);
+            return;
+        }
+        pool.parallelFor((size_t)bands, [&](size_t band)
+        {
+            const int first = (int)band * kRowsPerBand;
+            body(first, std::min(rows, first + kRowsPerBand));
+        });
+    }
+
+    void decodeRow(const uint8_t* src, int width, const MipOptions& options, float* dst)
+    {
+        const Tables& t = tables();
+        for (int x = 0; x < width; ++x)
+        {
+            const float alpha = src[x * 4 + 3] * (1.0f / 255.0f);
+            for (int c = 0; c < 3; ++c)
+            {
+                float value = options.srgb ? t.srgbToLinear[src[x * 4 + c]] : src[x * 4 + c] * (1.0f / 255.0f);
+                if (!options.premultiplied)
+                    value *= alpha;
+                dst[x * 4 + c] = value;
+            }
+            dst[x * 4 + 3] = alpha;
+        }
+    }
+
+    inline uint8_t encodeLinear(float value)
+    {
+        value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+        return (uint8_t)(value * 255.0f + 0.5f);
+    }
+
+    void encodeRow(const float* src, int width, const MipOptions& options, uint8_t* dst)
+    {
+        const Tables& t = tables();
+        for (int x = 0; x < width; ++x)
+        {
+            const float alpha = std::min(std::max(src[x * 4 + 3], 0.0f), 1.0f);
+            const float scale = options.premultiplied ? 1.0f : alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            for (int c = 0; c < 3; ++c)
+            {
+                const float value = src[x * 4 + c] * scale;
+                if (options.srgb)
+                {
+                    const float clamped = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+                    dst[x * 4 + c] = t.linearToSrgb[(int)(clamped * kEncodeTableSize + 0.5f)];
+                }
+                else
+                    dst[x * 4 + c] = encodeLinear(value);
+            }
+            dst[x * 4 + 3] = encodeLinear(alpha);
+        }
+    }
+
+    /* 2x2 average of rows y0 and y1 (equal when the source is one row high). */
+    void boxRow(const float* row0, const float* row1, int srcWidth, int dstWidth, float* dst)
+    {
+        int x = 0;
+#ifdef SIMD_AVX2
+        const __m256 quarter8 = _mm256_set1_ps(0.25f);
+        for (; 2 * x + 3 < srcWidth && x + 2 <= dstWidth; x += 2)
+        {
+            /* Source texels 2x .. 2x+3 of both rows; pair them up per output. */
+            const __m256 a0 = _mm256_loadu_ps(row0 + x * 8);
+            const __m256 b0 = _mm256_loadu_ps(row0 + x * 8 + 8);
+            const __m256 a1 = _mm256_loadu_ps(row1 + x * 8);
+            const __m256 b1 = _mm256_loadu_ps(row1 + x * 8 + 8);
+            const __m256 even = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20), _mm256_permute2f128_ps(a1, b1, 0x20));
+            const __m256 odd = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x31), _mm256_permute2f128_ps(a1, b1, 0x31));
+            _mm256_storeu_ps(dst + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter8));
+        }
+#endif
+        for (; x < dstWidth; ++x)
+        {
+            const int x0 = std::min(2 * x, srcWidth - 1);
+            const int x1 = std::min(2 * x + 1, srcWidth - 1);
+#ifdef SIMD_SSE2
+            const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0 * 4), _mm_loadu_ps(row0 + x1 * 4)),
+                _mm_add_ps(_mm_loadu_ps(row1 + x0 * 4), _mm_loadu_ps(row1 + x1 * 4)));
+            _mm_storeu_ps(dst + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+            for (int c = 0; c < 4; ++c)
+                dst[x * 4 + c] = 0.25f * (row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c]);
+#endif
+        }
+    }
+
+    /* One output texel of the horizontal Kaiser pass, edges clamped. */
+    inline void kaiserTexel(const float* src, int srcWidth, int x, float* dst)
+    {
+        const float* weights = tables().kaiser;
+#ifdef SIMD_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < kKaiserTaps; ++k)
+        {
+            const int sx = std::min(std::max(2 * x - 2 + k, 0), srcWidth - 1);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + sx * 4), _mm_set1_ps(weights[k])));
+        }
+        _mm_storeu_ps(dst + x * 4, sum);
+#else
+        float sum[4] = {};
+        for (int k = 0; k < kKaiserTaps; ++k)
+        {
+            const int sx = std::min(std::max(2 * x - 2 + k, 0), srcWidth - 1);
+            for (int c = 0; c < 4; ++c)
+                sum[c] += src[sx * 4 + c] * weights[k];
+        }
+        for (int c = 0; c < 4; ++c)
+            dst[x * 4 + c] = sum[c];
+#endif
+    }
+
+    /* Horizontal Kaiser pass: srcWidth texels to dstWidth. */
+    void kaiserRow(const float* src, int srcWidth, int dstWidth, float* dst)
+    {
+        int x = 0;
+#ifdef SIMD_AVX2
+        /* The first output reaches past the left edge. */
+        if (x < dstWidth)
+            kaiserTexel(src, srcWidth, x++, dst);
+
+        /* Two outputs per iteration while every tap is inside the row; their
+           taps are two texels apart, so each tap loads both into the halves of
+           one register. */
+        const float* weights = tables().kaiser;
+        for (; x + 2 <= dstWidth && 2 * x + 6 <= srcWidth; x += 2)
+        {
+            const float* first = src + (2 * x - 2) * 4;
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < kKaiserTaps; ++k)
+            {
+                const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(first + k * 4)),
+                    _mm_loadu_ps(first + (k + 2) * 4), 1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(texels, _mm256_set1_ps(weights[k])));
+            }
+            _mm256_storeu_ps(dst + x * 4, sum);
+        }
+#endif
+        for (; x < dstWidth; ++x)
+            kaiserTexel(src, srcWidth, x, dst);
+    }
+
+    /* Vertical Kaiser pass for one output row: a weighted sum of six rows. */
+    void kaiserColumn(const float* const* rows, size_t count, float* dst)
+    {
+        const float* weights = tables().kaiser;
+        size_t i = 0;
+#ifdef SIMD_AVX2
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < kKaiserTaps; ++k)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+            _mm256_storeu_ps(dst + i, sum);
+        }
+#endif
+#ifdef SIMD_SSE2
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < kKaiserTaps; ++k)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+            _mm_storeu_ps(dst + i, sum);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < kKaiserTaps; ++k)
+                sum += rows[k][i] * weights[k];
+            dst[i] = sum;
+        }
+    }
+
+    void downsample(const Plane& src, MipFilter filter, ThreadPool& pool, Plane& dst)
+    {
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.texels.resize((size_t)dst.width * dst.height * 4);
+
+        if (filter == kMipBox)
+        {
+            forBands(pool, dst.height, [&](int first, int last)
+            {
+                for (int y = first; y < last; ++y)
+                {
+                    const int y0 = std::min(2 * y, src.height - 1);
+                    const int y1 = std::min(2 * y + 1, src.height - 1);
+                    boxRow(src.row(y0), src.row(y1), src.width, dst.width, dst.row(y));
+                }
+            });
+            return;
+        }
+
+        /* Kaiser, separably: halve the width into a temporary plane, then the
+           height. A dimension that is already 1 passes through unfiltered. */
+        Plane half;
+        half.width = dst.width;
+        half.height = src.height;
+        half.texels.resize((size_t)half.width * half.height * 4);
+        forBands(pool, src.height, [&](int first, int last)
+        {
+            for (int y = first; y < last; ++y)
+            {
+                if (src.width == 1)
+                    std::copy(src.row(y), src.row(y) + 4, half.row(y));
+                else
+                    kaiserRow(src.row(y), src.width, half.width, half.row(y));
+            }
+        });
+
+        forBands(pool, dst.height, [&](int first, int last)
+        {
+            for (int y = first; y < last; ++y)
+            {
+                if (half.height == 1)
+                {
+                    std::copy(half.row(0), half.row(0) + (size_t)half.width * 4, dst.row(y));
+                    continue;
+                }
+                const float* rows[kKaiserTaps];
+                for (int k = 0; k < kKaiserTaps; ++k)
+                    rows[k] = half.row(std::min(std::max(2 * y - 2 + k, 0), half.height - 1));
+                kaiserColumn(rows, (size_t)dst.width * 4, dst.row(y));
+            }
+        });
+    }
+}
+
+int mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++levels;
+    }
+    return levels;
+}
+
+void generateMips(const Image& base, const MipOptions& options, ThreadPool& pool, std::vector<Image>& levels)
+{
+    levels.clear();
+    if (base.width <= 0 || base.height <= 0 || (base.width == 1 && base.height == 1))
+        return;
+
+    Plane current;
+    current.width = base.width;
+    current.height = base.height;
+    current.texels.resize((size_t)base.width * base.height * 4);
+    forBands(pool, base.height, [&](int first, int last)
+    {
+        for (int y = first; y < last; ++y)
+            decodeRow(base.pixels.data() + (size_t)y * base.width * 4, base.width, options, current.row(y));
+    });
+
+    levels.resize(mipLevelCount(base.width, base.height) - 1);
+    Plane next;
+    for (Image& level : levels)
+    {
+        downsample(current, options.filter, pool, next);
+        std::swap(current, next);
+
+        level.width = current.width;
+        level.height = current.height;
+        level.pixels.resize((size_t)level.width * level.height * 4);
+        forBands(pool, level.height, [&](int first, int last)
+        {
+            for (int y = first; y < last; ++y)
+                encodeRow(current.row(y), current.width, options, level.pixels.data() + (size_t)y * level.width * 4);
+        });
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "Image.h"
+
+class ThreadPool;
+
+enum MipFilter
+{
+    kMipBox,     /* 2x2 average: cheapest, slightly blurry */
+    kMipKaiser,  /* 6-tap Kaiser-windowed sinc: sharper, may ring a little */
+};
+
+struct MipOptions
+{
+    MipFilter filter;
+
+    /* Colour channels are sRGB encoded; filtering happens in linear light. */
+    bool srgb;
+
+    /* Colour is already multiplied by alpha. Otherwise it is weighted by alpha
+       while filtering, so transparent texels do not bleed into their
+       neighbours, and divided back out afterwards. */
+    bool premultiplied;
+};
+
+/* Number of levels in a full chain for the given size, including level 0. */
+int mipLevelCount(int width, int height);
+
+/* Builds every level below base, halving down to 1x1; levels[0] is the
+   half-size level. Each level is computed from the previous one at float
+   precision, never from a rounded 8-bit copy. Rows within a level are split
+   across the pool, with SSE and, where the build allows, AVX kernels for the
+   filtering. */
+void generateMips(const Image& base, const MipOptions& options, ThreadPool& pool, std::vector<Image>& levels);
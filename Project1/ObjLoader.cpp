@@ -0,0 +1,550 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    const size_t kChunkSize = 1 << 20;
+
+    /* A face corner. Indices are zero-based; negative OBJ indices are kept
+       relative to the start of their chunk until the chunk's base is known,
+       which the relative bits record. */
+    struct Corner
+    {
+        int32_t position;
+        int32_t texcoord;   /* kMissing when absent */
+        int32_t normal;
+        uint32_t relative;  /* bit 0 position, 1 texcoord, 2 normal */
+    };
+
+    const int32_t kMissing = INT32_MIN;
+
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<float> normals;
+        std::vector<Corner> corners;    /* three per triangle */
+        size_t lines;
+        size_t errorLine;               /* within the chunk, when log is set */
+        std::string log;
+    };
+
+    uint32_t lowestBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (uint32_t)index;
+#else
+        return (uint32_t)__builtin_ctz(value);
+#endif
+    }
+
+    const char* findNewline(const char* p, const char* end)
+    {
+#ifdef SIMD_SSE2
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; end - p >= 16; p += 16)
+        {
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), newline));
+            if (mask)
+                return p + lowestBit((uint32_t)mask);
+        }
+#endif
+        while (p < end && *p != '\n')
+            ++p;
+        return p;
+    }
+
+    const char* skipSpaces(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /* SWAR digit runs, as in fast_float: test and convert 8 or 4 ASCII
+       digits at once inside a general-purpose register. */
+    bool eightDigits(const char* p, uint64_t& value)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        if (((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+            != 0x3333333333333333ull)
+            return false;
+        v -= 0x3030303030303030ull;
+        v = v * 10 + (v >> 8);
+        value = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+            + (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+        return true;
+    }
+
+    bool fourDigits(const char* p, uint32_t& value)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        if (((v & 0xF0F0F0F0u) | (((v + 0x06060606u) & 0xF0F0F0F0u) >> 4)) != 0x33333333u)
+            return false;
+        v -= 0x30303030u;
+        v = v * 10 + (v >> 8);
+        value = (((v & 0x00FF00FFu) * (1 + (100u << 16))) >> 16) & 0xFFFFu;
+        return true;
+    }
+
+    /* Accumulates up to 19 significant digits; later ones only move the
+       decimal exponent (integer part) or are dropped (fraction). */
+    const char* readDigits(const char* p, const char* end, uint64_t& mantissa, int& digits, int& exponent, bool fraction)
+    {
+        if (mantissa == 0)
+        {
+            while (p < end && *p == '0')
+            {
+                ++p;
+                exponent -= fraction ? 1 : 0;
+            }
+        }
+        uint64_t eight;
+        uint32_t four;
+        while (end - p >= 8 && digits + 8 <= 19 && eightDigits(p, eight))
+        {
+            mantissa = mantissa * 100000000 + eight;
+            digits += 8;
+            exponent -= fraction ? 8 : 0;
+            p += 8;
+        }
+        if (end - p >= 4 && digits + 4 <= 19 && fourDigits(p, four))
+        {
+            mantissa = mantissa * 10000 + four;
+            digits += 4;
+            exponent -= fraction ? 4 : 0;
+            p += 4;
+        }
+        for (; p < end && isDigit(*p); ++p)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits++;
+                exponent -= fraction ? 1 : 0;
+            }
+            else if (!fraction)
+                exponent++;
+        }
+        return p;
+    }
+
+    bool parseFloat(const char*& cursor, const char* end, float& value)
+    {
+        static const double kPowers[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        const char* p = cursor;
+        const bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            ++p;
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        const char* start = p;
+        p = readDigits(p, end, mantissa, digits, exponent, false);
+        bool any = p != start;
+        if (p < end && *p == '.')
+        {
+            start = ++p;
+            p = readDigits(p, end, mantissa, digits, exponent, true);
+            any = any || p != start;
+        }
+        if (!any)
+            return false;
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* q = p + 1;
+            const bool negativeExponent = q < end && *q == '-';
+            if (q < end && (*q == '-' || *q == '+'))
+                ++q;
+            if (q < end && isDigit(*q))
+            {
+                int written = 0;
+                for (; q < end && isDigit(*q); ++q)
+                    written = std::min(written * 10 + (*q - '0'), 10000);
+                exponent += negativeExponent ? -written : written;
+                p = q;
+            }
+        }
+
+        /* Exact for the usual short mantissas; beyond 10^22 the extra
+           rounding is far below float precision. */
+        double result = (double)mantissa;
+        if (mantissa != 0)
+        {
+            for (; exponent > 22; exponent -= 22)
+                result *= kPowers[22];
+            for (; exponent < -22; exponent += 22)
+                result /= kPowers[22];
+            result = exponent < 0 ? result / kPowers[-exponent] : result * kPowers[exponent];
+        }
+        value = (float)(negative ? -result : result);
+        cursor = p;
+        return true;
+    }
+
+    bool parseIndex(const char*& cursor, const char* end, int32_t& value)
+    {
+        const char* p = cursor;
+        const bool negative = p < end && *p == '-';
+        if (negative)
+            ++p;
+        if (p == end || !isDigit(*p))
+            return false;
+        int64_t result = 0;
+        for (; p < end && isDigit(*p); ++p)
+        {
+            result = result * 10 + (*p - '0');
+            if (result > INT32_MAX)
+                return false;
+        }
+        value = (int32_t)(negative ? -result : result);
+        cursor = p;
+        return true;
+    }
+
+    /* Turns a one-based or negative OBJ index into a zero-based one, local to
+       the chunk when relative. */
+    bool resolveIndex(int32_t index, size_t localCount, int32_t& resolved, uint32_t& relative, uint32_t bit)
+    {
+        if (index > 0)
+        {
+            resolved = index - 1;
+            return true;
+        }
+        if (index < 0)
+        {
+            resolved = (int32_t)((int64_t)localCount + index);
+            relative |= bit;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseCorner(const char*& p, const char* end, const Chunk& chunk, Corner& corner)
+    {
+        int32_t index;
+        corner.texcoord = kMissing;
+        corner.normal = kMissing;
+        corner.relative = 0;
+        if (!parseIndex(p, end, index) || !resolveIndex(index, chunk.positions.size() / 3, corner.position, corner.relative, 1))
+            return false;
+        if (p < end && *p == '/')
+        {
+            ++p;
+            if (p < end && *p != '/'
+                && (!parseIndex(p, end, index) || !resolveIndex(index, chunk.texcoords.size() / 2, corner.texcoord, corner.relative, 2)))
+                return false;
+            if (p < end && *p == '/')
+            {
+                ++p;
+                if (!parseIndex(p, end, index) || !resolveIndex(index, chunk.normals.size() / 3, corner.normal, corner.relative, 4))
+                    return false;
+            }
+        }
+        return p == end || *p == ' ' || *p == '\t' || *p == '\r';
+    }
+
+    /* Reads count floats; the first required ones must be present, the rest
+       default to zero. */
+    bool parseFloats(const char* p, const char* end, int count, int required, std::vector<float>& out)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            p = skipSpaces(p, end);
+            float value = 0.0f;
+            if (!parseFloat(p, end, value) && i < required)
+                return false;
+            out.push_back(value);
+        }
+        return true;
+    }
+
+    void parseChunk(Chunk& chunk)
+    {
+        std::vector<Corner> polygon;
+        chunk.lines = 0;
+        const char* p = chunk.begin;
+        while (p < chunk.end)
+        {
+            const char* lineEnd = findNewline(p, chunk.end);
+            const char* line = skipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+            chunk.lines++;
+            if (lineEnd - line < 2 || (line[1] != ' ' && line[1] != '\t' && line[0] != 'v'))
+                continue;
+
+            bool ok = true;
+            if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+                ok = parseFloats(line + 2, lineEnd, 3, 3, chunk.positions);
+            else if (line[0] == 'v' && line[1] == 't' && lineEnd - line > 2 && (line[2] == ' ' || line[2] == '\t'))
+                ok = parseFloats(line + 3, lineEnd, 2, 1, chunk.texcoords);
+            else if (line[0] == 'v' && line[1] == 'n' && lineEnd - line > 2 && (line[2] == ' ' || line[2] == '\t'))
+                ok = parseFloats(line + 3, lineEnd, 3, 3, chunk.normals);
+            else if (line[0] == 'f')
+            {
+                polygon.clear();
+                const char* q = skipSpaces(line + 2, lineEnd);
+                while (ok && q < lineEnd && *q != '\r')
+                {
+                    Corner corner;
+                    ok = parseCorner(q, lineEnd, chunk, corner);
+                    polygon.push_back(corner);
+                    q = skipSpaces(q, lineEnd);
+                }
+                ok = ok && polygon.size() >= 3;
+                for (size_t i = 2; ok && i < polygon.size(); ++i)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+            if (!ok)
+            {
+                chunk.log = line[0] == 'f' ? "malformed face" : "malformed vertex";
+                chunk.errorLine = chunk.lines;
+                return;
+            }
+        }
+    }
+
+    uint32_t hashCorner(const Corner& corner)
+    {
+        uint32_t hash = (uint32_t)corner.position * 0x9E3779B1u;
+        hash ^= (uint32_t)corner.texcoord * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+        hash ^= (uint32_t)corner.normal * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+        return hash ^ (hash >> 15);
+    }
+
+    template <typename Body>
+    void forEach(ThreadPool* pool, size_t count, const Body& body)
+    {
+        if (pool && count > 1)
+            pool->parallelFor(count, body);
+        else
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+    }
+}
+
+bool parseObj(const char* text, size_t size, ThreadPool* pool, MeshData& mesh, std::string& log)
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    /* Chunk boundaries go just past a newline, so no line is split. */
+    std::vector<Chunk> chunks;
+    const char* end = text + size;
+    for (const char* p = text; p < end;)
+    {
+        const char* next = size_t(end - p) > kChunkSize ? findNewline(p + kChunkSize, end) : end;
+        next = next < end ? next + 1 : end;
+        chunks.emplace_back();
+        chunks.back().begin = p;
+        chunks.back().end = next;
+        p = next;
+    }
+    forEach(pool, chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+    size_t line = 0;
+    for (const Chunk& chunk : chunks)
+    {
+        if (!chunk.log.empty())
+        {
+            log = "line " + std::to_string(line + chunk.errorLine) + ": " + chunk.log;
+            return false;
+        }
+        line += chunk.lines;
+    }
+
+    /* Gather the attribute arrays and make every index absolute. */
+    std::vector<size_t> positionBase(chunks.size() + 1, 0);
+    std::vector<size_t> texcoordBase(chunks.size() + 1, 0);
+    std::vector<size_t> normalBase(chunks.size() + 1, 0);
+    std::vector<size_t> cornerBase(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size() / 3;
+        texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texcoords.size() / 2;
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size() / 3;
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size();
+    }
+    const size_t positionCount = positionBase.back();
+    const size_t texcoordCount = texcoordBase.back();
+    const size_t normalCount = normalBase.back();
+    const size_t cornerCount = cornerBase.back();
+    if (cornerCount == 0)
+    {
+        log = "no faces";
+        return false;
+    }
+    if (cornerCount > UINT32_MAX / 2 || positionCount > INT32_MAX)
+    {
+        log = "too many faces";
+        return false;
+    }
+
+    std::vector<float> positions(positionCount * 3);
+    std::vector<float> texcoords(texcoordCount * 2);
+    std::vector<float> normals(normalCount * 3);
+    std::vector<Corner> corners(cornerCount);
+    std::vector<char> inRange(chunks.size(), 1);
+    forEach(pool, chunks.size(), [&](size_t i)
+    {
+        Chunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] * 3);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + texcoordBase[i] * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] * 3);
+        for (size_t c = 0; c < chunk.corners.size(); ++c)
+        {
+            Corner corner = chunk.corners[c];
+            int64_t position = corner.position + (corner.relative & 1 ? (int64_t)positionBase[i] : 0);
+            int64_t texcoord = corner.texcoord == kMissing ? -1 : corner.texcoord + (corner.relative & 2 ? (int64_t)texcoordBase[i] : 0);
+            int64_t normal = corner.normal == kMissing ? -1 : corner.normal + (corner.relative & 4 ? (int64_t)normalBase[i] : 0);
+            if (position < 0 || position >= (int64_t)positionCount
+                || (corner.texcoord != kMissing && (texcoord < 0 || texcoord >= (int64_t)texcoordCount))
+                || (corner.normal != kMissing && (normal < 0 || normal >= (int64_t)normalCount)))
+            {
+                inRange[i] = 0;
+                return;
+            }
+            corners[cornerBase[i] + c] = { (int32_t)position, (int32_t)texcoord, (int32_t)normal, 0 };
+        }
+        std::vector<Corner>().swap(chunk.corners);
+    });
+    if (std::find(inRange.begin(), inRange.end(), 0) != inRange.end())
+    {
+        log = "face index out of range";
+        return false;
+    }
+
+    /* Deduplicate corners: linear probing over a power-of-two table at most
+       half full, storing vertex numbers; the keys live in unique. */
+    size_t tableSize = 1;
+    while (tableSize < cornerCount * 2)
+        tableSize <<= 1;
+    std::vector<uint32_t> table(tableSize, UINT32_MAX);
+    std::vector<Corner> unique;
+    unique.reserve(cornerCount / 4);
+    mesh.indices.resize(cornerCount);
+    const size_t mask = tableSize - 1;
+    for (size_t c = 0; c < cornerCount; ++c)
+    {
+        const Corner& corner = corners[c];
+        size_t slot = hashCorner(corner) & mask;
+        for (;;)
+        {
+            const uint32_t vertex = table[slot];
+            if (vertex == UINT32_MAX)
+            {
+                table[slot] = (uint32_t)unique.size();
+                mesh.indices[c] = (uint32_t)unique.size();
+                unique.push_back(corner);
+                break;
+            }
+            const Corner& existing = unique[vertex];
+            if (existing.position == corner.position && existing.texcoord == corner.texcoord && existing.normal == corner.normal)
+            {
+                mesh.indices[c] = vertex;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    std::vector<uint32_t>().swap(table);
+
+    /* Smooth normals for corners without one, summed per position so that
+       texture seams do not crease the shading. Cross products are already
+       weighted by triangle area. */
+    std::vector<float> smooth;
+    if (std::any_of(unique.begin(), unique.end(), [](const Corner& corner) { return corner.normal < 0; }))
+    {
+        smooth.assign(positionCount * 3, 0.0f);
+        for (size_t c = 0; c < cornerCount; c += 3)
+        {
+            const float* a = &positions[(size_t)corners[c].position * 3];
+            const float* b = &positions[(size_t)corners[c + 1].position * 3];
+            const float* d = &positions[(size_t)corners[c + 2].position * 3];
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (int k = 0; k < 3; ++k)
+            {
+                float* target = &smooth[(size_t)corners[c + k].position * 3];
+                target[0] += n[0];
+                target[1] += n[1];
+                target[2] += n[2];
+            }
+        }
+    }
+
+    mesh.vertices.resize(unique.size() * kMeshVertexFloats);
+    const size_t vertexBand = 65536;
+    forEach(pool, (unique.size() + vertexBand - 1) / vertexBand, [&](size_t band)
+    {
+        const size_t last = std::min(unique.size(), (band + 1) * vertexBand);
+        for (size_t v = band * vertexBand; v < last; ++v)
+        {
+            const Corner& corner = unique[v];
+            float* out = &mesh.vertices[v * kMeshVertexFloats];
+            memcpy(out, &positions[(size_t)corner.position * 3], 3 * sizeof(float));
+            out[3] = corner.texcoord >= 0 ? texcoords[(size_t)corner.texcoord * 2] : 0.0f;
+            out[4] = corner.texcoord >= 0 ? texcoords[(size_t)corner.texcoord * 2 + 1] : 0.0f;
+            if (corner.normal >= 0)
+                memcpy(out + 5, &normals[(size_t)corner.normal * 3], 3 * sizeof(float));
+            else
+            {
+                const float* n = &smooth[(size_t)corner.position * 3];
+                const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+                out[5] = n[0] * scale;
+                out[6] = n[1] * scale;
+                out[7] = n[2] * scale;
+            }
+        }
+    });
+    return true;
+}
+
+bool loadObj(const std::string& path, ThreadPool* pool, MeshData& mesh, std::string& log)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        log = path + ": cannot open";
+        return false;
+    }
+    if (!parseObj((const char*)file.data(), file.size(), pool, mesh, log))
+    {
+        log = path + ": " + log;
+        return false;
+    }
+    return true;
+}
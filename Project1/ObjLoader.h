@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "Mesh.h"
+
+class ThreadPool;
+
+/* Wavefront OBJ import.
+
+   The file is memory mapped and cut at line boundaries into chunks of about
+   1 MiB, which are parsed in parallel: lines are found with SSE2, and numbers
+   are read eight or four digits at a time with plain integer arithmetic
+   rather than strtod. Corners are then resolved and deduplicated through an
+   open-addressing hash on their (position, texcoord, normal) indices, so each
+   distinct corner becomes one vertex of the interleaved MeshData.
+
+   Understood: v, vt, vn, and f in the v, v/vt, v//vn and v/vt/vn forms, with
+   negative (relative) indices; polygons are split into fans. Everything else
+   (o, g, s, usemtl, mtllib, l, p) is skipped. Missing texcoords are zero and
+   missing normals are replaced by area-weighted smooth normals. */
+
+/* With a NULL pool everything runs on the calling thread. */
+bool parseObj(const char* text, size_t size, ThreadPool* pool, MeshData& mesh, std::string& log);
+
+/* Maps path and parses it; log is prefixed with the path. */
+bool loadObj(const std::string& path, ThreadPool* pool, MeshData& mesh, std::string& log);
@@ -0,0 +1,291 @@
+#include "PixelConvert.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+namespace
+{
+    /* sRGB byte to 12-bit linear, and 12-bit linear back to an sRGB byte.
+       Twelve bits keep the round trip exact for every opaque value. */
+    struct SrgbTables
+    {
+        int32_t toLinear[256];
+        int32_t toSrgb[4096];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const double c = i / 255.0;
+                const double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                toLinear[i] = (int32_t)(linear * 4095.0 + 0.5);
+            }
+            for (int i = 0; i < 4096; ++i)
+            {
+                const double linear = i / 4095.0;
+                const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                toSrgb[i] = (int32_t)(c * 255.0 + 0.5);
+            }
+        }
+    };
+
+    const SrgbTables& srgbTables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    /* x * a / 255, rounded, exact for 8-bit inputs. */
+    inline uint8_t mulDiv255(int x, int a)
+    {
+        const int t = x * a + 128;
+        return (uint8_t)((t + (t >> 8)) >> 8);
+    }
+
+    void expandGray(const uint8_t* src, int width, uint8_t* dst)
+    {
+        int x = 0;
+#ifdef SIMD_SSE2
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i g = _mm_loadu_si128((const __m128i*)(src + x));
+            const __m128i gg0 = _mm_unpacklo_epi8(g, g);
+            const __m128i gg1 = _mm_unpackhi_epi8(g, g);
+            __m128i* out = (__m128i*)(dst + x * 4);
+            _mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(gg0, gg0), alpha));
+            _mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(gg0, gg0), alpha));
+            _mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(gg1, gg1), alpha));
+            _mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(gg1, gg1), alpha));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = src[x];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+
+    void expandGrayAlpha(const uint8_t* src, int width, uint8_t* dst)
+    {
+        int x = 0;
+#ifdef SIMD_SSE2
+        for (; x + 8 <= width; x += 8)
+        {
+            /* Each 16-bit lane holds gray | alpha << 8; duplicate the gray byte. */
+            const __m128i ga = _mm_loadu_si128((const __m128i*)(src + x * 2));
+            const __m128i gray = _mm_and_si128(ga, _mm_set1_epi16(0xff));
+            const __m128i gg = _mm_or_si128(gray, _mm_slli_epi16(gray, 8));
+            __m128i* out = (__m128i*)(dst + x * 4);
+            _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg, ga));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = src[x * 2];
+            dst[x * 4 + 3] = src[x * 2 + 1];
+        }
+    }
+
+    /* Three bytes per pixel to four, optionally swapping red and blue. */
+    void expandRgb(const uint8_t* src, int width, bool swap, uint8_t* dst)
+    {
+        int x = 0;
+#ifdef SIMD_SSSE3
+        const __m128i shuffle = swap
+            ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+            : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+#ifdef SIMD_AVX2
+        /* Two 12-byte groups per 256-bit register; the loads read 4 bytes past
+           the second group, hence the margin. */
+        const __m256i shuffle2 = _mm256_broadcastsi128_si256(shuffle);
+        const __m256i alpha2 = _mm256_set1_epi32((int)0xff000000);
+        for (; x + 10 <= width; x += 8)
+        {
+            const __m128i lo = _mm_loadu_si128((const __m128i*)(src + x * 3));
+            const __m128i hi = _mm_loadu_si128((const __m128i*)(src + x * 3 + 12));
+            const __m256i both = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(both, shuffle2), alpha2));
+        }
+#endif
+        for (; x + 6 <= width; x += 4)
+        {
+            const __m128i rgb = _mm_loadu_si128((const __m128i*)(src + x * 3));
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+#endif
+        const int r = swap ? 2 : 0;
+        const int b = swap ? 0 : 2;
+        for (; x < width; ++x)
+        {
+            dst[x * 4 + 0] = src[x * 3 + r];
+            dst[x * 4 + 1] = src[x * 3 + 1];
+            dst[x * 4 + 2] = src[x * 3 + b];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+
+    void swapRedBlue(const uint8_t* src, int width, uint8_t* dst)
+    {
+        int x = 0;
+#ifdef SIMD_SSE2
+        const __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i bgra = _mm_loadu_si128((const __m128i*)(src + x * 4));
+            const __m128i redBlue = _mm_andnot_si128(greenAlpha, bgra);
+            const __m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(redBlue, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            /* Within each pixel the two 16-bit halves were swapped, which moves
+               B to byte 0 and R to byte 2 -- exactly the exchange wanted. */
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_and_si128(bgra, greenAlpha), swapped));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            dst[x * 4 + 0] = src[x * 4 + 2];
+            dst[x * 4 + 1] = src[x * 4 + 1];
+            dst[x * 4 + 2] = src[x * 4 + 0];
+            dst[x * 4 + 3] = src[x * 4 + 3];
+        }
+    }
+
+    void premultiplyLinear(uint8_t* rgba, int width)
+    {
+        int x = 0;
+#ifdef SIMD_AVX2
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i round = _mm256_set1_epi16(128);
+            const __m256i keepAlpha = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+            for (; x + 8 <= width; x += 8)
+            {
+                const __m256i pixels = _mm256_loadu_si256((const __m256i*)(rgba + x * 4));
+                __m256i halves[2] = { _mm256_unpacklo_epi8(pixels, zero), _mm256_unpackhi_epi8(pixels, zero) };
+                for (__m256i& half : halves)
+                {
+                    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(half, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                    alpha = _mm256_or_si256(alpha, keepAlpha);
+                    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(half, alpha), round);
+                    half = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+                }
+                _mm256_storeu_si256((__m256i*)(rgba + x * 4), _mm256_packus_epi16(halves[0], halves[1]));
+            }
+        }
+#endif
+#ifdef SIMD_SSE2
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(128);
+            const __m128i keepAlpha = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+            for (; x + 4 <= width; x += 4)
+            {
+                const __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + x * 4));
+                __m128i halves[2] = { _mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero) };
+                for (__m128i& half : halves)
+                {
+                    /* Broadcast each pixel's alpha over its four lanes; OR-ing
+                       255 into the alpha lane turns it into a multiply by one. */
+                    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(half, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                    alpha = _mm_or_si128(alpha, keepAlpha);
+                    __m128i t = _mm_add_epi16(_mm_mullo_epi16(half, alpha), round);
+                    half = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+                }
+                _mm_storeu_si128((__m128i*)(rgba + x * 4), _mm_packus_epi16(halves[0], halves[1]));
+            }
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            uint8_t* p = rgba + x * 4;
+            const int a = p[3];
+            p[0] = mulDiv255(p[0], a);
+            p[1] = mulDiv255(p[1], a);
+            p[2] = mulDiv255(p[2], a);
+        }
+    }
+
+    void premultiplySrgb(uint8_t* rgba, int width)
+    {
+        const SrgbTables& tables = srgbTables();
+        int x = 0;
+#ifdef SIMD_AVX2
+        /* Two pixels per iteration: decode through a gather, scale in linear
+           light, re-encode through a second gather. */
+        const __m256i alphaLanes = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+        const __m256i alphaIndex = _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7);
+        for (; x + 2 <= width; x += 2)
+        {
+            uint8_t* p = rgba + x * 4;
+            if (p[3] == 255 && p[7] == 255)
+                continue;
+            const __m256i channels = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+            const __m256i alpha = _mm256_permutevar8x32_epi32(channels, alphaIndex);
+            const __m256i linear = _mm256_i32gather_epi32(tables.toLinear, channels, 4);
+            /* linear * alpha / 255 with rounding, via a 16.16 reciprocal. */
+            const __m256i scaled = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(linear, alpha),
+                _mm256_set1_epi32(257)), _mm256_set1_epi32(32768)), 16);
+            __m256i encoded = _mm256_i32gather_epi32(tables.toSrgb, scaled, 4);
+            encoded = _mm256_blendv_epi8(encoded, channels, alphaLanes);
+            const __m256i packed16 = _mm256_packus_epi32(encoded, encoded);
+            const __m256i packed8 = _mm256_packus_epi16(packed16, packed16);
+            const uint32_t first = (uint32_t)_mm256_extract_epi32(packed8, 0);
+            const uint32_t second = (uint32_t)_mm256_extract_epi32(packed8, 4);
+            memcpy(p, &first, 4);
+            memcpy(p + 4, &second, 4);
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            uint8_t* p = rgba + x * 4;
+            const int a = p[3];
+            if (a == 255)
+                continue;
+            for (int c = 0; c < 3; ++c)
+                p[c] = (uint8_t)tables.toSrgb[(tables.toLinear[p[c]] * a * 257 + 32768) >> 16];
+        }
+    }
+}
+
+void premultiplyRow(uint8_t* rgba, int width, bool srgb)
+{
+    if (srgb)
+        premultiplySrgb(rgba, width);
+    else
+        premultiplyLinear(rgba, width);
+}
+
+void convertRow(PixelFormat format, const uint8_t* src, int width, const ImageOptions& options, uint8_t* dst)
+{
+    bool hasAlpha = true;
+    switch (format)
+    {
+    case kGray8:
+        expandGray(src, width, dst);
+        hasAlpha = false;
+        break;
+    case kGrayAlpha8:
+        expandGrayAlpha(src, width, dst);
+        break;
+    case kRgb8:
+        expandRgb(src, width, false, dst);
+        hasAlpha = false;
+        break;
+    case kRgba8:
+        memcpy(dst, src, (size_t)width * 4);
+        break;
+    case kBgr8:
+        expandRgb(src, width, true, dst);
+        hasAlpha = false;
+        break;
+    case kBgra8:
+        swapRedBlue(src, width, dst);
+        break;
+    }
+
+    if (options.premultiply && hasAlpha)
+        premultiplyRow(dst, width, options.srgb);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+/* Layout of decoded rows handed to convertRow(). */
+enum PixelFormat
+{
+    kGray8,
+    kGrayAlpha8,
+    kRgb8,
+    kRgba8,
+    kBgr8,
+    kBgra8,
+};
+
+/* How decoded pixels are turned into texture data. */
+struct ImageOptions
+{
+    /* Multiply colour by alpha, for blending with GL_ONE, GL_ONE_MINUS_SRC_ALPHA. */
+    bool premultiply;
+
+    /* Colour is sRGB encoded (the texture will be GL_SRGB8_ALPHA8), so
+       premultiplication happens in linear light and is re-encoded. */
+    bool srgb;
+};
+
+/* Converts one row of width pixels to upload-ready RGBA8 in dst. src and dst
+   must not overlap. Uses SSSE3/AVX2 kernels where the build allows. */
+void convertRow(PixelFormat format, const uint8_t* src, int width, const ImageOptions& options, uint8_t* dst);
+
+/* In-place premultiplication of an RGBA8 row, as convertRow() applies it. */
+void premultiplyRow(uint8_t* rgba, int width, bool srgb);
@@ -0,0 +1,363 @@
+#include "ImageLoader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Deflate.h"
+
+namespace
+{
+    inline uint32_t readBigEndian(const uint8_t* p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    inline int paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = abs(p - a);
+        const int pb = abs(p - b);
+        const int pc = abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    /* Reverses the row filter in place; above is the previous unfiltered row
+       of the same pass (all zeros for the first). */
+    bool unfilterRow(int filter, uint8_t* row, const uint8_t* above, size_t size, size_t bpp)
+    {
+        switch (filter)
+        {
+        case 0:
+            return true;
+        case 1:
+            for (size_t i = bpp; i < size; ++i)
+                row[i] = (uint8_t)(row[i] + row[i - bpp]);
+            return true;
+        case 2:
+            for (size_t i = 0; i < size; ++i)
+                row[i] = (uint8_t)(row[i] + above[i]);
+            return true;
+        case 3:
+            for (size_t i = 0; i < bpp && i < size; ++i)
+                row[i] = (uint8_t)(row[i] + (above[i] >> 1));
+            for (size_t i = bpp; i < size; ++i)
+                row[i] = (uint8_t)(row[i] + ((row[i - bpp] + above[i]) >> 1));
+            return true;
+        case 4:
+            for (size_t i = 0; i < bpp && i < size; ++i)
+                row[i] = (uint8_t)(row[i] + above[i]);
+            for (size_t i = bpp; i < size; ++i)
+                row[i] = (uint8_t)(row[i] + paeth(row[i - bpp], above[i], above[i - bpp]));
+            return true;
+        }
+        return false;
+    }
+
+    struct PngHeader
+    {
+        uint32_t width;
+        uint32_t height;
+        int depth;
+        int colorType;
+        int interlace;
+        int channels;
+    };
+
+    /* Everything needed to turn an unfiltered row into 8-bit channels. */
+    struct RowUnpacker
+    {
+        const PngHeader* header;
+        uint8_t palette[256][4];
+        bool hasKey;
+        uint16_t key[3];        /* tRNS colour key, in the image's bit depth */
+        PixelFormat format;     /* of the unpacked row */
+        int outChannels;
+
+        /* True when unpacked rows equal the unfiltered bytes. */
+        bool identity() const
+        {
+            return header->depth == 8 && header->colorType != 3 && !hasKey;
+        }
+
+        void unpack(const uint8_t* row, uint32_t width, uint8_t* out) const
+        {
+            const int depth = header->depth;
+            const int channels = header->channels;
+
+            if (header->colorType == 3)
+            {
+                const int mask = (1 << depth) - 1;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const size_t bit = (size_t)x * depth;
+                    const int index = (row[bit >> 3] >> (8 - depth - (int)(bit & 7))) & mask;
+                    memcpy(out + x * outChannels, palette[index], outChannels);
+                }
+                return;
+            }
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint16_t samples[4] = {};
+                for (int c = 0; c < channels; ++c)
+                {
+                    const size_t sample = (size_t)x * channels + c;
+                    if (depth == 16)
+                        samples[c] = (uint16_t)(row[sample * 2] << 8 | row[sample * 2 + 1]);
+                    else if (depth == 8)
+                        samples[c] = row[sample];
+                    else
+                    {
+                        const size_t bit = sample * depth;
+                        samples[c] = (uint16_t)((row[bit >> 3] >> (8 - depth - (int)(bit & 7))) & ((1 << depth) - 1));
+                    }
+                }
+
+                uint8_t* pixel = out + x * outChannels;
+                for (int c = 0; c < channels; ++c)
+                {
+                    if (depth == 16)
+                        pixel[c] = (uint8_t)(samples[c] >> 8);
+                    else if (depth < 8)
+                        pixel[c] = (uint8_t)(samples[c] * 255 / ((1 << depth) - 1));
+                    else
+                        pixel[c] = (uint8_t)samples[c];
+                }
+                if (hasKey)
+                {
+                    bool transparent = samples[0] == key[0];
+                    for (int c = 1; c < channels; ++c)
+                        transparent = transparent && samples[c] == key[c];
+                    pixel[channels] = transparent ? 0 : 255;
+                }
+            }
+        }
+    };
+
+    size_t rowBytes(const PngHeader& header, uint32_t width)
+    {
+        return ((size_t)width * header.channels * header.depth + 7) / 8;
+    }
+}
+
+bool decodePng(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log)
+{
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (size < 8 || memcmp(data, kSignature, 8) != 0)
+    {
+        log = "png: bad signature";
+        return false;
+    }
+
+    PngHeader header = {};
+    RowUnpacker unpacker = {};
+    unpacker.header = &header;
+    int paletteSize = 0;
+    bool sawHeader = false;
+    std::vector<uint8_t> compressed;
+
+    for (size_t position = 8; ; )
+    {
+        if (size - position < 12)
+        {
+            log = "png: truncated chunk";
+            return false;
+        }
+        const uint32_t length = readBigEndian(data + position);
+        const uint8_t* type = data + position + 4;
+        const uint8_t* body = data + position + 8;
+        if (length > size - position - 12)
+        {
+            log = "png: truncated chunk";
+            return false;
+        }
+        position += 12 + (size_t)length;
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (length < 13)
+            {
+                log = "png: short IHDR";
+                return false;
+            }
+            header.width = readBigEndian(body);
+            header.height = readBigEndian(body + 4);
+            header.depth = body[8];
+            header.colorType = body[9];
+            header.interlace = body[12];
+            static const int kChannels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            header.channels = header.colorType <= 6 ? kChannels[header.colorType] : 0;
+            const int depth = header.depth;
+            /* 1, 2 and 4 only for greyscale and palette, 16 for all but palette. */
+            const bool lowDepth = depth == 1 || depth == 2 || depth == 4;
+            const bool depthOk = depth == 8 || (lowDepth && (header.colorType == 0 || header.colorType == 3))
+                || (depth == 16 && header.colorType != 3);
+            if (header.channels && !depthOk)
+            {
+                log = "png: bad bit depth " + std::to_string(depth) + " for colour type " + std::to_string(header.colorType);
+                return false;
+            }
+            if (!header.channels || body[10] != 0 || body[11] != 0 || header.interlace > 1)
+            {
+                log = "png: unsupported format";
+                return false;
+            }
+            if (header.width == 0 || header.height == 0
+                || header.width > (uint32_t)kMaxImageDimension || header.height > (uint32_t)kMaxImageDimension)
+            {
+                log = "png: bad dimensions";
+                return false;
+            }
+            sawHeader = true;
+        }
+        else if (!sawHeader)
+        {
+            log = "png: IHDR is not the first chunk";
+            return false;
+        }
+        else if (memcmp(type, "PLTE", 4) == 0)
+        {
+            paletteSize = (int)(length / 3 > 256 ? 256 : length / 3);
+            for (int i = 0; i < paletteSize; ++i)
+            {
+                unpacker.palette[i][0] = body[i * 3 + 0];
+                unpacker.palette[i][1] = body[i * 3 + 1];
+                unpacker.palette[i][2] = body[i * 3 + 2];
+                unpacker.palette[i][3] = 255;
+            }
+        }
+        else if (memcmp(type, "tRNS", 4) == 0)
+        {
+            if (header.colorType == 3)
+            {
+                for (uint32_t i = 0; i < length && i < 256; ++i)
+                    unpacker.palette[i][3] = body[i];
+                unpacker.hasKey = true;
+            }
+            else if ((header.colorType == 0 && length >= 2) || (header.colorType == 2 && length >= 6))
+            {
+                for (int c = 0; c < header.channels; ++c)
+                    unpacker.key[c] = (uint16_t)(body[c * 2] << 8 | body[c * 2 + 1]);
+                unpacker.hasKey = true;
+            }
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+            compressed.insert(compressed.end(), body, body + length);
+        else if (memcmp(type, "IEND", 4) == 0)
+            break;
+        else if (!(type[0] & 0x20))
+        {
+            log = "png: unknown critical chunk";
+            return false;
+        }
+    }
+
+    if (header.colorType == 3 && paletteSize == 0)
+    {
+        log = "png: missing palette";
+        return false;
+    }
+
+    /* What rows look like after unpacking, and how convertRow() reads them. */
+    static const PixelFormat kFormats[5] = { kGray8, kGrayAlpha8, kRgb8, kRgba8, kRgba8 };
+    if (header.colorType == 3)
+        unpacker.outChannels = unpacker.hasKey ? 4 : 3;
+    else
+        unpacker.outChannels = header.channels + (unpacker.hasKey ? 1 : 0);
+    unpacker.format = kFormats[unpacker.outChannels - 1];
+
+    /* Adam7 passes; a non-interlaced image is one pass covering everything. */
+    static const int kStartX[7] = { 0, 4, 0, 2, 0, 1, 0 };
+    static const int kStartY[7] = { 0, 0, 4, 0, 2, 0, 1 };
+    static const int kStepX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+    static const int kStepY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+    const int passCount = header.interlace ? 7 : 1;
+
+    size_t expected = 0;
+    for (int pass = 0; pass < passCount; ++pass)
+    {
+        const uint32_t passWidth = header.interlace ? (header.width - kStartX[pass] + kStepX[pass] - 1) / kStepX[pass] : header.width;
+        const uint32_t passHeight = header.interlace ? (header.height - kStartY[pass] + kStepY[pass] - 1) / kStepY[pass] : header.height;
+        if (passWidth && passHeight)
+            expected += (size_t)passHeight * (rowBytes(header, passWidth) + 1);
+    }
+
+    std::vector<uint8_t> raw;
+    if (!inflateZlib(compressed.data(), compressed.size(), expected, raw, log))
+        return false;
+    if (raw.size() < expected)
+    {
+        log = "png: not enough image data";
+        return false;
+    }
+
+    image.width = (int)header.width;
+    image.height = (int)header.height;
+    image.pixels.resize((size_t)image.width * image.height * 4);
+
+    const size_t bpp = ((size_t)header.channels * header.depth + 7) / 8;
+    const size_t fullRowBytes = rowBytes(header, header.width);
+    std::vector<uint8_t> above(fullRowBytes, 0);
+    std::vector<uint8_t> unpacked((size_t)header.width * unpacker.outChannels);
+
+    /* Interlaced passes are gathered at full size before conversion. */
+    std::vector<uint8_t> gathered;
+    if (header.interlace)
+        gathered.resize((size_t)header.width * header.height * unpacker.outChannels);
+
+    uint8_t* cursor = raw.data();
+    for (int pass = 0; pass < passCount; ++pass)
+    {
+        const uint32_t passWidth = header.interlace ? (header.width - kStartX[pass] + kStepX[pass] - 1) / kStepX[pass] : header.width;
+        const uint32_t passHeight = header.interlace ? (header.height - kStartY[pass] + kStepY[pass] - 1) / kStepY[pass] : header.height;
+        if (!passWidth || !passHeight)
+            continue;
+
+        const size_t passRowBytes = rowBytes(header, passWidth);
+        const uint8_t* previous = above.data();
+        memset(above.data(), 0, fullRowBytes);
+        for (uint32_t y = 0; y < passHeight; ++y)
+        {
+            uint8_t* row = cursor + 1;
+            if (!unfilterRow(cursor[0], row, previous, passRowBytes, bpp))
+            {
+                log = "png: bad filter type";
+                return false;
+            }
+            previous = row;
+            cursor += passRowBytes + 1;
+
+            const uint8_t* pixels = row;
+            if (!unpacker.identity())
+            {
+                unpacker.unpack(row, passWidth, unpacked.data());
+                pixels = unpacked.data();
+            }
+
+            if (!header.interlace)
+            {
+                convertRow(unpacker.format, pixels, image.width, options, image.pixels.data() + (size_t)y * image.width * 4);
+                continue;
+            }
+
+            const size_t outY = kStartY[pass] + (size_t)y * kStepY[pass];
+            for (uint32_t x = 0; x < passWidth; ++x)
+            {
+                const size_t outX = kStartX[pass] + (size_t)x * kStepX[pass];
+                memcpy(gathered.data() + (outY * header.width + outX) * unpacker.outChannels,
+                    pixels + (size_t)x * unpacker.outChannels, unpacker.outChannels);
+            }
+        }
+    }
+
+    if (header.interlace)
+    {
+        const size_t stride = (size_t)header.width * unpacker.outChannels;
+        for (int y = 0; y < image.height; ++y)
+            convertRow(unpacker.format, gathered.data() + y * stride, image.width, options, image.pixels.data() + (size_t)y * image.width * 4);
+    }
+    return true;
+}
@@ -0,0 +1,202 @@
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "Deflate.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    /* Rows per strip never drop below this, so tiny strips do not lose most of
+       their compression to the sync flush and block headers. */
+    const int kMinStripRows = 16;
+
+    void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    /* Appends length, type, data and CRC. */
+    void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+    {
+        putBigEndian(out, (uint32_t)size);
+        const size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        putBigEndian(out, crc32(0, out.data() + typeOffset, size + 4));
+    }
+
+    inline uint8_t paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = abs(p - a);
+        const int pb = abs(p - b);
+        const int pc = abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return (uint8_t)a;
+        return pb <= pc ? (uint8_t)b : (uint8_t)c;
+    }
+
+    /* Writes the filter byte and residuals of one row to out and returns the
+       heuristic cost (sum of residuals read as signed bytes). */
+    int filterRow(int filter, const uint8_t* row, const uint8_t* above, size_t size, int bpp, uint8_t* out)
+    {
+        out[0] = (uint8_t)filter;
+        uint8_t* residual = out + 1;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+            const int b = above ? above[i] : 0;
+            const int c = above && i >= (size_t)bpp ? above[i - bpp] : 0;
+            int predicted = 0;
+            switch (filter)
+            {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) >> 1; break;
+            case 4: predicted = paeth(a, b, c); break;
+            }
+            residual[i] = (uint8_t)(row[i] - predicted);
+        }
+
+        int cost = 0;
+        for (size_t i = 0; i < size; ++i)
+            cost += abs((int)(int8_t)residual[i]);
+        return cost;
+    }
+
+    void convertRow(const uint8_t* rgba, int width, bool keepAlpha, uint8_t* out)
+    {
+        if (keepAlpha)
+        {
+            memcpy(out, rgba, (size_t)width * 4);
+            return;
+        }
+        for (int x = 0; x < width; ++x)
+        {
+            out[x * 3 + 0] = rgba[x * 4 + 0];
+            out[x * 3 + 1] = rgba[x * 4 + 1];
+            out[x * 3 + 2] = rgba[x * 4 + 2];
+        }
+    }
+}
+
+void encodePng(const uint8_t* rgba, size_t stride, int width, int height, bool flipY, bool keepAlpha,
+    int level, ThreadPool& pool, std::vector<uint8_t>& png)
+{
+    const int bpp = keepAlpha ? 4 : 3;
+    const size_t rowBytes = (size_t)width * bpp;
+    const size_t filteredRowBytes = rowBytes + 1;
+
+    const int targetStrips = (int)(pool.size() + 1) * 2;
+    const int stripRows = std::max(kMinStripRows, (height + targetStrips - 1) / std::max(targetStrips, 1));
+    const int stripCount = height > 0 ? (height + stripRows - 1) / stripRows : 0;
+
+    auto sourceRow = [&](int y)
+    {
+        return rgba + (size_t)(flipY ? height - 1 - y : y) * stride;
+    };
+
+    /* Pass 1: filter. A strip needs only the raw row above its first row. */
+    std::vector<uint8_t> filtered((size_t)height * filteredRowBytes);
+    pool.parallelFor((size_t)stripCount, [&](size_t strip)
+    {
+        const int firstRow = (int)strip * stripRows;
+        const int lastRow = std::min(height, firstRow + stripRows);
+
+        std::vector<uint8_t> rows(rowBytes * 2);
+        std::vector<uint8_t> candidate(filteredRowBytes);
+        uint8_t* current = rows.data();
+        uint8_t* above = rows.data() + rowBytes;
+        if (firstRow > 0)
+            convertRow(sourceRow(firstRow - 1), width, keepAlpha, above);
+
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            convertRow(sourceRow(y), width, keepAlpha, current);
+            const uint8_t* previous = y > 0 ? above : NULL;
+            uint8_t* out = filtered.data() + (size_t)y * filteredRowBytes;
+
+            int bestCost = filterRow(0, current, previous, rowBytes, bpp, out);
+            for (int filter = 1; filter <= 4; ++filter)
+            {
+                const int cost = filterRow(filter, current, previous, rowBytes, bpp, candidate.data());
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    memcpy(out, candidate.data(), filteredRowBytes);
+                }
+            }
+            std::swap(current, above);
+        }
+    });
+
+    /* Pass 2: deflate each strip into a complete IDAT chunk. */
+    std::vector<std::vector<uint8_t>> chunks(stripCount);
+    std::vector<uint32_t> adlers(stripCount);
+    pool.parallelFor((size_t)stripCount, [&](size_t strip)
+    {
+        const size_t begin = strip * stripRows * filteredRowBytes;
+        const size_t end = std::min(filtered.size(), begin + stripRows * filteredRowBytes);
+        const bool last = strip + 1 == (size_t)stripCount;
+
+        std::vector<uint8_t> data;
+        data.reserve((end - begin) / 2 + 64);
+        if (strip == 0)
+        {
+            /* zlib header: deflate, 32 KiB window, no preset dictionary. */
+            data.push_back(0x78);
+            data.push_back(0x9c);
+        }
+        deflateRange(filtered.data(), begin, end, last, level, data);
+        adlers[strip] = adler32(1, filtered.data() + begin, end - begin);
+
+        chunks[strip].reserve(data.size() + 12);
+        appendChunk(chunks[strip], "IDAT", data.data(), data.size());
+    });
+
+    uint32_t adler = 1;
+    for (int strip = 0; strip < stripCount; ++strip)
+    {
+        const size_t begin = (size_t)strip * stripRows * filteredRowBytes;
+        const size_t end = std::min(filtered.size(), begin + stripRows * filteredRowBytes);
+        adler = adler32Combine(adler, adlers[strip], end - begin);
+    }
+
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    png.clear();
+    png.insert(png.end(), kSignature, kSignature + 8);
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, (uint32_t)width);
+    putBigEndian(header, (uint32_t)height);
+    header.push_back(8);                    /* bit depth */
+    header.push_back(keepAlpha ? 6 : 2);    /* colour type: RGBA or RGB */
+    header.push_back(0);                    /* deflate */
+    header.push_back(0);                    /* adaptive filtering */
+    header.push_back(0);                    /* no interlace */
+    appendChunk(png, "IHDR", header.data(), header.size());
+
+    if (stripCount == 0)
+    {
+        /* Zero-height image: an empty zlib stream still has to be present. */
+        std::vector<uint8_t> data = { 0x78, 0x9c };
+        deflateRange(NULL, 0, 0, true, level, data);
+        putBigEndian(data, 1);
+        appendChunk(png, "IDAT", data.data(), data.size());
+    }
+    else
+    {
+        for (const std::vector<uint8_t>& chunk : chunks)
+            png.insert(png.end(), chunk.begin(), chunk.end());
+
+        uint8_t trailer[4] = { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler };
+        appendChunk(png, "IDAT", trailer, 4);
+    }
+    appendChunk(png, "IEND", NULL, 0);
+}
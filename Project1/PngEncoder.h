@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/* Encodes RGBA8 pixels as an 8-bit RGB (or RGBA with keepAlpha) PNG into png.
+
+   The image is cut into horizontal strips that are filtered and deflated in
+   parallel on the pool. Every row picks the filter (None, Sub, Up, Average,
+   Paeth) with the smallest sum of absolute residuals. Each strip is deflated
+   with the previous 32 KiB as its dictionary and ends in a sync flush, so
+   the strips concatenate into a single zlib stream; each becomes its own IDAT
+   chunk, CRC'd by the worker that produced it, and the per-strip Adler-32
+   checksums are combined for the stream trailer. flipY stores the rows bottom
+   up, which turns a GL readback the right way round. */
+void encodePng(const uint8_t* rgba, size_t stride, int width, int height, bool flipY, bool keepAlpha,
+    int level, ThreadPool& pool, std::vector<uint8_t>& png);
@@ -0,0 +1,168 @@
+#include "QuantizedMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const VertexAttribute kQuantizedAttributes[3] = {
+    { 0, 3, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, position) },
+    { 1, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(QuantizedVertex, texcoord) },
+    { 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(QuantizedVertex, normal) },
+};
+
+const char* const kPositionDecodeGlsl =
+    "uniform vec3 positionScale;\n"
+    "uniform vec3 positionBias;\n"
+    "vec3 decodePosition(vec3 p) { return p * positionScale + positionBias; }\n";
+
+namespace
+{
+    /* Encodes for the GL 4.2+ rule, max(c / (2^(b-1) - 1), -1), which
+       almost every 3.3 driver applies as well, so the most negative code is
+       never needed. GL 3.3 itself specifies (2c + 1) / (2^b - 1); under
+       that rule a value decodes up to half a step high, about 0.001 for the
+       10-bit normals, and zero is not exact. That is below what shading
+       can show, so we accept it rather than encode for both. */
+    int32_t snorm(float value, int bits)
+    {
+        const float limit = (float)((1 << (bits - 1)) - 1);
+        return (int32_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * limit);
+    }
+
+    float unsnorm(int32_t code, int bits)
+    {
+        return std::max((float)code / (float)((1 << (bits - 1)) - 1), -1.0f);
+    }
+
+    int32_t signExtend(uint32_t value, int bits)
+    {
+        return (int32_t)(value << (32 - bits)) >> (32 - bits);
+    }
+}
+
+uint32_t packSnorm1010102(float x, float y, float z, float w)
+{
+    return ((uint32_t)snorm(x, 10) & 0x3FF) | ((uint32_t)snorm(y, 10) & 0x3FF) << 10
+        | ((uint32_t)snorm(z, 10) & 0x3FF) << 20 | ((uint32_t)snorm(w, 2) & 0x3) << 30;
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000)        /* infinity and NaN, keeping NaN quiet */
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+    if (magnitude >= 0x477FF000)        /* rounds to above 65504 */
+        return sign | 0x7C00;
+    if (magnitude < 0x38800000)         /* half denormals and zero */
+    {
+        if (magnitude < 0x33000000)
+            return sign;
+        const uint32_t shift = 126 - (magnitude >> 23);
+        const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | (uint16_t)half;
+    }
+
+    /* Rebias the exponent and round the mantissa to 10 bits; a carry out of
+       the mantissa correctly bumps the exponent. */
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    const uint32_t rest = magnitude & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t)half;
+}
+
+float halfToFloat(uint16_t value)
+{
+    const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F)
+        bits = sign | 0x7F800000 | mantissa << 13;
+    else if (exponent != 0)
+        bits = sign | (exponent + 112) << 23 | mantissa << 13;
+    else
+    {
+        /* Denormals are exact in float: mantissa * 2^-24. */
+        const float magnitude = (float)mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &magnitude, 4);
+        bits |= sign;
+    }
+    float result;
+    memcpy(&result, &bits, 4);
+    return result;
+}
+
+void quantizeMesh(const MeshData& mesh, QuantizedMeshData& out)
+{
+    const size_t vertexCount = mesh.vertices.size() / kMeshVertexFloats;
+    float low[3] = { 0.0f, 0.0f, 0.0f };
+    float high[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t v = 0; v < vertexCount; ++v)
+        for (int k = 0; k < 3; ++k)
+        {
+            const float p = mesh.vertices[v * kMeshVertexFloats + k];
+            low[k] = v == 0 ? p : std::min(low[k], p);
+            high[k] = v == 0 ? p : std::max(high[k], p);
+        }
+
+    float inverse[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        out.decode.bias[k] = (low[k] + high[k]) * 0.5f;
+        out.decode.scale[k] = (high[k] - low[k]) * 0.5f;
+        inverse[k] = out.decode.scale[k] > 0.0f ? 1.0f / out.decode.scale[k] : 0.0f;
+    }
+
+    out.vertices.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float* source = &mesh.vertices[v * kMeshVertexFloats];
+        QuantizedVertex& vertex = out.vertices[v];
+        for (int k = 0; k < 3; ++k)
+            vertex.position[k] = (int16_t)snorm((source[k] - out.decode.bias[k]) * inverse[k], 16);
+        vertex.position[3] = 0;
+        vertex.texcoord[0] = floatToHalf(source[3]);
+        vertex.texcoord[1] = floatToHalf(source[4]);
+        vertex.normal = packSnorm1010102(source[5], source[6], source[7], 0.0f);
+    }
+    out.indices = mesh.indices;
+}
+
+void dequantizeMesh(const QuantizedMeshData& mesh, MeshData& out)
+{
+    out.vertices.resize(mesh.vertices.size() * kMeshVertexFloats);
+    for (size_t v = 0; v < mesh.vertices.size(); ++v)
+    {
+        const QuantizedVertex& vertex = mesh.vertices[v];
+        float* target = &out.vertices[v * kMeshVertexFloats];
+        for (int k = 0; k < 3; ++k)
+            target[k] = unsnorm(vertex.position[k], 16) * mesh.decode.scale[k] + mesh.decode.bias[k];
+        target[3] = halfToFloat(vertex.texcoord[0]);
+        target[4] = halfToFloat(vertex.texcoord[1]);
+        for (int k = 0; k < 3; ++k)
+            target[5 + k] = unsnorm(signExtend(vertex.normal >> (10 * k), 10), 10);
+    }
+    out.indices = mesh.indices;
+}
+
+ClusteredMesh createClusteredMesh(const QuantizedMeshData& data)
+{
+    return createClusteredMesh(data.vertices.data(), data.vertices.size(), sizeof(QuantizedVertex),
+        kQuantizedAttributes, 3, data.indices.data(), data.indices.size());
+}
+
+void setPositionDecode(GLuint program, const PositionDecode& decode)
+{
+    glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, decode.scale);
+    glUniform3fv(glGetUniformLocation(program, "positionBias"), 1, decode.bias);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+/* Compact vertex formats for MeshData: 16 bytes a vertex instead of 32, at
+   the same attribute locations, so only the position decode in the vertex
+   shader differs.
+
+     offset 0   position  3 x GL_SHORT, normalized, padded to 8 bytes;
+                          each axis maps the mesh bounds onto [-1, 1]
+     offset 8   normal    GL_INT_2_10_10_10_REV, normalized; the 2-bit w is
+                          free for a tangent's handedness when the same
+                          packing is used for tangents
+     offset 12  texcoord  2 x GL_HALF_FLOAT
+
+   Positions keep about 1/65535 of the bounds, normals about 0.1 degree and
+   texcoords 11 significant bits, which is plenty for texcoords in [0, 1]
+   but not for heavily tiled ones. */
+struct QuantizedVertex
+{
+    int16_t position[4];
+    uint32_t normal;
+    uint16_t texcoord[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex must stay tightly packed");
+
+extern const VertexAttribute kQuantizedAttributes[3];
+
+/* Object-space position = decoded * scale + bias. */
+struct PositionDecode
+{
+    float scale[3];
+    float bias[3];
+};
+
+struct QuantizedMeshData
+{
+    std::vector<QuantizedVertex> vertices;
+    std::vector<uint32_t> indices;
+    PositionDecode decode;
+};
+
+void quantizeMesh(const MeshData& mesh, QuantizedMeshData& out);
+
+/* Back to kMeshVertexFloats floats a vertex, for measuring the error. */
+void dequantizeMesh(const QuantizedMeshData& mesh, MeshData& out);
+
+/* createClusteredMesh() for quantized data. */
+ClusteredMesh createClusteredMesh(const QuantizedMeshData& data);
+
+/* GLSL for vertex shaders that read the quantized layout, to be placed after
+   the #version line: declares the positionScale and positionBias uniforms
+   and vec3 decodePosition(vec3). */
+extern const char* const kPositionDecodeGlsl;
+
+/* Sets the uniforms declared by kPositionDecodeGlsl on the current program. */
+void setPositionDecode(GLuint program, const PositionDecode& decode);
+
+/* Signed normalized 10.10.10.2, x in the low bits. Inputs are clamped to
+   [-1, 1]. */
+uint32_t packSnorm1010102(float x, float y, float z, float w);
+
+/* IEEE half precision, rounded to nearest even; overflow becomes infinity. */
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
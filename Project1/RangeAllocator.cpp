@@ -0,0 +1,313 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static uint32_t lowestBit(uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(value);
+#endif
+}
+
+static uint32_t highestBit(uint64_t value)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (value >> 32)
+    {
+        _BitScanReverse(&index, (unsigned long)(value >> 32));
+        return (uint32_t)index + 32;
+    }
+    _BitScanReverse(&index, (unsigned long)value);
+    return (uint32_t)index;
+#else
+    return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+}
+
+RangeAllocator::RangeAllocator(size_t capacity)
+    : m_firstPhysical(kNone)
+    , m_scanStart(kNone)
+    , m_capacity(capacity)
+    , m_used(0)
+    , m_allocations(0)
+    , m_firstLevelMap(0)
+{
+    std::fill(m_secondLevelMap, m_secondLevelMap + kFirstLevelCount, 0u);
+    for (uint32_t i = 0; i < kFirstLevelCount; ++i)
+        std::fill(m_heads[i], m_heads[i] + kSecondLevelCount, kNone);
+
+    if (capacity == 0)
+        return;
+
+    m_firstPhysical = newNode();
+    m_scanStart = m_firstPhysical;
+    Node& node = m_nodes[m_firstPhysical];
+    node.offset = 0;
+    node.size = capacity;
+    insertFree(m_firstPhysical);
+}
+
+/* Sizes below kSecondLevelCount map linearly into the first row; above that the
+   first level is the power of two and the second level splits it evenly. */
+void RangeAllocator::mapping(size_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+    if (size < kSecondLevelCount)
+    {
+        firstLevel = 0;
+        secondLevel = (uint32_t)size;
+        return;
+    }
+    const uint32_t top = highestBit(size);
+    firstLevel = top - kSecondLevelBits + 1;
+    secondLevel = (uint32_t)(size >> (top - kSecondLevelBits)) - kSecondLevelCount;
+}
+
+uint32_t RangeAllocator::newNode()
+{
+    uint32_t index;
+    if (!m_unusedNodes.empty())
+    {
+        index = m_unusedNodes.back();
+        m_unusedNodes.pop_back();
+    }
+    else
+    {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.push_back(Node());
+    }
+
+    Node& node = m_nodes[index];
+    node.offset = 0;
+    node.size = 0;
+    node.prevPhysical = node.nextPhysical = kNone;
+    node.prevFree = node.nextFree = kNone;
+    node.isFree = false;
+    return index;
+}
+
+void RangeAllocator::releaseNode(uint32_t node)
+{
+    m_unusedNodes.push_back(node);
+}
+
+void RangeAllocator::insertFree(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    uint32_t first, second;
+    mapping(node.size, first, second);
+
+    node.isFree = true;
+    node.prevFree = kNone;
+    node.nextFree = m_heads[first][second];
+    if (node.nextFree != kNone)
+        m_nodes[node.nextFree].prevFree = index;
+    m_heads[first][second] = index;
+
+    m_firstLevelMap |= 1u << first;
+    m_secondLevelMap[first] |= 1u << second;
+}
+
+void RangeAllocator::removeFree(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    uint32_t first, second;
+    mapping(node.size, first, second);
+
+    if (node.prevFree != kNone)
+        m_nodes[node.prevFree].nextFree = node.nextFree;
+    else
+        m_heads[first][second] = node.nextFree;
+    if (node.nextFree != kNone)
+        m_nodes[node.nextFree].prevFree = node.prevFree;
+
+    if (m_heads[first][second] == kNone)
+    {
+        m_secondLevelMap[first] &= ~(1u << second);
+        if (m_secondLevelMap[first] == 0)
+            m_firstLevelMap &= ~(1u << first);
+    }
+
+    node.isFree = false;
+    node.prevFree = node.nextFree = kNone;
+}
+
+uint32_t RangeAllocator::findFree(size_t size)
+{
+    /* Round up to the next class so any range in the found list is big enough. */
+    if (size >= kSecondLevelCount)
+        size += ((size_t)1 << (highestBit(size) - kSecondLevelBits)) - 1;
+
+    uint32_t first, second;
+    mapping(size, first, second);
+    if (first >= kFirstLevelCount)
+        return kNone;
+
+    uint32_t secondMap = second < 32 ? m_secondLevelMap[first] & (~0u << second) : 0;
+    if (!secondMap)
+    {
+        const uint32_t firstMap = first + 1 < 32 ? m_firstLevelMap & (~0u << (first + 1)) : 0;
+        if (!firstMap)
+            return kNone;
+        first = lowestBit(firstMap);
+        secondMap = m_secondLevelMap[first];
+    }
+    second = lowestBit(secondMap);
+    return m_heads[first][second];
+}
+
+RangeAllocator::Allocation RangeAllocator::allocate(size_t size)
+{
+    size = std::max<size_t>(size, 1);
+    uint32_t index = findFree(size);
+    if (index == kNone)
+        return kInvalid;
+
+    removeFree(index);
+
+    /* Split off the tail as a new free range. */
+    if (m_nodes[index].size > size)
+    {
+        uint32_t rest = newNode();
+        Node& node = m_nodes[index];
+        Node& tail = m_nodes[rest];
+        tail.offset = node.offset + size;
+        tail.size = node.size - size;
+        tail.prevPhysical = index;
+        tail.nextPhysical = node.nextPhysical;
+        if (node.nextPhysical != kNone)
+            m_nodes[node.nextPhysical].prevPhysical = rest;
+        node.nextPhysical = rest;
+        node.size = size;
+        insertFree(rest);
+    }
+
+    m_used += m_nodes[index].size;
+    m_allocations++;
+    return index;
+}
+
+void RangeAllocator::mergeWithNext(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    const uint32_t next = node.nextPhysical;
+    if (next == kNone || !m_nodes[next].isFree)
+        return;
+
+    removeFree(next);
+    node.size += m_nodes[next].size;
+    node.nextPhysical = m_nodes[next].nextPhysical;
+    if (node.nextPhysical != kNone)
+        m_nodes[node.nextPhysical].prevPhysical = index;
+    releaseNode(next);
+}
+
+void RangeAllocator::free(Allocation allocation)
+{
+    if (allocation == kInvalid)
+        return;
+
+    m_used -= m_nodes[allocation].size;
+    m_allocations--;
+
+    uint32_t index = allocation;
+    mergeWithNext(index);
+
+    const uint32_t prev = m_nodes[index].prevPhysical;
+    if (prev != kNone && m_nodes[prev].isFree)
+    {
+        removeFree(prev);
+        m_nodes[prev].size += m_nodes[index].size;
+        m_nodes[prev].nextPhysical = m_nodes[index].nextPhysical;
+        if (m_nodes[index].nextPhysical != kNone)
+            m_nodes[m_nodes[index].nextPhysical].prevPhysical = prev;
+        releaseNode(index);
+        index = prev;
+    }
+
+    /* Ranges merged away all lay at or after index, so the scan start
+       never points at a released node. */
+    if (m_nodes[index].offset < m_nodes[m_scanStart].offset)
+        m_scanStart = index;
+    insertFree(index);
+}
+
+RangeAllocator::Allocation RangeAllocator::movable() const
+{
+    /* Allocations only fill ranges and slideDown() only moves one below its
+       hole, so nothing before m_scanStart becomes free except through
+       free(), which moves it back. */
+    for (uint32_t index = m_scanStart; index != kNone; index = m_nodes[index].nextPhysical)
+    {
+        const uint32_t next = m_nodes[index].nextPhysical;
+        if (m_nodes[index].isFree)
+        {
+            m_scanStart = index;
+            return next != kNone && !m_nodes[next].isFree ? next : kInvalid;
+        }
+    }
+    return kInvalid;
+}
+
+size_t RangeAllocator::slideDown(Allocation allocation)
+{
+    const uint32_t gap = m_nodes[allocation].prevPhysical;
+    const size_t previousOffset = m_nodes[allocation].offset;
+    if (gap == kNone || !m_nodes[gap].isFree)
+        return previousOffset;
+
+    removeFree(gap);
+    Node& node = m_nodes[allocation];
+    Node& hole = m_nodes[gap];
+
+    /* Swap the two ranges in the physical list: [hole][node] -> [node][hole]. */
+    node.offset = hole.offset;
+    hole.offset = node.offset + node.size;
+
+    const uint32_t before = hole.prevPhysical;
+    const uint32_t after = node.nextPhysical;
+    node.prevPhysical = before;
+    node.nextPhysical = gap;
+    hole.prevPhysical = allocation;
+    hole.nextPhysical = after;
+    if (before != kNone)
+        m_nodes[before].nextPhysical = allocation;
+    else
+        m_firstPhysical = allocation;
+    if (after != kNone)
+        m_nodes[after].prevPhysical = gap;
+
+    mergeWithNext(gap);
+    insertFree(gap);
+    return previousOffset;
+}
+
+RangeAllocator::Stats RangeAllocator::stats() const
+{
+    Stats stats = {};
+    stats.capacity = m_capacity;
+    stats.used = m_used;
+    stats.allocations = m_allocations;
+    for (uint32_t index = m_firstPhysical; index != kNone; index = m_nodes[index].nextPhysical)
+    {
+        if (!m_nodes[index].isFree)
+            continue;
+        stats.freeRanges++;
+        stats.largestFree = std::max(stats.largestFree, m_nodes[index].size);
+    }
+    const size_t freeSpace = m_capacity - m_used;
+    stats.fragmentation = freeSpace ? 1.0f - (float)stats.largestFree / (float)freeSpace : 0.0f;
+    return stats;
+}
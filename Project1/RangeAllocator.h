@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Two-level segregated fit (TLSF) allocator for ranges of an external
+   resource, such as vertices or indices inside a GPU buffer. Only bookkeeping
+   lives here; the caller owns the storage. Allocation and free are O(1).
+
+   Allocations are identified by stable ids. Compaction support: movable()
+   finds the allocation directly after the lowest free range, and slideDown()
+   moves it into that range, keeping its id, so callers can relocate the data
+   a little at a time. Capacities up to 2^34 units are supported. */
+class RangeAllocator
+{
+public:
+    typedef uint32_t Allocation;
+    static constexpr Allocation kInvalid = 0xffffffffu;
+
+    struct Stats
+    {
+        size_t capacity;
+        size_t used;
+        size_t allocations;
+        size_t freeRanges;
+        size_t largestFree;
+        float fragmentation; /* 1 - largestFree / free space, 0 when compact */
+    };
+
+    explicit RangeAllocator(size_t capacity);
+
+    /* Returns kInvalid when no free range is large enough. */
+    Allocation allocate(size_t size);
+    void free(Allocation allocation);
+
+    size_t offset(Allocation allocation) const { return m_nodes[allocation].offset; }
+    size_t size(Allocation allocation) const { return m_nodes[allocation].size; }
+
+    /* The allocation that directly follows the lowest free range, or kInvalid
+       when everything in use is already packed at the start. Scans on from
+       where the last call stopped, so a defragmentation loop calling it
+       after every slideDown() costs O(1) per move. */
+    Allocation movable() const;
+
+    /* Moves an allocation returned by movable() down to the start of the free
+       range before it. Returns its previous offset. */
+    size_t slideDown(Allocation allocation);
+
+    Stats stats() const;
+
+private:
+    enum
+    {
+        kSecondLevelBits = 4,
+        kSecondLevelCount = 1 << kSecondLevelBits,
+        kFirstLevelCount = 32,
+    };
+
+    static constexpr uint32_t kNone = 0xffffffffu;
+
+    struct Node
+    {
+        size_t offset;
+        size_t size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool isFree;
+    };
+
+    static void mapping(size_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+    uint32_t newNode();
+    void releaseNode(uint32_t node);
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+    uint32_t findFree(size_t size);
+    void mergeWithNext(uint32_t node);
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_unusedNodes;
+    uint32_t m_firstPhysical;
+    mutable uint32_t m_scanStart;   /* no free range lies before this node; movable() starts here */
+    size_t m_capacity;
+    size_t m_used;
+    size_t m_allocations;
+
+    uint32_t m_firstLevelMap;
+    uint32_t m_secondLevelMap[kFirstLevelCount];
+    uint32_t m_heads[kFirstLevelCount][kSecondLevelCount];
+};
@@ -0,0 +1,246 @@
+#include "RectPacker.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+SkylinePacker::SkylinePacker(int width, int height)
+    : m_width(width)
+    , m_height(height)
+    , m_usedArea(0)
+{
+    reset();
+}
+
+void SkylinePacker::reset()
+{
+    m_usedArea = 0;
+    m_skyline.clear();
+    Segment floor = { 0, 0, m_width };
+    m_skyline.push_back(floor);
+}
+
+int SkylinePacker::fitAt(size_t i, int width, int height) const
+{
+    const int x = m_skyline[i].x;
+    if (x + width > m_width)
+        return -1;
+    int y = 0;
+    for (int remaining = width; remaining > 0; ++i)
+    {
+        y = std::max(y, m_skyline[i].y);
+        if (y + height > m_height)
+            return -1;
+        remaining -= m_skyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(int width, int height, PackedRect& rect)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    size_t best = SIZE_MAX;
+    int bestY = INT_MAX;
+    for (size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        const int y = fitAt(i, width, height);
+        if (y >= 0 && y < bestY)
+        {
+            best = i;
+            bestY = y;
+        }
+    }
+    if (best == SIZE_MAX)
+        return false;
+
+    rect.x = m_skyline[best].x;
+    rect.y = bestY;
+    rect.width = width;
+    rect.height = height;
+    m_usedArea += (size_t)width * height;
+
+    /* The new segment replaces everything it covers; a segment it covers
+       partly keeps its right part. */
+    Segment top = { rect.x, bestY + height, width };
+    size_t end = best;
+    while (end < m_skyline.size() && m_skyline[end].x + m_skyline[end].width <= rect.x + width)
+        end++;
+    if (end < m_skyline.size() && m_skyline[end].x < rect.x + width)
+    {
+        const int cut = rect.x + width - m_skyline[end].x;
+        m_skyline[end].x += cut;
+        m_skyline[end].width -= cut;
+    }
+    m_skyline.erase(m_skyline.begin() + best, m_skyline.begin() + end);
+    m_skyline.insert(m_skyline.begin() + best, top);
+
+    /* Merge neighbours of equal height so the list stays short. */
+    for (size_t i = best > 0 ? best - 1 : 0; i + 1 < m_skyline.size() && i <= best + 1;)
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].width += m_skyline[i + 1].width;
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else
+            ++i;
+    }
+    return true;
+}
+
+float SkylinePacker::occupancy() const
+{
+    return (float)m_usedArea / ((float)m_width * (float)m_height);
+}
+
+MaxRectsPacker::MaxRectsPacker(int width, int height)
+    : m_width(width)
+    , m_height(height)
+    , m_usedArea(0)
+{
+    reset();
+}
+
+void MaxRectsPacker::reset()
+{
+    m_usedArea = 0;
+    m_free.clear();
+    PackedRect page = { 0, 0, m_width, m_height };
+    m_free.push_back(page);
+}
+
+bool MaxRectsPacker::insert(int width, int height, PackedRect& rect)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    int bestShort = INT_MAX;
+    int bestLong = INT_MAX;
+    const PackedRect* best = NULL;
+    for (const PackedRect& free : m_free)
+    {
+        if (free.width < width || free.height < height)
+            continue;
+        const int leftoverX = free.width - width;
+        const int leftoverY = free.height - height;
+        const int shortSide = std::min(leftoverX, leftoverY);
+        const int longSide = std::max(leftoverX, leftoverY);
+        if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+        {
+            bestShort = shortSide;
+            bestLong = longSide;
+            best = &free;
+        }
+    }
+    if (!best)
+        return false;
+
+    rect.x = best->x;
+    rect.y = best->y;
+    rect.width = width;
+    rect.height = height;
+    place(rect);
+    m_usedArea += (size_t)width * height;
+    return true;
+}
+
+void MaxRectsPacker::place(const PackedRect& rect)
+{
+    /* Every free rectangle overlapping the placed one is replaced by the up
+       to four maximal rectangles around it. */
+    std::vector<PackedRect> split;
+    for (PackedRect& free : m_free)
+    {
+        if (rect.x >= free.x + free.width || rect.x + rect.width <= free.x
+            || rect.y >= free.y + free.height || rect.y + rect.height <= free.y)
+            continue;
+
+        if (rect.x > free.x)
+            split.push_back({ free.x, free.y, rect.x - free.x, free.height });
+        if (rect.x + rect.width < free.x + free.width)
+            split.push_back({ rect.x + rect.width, free.y, free.x + free.width - rect.x - rect.width, free.height });
+        if (rect.y > free.y)
+            split.push_back({ free.x, free.y, free.width, rect.y - free.y });
+        if (rect.y + rect.height < free.y + free.height)
+            split.push_back({ free.x, rect.y + rect.height, free.width, free.y + free.height - rect.y - rect.height });
+        free.width = 0;     /* removed below */
+    }
+    m_free.erase(std::remove_if(m_free.begin(), m_free.end(), [](const PackedRect& r) { return r.width == 0; }), m_free.end());
+
+    /* The surviving rectangles contain none of each other, and none of them
+       can lie inside a new one (it would have lain inside the rectangle the
+       new one was cut from), so only the new ones need pruning. */
+    const auto contains = [](const PackedRect& outer, const PackedRect& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width
+            && inner.y + inner.height <= outer.y + outer.height;
+    };
+    for (size_t i = 0; i < split.size(); ++i)
+    {
+        bool redundant = false;
+        for (size_t j = 0; j < split.size() && !redundant; ++j)
+            redundant = j != i && split[j].width > 0 && contains(split[j], split[i])
+                && (j < i || !contains(split[i], split[j]));
+        for (size_t j = 0; j < m_free.size() && !redundant; ++j)
+            redundant = contains(m_free[j], split[i]);
+        if (redundant)
+            split[i].width = 0;
+    }
+    for (const PackedRect& r : split)
+        if (r.width > 0)
+            m_free.push_back(r);
+}
+
+float MaxRectsPacker::occupancy() const
+{
+    return (float)m_usedArea / ((float)m_width * (float)m_height);
+}
+
+int packAtlasPages(const std::vector<PackedRect>& sizes, int pageWidth, int pageHeight,
+    std::vector<AtlasPlacement>& placements)
+{
+    placements.assign(sizes.size(), AtlasPlacement());
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+        if (sizes[i].width > pageWidth || sizes[i].height > pageHeight)
+            return -1;
+    }
+    /* Largest first by the longer side, then by area: big rectangles decide
+       the layout and small ones fill the gaps. */
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const int sideA = std::max(sizes[a].width, sizes[a].height);
+        const int sideB = std::max(sizes[b].width, sizes[b].height);
+        if (sideA != sideB)
+            return sideA > sideB;
+        return sizes[a].width * sizes[a].height > sizes[b].width * sizes[b].height;
+    });
+
+    /* Every page stays open, so later small rectangles can still fill the
+       gaps of earlier pages. */
+    std::vector<MaxRectsPacker> pages;
+    for (size_t i : order)
+    {
+        const PackedRect& size = sizes[i];
+        AtlasPlacement& placement = placements[i];
+        placement.page = -1;
+        if (size.width <= 0 || size.height <= 0)
+        {
+            placement.page = 0;
+            placement.rect = { 0, 0, size.width, size.height };
+            continue;
+        }
+        for (size_t p = 0; p < pages.size() && placement.page < 0; ++p)
+            if (pages[p].insert(size.width, size.height, placement.rect))
+                placement.page = (int)p;
+        if (placement.page < 0)
+        {
+            pages.emplace_back(pageWidth, pageHeight);
+            pages.back().insert(size.width, size.height, placement.rect);
+            placement.page = (int)pages.size() - 1;
+        }
+    }
+    return std::max((int)pages.size(), sizes.empty() ? 0 : 1);
+}
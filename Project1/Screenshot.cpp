@@ -0,0 +1,74 @@
+#include "Screenshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "PngEncoder.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+ScreenshotWriter::ScreenshotWriter(ThreadPool& pool)
+    : m_pool(pool)
+    , m_pending(0)
+{
+}
+
+ScreenshotWriter::~ScreenshotWriter()
+{
+    wait();
+}
+
+void ScreenshotWriter::save(const ReadbackFrame& frame, const std::string& path)
+{
+    /* The readback buffer is only valid during the callback. */
+    const size_t rowBytes = (size_t)frame.width * 4;
+    std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>(rowBytes * frame.height);
+    for (int y = 0; y < frame.height; ++y)
+        memcpy(pixels->data() + y * rowBytes, frame.pixels + y * frame.stride, rowBytes);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending++;
+    }
+
+    const int width = frame.width;
+    const int height = frame.height;
+    m_pool.enqueue([this, pixels, width, height, path]()
+    {
+        const double start = nowSeconds();
+        std::vector<uint8_t> png;
+        encodePng(pixels->data(), (size_t)width * 4, width, height, true, false, 6, m_pool, png);
+        const double encoded = nowSeconds();
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file && fwrite(png.data(), 1, png.size(), file) == png.size() && fclose(file) == 0)
+        {
+            printf("screenshot %s: %dx%d, %zu KiB, encoded in %.1f ms on %u threads\n", path.c_str(),
+                width, height, png.size() / 1024, (encoded - start) * 1000.0, m_pool.size() + 1);
+        }
+        else
+        {
+            if (file)
+                fclose(file);
+            fprintf(stderr, "cannot write screenshot %s\n", path.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending--;
+        m_done.notify_all();
+    });
+}
+
+void ScreenshotWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+}
+
+size_t ScreenshotWriter::pending()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
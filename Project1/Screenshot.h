@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "AsyncReadback.h"
+
+class ThreadPool;
+
+/* Saves read-back frames as PNG files without blocking the render thread.
+
+   save() copies the pixels and returns; the encoding and the file write run
+   as a job on the thread pool, which in turn spreads the PNG strips over the
+   pool. */
+class ScreenshotWriter
+{
+public:
+    explicit ScreenshotWriter(ThreadPool& pool);
+    ~ScreenshotWriter();
+
+    ScreenshotWriter(const ScreenshotWriter&) = delete;
+    ScreenshotWriter& operator=(const ScreenshotWriter&) = delete;
+
+    void save(const ReadbackFrame& frame, const std::string& path);
+
+    /* Blocks until every queued screenshot is on disk. */
+    void wait();
+
+    size_t pending();
+
+private:
+    ThreadPool& m_pool;
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    size_t m_pending;
+};
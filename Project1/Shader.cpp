@@ -0,0 +1,93 @@
+#include "Shader.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+bool readTextFile(const std::string& path, std::string& out)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    out = contents.str();
+    return true;
+}
+
+GLuint compileShader(GLenum type, const std::string& source, std::string& log)
+{
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> buffer(length > 1 ? length : 1);
+        glGetShaderInfoLog(shader, (GLsizei)buffer.size(), NULL, buffer.data());
+        log = buffer.data();
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, std::string& log)
+{
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDetachShader(program, vertexShader);
+    glDetachShader(program, fragmentShader);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> buffer(length > 1 ? length : 1);
+        glGetProgramInfoLog(program, (GLsizei)buffer.size(), NULL, buffer.data());
+        log = buffer.data();
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint buildProgram(const std::string& vertexSource, const std::string& fragmentSource, std::string& log)
+{
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource, log);
+    GLuint fs = vs ? compileShader(GL_FRAGMENT_SHADER, fragmentSource, log) : 0;
+    GLuint program = vs && fs ? linkProgram(vs, fs, log) : 0;
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return program;
+}
+
+GLuint buildProgramFromFiles(const std::string& vertexPath, const std::string& fragmentPath, std::string& log)
+{
+    std::string vertexSource, fragmentSource;
+    if (!readTextFile(vertexPath, vertexSource))
+    {
+        log = "cannot read " + vertexPath;
+        return 0;
+    }
+    if (!readTextFile(fragmentPath, fragmentSource))
+    {
+        log = "cannot read " + fragmentPath;
+        return 0;
+    }
+
+    GLuint program = buildProgram(vertexSource, fragmentSource, log);
+    if (!program)
+        log = vertexPath + ", " + fragmentPath + ": " + log;
+    return program;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+/* Reads a whole text file into out. Returns false if the file cannot be opened. */
+bool readTextFile(const std::string& path, std::string& out);
+
+/* Compiles one shader stage. Returns 0 and fills log on failure. */
+GLuint compileShader(GLenum type, const std::string& source, std::string& log);
+
+/* Links a vertex/fragment pair into a program. The stages are detached but not
+   deleted. Returns 0 and fills log on failure. */
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, std::string& log);
+
+/* Compiles and links a vertex/fragment pair given as source text, deleting the
+   stages afterwards. Returns 0 and fills log on failure. */
+GLuint buildProgram(const std::string& vertexSource, const std::string& fragmentSource, std::string& log);
+
+/* buildProgram() on the contents of two files; errors name both paths. */
+GLuint buildProgramFromFiles(const std::string& vertexPath, const std::string& fragmentPath, std::string& log);
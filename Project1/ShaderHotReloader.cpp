@@ -0,0 +1,157 @@
+#include "ShaderHotReloader.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Shader.h"
+
+ShaderHotReloader::ShaderHotReloader(GLFWwindow* mainWindow, const std::string& vertexPath, const std::string& fragmentPath)
+    : m_mainWindow(mainWindow)
+    , m_workerContext(NULL)
+    , m_vertexPath(vertexPath)
+    , m_fragmentPath(fragmentPath)
+    , m_program(0)
+    , m_running(false)
+    , m_pendingProgram(0)
+    , m_pendingFence(NULL)
+{
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+    stop();
+}
+
+bool ShaderHotReloader::start()
+{
+    std::string log;
+    m_program = build(log);
+    if (!m_program)
+        fprintf(stderr, "shader build failed, waiting for edits:\n%s\n", log.c_str());
+
+    if (!m_watcher.watch(m_vertexPath) || !m_watcher.watch(m_fragmentPath))
+    {
+        fprintf(stderr, "cannot watch %s / %s\n", m_vertexPath.c_str(), m_fragmentPath.c_str());
+        return m_program != 0;
+    }
+
+    /* Window creation has to happen on the main thread; the context is then
+       handed to the worker. The current context hints are reused so the shared
+       context matches the main one. */
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    m_workerContext = glfwCreateWindow(1, 1, "shader compiler", NULL, m_mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!m_workerContext)
+    {
+        fprintf(stderr, "cannot create shared context, hot reload disabled\n");
+        return m_program != 0;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&ShaderHotReloader::run, this);
+    return m_program != 0;
+}
+
+void ShaderHotReloader::stop()
+{
+    if (m_thread.joinable())
+    {
+        m_running = false;
+        m_thread.join();
+    }
+
+    if (m_pendingProgram)
+    {
+        glDeleteProgram(m_pendingProgram);
+        glDeleteSync(m_pendingFence);
+        m_pendingProgram = 0;
+        m_pendingFence = NULL;
+    }
+
+    if (m_workerContext)
+    {
+        glfwDestroyWindow(m_workerContext);
+        m_workerContext = NULL;
+    }
+
+    if (m_program)
+    {
+        glDeleteProgram(m_program);
+        m_program = 0;
+    }
+}
+
+GLuint ShaderHotReloader::build(std::string& log)
+{
+    GLuint program = buildProgramFromFiles(m_vertexPath, m_fragmentPath, log);
+    if (program && m_setup && !m_setup(program, log))
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool ShaderHotReloader::poll()
+{
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || !m_pendingProgram)
+        return false;
+
+    /* Zero timeout: only check whether the worker's commands have completed. */
+    GLenum state = glClientWaitSync(m_pendingFence, 0, 0);
+    if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+        return false;
+
+    if (m_program)
+        glDeleteProgram(m_program);
+    m_program = m_pendingProgram;
+    glDeleteSync(m_pendingFence);
+    m_pendingProgram = 0;
+    m_pendingFence = NULL;
+    return true;
+}
+
+void ShaderHotReloader::run()
+{
+    glfwMakeContextCurrent(m_workerContext);
+
+    std::vector<std::string> changed;
+    while (m_running)
+    {
+        changed.clear();
+        if (!m_watcher.wait(100, changed))
+            continue;
+
+        std::string log;
+        GLuint program = build(log);
+        if (!program)
+        {
+            fprintf(stderr, "shader reload failed, keeping previous program:\n%s\n", log.c_str());
+            continue;
+        }
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        GLuint staleProgram = 0;
+        GLsync staleFence = NULL;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            staleProgram = m_pendingProgram;
+            staleFence = m_pendingFence;
+            m_pendingProgram = program;
+            m_pendingFence = fence;
+        }
+
+        /* A newer build superseded one the render thread had not picked up yet. */
+        if (staleProgram)
+        {
+            glDeleteProgram(staleProgram);
+            glDeleteSync(staleFence);
+        }
+        fprintf(stderr, "shader reloaded: %s\n", changed.front().c_str());
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FileWatcher.h"
+
+/* Keeps a vertex/fragment program in sync with its GLSL sources on disk.
+
+   A background thread owns a hidden GLFW window whose context shares objects
+   with the main one. When a source changes it recompiles and links there, so the
+   render thread never waits on the compiler. A successfully linked program is
+   published together with a fence; poll() swaps it in once the fence has
+   signalled. Failed builds are reported and the previous program stays bound. */
+class ShaderHotReloader
+{
+public:
+    ShaderHotReloader(GLFWwindow* mainWindow, const std::string& vertexPath, const std::string& fragmentPath);
+    ~ShaderHotReloader();
+
+    ShaderHotReloader(const ShaderHotReloader&) = delete;
+    ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+    /* Runs after every successful link, on the thread that linked the program.
+       It may configure the program (block bindings) or reject it by returning
+       false with a message in log. Set before start(). */
+    void setProgramSetup(std::function<bool(GLuint, std::string&)> setup) { m_setup = setup; }
+
+    /* Builds the initial program and starts the watcher thread. Must be called
+       on the main thread with the main context current. */
+    bool start();
+
+    /* Stops the watcher thread and releases the shared context and programs.
+       Main thread only, before glfwTerminate. */
+    void stop();
+
+    /* Called once per frame on the render thread. Never blocks. Returns true when
+       a new program has been swapped in, in which case cached uniform locations
+       must be queried again. */
+    bool poll();
+
+    GLuint program() const { return m_program; }
+
+private:
+    void run();
+    GLuint build(std::string& log);
+
+    GLFWwindow* m_mainWindow;
+    GLFWwindow* m_workerContext;
+    std::string m_vertexPath;
+    std::string m_fragmentPath;
+
+    std::function<bool(GLuint, std::string&)> m_setup;
+    GLuint m_program;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    FileWatcher m_watcher;
+
+    std::mutex m_mutex;
+    GLuint m_pendingProgram;
+    GLsync m_pendingFence;
+};
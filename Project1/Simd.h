@@ -0,0 +1,28 @@
+#pragma once
+
+/* Compile-time SIMD selection shared by the CPU kernels.
+
+   SIMD_SSE2 is set on every x86-64 build and on 32-bit builds compiled for
+   SSE2; SIMD_SSSE3 when byte shuffles are available (-mssse3, or any AVX
+   target since MSVC has no SSSE3 switch); SIMD_AVX2 only when the compiler
+   targets AVX2 (/arch:AVX2, -mavx2).
+   Kernels provide a scalar path for everything else.
+
+   The Debug and Release configurations build for SSE2 only. ReleaseAVX2
+   adds /arch:AVX2, which turns on the SSSE3 and AVX2 paths as well; that
+   build needs an AVX2 CPU. Timings quoted for these kernels were taken
+   with GCC -O2 -mavx2, the equivalent of ReleaseAVX2. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define SIMD_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#endif
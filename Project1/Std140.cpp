@@ -0,0 +1,86 @@
+#include "Std140.h"
+
+#include <vector>
+
+/* Strips an instance name prefix ("Frame.time") and an array suffix ("lights[0]"). */
+static std::string memberName(const char* reflected)
+{
+    std::string name = reflected;
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos)
+        name = name.substr(dot + 1);
+    size_t bracket = name.find('[');
+    if (bracket != std::string::npos)
+        name = name.substr(0, bracket);
+    return name;
+}
+
+bool std140::verifyBlock(GLuint program, const char* blockName, const Member* members, size_t count, size_t size, std::string& log)
+{
+    GLuint index = glGetUniformBlockIndex(program, blockName);
+    if (index == GL_INVALID_INDEX)
+        return true;
+
+    GLint dataSize = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+    if ((size_t)dataSize != size)
+    {
+        log = std::string(blockName) + ": GLSL size " + std::to_string(dataSize) + ", C++ size " + std::to_string(size);
+        return false;
+    }
+
+    GLint activeCount = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &activeCount);
+    std::vector<GLint> indices(activeCount);
+    if (activeCount > 0)
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+
+    std::vector<GLuint> uniforms(indices.begin(), indices.end());
+    std::vector<GLint> offsets(activeCount), types(activeCount), sizes(activeCount);
+    if (activeCount > 0)
+    {
+        glGetActiveUniformsiv(program, activeCount, uniforms.data(), GL_UNIFORM_OFFSET, offsets.data());
+        glGetActiveUniformsiv(program, activeCount, uniforms.data(), GL_UNIFORM_TYPE, types.data());
+        glGetActiveUniformsiv(program, activeCount, uniforms.data(), GL_UNIFORM_SIZE, sizes.data());
+    }
+
+    std::vector<bool> seen(count, false);
+    char nameBuffer[256];
+    for (GLint i = 0; i < activeCount; ++i)
+    {
+        glGetActiveUniformName(program, uniforms[i], sizeof(nameBuffer), NULL, nameBuffer);
+        std::string name = memberName(nameBuffer);
+
+        size_t m = 0;
+        while (m < count && name != members[m].name)
+            ++m;
+        if (m == count)
+        {
+            log = std::string(blockName) + "." + name + " is missing from the C++ description";
+            return false;
+        }
+
+        seen[m] = true;
+        if ((size_t)offsets[i] != members[m].offset)
+        {
+            log = std::string(blockName) + "." + name + ": GLSL offset " + std::to_string(offsets[i])
+                + ", C++ offset " + std::to_string(members[m].offset);
+            return false;
+        }
+        if ((GLenum)types[i] != members[m].glType || (size_t)sizes[i] != members[m].count)
+        {
+            log = std::string(blockName) + "." + name + ": type or array size differs from the C++ description";
+            return false;
+        }
+    }
+
+    for (size_t m = 0; m < count; ++m)
+    {
+        if (!seen[m])
+        {
+            log = std::string(blockName) + "." + members[m].name + " is not declared in GLSL";
+            return false;
+        }
+    }
+    return true;
+}
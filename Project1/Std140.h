@@ -0,0 +1,167 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+
+/* Compile-time description of std140 uniform blocks.
+
+   A block is a plain struct built from the types below, plus a BlockLayout
+   specialisation listing its members in declaration order:
+
+       struct FrameUniforms
+       {
+           std140::mat4 viewProjection;
+           std140::vec3 cameraPosition;
+           float time;
+       };
+
+       namespace std140
+       {
+           template <> struct BlockLayout<FrameUniforms>
+           {
+               static constexpr const char* name = "Frame";
+               static constexpr Member members[] = {
+                   STD140_MEMBER(FrameUniforms, viewProjection),
+                   STD140_MEMBER(FrameUniforms, cameraPosition),
+                   STD140_MEMBER(FrameUniforms, time),
+               };
+           };
+       }
+       STD140_CHECK(FrameUniforms);
+
+   STD140_CHECK computes the std140 offsets from the member types and fails the
+   build if the C++ struct does not match them (usually a vec3 followed by
+   something other than a scalar, which needs explicit padding). verifyBlock()
+   then compares the same table against the linked program's reflection data. */
+namespace std140
+{
+    struct alignas(8) vec2 { float x, y; };
+    struct vec3 { float x, y, z; };
+    struct alignas(16) vec4 { float x, y, z, w; };
+    struct alignas(16) ivec4 { int x, y, z, w; };
+    struct alignas(16) mat4 { float m[16]; };
+
+    /* Array elements are rounded up to a vec4 stride. */
+    template <class T>
+    struct alignas(16) element { T value; };
+
+    template <class T, size_t N>
+    struct array
+    {
+        element<T> items[N];
+
+        T& operator[](size_t i) { return items[i].value; }
+        const T& operator[](size_t i) const { return items[i].value; }
+    };
+
+    /* Base alignment, size and reflected GL type of each supported member type. */
+    template <class T> struct Traits;
+    template <> struct Traits<float> { enum : size_t { alignment = 4, size = 4, count = 1 }; static constexpr GLenum glType = GL_FLOAT; };
+    template <> struct Traits<int> { enum : size_t { alignment = 4, size = 4, count = 1 }; static constexpr GLenum glType = GL_INT; };
+    template <> struct Traits<unsigned> { enum : size_t { alignment = 4, size = 4, count = 1 }; static constexpr GLenum glType = GL_UNSIGNED_INT; };
+    template <> struct Traits<vec2> { enum : size_t { alignment = 8, size = 8, count = 1 }; static constexpr GLenum glType = GL_FLOAT_VEC2; };
+    template <> struct Traits<vec3> { enum : size_t { alignment = 16, size = 12, count = 1 }; static constexpr GLenum glType = GL_FLOAT_VEC3; };
+    template <> struct Traits<vec4> { enum : size_t { alignment = 16, size = 16, count = 1 }; static constexpr GLenum glType = GL_FLOAT_VEC4; };
+    template <> struct Traits<ivec4> { enum : size_t { alignment = 16, size = 16, count = 1 }; static constexpr GLenum glType = GL_INT_VEC4; };
+    template <> struct Traits<mat4> { enum : size_t { alignment = 16, size = 64, count = 1 }; static constexpr GLenum glType = GL_FLOAT_MAT4; };
+
+    template <class T, size_t N>
+    struct Traits<array<T, N>>
+    {
+        enum : size_t
+        {
+            alignment = 16,
+            size = N * ((Traits<T>::size + 15) & ~size_t(15)),
+            count = N,
+        };
+        static constexpr GLenum glType = Traits<T>::glType;
+    };
+
+    struct Member
+    {
+        const char* name;
+        size_t offset;
+        size_t alignment;
+        size_t size;
+        size_t count;
+        GLenum glType;
+    };
+
+    /* Specialised once per block, see above. */
+    template <class Block> struct BlockLayout;
+
+    constexpr size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    template <class Block>
+    constexpr size_t memberCount()
+    {
+        return sizeof(BlockLayout<Block>::members) / sizeof(Member);
+    }
+
+    /* std140 offset of member i, computed purely from the member types. */
+    template <class Block>
+    constexpr size_t expectedOffset(size_t index)
+    {
+        size_t offset = 0;
+        for (size_t i = 0; i < index; ++i)
+            offset = alignUp(offset, BlockLayout<Block>::members[i].alignment) + BlockLayout<Block>::members[i].size;
+        return alignUp(offset, BlockLayout<Block>::members[index].alignment);
+    }
+
+    /* std140 size of the whole block, rounded to a vec4 as GL reports it. */
+    template <class Block>
+    constexpr size_t expectedSize()
+    {
+        const size_t last = memberCount<Block>() - 1;
+        return alignUp(expectedOffset<Block>(last) + BlockLayout<Block>::members[last].size, 16);
+    }
+
+    /* Index of the first member whose C++ offset differs from std140, or
+       memberCount() when the struct matches. */
+    template <class Block>
+    constexpr size_t firstMismatch()
+    {
+        for (size_t i = 0; i < memberCount<Block>(); ++i)
+            if (BlockLayout<Block>::members[i].offset != expectedOffset<Block>(i))
+                return i;
+        return memberCount<Block>();
+    }
+
+    /* Compares the block description with the program's reflection data.
+       Returns false and fills log on the first mismatch. Blocks the program does
+       not use are accepted. */
+    bool verifyBlock(GLuint program, const char* blockName, const Member* members, size_t count, size_t size, std::string& log);
+
+    template <class Block>
+    bool verifyBlock(GLuint program, std::string& log)
+    {
+        return verifyBlock(program, BlockLayout<Block>::name, BlockLayout<Block>::members, memberCount<Block>(), sizeof(Block), log);
+    }
+
+    /* Points the program's block at a uniform buffer binding point. */
+    template <class Block>
+    void bindBlock(GLuint program, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(program, BlockLayout<Block>::name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, binding);
+    }
+}
+
+#define STD140_MEMBER(Block, member) \
+    ::std140::Member{ #member, offsetof(Block, member), \
+        ::std140::Traits<decltype(Block::member)>::alignment, \
+        ::std140::Traits<decltype(Block::member)>::size, \
+        ::std140::Traits<decltype(Block::member)>::count, \
+        ::std140::Traits<decltype(Block::member)>::glType }
+
+#define STD140_CHECK(Block) \
+    static_assert(::std140::firstMismatch<Block>() == ::std140::memberCount<Block>(), \
+        #Block " does not follow std140 offsets; add padding before the first mismatching member"); \
+    static_assert(sizeof(Block) == ::std140::expectedSize<Block>(), \
+        #Block " size does not match its std140 size; add trailing padding")
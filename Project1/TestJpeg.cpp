@@ -0,0 +1,71 @@
+#include "Tests.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ImageLoader.h"
+
+/* Malformed Huffman tables must be rejected before any of their codes are
+   written: three 1-bit codes once ran past the fast lookup table. */
+
+/* SOI, one DHT segment with the given code counts per length and enough
+   symbols for them, then EOI. */
+static std::vector<uint8_t> jpegWithTable(const uint8_t (&counts)[16])
+{
+    int total = 0;
+    for (uint8_t count : counts)
+        total += count;
+    const int length = 2 + 1 + 16 + total;
+    std::vector<uint8_t> file = { 0xff, 0xd8, 0xff, 0xc4, (uint8_t)(length >> 8), (uint8_t)length, 0x00 };
+    for (uint8_t count : counts)
+        file.push_back(count);
+    for (int i = 0; i < total; ++i)
+        file.push_back((uint8_t)i);
+    file.push_back(0xff);
+    file.push_back(0xd9);
+    return file;
+}
+
+static int expectRejected(const char* what, const uint8_t (&counts)[16])
+{
+    const std::vector<uint8_t> file = jpegWithTable(counts);
+    const ImageOptions options = { false, false };
+    Image image;
+    std::string log;
+    if (decodeJpeg(file.data(), file.size(), options, image, log) || log.find("Huffman") == std::string::npos)
+    {
+        printf("jpeg: %s was not rejected as a bad Huffman table (%s)\n", what, log.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int testJpeg()
+{
+    const uint8_t threeOneBit[16] = { 3 };
+    const uint8_t manyOneBit[16] = { 200 };
+    const uint8_t fiveTwoBit[16] = { 0, 5 };
+    const uint8_t fullThenMore[16] = { 2, 1 };
+    const uint8_t longCodes[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255 };
+    int failed = 0;
+    failed += expectRejected("three 1-bit codes", threeOneBit);
+    failed += expectRejected("200 1-bit codes", manyOneBit);
+    failed += expectRejected("five 2-bit codes", fiveTwoBit);
+    failed += expectRejected("a code after a full length", fullThenMore);
+
+    /* A valid table is not an error by itself; the file then fails for
+       lack of a frame, not for its table. */
+    const std::vector<uint8_t> file = jpegWithTable(longCodes);
+    const ImageOptions options = { false, false };
+    Image image;
+    std::string log;
+    decodeJpeg(file.data(), file.size(), options, image, log);
+    if (log.find("Huffman") != std::string::npos)
+    {
+        printf("jpeg: a valid table was rejected (%s)\n", log.c_str());
+        failed++;
+    }
+    return failed;
+}
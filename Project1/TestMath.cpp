@@ -0,0 +1,101 @@
+#include "Tests.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "VectorMath.h"
+
+/* The batched kernels against plain scalar code that adds the products in
+   the same order, compared bit for bit. Counts are not multiples of four so
+   the scalar tails run too. Expected to fail on builds that allow FMA
+   contraction; see VectorMath.h. */
+
+static const size_t kCount = 37;
+
+static float randomFloat(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (float)(seed >> 8) / (float)(1u << 24) * 4.0f - 2.0f;
+}
+
+static void referenceMultiply(const Mat4& a, const Mat4& b, Mat4& out)
+{
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row)
+            out.m[column * 4 + row] = ((a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1])
+                + a.m[8 + row] * b.m[column * 4 + 2]) + a.m[12 + row] * b.m[column * 4 + 3];
+}
+
+static Vec3 referenceTransform(const Mat4& m, Vec3 p)
+{
+    float r[3];
+    for (int row = 0; row < 3; ++row)
+        r[row] = ((m.m[row] * p.x + m.m[4 + row] * p.y) + m.m[8 + row] * p.z) + m.m[12 + row];
+    return Vec3{ r[0], r[1], r[2] };
+}
+
+static Quat referenceQuat(const Quat& a, const Quat& b)
+{
+    return Quat{
+        ((a.w * b.x + a.x * b.w) + a.y * b.z) - a.z * b.y,
+        ((a.w * b.y - a.x * b.z) + a.y * b.w) + a.z * b.x,
+        ((a.w * b.z + a.x * b.y) - a.y * b.x) + a.z * b.w,
+        ((a.w * b.w - a.x * b.x) - a.y * b.y) - a.z * b.z,
+    };
+}
+
+static int countDifferent(const char* what, const void* results, const void* expected, size_t count, size_t size)
+{
+    int different = 0;
+    for (size_t i = 0; i < count; ++i)
+        different += memcmp((const uint8_t*)results + i * size, (const uint8_t*)expected + i * size, size) != 0;
+    if (different)
+        printf("math: %s differs from scalar in %d of %zu results\n", what, different, count);
+    return different;
+}
+
+int testMath()
+{
+    uint32_t seed = 7;
+    std::vector<Mat4> a(kCount), b(kCount);
+    std::vector<Vec3> points(kCount);
+    std::vector<Quat> qa(kCount), qb(kCount);
+    for (size_t i = 0; i < kCount; ++i)
+    {
+        for (int k = 0; k < 16; ++k)
+        {
+            a[i].m[k] = randomFloat(seed);
+            b[i].m[k] = randomFloat(seed);
+        }
+        points[i] = Vec3{ randomFloat(seed), randomFloat(seed), randomFloat(seed) };
+        qa[i] = Quat{ randomFloat(seed), randomFloat(seed), randomFloat(seed), randomFloat(seed) };
+        qb[i] = Quat{ randomFloat(seed), randomFloat(seed), randomFloat(seed), randomFloat(seed) };
+    }
+
+    int failed = 0;
+    std::vector<Mat4> matrices(kCount), expectedMatrices(kCount);
+    multiplyMatrices(a[0], b.data(), matrices.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i)
+        referenceMultiply(a[0], b[i], expectedMatrices[i]);
+    failed += countDifferent("multiplyMatrices, one by many", matrices.data(), expectedMatrices.data(), kCount, sizeof(Mat4));
+
+    multiplyMatrices(a.data(), b.data(), matrices.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i)
+        referenceMultiply(a[i], b[i], expectedMatrices[i]);
+    failed += countDifferent("multiplyMatrices, pairwise", matrices.data(), expectedMatrices.data(), kCount, sizeof(Mat4));
+
+    std::vector<Vec3> transformed(kCount), expectedPoints(kCount);
+    transformPoints(a[0], points.data(), transformed.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i)
+        expectedPoints[i] = referenceTransform(a[0], points[i]);
+    failed += countDifferent("transformPoints", transformed.data(), expectedPoints.data(), kCount, sizeof(Vec3));
+
+    std::vector<Quat> products(kCount), expectedProducts(kCount);
+    multiplyQuats(qa.data(), qb.data(), products.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i)
+        expectedProducts[i] = referenceQuat(qa[i], qb[i]);
+    failed += countDifferent("multiplyQuats", products.data(), expectedProducts.data(), kCount, sizeof(Quat));
+    return failed;
+}
@@ -0,0 +1,39 @@
+#include "Tests.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct Test
+{
+    const char* name;
+    int (*run)();
+};
+
+static const Test kTests[] = {
+    { "jpeg", testJpeg },
+    { "math", testMath },
+};
+
+int runTests(const char* name)
+{
+    const bool all = strcmp(name, "all") == 0;
+    int failed = 0;
+    bool found = false;
+    for (const Test& test : kTests)
+    {
+        if (!all && strcmp(test.name, name) != 0)
+            continue;
+        found = true;
+        const int result = test.run();
+        printf("%-10s %s\n", test.name, result == 0 ? "ok" : "FAILED");
+        failed += result != 0;
+    }
+    if (found)
+        return failed;
+
+    fprintf(stderr, "unknown test '%s', available: all", name);
+    for (const Test& test : kTests)
+        fprintf(stderr, " %s", test.name);
+    fprintf(stderr, "\n");
+    return -1;
+}
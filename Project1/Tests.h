@@ -0,0 +1,9 @@
+#pragma once
+
+/* Self-checks, selected on the command line with --test <name>, or --test
+   all for every one. They need no window or GL context. Each prints what
+   failed and returns 0 when everything passed. */
+int runTests(const char* name);
+
+int testJpeg();
+int testMath();
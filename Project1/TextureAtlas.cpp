@@ -0,0 +1,163 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    /* Dirty rectangles are merged when their bounding box wastes no more
+       than this fraction of its area on texels that did not change: one
+       bigger upload is cheaper than several small ones. */
+    const float kMergeWaste = 0.25f;
+
+    size_t area(const PackedRect& rect)
+    {
+        return (size_t)rect.width * rect.height;
+    }
+
+    PackedRect bounds(const PackedRect& a, const PackedRect& b)
+    {
+        const int x0 = std::min(a.x, b.x);
+        const int y0 = std::min(a.y, b.y);
+        const int x1 = std::max(a.x + a.width, b.x + b.width);
+        const int y1 = std::max(a.y + a.height, b.y + b.height);
+        return { x0, y0, x1 - x0, y1 - y0 };
+    }
+}
+
+void blitWithPadding(const Image& image, uint8_t* page, int pageWidth, int x, int y, int padding)
+{
+    /* Rows first, each extended left and right, then the top and bottom
+       padding rows copied from the finished edge rows. */
+    const size_t pitch = (size_t)pageWidth * 4;
+    for (int row = 0; row < image.height; ++row)
+    {
+        uint8_t* target = page + (y + row) * pitch + (size_t)x * 4;
+        const uint8_t* source = &image.pixels[(size_t)row * image.width * 4];
+        memcpy(target, source, (size_t)image.width * 4);
+        for (int p = 1; p <= padding; ++p)
+        {
+            memcpy(target - p * 4, source, 4);
+            memcpy(target + (image.width - 1 + p) * 4, source + (image.width - 1) * 4, 4);
+        }
+    }
+    const size_t paddedBytes = (size_t)(image.width + 2 * padding) * 4;
+    uint8_t* top = page + y * pitch + (size_t)(x - padding) * 4;
+    uint8_t* bottom = top + (image.height - 1) * pitch;
+    for (int p = 1; p <= padding; ++p)
+    {
+        memcpy(top - p * pitch, top, paddedBytes);
+        memcpy(bottom + p * pitch, bottom, paddedBytes);
+    }
+}
+
+TextureAtlas::TextureAtlas(int width, int height, int padding)
+    : m_packer(width, height)
+    , m_padding(padding)
+    , m_texture(0)
+    , m_pixels((size_t)width * height * 4, 0)
+    , m_images(0)
+    , m_uploads(0)
+    , m_bytesUploaded(0)
+{
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    glDeleteTextures(1, &m_texture);
+}
+
+bool TextureAtlas::add(const Image& image, Region& region)
+{
+    PackedRect rect;
+    if (image.width <= 0 || image.height <= 0
+        || !m_packer.insert(image.width + 2 * m_padding, image.height + 2 * m_padding, rect))
+        return false;
+
+    const int x = rect.x + m_padding;
+    const int y = rect.y + m_padding;
+    blitWithPadding(image, m_pixels.data(), m_packer.width(), x, y, m_padding);
+    markDirty(rect);
+
+    region.x = x;
+    region.y = y;
+    region.width = image.width;
+    region.height = image.height;
+    region.u0 = (float)x / m_packer.width();
+    region.v0 = (float)y / m_packer.height();
+    region.u1 = (float)(x + image.width) / m_packer.width();
+    region.v1 = (float)(y + image.height) / m_packer.height();
+    m_images++;
+    return true;
+}
+
+void TextureAtlas::markDirty(const PackedRect& rect)
+{
+    /* Grow into an existing rectangle while that stays cheap; a merge can
+       make another merge worthwhile, so repeat until nothing changes. */
+    PackedRect merged = rect;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (size_t i = 0; i < m_dirty.size(); ++i)
+        {
+            const PackedRect candidate = bounds(merged, m_dirty[i]);
+            if ((float)(area(merged) + area(m_dirty[i])) >= (1.0f - kMergeWaste) * (float)area(candidate))
+            {
+                merged = candidate;
+                m_dirty[i] = m_dirty.back();
+                m_dirty.pop_back();
+                changed = true;
+                break;
+            }
+        }
+    }
+    m_dirty.push_back(merged);
+}
+
+void TextureAtlas::flush()
+{
+    if (m_dirty.empty())
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, m_packer.width());
+    for (const PackedRect& rect : m_dirty)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RGBA, GL_UNSIGNED_BYTE,
+            &m_pixels[((size_t)rect.y * m_packer.width() + rect.x) * 4]);
+        m_uploads++;
+        m_bytesUploaded += area(rect) * 4;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_dirty.clear();
+}
+
+void TextureAtlas::clear()
+{
+    m_packer.reset();
+    m_dirty.clear();
+    m_images = 0;
+}
+
+TextureAtlas::Stats TextureAtlas::stats() const
+{
+    Stats stats;
+    stats.images = m_images;
+    stats.uploads = m_uploads;
+    stats.bytesUploaded = m_bytesUploaded;
+    stats.occupancy = m_packer.occupancy();
+    return stats;
+}
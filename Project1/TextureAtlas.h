@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "Image.h"
+#include "RectPacker.h"
+
+/* One RGBA8 texture shared by many small images (sprites, UI elements,
+   glyphs), so everything drawn from it can go out in one draw call.
+
+   Images can be added at any time. They are packed with a SkylinePacker and
+   copied into a CPU copy of the page; the texture only catches up in
+   flush(), which merges the rectangles touched since the last flush and
+   uploads each merged rectangle with a single glTexSubImage2D. Many sprites
+   added in a frame therefore cost a handful of uploads, not one each.
+
+   Each image is surrounded by padding texels that repeat its edge, so
+   bilinear filtering at the border of a region does not pick up the
+   neighbours. The texture has no mipmaps: lower levels would blend
+   neighbouring images together whatever the padding. */
+class TextureAtlas
+{
+public:
+    /* Texture coordinates put v = 0 at the first row of the page, which
+       holds the images' top rows. */
+    struct Region
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+        float u0;
+        float v0;
+        float u1;
+        float v1;
+    };
+
+    struct Stats
+    {
+        size_t images;
+        size_t uploads;         /* glTexSubImage2D calls, total */
+        size_t bytesUploaded;
+        float occupancy;        /* of the page, padding included */
+    };
+
+    /* Creates the texture, so needs the GL thread. */
+    TextureAtlas(int width, int height, int padding = 1);
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    /* Returns false when the image does not fit in what is left. Any thread
+       that owns the atlas; no GL calls. */
+    bool add(const Image& image, Region& region);
+
+    /* Uploads the pending rectangles. GL thread. */
+    void flush();
+
+    /* Forgets all images; the texture keeps its contents until overwritten. */
+    void clear();
+
+    GLuint texture() const { return m_texture; }
+    int width() const { return m_packer.width(); }
+    int height() const { return m_packer.height(); }
+    Stats stats() const;
+
+private:
+    void markDirty(const PackedRect& rect);
+
+    SkylinePacker m_packer;
+    int m_padding;
+    GLuint m_texture;
+    std::vector<uint8_t> m_pixels;
+    std::vector<PackedRect> m_dirty;
+    size_t m_images;
+    size_t m_uploads;
+    size_t m_bytesUploaded;
+};
+
+/* Copies image into an RGBA8 page pageWidth texels wide at (x, y) and
+   repeats its edge texels padding times around it. The padded rectangle
+   must lie inside the page. Also used by the offline packer. */
+void blitWithPadding(const Image& image, uint8_t* page, int pageWidth, int x, int y, int padding);
@@ -0,0 +1,345 @@
+#include "TextureContainer.h"
+
+#include <cstring>
+
+#include "ImageLoader.h"
+
+namespace
+{
+    const uint32_t kDdsMipMapCount = 0x20000;
+    const uint32_t kDdsFourCC = 0x4;
+    const uint32_t kDdsCubeMap = 0x200;
+    const uint32_t kDdsVolume = 0x200000;
+    const uint32_t kDxgiTexture2D = 3;
+
+    inline uint32_t readLittleEndian(const uint8_t* p)
+    {
+        return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    inline void writeLittleEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back((uint8_t)(value >> (i * 8)));
+    }
+
+    inline uint32_t fourCC(const char* code)
+    {
+        return readLittleEndian((const uint8_t*)code);
+    }
+
+    bool formatFromDxgi(uint32_t dxgi, BlockFormat& format, bool& srgb)
+    {
+        srgb = false;
+        switch (dxgi)
+        {
+        case 71: format = kBC1; return true;
+        case 72: format = kBC1; srgb = true; return true;
+        case 77: format = kBC3; return true;
+        case 78: format = kBC3; srgb = true; return true;
+        case 80: format = kBC4; return true;
+        case 83: format = kBC5; return true;
+        case 98: format = kBC7; return true;
+        case 99: format = kBC7; srgb = true; return true;
+        default: return false;
+        }
+    }
+
+    uint32_t dxgiFromFormat(BlockFormat format, bool srgb)
+    {
+        switch (format)
+        {
+        case kBC1: return srgb ? 72 : 71;
+        case kBC3: return srgb ? 78 : 77;
+        case kBC4: return 80;
+        case kBC5: return 83;
+        case kBC7: return srgb ? 99 : 98;
+        }
+        return 0;
+    }
+
+    bool formatFromGl(uint32_t internalFormat, BlockFormat& format, bool& srgb)
+    {
+        srgb = false;
+        switch (internalFormat)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: format = kBC1; return true;
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: format = kBC1; srgb = true; return true;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: format = kBC3; return true;
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: format = kBC3; srgb = true; return true;
+        case GL_COMPRESSED_RED_RGTC1: format = kBC4; return true;
+        case GL_COMPRESSED_RG_RGTC2: format = kBC5; return true;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB: format = kBC7; return true;
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB: format = kBC7; srgb = true; return true;
+        default: return false;
+        }
+    }
+
+    bool checkSize(int width, int height, std::string& log)
+    {
+        if (width <= 0 || height <= 0 || width > kMaxImageDimension || height > kMaxImageDimension)
+        {
+            log = "unsupported size " + std::to_string(width) + "x" + std::to_string(height);
+            return false;
+        }
+        return true;
+    }
+}
+
+bool decodeDds(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log)
+{
+    if (size < 128 || memcmp(data, "DDS ", 4) != 0 || readLittleEndian(data + 4) != 124)
+    {
+        log = "not a DDS file";
+        return false;
+    }
+
+    const uint32_t flags = readLittleEndian(data + 8);
+    const int height = (int)readLittleEndian(data + 12);
+    const int width = (int)readLittleEndian(data + 16);
+    const uint32_t mipCount = flags & kDdsMipMapCount ? readLittleEndian(data + 28) : 1;
+    const uint32_t pixelFlags = readLittleEndian(data + 80);
+    const uint32_t code = readLittleEndian(data + 84);
+    const uint32_t caps2 = readLittleEndian(data + 112);
+    if (!checkSize(width, height, log))
+        return false;
+    if (caps2 & (kDdsCubeMap | kDdsVolume))
+    {
+        log = "cube maps and volume textures are not supported";
+        return false;
+    }
+    if (!(pixelFlags & kDdsFourCC))
+    {
+        log = "uncompressed DDS files are not supported";
+        return false;
+    }
+
+    size_t offset = 128;
+    texture.srgb = false;
+    if (code == fourCC("DX10"))
+    {
+        if (size < 148)
+        {
+            log = "truncated DX10 header";
+            return false;
+        }
+        if (!formatFromDxgi(readLittleEndian(data + 128), texture.format, texture.srgb))
+        {
+            log = "unsupported DXGI format " + std::to_string(readLittleEndian(data + 128));
+            return false;
+        }
+        if (readLittleEndian(data + 132) != kDxgiTexture2D || readLittleEndian(data + 140) > 1)
+        {
+            log = "only single 2D textures are supported";
+            return false;
+        }
+        offset = 148;
+    }
+    else if (code == fourCC("DXT1"))
+        texture.format = kBC1;
+    else if (code == fourCC("DXT5"))
+        texture.format = kBC3;
+    else if (code == fourCC("ATI1") || code == fourCC("BC4U"))
+        texture.format = kBC4;
+    else if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+        texture.format = kBC5;
+    else
+    {
+        const char name[5] = { (char)code, (char)(code >> 8), (char)(code >> 16), (char)(code >> 24), 0 };
+        log = std::string("unsupported FourCC '") + name + "'";
+        return false;
+    }
+
+    /* Levels follow each other with no padding; a file may stop the chain
+       early but not run past 1x1. */
+    texture.levels.clear();
+    int levelWidth = width, levelHeight = height;
+    size_t total = 0;
+    for (uint32_t level = 0; level < (mipCount ? mipCount : 1); ++level)
+    {
+        const size_t levelSize = compressedSize(texture.format, levelWidth, levelHeight);
+        texture.levels.push_back({ levelWidth, levelHeight, total, levelSize });
+        total += levelSize;
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+    }
+    if (size - offset < total)
+    {
+        log = "truncated DDS data";
+        return false;
+    }
+    texture.data.assign(data + offset, data + offset + total);
+    return true;
+}
+
+bool decodeKtx(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log)
+{
+    static const uint8_t kSignature[12] = { 0xab, 'K', 'T', 'X', ' ', '1', '1', 0xbb, '\r', '\n', 0x1a, '\n' };
+    if (size < 64 || memcmp(data, kSignature, 12) != 0)
+    {
+        log = "not a KTX 1 file";
+        return false;
+    }
+    if (readLittleEndian(data + 12) != 0x04030201)
+    {
+        log = "big-endian KTX files are not supported";
+        return false;
+    }
+
+    const uint32_t glType = readLittleEndian(data + 16);
+    const uint32_t internalFormat = readLittleEndian(data + 28);
+    const int width = (int)readLittleEndian(data + 36);
+    const int height = (int)readLittleEndian(data + 40);
+    const uint32_t depth = readLittleEndian(data + 44);
+    const uint32_t arrayElements = readLittleEndian(data + 48);
+    const uint32_t faces = readLittleEndian(data + 52);
+    const uint32_t mipCount = readLittleEndian(data + 56);
+    const uint32_t keyValueBytes = readLittleEndian(data + 60);
+    if (glType != 0 || !formatFromGl(internalFormat, texture.format, texture.srgb))
+    {
+        log = "unsupported KTX internal format " + std::to_string(internalFormat);
+        return false;
+    }
+    if (!checkSize(width, height, log))
+        return false;
+    if (depth > 1 || arrayElements > 0 || faces != 1)
+    {
+        log = "only single 2D textures are supported";
+        return false;
+    }
+
+    /* Each level is a 32-bit size followed by the data, padded to 4 bytes. */
+    size_t offset = 64 + (size_t)keyValueBytes;
+    texture.levels.clear();
+    texture.data.clear();
+    int levelWidth = width, levelHeight = height;
+    for (uint32_t level = 0; level < (mipCount ? mipCount : 1); ++level)
+    {
+        if (offset > size || size - offset < 4)
+        {
+            log = "truncated KTX data";
+            return false;
+        }
+        const size_t levelSize = readLittleEndian(data + offset);
+        const size_t expected = compressedSize(texture.format, levelWidth, levelHeight);
+        if (levelSize != expected || size - offset - 4 < levelSize)
+        {
+            log = "KTX level " + std::to_string(level) + " has the wrong size";
+            return false;
+        }
+        texture.levels.push_back({ levelWidth, levelHeight, texture.data.size(), levelSize });
+        texture.data.insert(texture.data.end(), data + offset + 4, data + offset + 4 + levelSize);
+        offset += 4 + ((levelSize + 3) & ~(size_t)3);
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+    }
+    return true;
+}
+
+bool decodeTextureContainer(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log)
+{
+    if (size >= 4 && memcmp(data, "DDS ", 4) == 0)
+        return decodeDds(data, size, texture, log);
+    return decodeKtx(data, size, texture, log);
+}
+
+bool loadCompressedTexture(const std::string& path, CompressedTexture& texture, std::string& log)
+{
+    std::vector<uint8_t> data;
+    if (!readBinaryFile(path, data))
+    {
+        log = "cannot read " + path;
+        return false;
+    }
+    if (!decodeTextureContainer(data.data(), data.size(), texture, log))
+    {
+        log = path + ": " + log;
+        return false;
+    }
+    return true;
+}
+
+bool isCompressedTexturePath(const std::string& path)
+{
+    const size_t dot = path.rfind('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension)
+        c = (char)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    return extension == "dds" || extension == "ktx";
+}
+
+void encodeDds(const CompressedTexture& texture, std::vector<uint8_t>& out)
+{
+    const bool dx10 = texture.format == kBC7 || texture.srgb;
+    const int width = texture.levels.empty() ? 0 : texture.levels[0].width;
+    const int height = texture.levels.empty() ? 0 : texture.levels[0].height;
+    const char* code = dx10 ? "DX10" : texture.format == kBC1 ? "DXT1" : texture.format == kBC3 ? "DXT5"
+        : texture.format == kBC4 ? "ATI1" : "ATI2";
+
+    /* CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE */
+    out.assign({ 'D', 'D', 'S', ' ' });
+    writeLittleEndian(out, 124);
+    writeLittleEndian(out, 0x1 | 0x2 | 0x4 | 0x1000 | kDdsMipMapCount | 0x80000);
+    writeLittleEndian(out, (uint32_t)height);
+    writeLittleEndian(out, (uint32_t)width);
+    writeLittleEndian(out, texture.levels.empty() ? 0 : (uint32_t)texture.levels[0].size);
+    writeLittleEndian(out, 0);
+    writeLittleEndian(out, (uint32_t)texture.levels.size());
+    out.resize(out.size() + 11 * 4, 0);
+
+    writeLittleEndian(out, 32);
+    writeLittleEndian(out, kDdsFourCC);
+    writeLittleEndian(out, fourCC(code));
+    out.resize(out.size() + 5 * 4, 0);
+
+    /* TEXTURE, plus COMPLEX | MIPMAP when there is a chain. */
+    writeLittleEndian(out, 0x1000 | (texture.levels.size() > 1 ? 0x8 | 0x400000 : 0));
+    out.resize(out.size() + 4 * 4, 0);
+
+    if (dx10)
+    {
+        writeLittleEndian(out, dxgiFromFormat(texture.format, texture.srgb));
+        writeLittleEndian(out, kDxgiTexture2D);
+        writeLittleEndian(out, 0);
+        writeLittleEndian(out, 1);
+        writeLittleEndian(out, 0);
+    }
+    out.insert(out.end(), texture.data.begin(), texture.data.end());
+}
+
+GLenum compressedGlFormat(BlockFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case kBC1: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case kBC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case kBC4: return GL_COMPRESSED_RED_RGTC1;
+    case kBC5: return GL_COMPRESSED_RG_RGTC2;
+    case kBC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+    }
+    return 0;
+}
+
+bool compressedFormatSupported(BlockFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case kBC1:
+    case kBC3:
+        return GLAD_GL_EXT_texture_compression_s3tc && (!srgb || GLAD_GL_EXT_texture_sRGB);
+    case kBC4:
+    case kBC5:
+        return true;
+    case kBC7:
+        return GLAD_GL_ARB_texture_compression_bptc || GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2);
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+
+/* Block-compressed textures in DDS and KTX (version 1) containers.
+
+   Only plain 2D textures are accepted: no cube maps, arrays or volumes. The
+   DDS reader takes the legacy DXT1, DXT5, ATI1/BC4U and ATI2/BC5U codes and
+   the DX10 header with the BC1, BC3, BC4, BC5 and BC7 DXGI formats; the KTX
+   reader takes the matching GL internal formats. Mip levels are kept as
+   stored, largest first. */
+
+struct CompressedLevel
+{
+    int width;
+    int height;
+    size_t offset;  /* into CompressedTexture::data */
+    size_t size;
+};
+
+struct CompressedTexture
+{
+    BlockFormat format;
+    bool srgb;
+    std::vector<CompressedLevel> levels;
+    std::vector<uint8_t> data;
+};
+
+bool decodeDds(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log);
+bool decodeKtx(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log);
+
+/* Picks the reader from the file signature. */
+bool decodeTextureContainer(const uint8_t* data, size_t size, CompressedTexture& texture, std::string& log);
+
+/* readBinaryFile() followed by decodeTextureContainer(); log is prefixed with the path. */
+bool loadCompressedTexture(const std::string& path, CompressedTexture& texture, std::string& log);
+
+/* True for the .dds and .ktx extensions. */
+bool isCompressedTexturePath(const std::string& path);
+
+/* Writes a DDS file, with the DX10 header only where the legacy one cannot
+   describe the format (BC7 and sRGB). */
+void encodeDds(const CompressedTexture& texture, std::vector<uint8_t>& out);
+
+/* GL internal format for glCompressedTexImage2D. */
+GLenum compressedGlFormat(BlockFormat format, bool srgb);
+
+/* Whether the current context can sample the format: BC1/BC3 need
+   EXT_texture_compression_s3tc (and EXT_texture_sRGB for sRGB), BC4/BC5 are
+   core, BC7 needs ARB_texture_compression_bptc or GL 4.2. */
+bool compressedFormatSupported(BlockFormat format, bool srgb);
@@ -0,0 +1,415 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include "ThreadPool.h"
+#include "Timer.h"
+
+size_t textureLevelBytes(GLenum internalFormat, int width, int height)
+{
+    const size_t texels = (size_t)width * height;
+    const size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+        return blocks * 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+        return blocks * 16;
+    case GL_R8:
+        return texels;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return texels * 2;
+    case GL_RGBA16F:
+    case GL_RGBA16:
+    case GL_RG32F:
+        return texels * 8;
+    case GL_RGBA32F:
+        return texels * 16;
+    default:
+        /* RGBA8, sRGB, RGB8 padded, RG16F, R32F, 24/32-bit depth. */
+        return texels * 4;
+    }
+}
+
+size_t estimateTextureBytes(GLuint texture)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    size_t bytes = 0;
+    for (GLint level = 0; level < 16; ++level)
+    {
+        GLint width = 0, height = 0, format = 0, compressed = GL_FALSE;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0)
+            continue;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            bytes += (size_t)size;
+            continue;
+        }
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        bytes += textureLevelBytes((GLenum)format, width, height);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return bytes;
+}
+
+TextureResidency::TextureResidency(size_t budget)
+    : m_budget(budget)
+    , m_frame(0)
+    , m_levelsLoaded(0)
+    , m_levelsReleased(0)
+    , m_bytesUploaded(0)
+    , m_cpuSeconds(0.0)
+{
+}
+
+TextureResidency::~TextureResidency()
+{
+    for (const Entry& entry : m_entries)
+        if (!entry.tracked)
+            glDeleteTextures(1, &entry.texture);
+}
+
+GLuint TextureResidency::add(std::vector<Image> levels, bool srgb)
+{
+    if (levels.empty())
+        return 0;
+    Entry entry = {};
+    entry.compressed = false;
+    entry.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    entry.levels = std::move(levels);
+    return create(entry);
+}
+
+GLuint TextureResidency::add(const CompressedTexture& texture)
+{
+    if (texture.levels.empty())
+        return 0;
+    Entry entry = {};
+    entry.compressed = compressedFormatSupported(texture.format, texture.srgb);
+    entry.internalFormat = entry.compressed ? compressedGlFormat(texture.format, texture.srgb)
+        : texture.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    for (const CompressedLevel& level : texture.levels)
+    {
+        Image image;
+        const uint8_t* data = texture.data.data() + level.offset;
+        if (entry.compressed)
+        {
+            image.width = level.width;
+            image.height = level.height;
+            image.pixels.assign(data, data + level.size);
+        }
+        else
+            decompressImage(texture.format, data, level.width, level.height, ThreadPool::shared(), image);
+        entry.levels.push_back(std::move(image));
+    }
+    return create(entry);
+}
+
+GLuint TextureResidency::create(Entry& entry)
+{
+    const int levelCount = (int)entry.levels.size();
+    entry.tracked = false;
+    entry.width = entry.levels[0].width;
+    entry.height = entry.levels[0].height;
+    entry.tail = levelCount - 1;
+    for (int level = 0; level < levelCount; ++level)
+    {
+        const Image& image = entry.levels[level];
+        entry.levelBytes.push_back(textureLevelBytes(entry.internalFormat, image.width, image.height));
+        if (level < entry.tail && std::max(image.width, image.height) <= kTailSize)
+            entry.tail = level;
+    }
+    entry.screenSize = 0.0f;
+    entry.demandFrame = 0;
+    entry.trackedBytes = 0;
+
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    entry.base = levelCount;
+    for (int level = levelCount - 1; level >= entry.tail; --level)
+        uploadLevel(entry, level);
+    entry.target = entry.tail;
+    entry.wanted = entry.tail;
+
+    const GLuint texture = entry.texture;
+    m_index[texture] = m_entries.size();
+    m_entries.push_back(std::move(entry));
+    return texture;
+}
+
+void TextureResidency::track(GLuint texture)
+{
+    const auto found = m_index.find(texture);
+    if (found != m_index.end() && !m_entries[found->second].tracked)
+        return;
+
+    const size_t bytes = estimateTextureBytes(texture);
+    if (found != m_index.end())
+    {
+        m_entries[found->second].trackedBytes = bytes;
+        return;
+    }
+
+    Entry entry = {};
+    entry.texture = texture;
+    entry.tracked = true;
+    entry.trackedBytes = bytes;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &entry.width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &entry.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_index[texture] = m_entries.size();
+    m_entries.push_back(std::move(entry));
+}
+
+void TextureResidency::remove(GLuint texture)
+{
+    const auto found = m_index.find(texture);
+    if (found == m_index.end())
+        return;
+    const size_t index = found->second;
+    if (!m_entries[index].tracked)
+        glDeleteTextures(1, &m_entries[index].texture);
+    m_index.erase(found);
+    if (index + 1 != m_entries.size())
+    {
+        m_entries[index] = std::move(m_entries.back());
+        m_index[m_entries[index].texture] = index;
+    }
+    m_entries.pop_back();
+}
+
+void TextureResidency::demand(GLuint texture, float screenSize)
+{
+    const auto found = m_index.find(texture);
+    if (found == m_index.end())
+        return;
+    Entry& entry = m_entries[found->second];
+    if (entry.demandFrame != m_frame || entry.screenSize < screenSize)
+        entry.screenSize = screenSize;
+    entry.demandFrame = m_frame;
+}
+
+size_t TextureResidency::bytesFrom(const Entry& entry, int level) const
+{
+    size_t bytes = 0;
+    for (size_t i = level; i < entry.levelBytes.size(); ++i)
+        bytes += entry.levelBytes[i];
+    return bytes;
+}
+
+int TextureResidency::wantedLevel(const Entry& entry) const
+{
+    if (m_frame - entry.demandFrame >= kDemandFrames || entry.screenSize <= 0.0f)
+        return entry.tail;
+    /* The finest level still at least as large as the texture on screen. */
+    const float ratio = std::max(entry.width, entry.height) / entry.screenSize;
+    const int level = ratio > 1.0f ? (int)std::floor(std::log2(ratio)) : 0;
+    return std::min(level, entry.tail);
+}
+
+float TextureResidency::density(const Entry& entry, int level)
+{
+    return entry.screenSize / (float)std::max(std::max(entry.width, entry.height) >> level, 1);
+}
+
+void TextureResidency::fitBudget()
+{
+    size_t total = 0;
+    for (Entry& entry : m_entries)
+    {
+        if (entry.tracked)
+        {
+            total += entry.trackedBytes;
+            continue;
+        }
+        entry.wanted = wantedLevel(entry);
+        entry.target = entry.wanted;
+        total += bytesFrom(entry, entry.target);
+    }
+    if (total <= m_budget)
+        return;
+
+    /* Least visible detail first: the level with the fewest screen pixels
+       per texel goes, then the next, until the rest fits. */
+    typedef std::pair<float, size_t> Candidate;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        if (!m_entries[i].tracked && m_entries[i].target < m_entries[i].tail)
+            candidates.push(Candidate(density(m_entries[i], m_entries[i].target), i));
+    while (total > m_budget && !candidates.empty())
+    {
+        Entry& entry = m_entries[candidates.top().second];
+        candidates.pop();
+        total -= entry.levelBytes[entry.target];
+        entry.target++;
+        if (entry.target < entry.tail)
+            candidates.push(Candidate(density(entry, entry.target), (size_t)(&entry - m_entries.data())));
+    }
+}
+
+void TextureResidency::release(Entry& entry)
+{
+    if (entry.base >= entry.target)
+        return;
+    /* A 0 x 0 image frees the level; levels outside BASE..MAX do not take
+       part in completeness, so its format does not matter. */
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.target);
+    for (int level = entry.base; level < entry.target; ++level)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    m_levelsReleased += entry.target - entry.base;
+    entry.base = entry.target;
+}
+
+void TextureResidency::uploadLevel(Entry& entry, int level)
+{
+    const Image& image = entry.levels[level];
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (entry.compressed)
+    {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, image.width, image.height, 0,
+            (GLsizei)image.pixels.size(), image.pixels.data());
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, image.width, image.height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    entry.base = level;
+    m_levelsLoaded++;
+    m_bytesUploaded += image.pixels.size();
+}
+
+void TextureResidency::update(size_t uploadBudget)
+{
+    const double start = nowSeconds();
+    fitBudget();
+
+    /* Releases first, so the uploads below never push past the budget. */
+    std::vector<size_t> due;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        Entry& entry = m_entries[i];
+        if (entry.tracked)
+            continue;
+        release(entry);
+        if (entry.base > entry.target)
+            due.push_back(i);
+    }
+
+    /* The blurriest texture on screen first, one level per texture per
+       round, so a single large texture cannot hold up the rest. */
+    std::sort(due.begin(), due.end(), [this](size_t a, size_t b) {
+        const Entry& left = m_entries[a];
+        const Entry& right = m_entries[b];
+        return density(left, left.base) > density(right, right.base);
+    });
+    size_t uploaded = 0;
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (size_t i : due)
+        {
+            Entry& entry = m_entries[i];
+            if (entry.base <= entry.target)
+                continue;
+            const size_t bytes = entry.levels[entry.base - 1].pixels.size();
+            if (uploaded > 0 && uploaded + bytes > uploadBudget)
+                continue;
+            uploadLevel(entry, entry.base - 1);
+            uploaded += bytes;
+            progress = true;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_frame++;
+    m_cpuSeconds += nowSeconds() - start;
+}
+
+TextureResidency::Stats TextureResidency::stats() const
+{
+    Stats stats = {};
+    stats.budget = m_budget;
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.tracked)
+        {
+            stats.tracked++;
+            stats.trackedBytes += entry.trackedBytes;
+            continue;
+        }
+        stats.textures++;
+        stats.residentBytes += bytesFrom(entry, entry.base);
+        stats.wantedBytes += bytesFrom(entry, entry.wanted);
+        stats.fullBytes += bytesFrom(entry, 0);
+        stats.reduced += entry.target > entry.wanted;
+        stats.pending += entry.base > entry.target;
+    }
+    stats.levelsLoaded = m_levelsLoaded;
+    stats.levelsReleased = m_levelsReleased;
+    stats.bytesUploaded = m_bytesUploaded;
+    stats.cpuSeconds = m_cpuSeconds;
+    return stats;
+}
+
+std::vector<TextureResidency::Usage> TextureResidency::usage() const
+{
+    std::vector<Usage> result;
+    result.reserve(m_entries.size());
+    for (const Entry& entry : m_entries)
+    {
+        Usage usage = {};
+        usage.texture = entry.texture;
+        usage.tracked = entry.tracked;
+        usage.width = entry.width;
+        usage.height = entry.height;
+        if (entry.tracked)
+        {
+            usage.residentBytes = entry.trackedBytes;
+            usage.fullBytes = entry.trackedBytes;
+        }
+        else
+        {
+            usage.levels = (int)entry.levels.size();
+            usage.baseLevel = entry.base;
+            usage.targetLevel = entry.target;
+            usage.wantedLevel = entry.wanted;
+            usage.screenSize = m_frame - entry.demandFrame > kDemandFrames ? 0.0f : entry.screenSize;
+            usage.residentBytes = bytesFrom(entry, entry.base);
+            usage.fullBytes = bytesFrom(entry, 0);
+        }
+        result.push_back(usage);
+    }
+    std::sort(result.begin(), result.end(), [](const Usage& a, const Usage& b) {
+        return a.residentBytes > b.residentBytes;
+    });
+    return result;
+}
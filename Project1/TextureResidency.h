@@ -0,0 +1,165 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Image.h"
+#include "TextureContainer.h"
+
+/* Keeps the textures in video memory under a byte budget by streaming their
+   mip levels in and out.
+
+   Managed textures (add()) keep every level in system memory; only the GPU
+   copy is budgeted. Each frame the renderer reports how large each texture
+   appears on screen (demand()), which picks the finest level worth having.
+   When the wanted levels add up to more than the budget, update() gives up
+   detail where it is least visible first: the texture whose finest wanted
+   level has the fewest screen pixels per texel loses that level, repeatedly,
+   until everything fits. Levels no longer wanted are released at once;
+   missing ones are uploaded finest-needed first, limited to a number of
+   bytes per frame. GL_TEXTURE_BASE_LEVEL follows the finest resident level
+   and GL_TEXTURE_MAX_LEVEL stays at the last one, so a texture is always
+   complete and simply samples blurrier while a level is out.
+
+   Levels are defined with glTexImage2D rather than immutable storage, since
+   releasing one means redefining it as 0 x 0. The mip tail, every level of
+   at most kTailSize texels a side, is uploaded by add() and never released.
+
+   Other textures can be tracked for accounting only (track()): their size is
+   estimated from the levels GL reports and counts against the budget, but
+   they are never touched. */
+class TextureResidency
+{
+public:
+    enum
+    {
+        kTailSize = 64,
+        kDemandFrames = 30,     /* frames a demand() stays valid */
+    };
+
+    struct Stats
+    {
+        size_t textures;            /* managed */
+        size_t tracked;             /* accounting only */
+        size_t budget;
+        size_t residentBytes;       /* managed levels in video memory */
+        size_t trackedBytes;
+        size_t wantedBytes;         /* what the demand would need without a budget */
+        size_t fullBytes;           /* every managed level */
+        size_t reduced;             /* textures held coarser than wanted by the budget */
+        size_t pending;             /* textures still missing a level they are allowed */
+        uint64_t levelsLoaded;
+        uint64_t levelsReleased;
+        uint64_t bytesUploaded;
+        double cpuSeconds;          /* in update() */
+    };
+
+    struct Usage
+    {
+        GLuint texture;
+        bool tracked;               /* accounting only */
+        int width;
+        int height;
+        int levels;
+        int baseLevel;              /* finest resident level */
+        int targetLevel;            /* finest level allowed under the budget */
+        int wantedLevel;            /* finest level the demand asks for */
+        float screenSize;           /* last demand, 0 when it has expired */
+        size_t residentBytes;
+        size_t fullBytes;
+    };
+
+    explicit TextureResidency(size_t budget);
+    ~TextureResidency();
+
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+    /* GL thread. Creates a texture from a full RGBA8 mip chain, level 0 first
+       (see generateMips()), and uploads its tail. The texture belongs to the
+       manager until remove(). */
+    GLuint add(std::vector<Image> levels, bool srgb = false);
+
+    /* GL thread. As add(), keeping the stored block format; expanded to RGBA8
+       on the shared pool when the driver cannot sample it. */
+    GLuint add(const CompressedTexture& texture);
+
+    /* GL thread. Counts an existing texture against the budget. Call again
+       when its levels change; the size is read back from GL each time. */
+    void track(GLuint texture);
+
+    /* GL thread. Deletes a managed texture, or stops tracking another one. */
+    void remove(GLuint texture);
+
+    /* The texture covers about screenSize pixels across its wider side this
+       frame. The largest report of a frame counts; textures without one for
+       kDemandFrames frames fall back to their tail. */
+    void demand(GLuint texture, float screenSize);
+
+    void setBudget(size_t bytes) { m_budget = bytes; }
+    size_t budget() const { return m_budget; }
+
+    /* GL thread, once per frame after the demands. Releases levels, then
+       uploads at most uploadBudget bytes (and always at least one level when
+       one is due). */
+    void update(size_t uploadBudget);
+
+    Stats stats() const;
+
+    /* One entry per managed and tracked texture, largest resident first. */
+    std::vector<Usage> usage() const;
+
+private:
+    struct Entry
+    {
+        GLuint texture;
+        bool tracked;
+        bool compressed;
+        GLenum internalFormat;
+        std::vector<Image> levels;          /* block data when compressed */
+        std::vector<size_t> levelBytes;     /* video memory per level */
+        int width;
+        int height;
+        int tail;                           /* coarsest level that may be released, plus one */
+        int base;
+        int target;
+        int wanted;
+        float screenSize;
+        uint64_t demandFrame;
+        size_t trackedBytes;
+    };
+
+    GLuint create(Entry& entry);
+    size_t bytesFrom(const Entry& entry, int level) const;
+    int wantedLevel(const Entry& entry) const;
+
+    /* Pixels per texel of the entry's level at the given demand; the
+       smallest is the first to lose detail. */
+    static float density(const Entry& entry, int level);
+
+    void fitBudget();
+    void release(Entry& entry);
+    void uploadLevel(Entry& entry, int level);
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<GLuint, size_t> m_index;
+    size_t m_budget;
+    uint64_t m_frame;
+    uint64_t m_levelsLoaded;
+    uint64_t m_levelsReleased;
+    uint64_t m_bytesUploaded;
+    double m_cpuSeconds;
+};
+
+/* Video memory of one width x height level in the given internal format, as
+   the driver is likely to lay it out (RGB8 padded to 4 bytes, compressed
+   formats in whole 4x4 blocks). */
+size_t textureLevelBytes(GLenum internalFormat, int width, int height);
+
+/* GL thread. Sum of textureLevelBytes() over the levels GL reports for a
+   2D texture; binds it to GL_TEXTURE_2D on the active unit. */
+size_t estimateTextureBytes(GLuint texture);
@@ -0,0 +1,384 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "ThreadPool.h"
+#include "Timer.h"
+
+static const uint8_t kPlaceholder[4] = { 128, 128, 128, 255 };
+
+TextureStreamer::TextureStreamer(ThreadPool& pool, size_t stagingSize, int stagingCount)
+    : m_pool(pool)
+    , m_queue(std::make_shared<Queue>())
+    , m_staging(stagingCount > 0 ? stagingCount : 1)
+    , m_stagingSize(stagingSize)
+    , m_nextStaging(0)
+    , m_pending(0)
+    , m_compressedSupport(0)
+    , m_stats()
+{
+    m_mipOptions.filter = kMipKaiser;
+    m_mipOptions.srgb = true;
+    m_mipOptions.premultiplied = false;
+    for (int format = kBC1; format <= kBC7; ++format)
+    {
+        for (int srgb = 0; srgb < 2; ++srgb)
+        {
+            if (compressedFormatSupported((BlockFormat)format, srgb != 0))
+                m_compressedSupport |= 1u << (format * 2 + srgb);
+        }
+    }
+    m_queue->closed = false;
+    for (Staging& staging : m_staging)
+    {
+        glGenBuffers(1, &staging.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_stagingSize, NULL, GL_STREAM_DRAW);
+        staging.fence = NULL;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queue->mutex);
+        m_queue->closed = true;
+        m_queue->decoded.clear();
+    }
+    for (Staging& staging : m_staging)
+    {
+        if (staging.fence)
+            glDeleteSync(staging.fence);
+        glDeleteBuffers(1, &staging.buffer);
+    }
+}
+
+GLuint TextureStreamer::reserve()
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kPlaceholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_stats.requested++;
+    m_pending++;
+    return texture;
+}
+
+void TextureStreamer::publish(const std::shared_ptr<Queue>& queue, Upload& upload)
+{
+    upload.started = false;
+    upload.level = (int)upload.levels.size() - 1;
+    upload.nextRow = 0;
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->closed)
+        queue->decoded.push_back(std::move(upload));
+}
+
+GLuint TextureStreamer::request(Decoder decoder, bool mipmaps)
+{
+    const GLuint texture = reserve();
+    request(texture, decoder, mipmaps);
+    return texture;
+}
+
+GLuint TextureStreamer::requestCompressed(CompressedDecoder decoder)
+{
+    const GLuint texture = reserve();
+    requestCompressed(texture, decoder);
+    return texture;
+}
+
+void TextureStreamer::request(GLuint texture, Decoder decoder, bool mipmaps)
+{
+    std::shared_ptr<Queue> queue = m_queue;
+    ThreadPool* pool = &m_pool;
+    const MipOptions mipOptions = m_mipOptions;
+    m_pool.enqueue([queue, pool, decoder, texture, mipmaps, mipOptions]()
+    {
+        Upload upload;
+        upload.texture = texture;
+        upload.mipmaps = mipmaps;
+        upload.internalFormat = GL_RGBA8;
+        upload.compressed = false;
+        upload.expanded = false;
+        upload.blockBytes = 0;
+        upload.levels.resize(1);
+        Image& image = upload.levels[0];
+        image.width = image.height = 0;
+        upload.ok = decoder(image, upload.log);
+        if (upload.ok && (image.width <= 0 || image.height <= 0
+            || image.pixels.size() < (size_t)image.width * image.height * 4))
+        {
+            upload.ok = false;
+            upload.log = "decoder returned an empty or truncated image";
+        }
+
+        /* parallelFor runs on the caller as well, so this is safe from a job. */
+        if (upload.ok && mipmaps)
+        {
+            std::vector<Image> mips;
+            generateMips(image, mipOptions, *pool, mips);
+            for (Image& mip : mips)
+                upload.levels.push_back(std::move(mip));
+        }
+        publish(queue, upload);
+    });
+}
+
+void TextureStreamer::requestCompressed(GLuint texture, CompressedDecoder decoder)
+{
+    std::shared_ptr<Queue> queue = m_queue;
+    ThreadPool* pool = &m_pool;
+    const unsigned support = m_compressedSupport;
+    m_pool.enqueue([queue, pool, decoder, texture, support]()
+    {
+        Upload upload;
+        upload.texture = texture;
+        upload.compressed = false;
+        upload.expanded = false;
+        CompressedTexture source;
+        upload.ok = decoder(source, upload.log);
+        if (upload.ok && source.levels.empty())
+        {
+            upload.ok = false;
+            upload.log = "decoder returned no levels";
+        }
+
+        if (upload.ok)
+        {
+            const bool native = (support >> (source.format * 2 + (source.srgb ? 1 : 0)) & 1) != 0;
+            upload.mipmaps = source.levels.size() > 1;
+            upload.compressed = native;
+            upload.blockBytes = blockBytes(source.format);
+            upload.internalFormat = native ? compressedGlFormat(source.format, source.srgb)
+                : source.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            for (const CompressedLevel& level : source.levels)
+            {
+                Image image;
+                const uint8_t* data = source.data.data() + level.offset;
+                if (native)
+                {
+                    image.width = level.width;
+                    image.height = level.height;
+                    image.pixels.assign(data, data + level.size);
+                }
+                else
+                    decompressImage(source.format, data, level.width, level.height, *pool, image);
+                upload.levels.push_back(std::move(image));
+            }
+            upload.expanded = !native;
+        }
+        publish(queue, upload);
+    });
+}
+
+size_t TextureStreamer::rowBytes(const Upload& upload, const Image& image)
+{
+    return upload.compressed ? (size_t)((image.width + 3) / 4) * upload.blockBytes : (size_t)image.width * 4;
+}
+
+int TextureStreamer::rowCount(const Upload& upload, const Image& image)
+{
+    return upload.compressed ? (image.height + 3) / 4 : image.height;
+}
+
+void TextureStreamer::uploadRows(const Upload& upload, const Image& image, int firstRow, int rows, const void* data)
+{
+    if (upload.compressed)
+    {
+        /* Sub-images cover whole blocks, except where they reach the edge. */
+        const int y = firstRow * 4;
+        const int height = std::min(rows * 4, image.height - y);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, image.width, height, upload.internalFormat,
+            (GLsizei)(rowBytes(upload, image) * rows), data);
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, firstRow, image.width, rows,
+            GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+void TextureStreamer::allocateLevel(const Upload& upload, int level)
+{
+    /* With no unpack buffer bound NULL means "no data". */
+    const Image& image = upload.levels[level];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (upload.compressed)
+    {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, upload.internalFormat, image.width, image.height, 0,
+            (GLsizei)image.pixels.size(), NULL);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, upload.internalFormat, image.width, image.height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+}
+
+bool TextureStreamer::begin(Upload& upload)
+{
+    if (!upload.ok)
+    {
+        fprintf(stderr, "texture %u failed to decode: %s\n", upload.texture, upload.log.c_str());
+        m_stats.failed++;
+        m_pending--;
+        return false;
+    }
+
+    /* Level 0 still holds the placeholder and BASE/MAX_LEVEL keep it the
+       only level sampled until the smallest real level is in. With mipmaps,
+       level 0 is the last to go up and is only reallocated then; a single
+       level texture moves the placeholder to level 1 first. */
+    if (upload.expanded)
+        m_stats.expanded++;
+    glBindTexture(GL_TEXTURE_2D, upload.texture);
+    if (upload.levels.size() == 1)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kPlaceholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1);
+        allocateLevel(upload, 0);
+    }
+    else
+    {
+        for (int level = 1; level < (int)upload.levels.size(); ++level)
+            allocateLevel(upload, level);
+    }
+    if (upload.mipmaps)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    upload.started = true;
+    return true;
+}
+
+bool TextureStreamer::finishLevel(Upload& upload)
+{
+    glBindTexture(GL_TEXTURE_2D, upload.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)upload.levels.size() - 1);
+    if (upload.levels.size() == 1)
+        glTexImage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    /* The decoded pixels are no longer needed once they are on the GPU. */
+    upload.levels[upload.level] = Image();
+    if (upload.level > 0)
+    {
+        upload.level--;
+        upload.nextRow = 0;
+        if (upload.level == 0)
+            allocateLevel(upload, 0);
+        return false;
+    }
+
+    m_stats.completed++;
+    m_pending--;
+    return true;
+}
+
+void TextureStreamer::update(size_t byteBudget)
+{
+    const double start = nowSeconds();
+
+    {
+        std::lock_guard<std::mutex> lock(m_queue->mutex);
+        while (!m_queue->decoded.empty())
+        {
+            m_uploads.push_back(std::move(m_queue->decoded.front()));
+            m_queue->decoded.pop_front();
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    size_t budget = byteBudget;
+    bool firstSlice = true;
+    while (!m_uploads.empty())
+    {
+        Upload& upload = m_uploads.front();
+        if (!upload.started)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (!begin(upload))
+            {
+                m_uploads.pop_front();
+                continue;
+            }
+        }
+
+        /* A single row larger than a staging buffer cannot be banded; upload
+           the level from client memory in one go instead. */
+        const Image& image = upload.levels[upload.level];
+        const size_t bytesPerRow = rowBytes(upload, image);
+        const int rowTotal = rowCount(upload, image);
+        if (bytesPerRow > m_stagingSize)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glBindTexture(GL_TEXTURE_2D, upload.texture);
+            uploadRows(upload, image, 0, rowTotal, image.pixels.data());
+            budget -= std::min(budget, image.pixels.size());
+            firstSlice = false;
+            m_stats.bytesUploaded += image.pixels.size();
+            m_stats.slices++;
+            if (finishLevel(upload))
+                m_uploads.pop_front();
+            continue;
+        }
+
+        /* Rows that fit both the staging buffer and what is left of the
+           budget; the first band of a frame always moves at least one row. */
+        const int remaining = rowTotal - upload.nextRow;
+        int rows = (int)std::min<size_t>(remaining, std::min(budget, m_stagingSize) / bytesPerRow);
+        if (rows == 0 && firstSlice)
+            rows = 1;
+        if (rows == 0)
+            break;
+
+        Staging& staging = m_staging[m_nextStaging];
+        if (staging.fence)
+        {
+            GLenum state = glClientWaitSync(staging.fence, 0, 0);
+            if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+            {
+                m_stats.stagingStalls++;
+                break;
+            }
+            glDeleteSync(staging.fence);
+            staging.fence = NULL;
+        }
+
+        /* The GPU is done with this buffer, so nothing needs to synchronise. */
+        const size_t bytes = bytesPerRow * rows;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!mapped)
+            break;
+        memcpy(mapped, image.pixels.data() + bytesPerRow * upload.nextRow, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D, upload.texture);
+        uploadRows(upload, image, upload.nextRow, rows, (void*)0);
+        staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_nextStaging = (m_nextStaging + 1) % m_staging.size();
+
+        upload.nextRow += rows;
+        budget -= std::min(budget, bytes);
+        firstSlice = false;
+        m_stats.bytesUploaded += bytes;
+        m_stats.slices++;
+
+        if (upload.nextRow == rowTotal && finishLevel(upload))
+            m_uploads.pop_front();
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_stats.cpuSeconds += nowSeconds() - start;
+}
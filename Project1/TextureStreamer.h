@@ -0,0 +1,153 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "MipGenerator.h"
+#include "TextureContainer.h"
+
+class ThreadPool;
+
+/* Streams textures in without frame spikes.
+
+   request() creates the texture straight away with a 1x1 grey placeholder,
+   shown until the first real level is in, and queues the decoder on the
+   thread pool. update(), called once per frame on the GL thread, takes
+   decoded images and copies at most a given number of bytes into a small ring
+   of GL_PIXEL_UNPACK_BUFFER staging buffers, issuing glTexSubImage2D from
+   them a band of rows at a time, so a large image is spread over several
+   frames. A staging buffer is only reused once the fence of its last upload
+   has signalled; if none is free the upload simply resumes next frame.
+
+   Mipmaps, when asked for, are built on the worker right after decoding (see
+   MipGenerator.h) instead of with glGenerateMipmap on the GL thread. Levels go
+   up smallest first and GL_TEXTURE_BASE_LEVEL follows the last complete one,
+   so a texture starts out blurry and sharpens as its larger levels arrive.
+
+   Block-compressed textures (requestCompressed) take the same path with rows
+   of 4x4 blocks in place of texel rows, keeping the mip levels stored in the
+   file. When the driver lacks the format they are expanded to RGBA8 on the
+   worker instead. */
+class TextureStreamer
+{
+public:
+    /* Runs on a worker thread; fills image or returns false with a message. */
+    typedef std::function<bool(Image& image, std::string& log)> Decoder;
+    typedef std::function<bool(CompressedTexture& texture, std::string& log)> CompressedDecoder;
+
+    struct Stats
+    {
+        uint64_t requested;
+        uint64_t completed;
+        uint64_t failed;          /* decoder errors; the placeholder stays */
+        uint64_t bytesUploaded;
+        uint64_t slices;          /* glTexSubImage2D calls */
+        uint64_t stagingStalls;   /* updates cut short because every staging buffer was busy */
+        uint64_t expanded;        /* compressed textures decoded on the CPU for lack of driver support */
+        double cpuSeconds;        /* spent in update() */
+    };
+
+    TextureStreamer(ThreadPool& pool, size_t stagingSize = 4 << 20, int stagingCount = 3);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /* GL thread. The returned texture belongs to the caller and is usable at
+       once; its contents change as the upload progresses. */
+    GLuint request(Decoder decoder, bool mipmaps = true);
+
+    /* GL thread. As request(), for a DDS or KTX style texture. */
+    GLuint requestCompressed(CompressedDecoder decoder);
+
+    /* GL thread. The placeholder alone, for when the data is still being read;
+       pass it to one of the overloads below once it is in. Counts as pending
+       until then. */
+    GLuint reserve();
+    void request(GLuint texture, Decoder decoder, bool mipmaps = true);
+    void requestCompressed(GLuint texture, CompressedDecoder decoder);
+
+    /* Filter and colour handling for the mipmaps of later requests. Defaults
+       to the Kaiser filter on straight-alpha sRGB images. */
+    void setMipOptions(const MipOptions& options) { m_mipOptions = options; }
+
+    /* GL thread, once per frame. Uploads up to byteBudget bytes. */
+    void update(size_t byteBudget);
+
+    /* Textures requested but not completely uploaded yet. */
+    size_t pending() const { return m_pending; }
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Upload
+    {
+        GLuint texture;
+        bool mipmaps;
+        bool ok;
+        std::string log;
+        std::vector<Image> levels;  /* levels[0] is the decoded image; block data when compressed */
+        GLenum internalFormat;
+        bool compressed;
+        bool expanded;              /* compressed on disk, RGBA8 on the GPU */
+        size_t blockBytes;
+        bool started;
+        int level;                  /* being uploaded, counting down to 0 */
+        int nextRow;                /* texel rows, or block rows when compressed */
+    };
+
+    /* Outlives the streamer while decode jobs are still queued on the pool. */
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Upload> decoded;
+        bool closed;
+    };
+
+    struct Staging
+    {
+        GLuint buffer;
+        GLsync fence;
+    };
+
+    /* Hands a decoded upload to the GL thread. Worker threads. */
+    static void publish(const std::shared_ptr<Queue>& queue, Upload& upload);
+
+    /* Size of one row of the current level, in bytes and in rows, and the
+       glTexSubImage2D / glCompressedTexSubImage2D call covering some of them. */
+    static size_t rowBytes(const Upload& upload, const Image& image);
+    static int rowCount(const Upload& upload, const Image& image);
+    static void uploadRows(const Upload& upload, const Image& image, int firstRow, int rows, const void* data);
+
+    /* Gives a level its real size with undefined contents. */
+    static void allocateLevel(const Upload& upload, int level);
+
+    /* Allocates the levels that can be without hiding the placeholder.
+       Returns false when decoding failed. */
+    bool begin(Upload& upload);
+
+    /* Makes the level just uploaded the base level and moves on to the next
+       larger one, allocating level 0 when its turn comes. Returns true once
+       level 0 is in. */
+    bool finishLevel(Upload& upload);
+
+    ThreadPool& m_pool;
+    std::shared_ptr<Queue> m_queue;
+    std::vector<Staging> m_staging;
+    size_t m_stagingSize;
+    size_t m_nextStaging;
+    std::deque<Upload> m_uploads;
+    size_t m_pending;
+    MipOptions m_mipOptions;
+    unsigned m_compressedSupport;   /* bit format * 2 + srgb */
+    Stats m_stats;
+};
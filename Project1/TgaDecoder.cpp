@@ -0,0 +1,206 @@
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    /* 15/16-bit ARRRRRGGGGGBBBBB to BGRA. */
+    inline void expand16(const uint8_t* p, bool hasAlpha, uint8_t* out)
+    {
+        const int value = p[0] | p[1] << 8;
+        out[0] = (uint8_t)((value & 0x1f) * 255 / 31);
+        out[1] = (uint8_t)(((value >> 5) & 0x1f) * 255 / 31);
+        out[2] = (uint8_t)(((value >> 10) & 0x1f) * 255 / 31);
+        out[3] = hasAlpha && !(value & 0x8000) ? 0 : 255;
+    }
+}
+
+bool decodeTga(const uint8_t* data, size_t size, const ImageOptions& options, Image& image, std::string& log)
+{
+    if (size < 18)
+    {
+        log = "tga: truncated header";
+        return false;
+    }
+
+    const int idLength = data[0];
+    const int colorMapType = data[1];
+    const int imageType = data[2];
+    const int mapFirst = data[3] | data[4] << 8;
+    const int mapLength = data[5] | data[6] << 8;
+    const int mapDepth = data[7];
+    const int width = data[12] | data[13] << 8;
+    const int height = data[14] | data[15] << 8;
+    const int depth = data[16];
+    const int descriptor = data[17];
+    const int alphaBits = descriptor & 0x0f;
+    const bool topDown = (descriptor & 0x20) != 0;
+    const bool rightToLeft = (descriptor & 0x10) != 0;
+
+    const bool rle = imageType >= 9;
+    const int baseType = rle ? imageType - 8 : imageType;
+    const bool mapped = baseType == 1;
+    const bool gray = baseType == 3;
+    if ((baseType < 1 || baseType > 3) || colorMapType > 1 || (mapped && colorMapType != 1))
+    {
+        log = "tga: unsupported image type";
+        return false;
+    }
+    if ((mapped && depth != 8 && depth != 16) || (gray && depth != 8 && depth != 16)
+        || (baseType == 2 && depth != 15 && depth != 16 && depth != 24 && depth != 32)
+        || (mapped && mapDepth != 15 && mapDepth != 16 && mapDepth != 24 && mapDepth != 32))
+    {
+        log = "tga: unsupported pixel depth";
+        return false;
+    }
+    if (width <= 0 || height <= 0)
+    {
+        log = "tga: bad dimensions";
+        return false;
+    }
+
+    const uint8_t* cursor = data + 18 + idLength;
+    const uint8_t* end = data + size;
+    const int mapEntryBytes = (mapDepth + 7) / 8;
+    const size_t mapBytes = colorMapType ? (size_t)mapLength * mapEntryBytes : 0;
+    if ((size_t)(end - data) < 18 + idLength + mapBytes)
+    {
+        log = "tga: truncated colour map";
+        return false;
+    }
+
+    /* The colour map, expanded to BGRA once. */
+    std::vector<uint8_t> palette;
+    if (mapped)
+    {
+        palette.assign((size_t)(mapFirst + mapLength) * 4, 0);
+        for (int i = 0; i < mapLength; ++i)
+        {
+            const uint8_t* entry = cursor + (size_t)i * mapEntryBytes;
+            uint8_t* out = &palette[(size_t)(mapFirst + i) * 4];
+            if (mapEntryBytes == 2)
+                expand16(entry, mapDepth == 16 && alphaBits > 0, out);
+            else
+            {
+                out[0] = entry[0];
+                out[1] = entry[1];
+                out[2] = entry[2];
+                out[3] = mapEntryBytes == 4 ? entry[3] : 255;
+            }
+        }
+    }
+    cursor += mapBytes;
+
+    /* Rows as stored, then as handed to convertRow(). */
+    const int pixelBytes = (depth + 7) / 8;
+    PixelFormat format = kBgra8;
+    if (gray)
+        format = depth == 8 ? kGray8 : kGrayAlpha8;
+    else if (!mapped && depth == 24)
+        format = kBgr8;
+    const bool passThrough = gray || (!mapped && (depth == 24 || (depth == 32 && alphaBits > 0)));
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t)width * height * 4);
+    std::vector<uint8_t> stored((size_t)width * pixelBytes);
+    std::vector<uint8_t> expanded((size_t)width * 4);
+
+    int runLeft = 0;
+    bool runRepeats = false;
+    uint8_t runPixel[4] = {};
+    for (int y = 0; y < height; ++y)
+    {
+        /* Gather one row of stored pixels; RLE packets may span rows. */
+        if (!rle)
+        {
+            if ((size_t)(end - cursor) < stored.size())
+            {
+                log = "tga: truncated pixel data";
+                return false;
+            }
+            memcpy(stored.data(), cursor, stored.size());
+            cursor += stored.size();
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                if (runLeft == 0)
+                {
+                    if (cursor >= end)
+                    {
+                        log = "tga: truncated RLE data";
+                        return false;
+                    }
+                    const int packet = *cursor++;
+                    runLeft = (packet & 0x7f) + 1;
+                    runRepeats = (packet & 0x80) != 0;
+                    if (runRepeats)
+                    {
+                        if (end - cursor < pixelBytes)
+                        {
+                            log = "tga: truncated RLE data";
+                            return false;
+                        }
+                        memcpy(runPixel, cursor, pixelBytes);
+                        cursor += pixelBytes;
+                    }
+                }
+                uint8_t* out = stored.data() + (size_t)x * pixelBytes;
+                if (runRepeats)
+                    memcpy(out, runPixel, pixelBytes);
+                else
+                {
+                    if (end - cursor < pixelBytes)
+                    {
+                        log = "tga: truncated RLE data";
+                        return false;
+                    }
+                    memcpy(out, cursor, pixelBytes);
+                    cursor += pixelBytes;
+                }
+                runLeft--;
+            }
+        }
+
+        if (rightToLeft)
+        {
+            for (int x = 0; x < width / 2; ++x)
+                std::swap_ranges(stored.begin() + (size_t)x * pixelBytes, stored.begin() + (size_t)(x + 1) * pixelBytes,
+                    stored.begin() + (size_t)(width - 1 - x) * pixelBytes);
+        }
+
+        const uint8_t* row = stored.data();
+        if (!passThrough)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const uint8_t* p = stored.data() + (size_t)x * pixelBytes;
+                uint8_t* out = expanded.data() + (size_t)x * 4;
+                if (mapped)
+                {
+                    const size_t index = pixelBytes == 2 ? (size_t)(p[0] | p[1] << 8) : p[0];
+                    if (index * 4 < palette.size())
+                        memcpy(out, &palette[index * 4], 4);
+                    else
+                        memset(out, 0, 4);
+                }
+                else if (depth == 32)
+                {
+                    /* 32-bit without alpha bits: the fourth byte is padding. */
+                    memcpy(out, p, 3);
+                    out[3] = 255;
+                }
+                else
+                    expand16(p, depth == 16 && alphaBits > 0, out);
+            }
+            row = expanded.data();
+        }
+
+        const int outY = topDown ? y : height - 1 - y;
+        convertRow(format, row, width, options, image.pixels.data() + (size_t)outY * width * 4);
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : m_running(0)
+    , m_stopping(false)
+{
+    if (threadCount == 0)
+    {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threadCount = hardware > 1 ? hardware - 1 : 1;
+    }
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_running++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running--;
+            if (m_running == 0 && m_jobs.empty())
+                m_idle.notify_all();
+        }
+    }
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_running == 0 && m_jobs.empty(); });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+    if (count == 1)
+    {
+        body(0);
+        return;
+    }
+
+    /* Shared with the helper jobs, which may only get to run after this call
+       has returned; by then every index is claimed and they exit untouched. */
+    struct Loop
+    {
+        std::atomic<size_t> next;
+        std::atomic<size_t> finished;
+        size_t count;
+        const std::function<void(size_t)>* body;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+    loop->next = 0;
+    loop->finished = 0;
+    loop->count = count;
+    loop->body = &body;
+
+    auto work = [](Loop& state)
+    {
+        for (;;)
+        {
+            const size_t index = state.next.fetch_add(1);
+            if (index >= state.count)
+                return;
+            (*state.body)(index);
+            if (state.finished.fetch_add(1) + 1 == state.count)
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.done.notify_all();
+            }
+        }
+    };
+
+    const size_t helpers = count - 1 < m_threads.size() ? count - 1 : m_threads.size();
+    for (size_t i = 0; i < helpers; ++i)
+        enqueue([loop, work] { work(*loop); });
+
+    work(*loop);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->done.wait(lock, [&loop] { return loop->finished.load() == loop->count; });
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads for CPU jobs (encoding, decoding, conversion).
+
+   enqueue() runs fire-and-forget jobs. parallelFor() splits a loop across the
+   workers and the calling thread and returns when every index is done; the
+   caller keeps claiming indices itself, so it is safe to call from inside a
+   job even when all workers are busy. */
+class ThreadPool
+{
+public:
+    /* threadCount 0 uses one thread per hardware thread, minus the caller. */
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /* Process-wide pool, created on first use. */
+    static ThreadPool& shared();
+
+    void enqueue(std::function<void()> job);
+
+    /* Runs body(i) for every i in [0, count). */
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    /* Blocks until the queue is empty and no job is running. */
+    void waitIdle();
+
+    unsigned size() const { return (unsigned)m_threads.size(); }
+
+private:
+    void run();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    size_t m_running;
+    bool m_stopping;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <chrono>
+
+/* Seconds on a monotonic clock. */
+inline double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
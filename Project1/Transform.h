@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cmath>
+
+/* Column-major 2D rotation, uniform scale and translation. */
+inline void makeTransform(float angle, float scale, float x, float y, float out[16])
+{
+    const float c = std::cos(angle) * scale;
+    const float s = std::sin(angle) * scale;
+    const float m[16] = {
+        c,    s,    0.0f, 0.0f,
+        -s,   c,    0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        x,    y,    0.0f, 1.0f,
+    };
+    for (int i = 0; i < 16; ++i)
+        out[i] = m[i];
+}
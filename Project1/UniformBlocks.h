@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Std140.h"
+
+/* Uniform buffer binding points shared by every program. */
+enum UniformBinding
+{
+    kFrameBinding = 0,
+    kDrawBinding = 1,
+};
+
+/* layout(std140) uniform Frame */
+struct FrameUniforms
+{
+    std140::mat4 projection;
+    float time;
+};
+
+/* layout(std140) uniform Draw */
+struct DrawUniforms
+{
+    std140::mat4 model;
+    std140::vec4 tint;
+};
+
+namespace std140
+{
+    template <> struct BlockLayout<FrameUniforms>
+    {
+        static constexpr const char* name = "Frame";
+        static constexpr Member members[] = {
+            STD140_MEMBER(FrameUniforms, projection),
+            STD140_MEMBER(FrameUniforms, time),
+        };
+    };
+
+    template <> struct BlockLayout<DrawUniforms>
+    {
+        static constexpr const char* name = "Draw";
+        static constexpr Member members[] = {
+            STD140_MEMBER(DrawUniforms, model),
+            STD140_MEMBER(DrawUniforms, tint),
+        };
+    };
+}
+
+STD140_CHECK(FrameUniforms);
+STD140_CHECK(DrawUniforms);
+
+/* Checks both blocks against the program's reflection and assigns their
+   binding points. Suitable as a ShaderHotReloader program setup callback. */
+inline bool setupUniformBlocks(GLuint program, std::string& log)
+{
+    if (!std140::verifyBlock<FrameUniforms>(program, log) || !std140::verifyBlock<DrawUniforms>(program, log))
+        return false;
+
+    std140::bindBlock<FrameUniforms>(program, kFrameBinding);
+    std140::bindBlock<DrawUniforms>(program, kDrawBinding);
+    return true;
+}
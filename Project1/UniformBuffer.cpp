@@ -0,0 +1,149 @@
+#include "UniformBuffer.h"
+
+#include <cstring>
+
+UniformBuffer::UniformBuffer(size_t capacity)
+    : m_buffer(0)
+    , m_capacity(capacity)
+    , m_alignment(256)
+    , m_mapped(NULL)
+    , m_head(0)
+    , m_frameBegin(0)
+    , m_segmentBegin(0)
+    , m_wrapped(false)
+    , m_stats()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+        m_alignment = (size_t)alignment;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    if (m_mapped)
+        end();
+    while (!m_inFlight.empty())
+        retireOldest(false);
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void UniformBuffer::begin()
+{
+    /* Drop frames the GPU has already finished with. */
+    while (!m_inFlight.empty())
+    {
+        GLenum state = glClientWaitSync(m_inFlight.front().fence, 0, 0);
+        if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+            break;
+        retireOldest(false);
+    }
+
+    m_frameBegin = m_head;
+    m_segmentBegin = m_head;
+    m_wrapped = false;
+    m_stats.bytesWritten = 0;
+    m_stats.blocksWritten = 0;
+
+    /* Unsynchronized: the fences above are the synchronization. Explicit
+       flushing limits coherency work to the bytes actually written. */
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    m_mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_capacity,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+GLintptr UniformBuffer::push(const void* data, size_t size)
+{
+    if (!m_mapped)
+        return -1;
+
+    size_t offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+    if (offset + size > m_capacity)
+    {
+        /* Wrap, unless that would run into the start of this same frame. */
+        if (m_wrapped || size >= m_frameBegin)
+            return -1;
+        flush(m_segmentBegin, m_head);
+        m_segmentBegin = 0;
+        m_wrapped = true;
+        offset = 0;
+    }
+    if (m_wrapped && offset + size >= m_frameBegin)
+        return -1;
+
+    while (overlapsInFlight(offset, offset + size))
+        retireOldest(true);
+
+    memcpy(m_mapped + offset, data, size);
+    m_head = offset + size;
+    m_stats.bytesWritten += size;
+    m_stats.blocksWritten++;
+    return (GLintptr)offset;
+}
+
+void UniformBuffer::end()
+{
+    if (!m_mapped)
+        return;
+
+    flush(m_segmentBegin, m_head);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_mapped = NULL;
+
+    if (m_head != m_frameBegin || m_wrapped)
+    {
+        Frame frame = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_frameBegin, m_head };
+        m_inFlight.push_back(frame);
+    }
+}
+
+void UniformBuffer::bind(GLuint binding, GLintptr offset, size_t size) const
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, offset, size);
+}
+
+bool UniformBuffer::overlapsInFlight(size_t begin, size_t end) const
+{
+    for (const Frame& frame : m_inFlight)
+    {
+        bool hit = frame.begin <= frame.end
+            ? begin < frame.end && frame.begin < end
+            : begin < frame.end || frame.begin < end;
+        if (hit)
+            return true;
+    }
+    return false;
+}
+
+void UniformBuffer::retireOldest(bool wait)
+{
+    Frame& frame = m_inFlight.front();
+    if (wait)
+    {
+        GLenum state = glClientWaitSync(frame.fence, 0, 0);
+        if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+        {
+            m_stats.stalls++;
+            glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        }
+    }
+    glDeleteSync(frame.fence);
+    m_inFlight.pop_front();
+}
+
+void UniformBuffer::flush(size_t begin, size_t end)
+{
+    if (end <= begin)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glFlushMappedBufferRange(GL_UNIFORM_BUFFER, begin, end - begin);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
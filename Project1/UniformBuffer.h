@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <deque>
+
+/* Streamed ring of uniform blocks.
+
+   Every block written during a frame is placed linearly in one large uniform
+   buffer at GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT boundaries, and each draw
+   selects its slice with glBindBufferRange instead of issuing individual
+   glUniform* calls. The buffer is mapped unsynchronized for the duration of a
+   frame; a fence per frame keeps the writer from overtaking ranges the GPU may
+   still be reading, so in steady state no call waits on the driver. */
+class UniformBuffer
+{
+public:
+    struct Stats
+    {
+        size_t bytesWritten;   /* during the last frame */
+        size_t blocksWritten;  /* during the last frame */
+        size_t stalls;         /* fence waits that had to block, total */
+    };
+
+    explicit UniformBuffer(size_t capacity);
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    /* Maps the ring for writing. No draw may use the buffer until end(). */
+    void begin();
+
+    /* Appends a block and returns its offset, or -1 when the frame does not fit
+       in the ring. */
+    GLintptr push(const void* data, size_t size);
+
+    template <class Block>
+    GLintptr push(const Block& block) { return push(&block, sizeof(Block)); }
+
+    /* Flushes the written ranges, unmaps and fences the frame. */
+    void end();
+
+    void bind(GLuint binding, GLintptr offset, size_t size) const;
+
+    template <class Block>
+    void bind(GLuint binding, GLintptr offset) const { bind(binding, offset, sizeof(Block)); }
+
+    GLuint buffer() const { return m_buffer; }
+    size_t alignment() const { return m_alignment; }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    /* A frame still in flight occupies [begin, end) of the ring; begin > end
+       means it wrapped around. */
+    struct Frame
+    {
+        GLsync fence;
+        size_t begin;
+        size_t end;
+    };
+
+    bool overlapsInFlight(size_t begin, size_t end) const;
+    void retireOldest(bool wait);
+    void flush(size_t begin, size_t end);
+
+    GLuint m_buffer;
+    size_t m_capacity;
+    size_t m_alignment;
+    unsigned char* m_mapped;
+
+    size_t m_head;
+    size_t m_frameBegin;
+    size_t m_segmentBegin;
+    bool m_wrapped;
+
+    std::deque<Frame> m_inFlight;
+    Stats m_stats;
+};
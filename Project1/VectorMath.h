@@ -0,0 +1,597 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "Simd.h"
+
+/* Vectors, 4x4 matrices and quaternions for the CPU side of the renderer.
+
+   Matrices are column-major, m[column * 4 + row], the layout GL and the
+   std140 mat4 expect, so a Mat4 can go to glUniformMatrix4fv or a uniform
+   block as is. Vectors are columns: a point transforms as M * p.
+
+   Vec4, Quat and Mat4 are 16-byte aligned and use SSE where the build has it
+   (see Simd.h). Vec3 stays three plain floats, matching vertex data and
+   std140's vec3, and its operations are scalar: one SIMD lane out of four
+   would be wasted and the loads cost more than they save. Every SIMD path
+   has a scalar twin that adds the products in the same order. Built for
+   SSE2 or AVX2 (/arch:AVX2, -mavx2) the two agree bit for bit, which
+   --test math checks. Nothing is promised once FMA contraction is allowed
+   (-mfma with GCC's default -ffp-contract, /fp:contract, /fp:fast): the
+   compiler then fuses products on either side, and results differ in the
+   last bits.
+
+   The batched kernels at the end are where SIMD pays: multiplyMatrices()
+   handles two output columns per AVX instruction when the build targets
+   AVX2, four rows per SSE instruction otherwise; transformPoints() and
+   multiplyQuats() work on four items at a time in transposed form. */
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+struct alignas(16) Vec4
+{
+    float x, y, z, w;
+};
+
+/* x, y, z is the vector part, w the scalar part; unit length for rotations. */
+struct alignas(16) Quat
+{
+    float x, y, z, w;
+};
+
+struct alignas(16) Mat4
+{
+    float m[16];
+};
+
+#if SIMD_SSE2
+namespace simd
+{
+    inline __m128 load(const Vec4& v) { return _mm_load_ps(&v.x); }
+    inline __m128 load(const Quat& q) { return _mm_load_ps(&q.x); }
+    inline Vec4 storeVec4(__m128 v) { Vec4 r; _mm_store_ps(&r.x, v); return r; }
+    inline Quat storeQuat(__m128 v) { Quat r; _mm_store_ps(&r.x, v); return r; }
+
+    /* Sum of the four lanes in every lane. */
+    inline __m128 horizontalSum(__m128 v)
+    {
+        __m128 t = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    /* Column-major product of the four columns of a with one column of b. */
+    inline __m128 combine(const __m128 a[4], const float* column)
+    {
+        __m128 r = _mm_mul_ps(a[0], _mm_set1_ps(column[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_set1_ps(column[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_set1_ps(column[2])));
+        return _mm_add_ps(r, _mm_mul_ps(a[3], _mm_set1_ps(column[3])));
+    }
+}
+#endif
+
+/* Vec3, scalar. */
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return Vec3{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return Vec3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3 operator-(Vec3 a) { return Vec3{ -a.x, -a.y, -a.z }; }
+inline Vec3 operator*(Vec3 a, Vec3 b) { return Vec3{ a.x * b.x, a.y * b.y, a.z * b.z }; }
+inline Vec3 operator*(Vec3 a, float s) { return Vec3{ a.x * s, a.y * s, a.z * s }; }
+inline Vec3 operator*(float s, Vec3 a) { return a * s; }
+
+inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(Vec3 a, Vec3 b) { return Vec3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline float length(Vec3 a) { return std::sqrt(dot(a, a)); }
+inline Vec3 lerp(Vec3 a, Vec3 b, float t) { return a + (b - a) * t; }
+
+/* Zero stays zero. */
+inline Vec3 normalize(Vec3 a)
+{
+    const float l = length(a);
+    return l > 0.0f ? a * (1.0f / l) : a;
+}
+
+/* Vec4. */
+
+inline Vec4 operator+(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_add_ps(simd::load(a), simd::load(b)));
+#else
+    return Vec4{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+#endif
+}
+
+inline Vec4 operator-(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_sub_ps(simd::load(a), simd::load(b)));
+#else
+    return Vec4{ a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
+#endif
+}
+
+inline Vec4 operator*(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_mul_ps(simd::load(a), simd::load(b)));
+#else
+    return Vec4{ a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w };
+#endif
+}
+
+inline Vec4 operator*(const Vec4& a, float s)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_mul_ps(simd::load(a), _mm_set1_ps(s)));
+#else
+    return Vec4{ a.x * s, a.y * s, a.z * s, a.w * s };
+#endif
+}
+
+inline Vec4 operator*(float s, const Vec4& a) { return a * s; }
+
+/* (x*x' + y*y') + (z*z' + w*w'), in that order on both paths. */
+inline float dot(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return _mm_cvtss_f32(simd::horizontalSum(_mm_mul_ps(simd::load(a), simd::load(b))));
+#else
+    return (a.x * b.x + a.y * b.y) + (a.z * b.z + a.w * b.w);
+#endif
+}
+
+inline float length(const Vec4& a) { return std::sqrt(dot(a, a)); }
+inline Vec4 lerp(const Vec4& a, const Vec4& b, float t) { return a + (b - a) * t; }
+
+inline Vec4 normalize(const Vec4& a)
+{
+    const float l = length(a);
+    return l > 0.0f ? a * (1.0f / l) : a;
+}
+
+inline Vec4 min(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_min_ps(simd::load(a), simd::load(b)));
+#else
+    return Vec4{ a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z, a.w < b.w ? a.w : b.w };
+#endif
+}
+
+inline Vec4 max(const Vec4& a, const Vec4& b)
+{
+#if SIMD_SSE2
+    return simd::storeVec4(_mm_max_ps(simd::load(a), simd::load(b)));
+#else
+    return Vec4{ a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z, a.w > b.w ? a.w : b.w };
+#endif
+}
+
+/* Quat. */
+
+inline Quat makeQuat(Vec3 axis, float angle)
+{
+    const Vec3 n = normalize(axis);
+    const float s = std::sin(angle * 0.5f);
+    return Quat{ n.x * s, n.y * s, n.z * s, std::cos(angle * 0.5f) };
+}
+
+inline Quat conjugate(const Quat& q) { return Quat{ -q.x, -q.y, -q.z, q.w }; }
+
+/* Hamilton product: rotating by a * b applies b first, then a. */
+inline Quat operator*(const Quat& a, const Quat& b)
+{
+#if SIMD_SSE2
+    /* Each term broadcasts one lane of a against a permutation of b, with the
+       signs flipped by xor. */
+    const __m128 qb = simd::load(b);
+    const __m128 signs1 = _mm_castsi128_ps(_mm_set_epi32((int)0x80000000, 0, (int)0x80000000, 0));
+    const __m128 signs2 = _mm_castsi128_ps(_mm_set_epi32((int)0x80000000, (int)0x80000000, 0, 0));
+    const __m128 signs3 = _mm_castsi128_ps(_mm_set_epi32((int)0x80000000, 0, 0, (int)0x80000000));
+    __m128 r = _mm_mul_ps(_mm_set1_ps(a.w), qb);
+    r = _mm_add_ps(r, _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(a.x), _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(0, 1, 2, 3))), signs1));
+    r = _mm_add_ps(r, _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(a.y), _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(1, 0, 3, 2))), signs2));
+    r = _mm_add_ps(r, _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(a.z), _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(2, 3, 0, 1))), signs3));
+    return simd::storeQuat(r);
+#else
+    return Quat{
+        ((a.w * b.x + a.x * b.w) + a.y * b.z) - a.z * b.y,
+        ((a.w * b.y - a.x * b.z) + a.y * b.w) + a.z * b.x,
+        ((a.w * b.z + a.x * b.y) - a.y * b.x) + a.z * b.w,
+        ((a.w * b.w - a.x * b.x) - a.y * b.y) - a.z * b.z,
+    };
+#endif
+}
+
+inline float dot(const Quat& a, const Quat& b)
+{
+#if SIMD_SSE2
+    return _mm_cvtss_f32(simd::horizontalSum(_mm_mul_ps(simd::load(a), simd::load(b))));
+#else
+    return (a.x * b.x + a.y * b.y) + (a.z * b.z + a.w * b.w);
+#endif
+}
+
+inline Quat normalize(const Quat& q)
+{
+    const float l = std::sqrt(dot(q, q));
+    if (l <= 0.0f)
+        return Quat{ 0.0f, 0.0f, 0.0f, 1.0f };
+    const float s = 1.0f / l;
+#if SIMD_SSE2
+    return simd::storeQuat(_mm_mul_ps(simd::load(q), _mm_set1_ps(s)));
+#else
+    return Quat{ q.x * s, q.y * s, q.z * s, q.w * s };
+#endif
+}
+
+/* Rotates v by the unit quaternion q: v + w t + q.xyz x t, t = 2 q.xyz x v. */
+inline Vec3 rotate(const Quat& q, Vec3 v)
+{
+    const Vec3 u = { q.x, q.y, q.z };
+    const Vec3 t = cross(u, v) * 2.0f;
+    return v + t * q.w + cross(u, t);
+}
+
+/* Normalized linear interpolation along the shorter arc. Cheap and good
+   enough for animation steps; use slerp() for constant angular speed. */
+inline Quat nlerp(const Quat& a, const Quat& b, float t)
+{
+    const float s = dot(a, b) < 0.0f ? -t : t;
+    const float r = 1.0f - t;
+    return normalize(Quat{ a.x * r + b.x * s, a.y * r + b.y * s, a.z * r + b.z * s, a.w * r + b.w * s });
+}
+
+inline Quat slerp(const Quat& a, const Quat& b, float t)
+{
+    float cosine = dot(a, b);
+    const float sign = cosine < 0.0f ? -1.0f : 1.0f;
+    cosine *= sign;
+    if (cosine > 0.9995f)
+        return nlerp(a, b, t);
+    const float angle = std::acos(cosine);
+    const float inverse = 1.0f / std::sin(angle);
+    const float r = std::sin((1.0f - t) * angle) * inverse;
+    const float s = std::sin(t * angle) * inverse * sign;
+    return Quat{ a.x * r + b.x * s, a.y * r + b.y * s, a.z * r + b.z * s, a.w * r + b.w * s };
+}
+
+/* Mat4. */
+
+inline Mat4 makeIdentity()
+{
+    return Mat4{ { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+}
+
+inline Mat4 makeTranslation(Vec3 t)
+{
+    Mat4 r = makeIdentity();
+    r.m[12] = t.x;
+    r.m[13] = t.y;
+    r.m[14] = t.z;
+    return r;
+}
+
+inline Mat4 makeScale(Vec3 s)
+{
+    Mat4 r = makeIdentity();
+    r.m[0] = s.x;
+    r.m[5] = s.y;
+    r.m[10] = s.z;
+    return r;
+}
+
+/* Translation * rotation * scale, built directly. q must be unit length. */
+inline Mat4 makeTrs(Vec3 t, const Quat& q, Vec3 s)
+{
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    return Mat4{ {
+        (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f,
+        2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f,
+        2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f,
+        t.x, t.y, t.z, 1.0f,
+    } };
+}
+
+inline Mat4 makeRotation(const Quat& q)
+{
+    return makeTrs(Vec3{ 0.0f, 0.0f, 0.0f }, q, Vec3{ 1.0f, 1.0f, 1.0f });
+}
+
+/* Right-handed, looking down -z, depth mapped to [-1, 1] as gluPerspective. */
+inline Mat4 makePerspective(float fovY, float aspect, float zNear, float zFar)
+{
+    const float f = 1.0f / std::tan(fovY * 0.5f);
+    Mat4 r = {};
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (zFar + zNear) / (zNear - zFar);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+    return r;
+}
+
+/* View matrix of a camera at eye looking at target, as gluLookAt. */
+inline Mat4 makeLookAt(Vec3 eye, Vec3 target, Vec3 up)
+{
+    const Vec3 f = normalize(target - eye);
+    const Vec3 s = normalize(cross(f, up));
+    const Vec3 u = cross(s, f);
+    return Mat4{ {
+        s.x, u.x, -f.x, 0.0f,
+        s.y, u.y, -f.y, 0.0f,
+        s.z, u.z, -f.z, 0.0f,
+        -dot(s, eye), -dot(u, eye), dot(f, eye), 1.0f,
+    } };
+}
+
+/* out = a * b. out may be a or b. */
+inline void multiply(const Mat4& a, const Mat4& b, Mat4& out)
+{
+#if SIMD_SSE2
+    const __m128 columns[4] = { _mm_load_ps(a.m), _mm_load_ps(a.m + 4), _mm_load_ps(a.m + 8), _mm_load_ps(a.m + 12) };
+    const __m128 r0 = simd::combine(columns, b.m);
+    const __m128 r1 = simd::combine(columns, b.m + 4);
+    const __m128 r2 = simd::combine(columns, b.m + 8);
+    const __m128 r3 = simd::combine(columns, b.m + 12);
+    _mm_store_ps(out.m, r0);
+    _mm_store_ps(out.m + 4, r1);
+    _mm_store_ps(out.m + 8, r2);
+    _mm_store_ps(out.m + 12, r3);
+#else
+    float r[16];
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row)
+            r[column * 4 + row] = ((a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1])
+                + a.m[8 + row] * b.m[column * 4 + 2]) + a.m[12 + row] * b.m[column * 4 + 3];
+    for (int i = 0; i < 16; ++i)
+        out.m[i] = r[i];
+#endif
+}
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+    Mat4 r;
+    multiply(a, b, r);
+    return r;
+}
+
+inline Vec4 operator*(const Mat4& m, const Vec4& v)
+{
+#if SIMD_SSE2
+    const __m128 columns[4] = { _mm_load_ps(m.m), _mm_load_ps(m.m + 4), _mm_load_ps(m.m + 8), _mm_load_ps(m.m + 12) };
+    return simd::storeVec4(simd::combine(columns, &v.x));
+#else
+    Vec4 r;
+    float* out = &r.x;
+    for (int row = 0; row < 4; ++row)
+        out[row] = ((m.m[row] * v.x + m.m[4 + row] * v.y) + m.m[8 + row] * v.z) + m.m[12 + row] * v.w;
+    return r;
+#endif
+}
+
+/* M * (p, 1) without the divide; for affine matrices. */
+inline Vec3 transformPoint(const Mat4& m, Vec3 p)
+{
+    const Vec4 r = m * Vec4{ p.x, p.y, p.z, 1.0f };
+    return Vec3{ r.x, r.y, r.z };
+}
+
+/* M * (v, 0): directions ignore the translation. */
+inline Vec3 transformVector(const Mat4& m, Vec3 v)
+{
+    const Vec4 r = m * Vec4{ v.x, v.y, v.z, 0.0f };
+    return Vec3{ r.x, r.y, r.z };
+}
+
+inline Mat4 transpose(const Mat4& a)
+{
+#if SIMD_SSE2
+    __m128 c0 = _mm_load_ps(a.m), c1 = _mm_load_ps(a.m + 4), c2 = _mm_load_ps(a.m + 8), c3 = _mm_load_ps(a.m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    Mat4 r;
+    _mm_store_ps(r.m, c0);
+    _mm_store_ps(r.m + 4, c1);
+    _mm_store_ps(r.m + 8, c2);
+    _mm_store_ps(r.m + 12, c3);
+    return r;
+#else
+    Mat4 r;
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row)
+            r.m[row * 4 + column] = a.m[column * 4 + row];
+    return r;
+#endif
+}
+
+/* General inverse by cofactors. Returns false, leaving out untouched, when
+   the matrix is singular. Scalar: inverses are rare enough per frame that
+   the SIMD version's length is not worth it. */
+inline bool inverse(const Mat4& a, Mat4& out)
+{
+    const float* m = a.m;
+    float r[16];
+    r[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    r[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    r[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    r[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    r[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    r[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    r[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    r[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    r[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    r[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    r[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    r[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    r[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    r[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    r[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    r[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    const float determinant = m[0] * r[0] + m[1] * r[4] + m[2] * r[8] + m[3] * r[12];
+    if (determinant == 0.0f || !std::isfinite(determinant))
+        return false;
+    const float scale = 1.0f / determinant;
+    for (int i = 0; i < 16; ++i)
+        out.m[i] = r[i] * scale;
+    return true;
+}
+
+/* Batched kernels. Outputs may alias the matching input. */
+
+#if SIMD_AVX2
+namespace simd
+{
+    /* Two output columns at once: each 128-bit lane holds one column of b,
+       permuted to broadcast its k-th element against column k of a, which
+       sits in both lanes. */
+    inline void multiplyAvx(const __m256 a[4], const float* b, float* out)
+    {
+        for (int half = 0; half < 2; ++half)
+        {
+            const __m256 columns = _mm256_loadu_ps(b + half * 8);
+            __m256 r = _mm256_mul_ps(a[0], _mm256_permute_ps(columns, _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a[1], _mm256_permute_ps(columns, _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a[2], _mm256_permute_ps(columns, _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a[3], _mm256_permute_ps(columns, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm256_storeu_ps(out + half * 8, r);
+        }
+    }
+
+    inline void loadAvx(const Mat4& a, __m256 columns[4])
+    {
+        for (int k = 0; k < 4; ++k)
+            columns[k] = _mm256_broadcast_ps((const __m128*)(a.m + k * 4));
+    }
+}
+#endif
+
+/* out[i] = a * b[i]: one matrix, such as the view-projection, applied to
+   many; a's columns are loaded once for the whole batch. */
+inline void multiplyMatrices(const Mat4& a, const Mat4* b, Mat4* out, size_t count)
+{
+#if SIMD_AVX2
+    __m256 columns[4];
+    simd::loadAvx(a, columns);
+    for (size_t i = 0; i < count; ++i)
+        simd::multiplyAvx(columns, b[i].m, out[i].m);
+#elif SIMD_SSE2
+    const __m128 columns[4] = { _mm_load_ps(a.m), _mm_load_ps(a.m + 4), _mm_load_ps(a.m + 8), _mm_load_ps(a.m + 12) };
+    for (size_t i = 0; i < count; ++i)
+    {
+        const __m128 r0 = simd::combine(columns, b[i].m);
+        const __m128 r1 = simd::combine(columns, b[i].m + 4);
+        const __m128 r2 = simd::combine(columns, b[i].m + 8);
+        const __m128 r3 = simd::combine(columns, b[i].m + 12);
+        _mm_store_ps(out[i].m, r0);
+        _mm_store_ps(out[i].m + 4, r1);
+        _mm_store_ps(out[i].m + 8, r2);
+        _mm_store_ps(out[i].m + 12, r3);
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+        multiply(a, b[i], out[i]);
+#endif
+}
+
+/* out[i] = a[i] * b[i], as when concatenating parent and local transforms. */
+inline void multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* out, size_t count)
+{
+#if SIMD_AVX2
+    for (size_t i = 0; i < count; ++i)
+    {
+        __m256 columns[4];
+        simd::loadAvx(a[i], columns);
+        simd::multiplyAvx(columns, b[i].m, out[i].m);
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+        multiply(a[i], b[i], out[i]);
+#endif
+}
+
+/* out[i] = M * (points[i], 1), affine. The SSE path takes four points per
+   step: three loads hold them as x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3,
+   shuffles turn those into one register per coordinate, and the results
+   are shuffled back the same way. Putting one point in one register
+   instead loses to the compiler's own vectorization of the scalar loop. */
+inline void transformPoints(const Mat4& m, const Vec3* points, Vec3* out, size_t count)
+{
+    size_t i = 0;
+#if SIMD_SSE2
+    __m128 rows[12];
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 3; ++row)
+            rows[column * 3 + row] = _mm_set1_ps(m.m[column * 4 + row]);
+    for (; i + 4 <= count; i += 4)
+    {
+        const float* in = &points[i].x;
+        const __m128 a = _mm_loadu_ps(in);
+        const __m128 b = _mm_loadu_ps(in + 4);
+        const __m128 c = _mm_loadu_ps(in + 8);
+        const __m128 u = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));    /* x2 y2 x3 y3 */
+        const __m128 x = _mm_shuffle_ps(a, u, _MM_SHUFFLE(2, 0, 3, 0));
+        const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), u, _MM_SHUFFLE(3, 1, 2, 0));
+        const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+
+        __m128 r[3];
+        for (int row = 0; row < 3; ++row)
+        {
+            r[row] = _mm_add_ps(_mm_mul_ps(rows[row], x), _mm_mul_ps(rows[3 + row], y));
+            r[row] = _mm_add_ps(_mm_add_ps(r[row], _mm_mul_ps(rows[6 + row], z)), rows[9 + row]);
+        }
+
+        const __m128 xy01 = _mm_unpacklo_ps(r[0], r[1]);    /* x0 y0 x1 y1 */
+        const __m128 xy23 = _mm_unpackhi_ps(r[0], r[1]);    /* x2 y2 x3 y3 */
+        float* result = &out[i].x;
+        _mm_storeu_ps(result, _mm_shuffle_ps(xy01, _mm_shuffle_ps(r[2], xy01, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(result + 4, _mm_shuffle_ps(_mm_shuffle_ps(xy01, r[2], _MM_SHUFFLE(1, 1, 3, 3)), xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(result + 8, _mm_shuffle_ps(_mm_shuffle_ps(r[2], xy23, _MM_SHUFFLE(2, 2, 2, 2)),
+            _mm_shuffle_ps(xy23, r[2], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = transformPoint(m, points[i]);
+}
+
+/* out[i] = a[i] * b[i]. Four products per step on SSE, transposed so each
+   register holds one component of four quaternions; a single product in one
+   register spends most of its time shuffling. */
+inline void multiplyQuats(const Quat* a, const Quat* b, Quat* out, size_t count)
+{
+    size_t i = 0;
+#if SIMD_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 ax = simd::load(a[i]), ay = simd::load(a[i + 1]), az = simd::load(a[i + 2]), aw = simd::load(a[i + 3]);
+        __m128 bx = simd::load(b[i]), by = simd::load(b[i + 1]), bz = simd::load(b[i + 2]), bw = simd::load(b[i + 3]);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+        __m128 x = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by));
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)), _mm_mul_ps(ay, bw)), _mm_mul_ps(az, bx));
+        __m128 z = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx)), _mm_mul_ps(az, bw));
+        __m128 w = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_store_ps(&out[i].x, x);
+        _mm_store_ps(&out[i + 1].x, y);
+        _mm_store_ps(&out[i + 2].x, z);
+        _mm_store_ps(&out[i + 3].x, w);
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = a[i] * b[i];
+}
+
+/* out[i] = makeTrs(t[i], r[i], s[i]). */
+inline void composeTransforms(const Vec3* t, const Quat* r, const Vec3* s, Mat4* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        out[i] = makeTrs(t[i], r[i], s[i]);
+}
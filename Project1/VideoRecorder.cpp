@@ -0,0 +1,185 @@
+#include "VideoRecorder.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "ColorConvert.h"
+
+VideoRecorder::VideoRecorder()
+    : m_format(kY4M)
+    , m_width(0)
+    , m_height(0)
+    , m_stopping(false)
+    , m_writeFailed(false)
+    , m_stats()
+{
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    close();
+}
+
+bool VideoRecorder::open(const std::string& path, Format format, int width, int height, int fps, int queueDepth)
+{
+    close();
+    if (width <= 0 || height <= 0 || !m_file.open(path))
+        return false;
+
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_stats = Stats();
+    m_stats.unbuffered = m_file.isUnbuffered();
+    m_stopping = false;
+    m_writeFailed = false;
+
+    if (format == kY4M)
+    {
+        char header[160];
+        int length = snprintf(header, sizeof(header),
+            "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+        m_file.write(header, (size_t)length);
+    }
+
+    const size_t frameBytes = (size_t)width * height * 4;
+    m_buffers.assign(queueDepth > 0 ? queueDepth : 1, Buffer());
+    m_free.clear();
+    m_queued.clear();
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        m_buffers[i].pixels.resize(frameBytes);
+        m_free.push_back(i);
+    }
+
+    const size_t chromaBytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    m_converted.resize(format == kY4M ? (size_t)width * height + 2 * chromaBytes : frameBytes);
+
+    m_thread = std::thread(&VideoRecorder::run, this);
+    return true;
+}
+
+void VideoRecorder::submit(const ReadbackFrame& frame)
+{
+    if (!isOpen())
+        return;
+    if (frame.width != m_width || frame.height != m_height)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.framesSkipped++;
+        return;
+    }
+
+    size_t index;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_free.empty())
+        {
+            m_stats.producerWaits++;
+            m_released.wait(lock, [this] { return !m_free.empty() || m_writeFailed; });
+            if (m_writeFailed)
+                return;
+        }
+        index = m_free.front();
+        m_free.pop_front();
+    }
+
+    /* Copy outside the lock; the writer never touches a buffer it does not own. */
+    uint8_t* destination = m_buffers[index].pixels.data();
+    const size_t rowBytes = (size_t)m_width * 4;
+    if (frame.stride == rowBytes)
+        memcpy(destination, frame.pixels, rowBytes * m_height);
+    else
+        for (int y = 0; y < m_height; ++y)
+            memcpy(destination + rowBytes * y, frame.pixels + frame.stride * y, rowBytes);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queued.push_back(index);
+    }
+    m_ready.notify_one();
+}
+
+void VideoRecorder::run()
+{
+    for (;;)
+    {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this] { return !m_queued.empty() || m_stopping; });
+            if (m_queued.empty())
+                break;
+            index = m_queued.front();
+            m_queued.pop_front();
+        }
+
+        writeFrame(m_buffers[index]);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(index);
+        }
+        m_released.notify_one();
+    }
+}
+
+void VideoRecorder::writeFrame(const Buffer& buffer)
+{
+    const uint8_t* pixels = buffer.pixels.data();
+    const size_t rowBytes = (size_t)m_width * 4;
+    bool ok;
+
+    if (m_format == kY4M)
+    {
+        uint8_t* y = m_converted.data();
+        uint8_t* u = y + (size_t)m_width * m_height;
+        uint8_t* v = u + (size_t)((m_width + 1) / 2) * ((m_height + 1) / 2);
+        rgbaToI420Flipped(pixels, rowBytes, m_width, m_height, y, u, v);
+        ok = m_file.write("FRAME\n", 6) && m_file.write(m_converted.data(), m_converted.size());
+    }
+    else
+    {
+        /* GL rows are bottom-up; the stream is top-down. */
+        for (int row = 0; row < m_height; ++row)
+            memcpy(m_converted.data() + rowBytes * row, pixels + rowBytes * (m_height - 1 - row), rowBytes);
+        ok = m_file.write(m_converted.data(), m_converted.size());
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (ok)
+    {
+        m_stats.framesWritten++;
+        m_stats.bytesWritten = m_file.size();
+    }
+    else if (!m_writeFailed)
+    {
+        m_writeFailed = true;
+        m_released.notify_all();
+        fprintf(stderr, "video recording: write failed, further frames are discarded\n");
+    }
+}
+
+bool VideoRecorder::close()
+{
+    if (!isOpen())
+        return true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_ready.notify_one();
+    m_thread.join();
+
+    bool ok = m_file.close() && !m_writeFailed;
+    m_buffers.clear();
+    m_converted.clear();
+    return ok;
+}
+
+VideoRecorder::Stats VideoRecorder::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncReadback.h"
+#include "DirectFileWriter.h"
+
+/* Records rendered frames to an uncompressed stream on disk.
+
+   The render thread only copies each read-back frame into a buffer from a
+   fixed pool and queues it. A dedicated writer thread flips it, converts it
+   (RGB to 4:2:0 YUV for Y4M) and appends it through DirectFileWriter. When the
+   writer falls behind and the pool is exhausted, submit() waits for a free
+   buffer instead of dropping the frame; those waits are counted. */
+class VideoRecorder
+{
+public:
+    enum Format
+    {
+        kY4M,      /* YUV4MPEG2, 4:2:0, playable by ffmpeg/mpv */
+        kRawRGBA,  /* headerless top-down RGBA8 frames */
+    };
+
+    struct Stats
+    {
+        uint64_t framesWritten;
+        uint64_t framesSkipped;   /* size differed from the stream's */
+        uint64_t producerWaits;   /* submit() calls that had to wait for the writer */
+        uint64_t bytesWritten;
+        bool unbuffered;          /* direct I/O was accepted by the file system */
+    };
+
+    VideoRecorder();
+    ~VideoRecorder();
+
+    VideoRecorder(const VideoRecorder&) = delete;
+    VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+    /* Creates the file and starts the writer thread. queueDepth frames may be
+       pending before submit() starts waiting. */
+    bool open(const std::string& path, Format format, int width, int height, int fps, int queueDepth = 8);
+
+    /* Queues one frame; typically called from an AsyncReadback callback. */
+    void submit(const ReadbackFrame& frame);
+
+    /* Writes everything queued, stops the writer and closes the file. */
+    bool close();
+
+    bool isOpen() const { return m_thread.joinable(); }
+    Stats stats();
+
+private:
+    struct Buffer
+    {
+        std::vector<uint8_t> pixels;
+    };
+
+    void run();
+    void writeFrame(const Buffer& buffer);
+
+    Format m_format;
+    int m_width;
+    int m_height;
+    DirectFileWriter m_file;
+
+    std::vector<Buffer> m_buffers;
+    std::vector<uint8_t> m_converted;
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_released;
+    std::deque<size_t> m_free;
+    std::deque<size_t> m_queued;
+    bool m_stopping;
+    bool m_writeFailed;
+    std::thread m_thread;
+
+    Stats m_stats;
+};
@@ -0,0 +1,472 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "ThreadPool.h"
+#include "Timer.h"
+
+const char* const VirtualTexture::kGlsl =
+    "uniform sampler2D vtPageTable;\n"
+    "uniform sampler2D vtCache;\n"
+    "/* virtual size in texels, pages per side at level 0, coarsest level, level bias */\n"
+    "uniform vec4 vtInfo;\n"
+    "/* cache size in texels, page size, border */\n"
+    "uniform vec3 vtCacheInfo;\n"
+    "int vtLevel(vec2 uv)\n"
+    "{\n"
+    "    vec2 t = uv * vtInfo.x;\n"
+    "    vec2 dx = dFdx(t);\n"
+    "    vec2 dy = dFdy(t);\n"
+    "    float rho = max(dot(dx, dx), dot(dy, dy));\n"
+    "    return int(clamp(0.5 * log2(max(rho, 1e-8)) + vtInfo.w, 0.0, vtInfo.z));\n"
+    "}\n"
+    "ivec2 vtPage(vec2 uv, int level)\n"
+    "{\n"
+    "    int pages = int(vtInfo.y) >> level;\n"
+    "    return clamp(ivec2(uv * float(pages)), ivec2(0), ivec2(pages - 1));\n"
+    "}\n"
+    "vec4 vtSample(vec2 uv)\n"
+    "{\n"
+    "    int level = vtLevel(uv);\n"
+    "    vec3 entry = floor(texelFetch(vtPageTable, vtPage(uv, level), level).rgb * 255.0 + 0.5);\n"
+    "    float pages = vtInfo.y / exp2(entry.b);\n"
+    "    vec2 inPage = clamp(uv * pages - floor(min(uv, vec2(0.99999)) * pages), 0.0, 1.0);\n"
+    "    float slot = vtCacheInfo.y + 2.0 * vtCacheInfo.z;\n"
+    "    vec2 texel = entry.rg * slot + vtCacheInfo.z + inPage * vtCacheInfo.y;\n"
+    "    return textureLod(vtCache, texel / vtCacheInfo.x, 0.0);\n"
+    "}\n"
+    "vec4 vtFeedback(vec2 uv)\n"
+    "{\n"
+    "    int level = vtLevel(uv);\n"
+    "    return vec4(vec2(vtPage(uv, level)), float(level), 255.0) / 255.0;\n"
+    "}\n";
+
+VirtualTexture::VirtualTexture(int virtualSize, int cachePagesPerSide, PageSource source, ThreadPool& pool)
+    : m_pool(pool)
+    , m_queue(std::make_shared<Queue>())
+    , m_virtualSize(virtualSize)
+    , m_pagesPerSide(std::max(virtualSize / kPageSize, 1))
+    , m_levels(1)
+    , m_cachePagesPerSide(std::min(std::max(cachePagesPerSide, 1), (int)kMaxCachePagesPerSide))
+    , m_pageTable(0)
+    , m_cache(0)
+    , m_wantedPages(0)
+    , m_missingPages(0)
+    , m_feedbackFrame(0)
+    , m_feedbackFramebuffer(0)
+    , m_feedbackColor(0)
+    , m_feedbackDepth(0)
+    , m_feedbackWidth(0)
+    , m_feedbackHeight(0)
+    , m_viewWidth(0)
+    , m_viewHeight(0)
+    , m_readback(3, [this](const ReadbackFrame& frame) { processFeedback(frame); })
+    , m_loaded(0)
+    , m_evicted(0)
+    , m_failed(0)
+    , m_discarded(0)
+    , m_cpuSeconds(0.0)
+{
+    m_queue->closed = false;
+    m_queue->source = std::move(source);
+    while ((m_pagesPerSide >> (m_levels - 1)) > 1)
+        m_levels++;
+
+    /* Page table: one RGBA8 texel per page and level, holding the slot
+       column and row and the level of the page actually resident. Entries
+       start with level 255, which no page has, so they all count as not
+       resident until the root is propagated below. */
+    glGenTextures(1, &m_pageTable);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    m_tableLevels.resize(m_levels);
+    for (int level = 0; level < m_levels; ++level)
+    {
+        const int size = m_pagesPerSide >> level;
+        m_tableLevels[level].assign((size_t)size * size * 4, 0);
+        for (size_t i = 2; i < m_tableLevels[level].size(); i += 4)
+            m_tableLevels[level][i] = 255;
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+
+    const int cacheSize = m_cachePagesPerSide * kSlotSize;
+    glGenTextures(1, &m_cache);
+    glBindTexture(GL_TEXTURE_2D, m_cache);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    Slot empty = { UINT32_MAX, 0 };
+    m_slots.assign((size_t)m_cachePagesPerSide * m_cachePagesPerSide, empty);
+
+    /* The coarsest page backs every lookup, so it is loaded now and pinned
+       in slot 0 with a lastWanted no eviction will pick. */
+    std::vector<uint8_t> texels((size_t)kSlotSize * kSlotSize * 4, 128);
+    const uint32_t root = pageKey(m_levels - 1, 0, 0);
+    if (!m_queue->source(m_levels - 1, 0, 0, texels.data()))
+        m_failed++;
+    uploadPage(0, texels.data());
+    m_slots[0].key = root;
+    m_slots[0].lastWanted = UINT64_MAX;
+    m_resident[root] = 0;
+    m_tableChanges.push_back(root);
+    updatePageTable();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queue->mutex);
+        m_queue->closed = true;
+        m_queue->loaded.clear();
+    }
+    if (m_feedbackFramebuffer)
+    {
+        glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+        glDeleteTextures(1, &m_feedbackColor);
+        glDeleteRenderbuffers(1, &m_feedbackDepth);
+    }
+    glDeleteTextures(1, &m_pageTable);
+    glDeleteTextures(1, &m_cache);
+}
+
+void VirtualTexture::beginFeedback(int width, int height)
+{
+    m_viewWidth = width;
+    m_viewHeight = height;
+    const int feedbackWidth = std::max(width / kFeedbackDivisor, 1);
+    const int feedbackHeight = std::max(height / kFeedbackDivisor, 1);
+    if (feedbackWidth != m_feedbackWidth || feedbackHeight != m_feedbackHeight)
+    {
+        if (!m_feedbackFramebuffer)
+        {
+            glGenFramebuffers(1, &m_feedbackFramebuffer);
+            glGenTextures(1, &m_feedbackColor);
+            glGenRenderbuffers(1, &m_feedbackDepth);
+        }
+        glBindTexture(GL_TEXTURE_2D, m_feedbackColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, feedbackWidth, feedbackHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_feedbackColor, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+        m_feedbackWidth = feedbackWidth;
+        m_feedbackHeight = feedbackHeight;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+    glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void VirtualTexture::endFeedback()
+{
+    /* The readback reads the current read framebuffer. */
+    m_readback.capture(m_feedbackWidth, m_feedbackHeight, m_feedbackFrame);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_viewWidth, m_viewHeight);
+}
+
+void VirtualTexture::processFeedback(const ReadbackFrame& frame)
+{
+    const double start = nowSeconds();
+    const uint64_t feedbackFrame = ++m_feedbackFrame;
+
+    /* Pixels with alpha 255 carry a request; the rest saw no virtual
+       texture. Duplicates are counted so busy pages come first. */
+    std::vector<uint32_t> keys;
+    keys.reserve((size_t)frame.width * frame.height);
+    for (int y = 0; y < frame.height; ++y)
+    {
+        const uint8_t* row = frame.pixels + frame.stride * y;
+        for (int x = 0; x < frame.width; ++x)
+        {
+            const uint8_t* pixel = row + x * 4;
+            const int level = pixel[2];
+            if (pixel[3] != 255 || level >= m_levels || pixel[0] >= (m_pagesPerSide >> level) || pixel[1] >= (m_pagesPerSide >> level))
+                continue;
+            keys.push_back(pageKey(level, pixel[0], pixel[1]));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    struct Want
+    {
+        uint32_t key;
+        size_t pixels;
+    };
+    std::vector<Want> wants;
+    for (size_t i = 0; i < keys.size();)
+    {
+        size_t j = i;
+        while (j < keys.size() && keys[j] == keys[i])
+            j++;
+        Want want = { keys[i], j - i };
+        wants.push_back(want);
+        i = j;
+    }
+
+    /* Every wanted page keeps its ancestors too, since they are what is
+       shown until it arrives and what it falls back to once evicted. */
+    m_wantedPages = wants.size();
+    m_missingPages = 0;
+    std::unordered_map<uint32_t, size_t> missing;
+    for (const Want& want : wants)
+    {
+        int level = keyLevel(want.key);
+        int x = keyX(want.key);
+        int y = keyY(want.key);
+        if (!m_resident.count(want.key))
+            m_missingPages++;
+        for (; level < m_levels; ++level, x >>= 1, y >>= 1)
+        {
+            const uint32_t key = pageKey(level, x, y);
+            const auto resident = m_resident.find(key);
+            if (resident != m_resident.end())
+            {
+                Slot& slot = m_slots[resident->second];
+                if (slot.lastWanted != UINT64_MAX)
+                    slot.lastWanted = feedbackFrame;
+            }
+            else if (!m_loading.count(key))
+                missing[key] += want.pixels;
+        }
+    }
+
+    /* Coarse levels first: each one improves a larger area and unlocks the
+       finer ones below it. Within a level, the most visible first. */
+    std::vector<Want> ordered;
+    ordered.reserve(missing.size());
+    for (const auto& entry : missing)
+    {
+        Want want = { entry.first, entry.second };
+        ordered.push_back(want);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const Want& a, const Want& b) {
+        if (keyLevel(a.key) != keyLevel(b.key))
+            return keyLevel(a.key) > keyLevel(b.key);
+        if (a.pixels != b.pixels)
+            return a.pixels > b.pixels;
+        return a.key < b.key;
+    });
+    m_wanted.clear();
+    for (const Want& want : ordered)
+        m_wanted.push_back(want.key);
+
+    m_cpuSeconds += nowSeconds() - start;
+}
+
+void VirtualTexture::startLoads()
+{
+    /* Enough in flight to keep every worker busy, few enough that a new
+       feedback frame can still change what comes next. */
+    const size_t maxLoading = (size_t)m_pool.size() * 2 + 2;
+    size_t next = 0;
+    while (m_loading.size() < maxLoading && next < m_wanted.size())
+    {
+        const uint32_t key = m_wanted[next++];
+        if (m_resident.count(key) || m_loading.count(key))
+            continue;
+        m_loading.insert(key);
+
+        std::shared_ptr<Queue> queue = m_queue;
+        m_pool.enqueue([queue, key]() {
+            LoadedPage page;
+            page.key = key;
+            page.texels.resize((size_t)kSlotSize * kSlotSize * 4);
+            page.ok = queue->source(keyLevel(key), keyX(key), keyY(key), page.texels.data());
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (!queue->closed)
+                queue->loaded.push_back(std::move(page));
+        });
+    }
+    m_wanted.erase(m_wanted.begin(), m_wanted.begin() + next);
+}
+
+void VirtualTexture::uploadPage(int slot, const uint8_t* texels)
+{
+    const int column = slot % m_cachePagesPerSide;
+    const int row = slot / m_cachePagesPerSide;
+    glBindTexture(GL_TEXTURE_2D, m_cache);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, column * kSlotSize, row * kSlotSize, kSlotSize, kSlotSize,
+        GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::update(int uploadBudget)
+{
+    m_readback.poll();
+    const double start = nowSeconds();
+
+    std::deque<LoadedPage> loaded;
+    {
+        std::lock_guard<std::mutex> lock(m_queue->mutex);
+        while (!m_queue->loaded.empty() && (int)loaded.size() < uploadBudget)
+        {
+            loaded.push_back(std::move(m_queue->loaded.front()));
+            m_queue->loaded.pop_front();
+        }
+    }
+
+    for (LoadedPage& page : loaded)
+    {
+        m_loading.erase(page.key);
+        if (!page.ok)
+        {
+            m_failed++;
+            continue;
+        }
+
+        /* Least recently wanted slot; a page wanted by the latest feedback
+           is never evicted for another, the new page is dropped instead. */
+        int victim = -1;
+        for (size_t i = 0; i < m_slots.size(); ++i)
+            if (victim < 0 || m_slots[i].lastWanted < m_slots[victim].lastWanted)
+                victim = (int)i;
+        Slot& slot = m_slots[victim];
+        if (slot.key != UINT32_MAX && slot.lastWanted >= m_feedbackFrame)
+        {
+            m_discarded++;
+            continue;
+        }
+        if (slot.key != UINT32_MAX)
+        {
+            m_resident.erase(slot.key);
+            m_tableChanges.push_back(slot.key);
+            m_evicted++;
+        }
+        uploadPage(victim, page.texels.data());
+        slot.key = page.key;
+        slot.lastWanted = m_feedbackFrame;
+        m_resident[page.key] = victim;
+        m_tableChanges.push_back(page.key);
+        m_loaded++;
+    }
+
+    startLoads();
+    if (!m_tableChanges.empty())
+        updatePageTable();
+    m_cpuSeconds += nowSeconds() - start;
+}
+
+void VirtualTexture::updatePageTable()
+{
+    /* Only the entries under a changed page can change: the page's own
+       entry, then each finer level of its subtree, where every entry that
+       is not a resident page of its own (level byte equal to its level)
+       takes its parent's. Coarsest changes first, so a subtree is always
+       filled from an up to date parent. Keys sort by level first. */
+    std::sort(m_tableChanges.begin(), m_tableChanges.end(), std::greater<uint32_t>());
+    m_tableChanges.erase(std::unique(m_tableChanges.begin(), m_tableChanges.end()), m_tableChanges.end());
+    m_tableRects.clear();
+    for (uint32_t key : m_tableChanges)
+    {
+        const int changed = keyLevel(key);
+        for (int level = changed; level >= 0; --level)
+        {
+            const int size = m_pagesPerSide >> level;
+            const int span = 1 << (changed - level);
+            const int x0 = keyX(key) * span;
+            const int y0 = keyY(key) * span;
+            std::vector<uint8_t>& table = m_tableLevels[level];
+            for (int y = y0; y < y0 + span; ++y)
+            {
+                for (int x = x0; x < x0 + span; ++x)
+                {
+                    uint8_t* entry = &table[((size_t)y * size + x) * 4];
+                    if (level == changed)
+                    {
+                        const auto resident = m_resident.find(key);
+                        if (resident != m_resident.end())
+                        {
+                            entry[0] = (uint8_t)(resident->second % m_cachePagesPerSide);
+                            entry[1] = (uint8_t)(resident->second / m_cachePagesPerSide);
+                            entry[2] = (uint8_t)level;
+                            entry[3] = 255;
+                            continue;
+                        }
+                    }
+                    else if (entry[2] == level)
+                        continue;
+                    /* The root is pinned, so anything else has a parent. */
+                    const int parentSize = size >> 1;
+                    memcpy(entry, &m_tableLevels[level + 1][((size_t)(y >> 1) * parentSize + (x >> 1)) * 4], 4);
+                }
+            }
+            TableRect rect = { level, x0, y0, span };
+            m_tableRects.push_back(rect);
+        }
+    }
+    m_tableChanges.clear();
+
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (const TableRect& rect : m_tableRects)
+    {
+        const int size = m_pagesPerSide >> rect.level;
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, size);
+        glTexSubImage2D(GL_TEXTURE_2D, rect.level, rect.x, rect.y, rect.size, rect.size, GL_RGBA, GL_UNSIGNED_BYTE,
+            &m_tableLevels[rect.level][((size_t)rect.y * size + rect.x) * 4]);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::setUniforms(GLuint program, int pageTableUnit, int cacheUnit, bool feedback) const
+{
+    glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    glActiveTexture(GL_TEXTURE0 + cacheUnit);
+    glBindTexture(GL_TEXTURE_2D, m_cache);
+    glActiveTexture(GL_TEXTURE0);
+
+    /* Derivatives in the feedback framebuffer are kFeedbackDivisor times
+       larger than on screen. */
+    const float bias = feedback ? -std::log2((float)kFeedbackDivisor) : 0.0f;
+    glUniform1i(glGetUniformLocation(program, "vtPageTable"), pageTableUnit);
+    glUniform1i(glGetUniformLocation(program, "vtCache"), cacheUnit);
+    glUniform4f(glGetUniformLocation(program, "vtInfo"), (float)m_virtualSize, (float)m_pagesPerSide,
+        (float)(m_levels - 1), bias);
+    glUniform3f(glGetUniformLocation(program, "vtCacheInfo"), (float)(m_cachePagesPerSide * kSlotSize),
+        (float)kPageSize, (float)kPageBorder);
+}
+
+VirtualTexture::Stats VirtualTexture::stats() const
+{
+    Stats stats;
+    stats.resident = m_resident.size();
+    stats.capacity = m_slots.size();
+    stats.loading = m_loading.size();
+    stats.loaded = m_loaded;
+    stats.evicted = m_evicted;
+    stats.failed = m_failed;
+    stats.discarded = m_discarded;
+    stats.feedbackFrames = m_feedbackFrame;
+    stats.wantedPages = m_wantedPages;
+    stats.missingPages = m_missingPages;
+    const size_t cacheSize = (size_t)m_cachePagesPerSide * kSlotSize;
+    stats.cacheBytes = cacheSize * cacheSize * 4;
+    stats.pageTableBytes = 0;
+    for (const std::vector<uint8_t>& level : m_tableLevels)
+        stats.pageTableBytes += level.size();
+    stats.cpuSeconds = m_cpuSeconds;
+    return stats;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AsyncReadback.h"
+
+class ThreadPool;
+
+/* Sparse virtual texturing: a texture far larger than video memory, of which
+   only the pages the screen needs are resident.
+
+   The virtual texture and every mip level of it are cut into kPageSize
+   square pages. Resident pages live in slots of one physical cache texture,
+   each with a kPageBorder texel border copied from its neighbours so
+   bilinear filtering works across page edges. A page table texture, with one
+   mip level per virtual level and one texel per page, points every page at
+   the slot of the finest resident page covering it, so a missing page falls
+   back to a coarser one rather than to nothing. The coarsest level is a
+   single page, loaded up front and never evicted.
+
+   What to load is decided from feedback: the scene is drawn once more into
+   a framebuffer kFeedbackDivisor times smaller, writing the page and level
+   every pixel wants (vtFeedback in kGlsl), and read back through an
+   AsyncReadback so nothing waits for the GPU. Each feedback frame becomes
+   the new request list, coarse levels first, and pages are produced by the
+   PageSource on the thread pool. update() uploads a bounded number of
+   finished pages per frame, evicting the least recently wanted ones, so the
+   memory used is the cache texture plus the small page table whatever the
+   size of the source.
+
+   Pages are at most 256 to a side at level 0 (feedback stores page
+   coordinates in 8 bits), which allows virtual textures of up to 32768
+   texels. */
+class VirtualTexture
+{
+public:
+    enum
+    {
+        kPageSize = 128,
+        kPageBorder = 4,
+        kSlotSize = kPageSize + 2 * kPageBorder,
+        kFeedbackDivisor = 8,
+        kMaxPagesPerSide = 256,
+        kMaxCachePagesPerSide = 256,    /* the page table stores slot column and row in 8 bits */
+    };
+
+    /* Fills rgba with kSlotSize x kSlotSize RGBA8 texels: page (pageX,
+       pageY) of the given level, top row first, including its border taken
+       from the neighbouring pages (clamped at the texture edge). Runs on pool
+       threads, several at once. */
+    typedef std::function<bool(int level, int pageX, int pageY, uint8_t* rgba)> PageSource;
+
+    struct Stats
+    {
+        size_t resident;            /* pages in the cache, the pinned one included */
+        size_t capacity;            /* slots in the cache */
+        size_t loading;             /* pages being produced on the pool */
+        uint64_t loaded;            /* pages uploaded, total */
+        uint64_t evicted;
+        uint64_t failed;            /* PageSource errors */
+        uint64_t discarded;         /* finished pages dropped because every slot was wanted */
+        uint64_t feedbackFrames;
+        size_t wantedPages;         /* distinct pages in the last feedback */
+        size_t missingPages;        /* of which not resident at their own level */
+        size_t cacheBytes;          /* physical texture */
+        size_t pageTableBytes;
+        double cpuSeconds;          /* in update() and the feedback callback */
+    };
+
+    /* GL thread. virtualSize is a power of two between kPageSize and
+       kPageSize * kMaxPagesPerSide; the cache holds cachePagesPerSide^2
+       pages, with cachePagesPerSide clamped to [1, kMaxCachePagesPerSide].
+       Loads the coarsest page synchronously. */
+    VirtualTexture(int virtualSize, int cachePagesPerSide, PageSource source, ThreadPool& pool);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    /* GL thread. Binds and clears the feedback framebuffer for a view of
+       width x height and sets the viewport to match; draw the scene with a
+       program using vtFeedback, then call endFeedback(). */
+    void beginFeedback(int width, int height);
+
+    /* Queues the readback and restores the default framebuffer and the
+       viewport. */
+    void endFeedback();
+
+    /* GL thread, once per frame. Takes finished readbacks and pages, starts
+       new loads and uploads at most uploadBudget pages. */
+    void update(int uploadBudget);
+
+    /* Binds the page table and the cache to the given texture units and sets
+       the kGlsl uniforms of program, which must be current. feedback selects
+       the level bias for the smaller feedback framebuffer. */
+    void setUniforms(GLuint program, int pageTableUnit, int cacheUnit, bool feedback) const;
+
+    /* GLSL to place after the #version line (3.3 core): declares the
+       uniforms and vec4 vtSample(vec2 uv), which samples the virtual texture,
+       and vec4 vtFeedback(vec2 uv), the colour to write in the feedback pass.
+       uv covers the whole virtual texture over [0, 1], v = 0 at its top row. */
+    static const char* const kGlsl;
+
+    GLuint pageTable() const { return m_pageTable; }
+    GLuint cache() const { return m_cache; }
+    Stats stats() const;
+
+private:
+    struct Slot
+    {
+        uint32_t key;           /* UINT32_MAX when free */
+        uint64_t lastWanted;    /* feedback frame */
+    };
+
+    /* A square of page table entries, uploaded with one glTexSubImage2D. */
+    struct TableRect
+    {
+        int level;
+        int x;
+        int y;
+        int size;
+    };
+
+    struct LoadedPage
+    {
+        uint32_t key;
+        bool ok;
+        std::vector<uint8_t> texels;
+    };
+
+    /* Outlives the texture while page jobs are still queued on the pool. */
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<LoadedPage> loaded;
+        bool closed;
+        PageSource source;
+    };
+
+    static uint32_t pageKey(int level, int x, int y) { return (uint32_t)level << 16 | (uint32_t)y << 8 | (uint32_t)x; }
+    static int keyLevel(uint32_t key) { return (int)(key >> 16); }
+    static int keyX(uint32_t key) { return (int)(key & 0xFF); }
+    static int keyY(uint32_t key) { return (int)(key >> 8 & 0xFF); }
+
+    void processFeedback(const ReadbackFrame& frame);
+    void startLoads();
+    void uploadPage(int slot, const uint8_t* texels);
+    void updatePageTable();
+
+    ThreadPool& m_pool;
+    std::shared_ptr<Queue> m_queue;
+    int m_virtualSize;
+    int m_pagesPerSide;         /* at level 0 */
+    int m_levels;
+    int m_cachePagesPerSide;
+
+    GLuint m_pageTable;
+    GLuint m_cache;
+    std::vector<std::vector<uint8_t>> m_tableLevels;    /* RGBA8 per level, CPU copy */
+    std::vector<uint32_t> m_tableChanges;               /* pages loaded or evicted since the last update */
+    std::vector<TableRect> m_tableRects;                /* scratch for updatePageTable() */
+
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint32_t, int> m_resident;       /* key to slot */
+    std::unordered_set<uint32_t> m_loading;
+    std::vector<uint32_t> m_wanted;                     /* not resident, most urgent first */
+    size_t m_wantedPages;
+    size_t m_missingPages;
+    uint64_t m_feedbackFrame;
+
+    GLuint m_feedbackFramebuffer;
+    GLuint m_feedbackColor;
+    GLuint m_feedbackDepth;
+    int m_feedbackWidth;
+    int m_feedbackHeight;
+    int m_viewWidth;
+    int m_viewHeight;
+    AsyncReadback m_readback;
+
+    uint64_t m_loaded;
+    uint64_t m_evicted;
+    uint64_t m_failed;
+    uint64_t m_discarded;
+    double m_cpuSeconds;
+};
@@ -1,13 +1,839 @@
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-int main(void)
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetPack.h"
+#include "AssetReader.h"
+#include "AsyncReadback.h"
+#include "Benchmarks.h"
+#include "ImageLoader.h"
+#include "InstancedRenderer.h"
+#include "Mesh.h"
+#include "MeshPool.h"
+#include "MipGenerator.h"
+#include "PngEncoder.h"
+#include "RectPacker.h"
+#include "Screenshot.h"
+#include "ShaderHotReloader.h"
+#include "TextureAtlas.h"
+#include "TextureContainer.h"
+#include "TextureResidency.h"
+#include "TextureStreamer.h"
+#include "Tests.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "Transform.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+#include "VideoRecorder.h"
+
+/* Adds one small world-space polygon with 4 to 8 corners at a pseudo-random
+   position, so meshes of different sizes come and go in the pool. */
+static MeshHandle addStaticShape(MeshPool& pool, unsigned& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    const float x = (seed >> 8 & 0xffff) / 32768.0f - 1.0f;
+    seed = seed * 1664525u + 1013904223u;
+    const float y = (seed >> 8 & 0xffff) / 32768.0f - 1.0f;
+    const int corners = 4 + (int)(seed >> 28) % 5;
+    const float size = 0.004f + (seed >> 24 & 3) * 0.002f;
+    const float shade = 0.15f + (seed >> 20 & 7) * 0.03f;
+
+    float vertices[8 * 5];
+    GLushort indices[6 * 3];
+    for (int i = 0; i < corners; ++i)
+    {
+        const float angle = 6.2831853f * i / corners;
+        float* vertex = vertices + i * 5;
+        vertex[0] = x + std::cos(angle) * size;
+        vertex[1] = y + std::sin(angle) * size;
+        vertex[2] = shade;
+        vertex[3] = shade;
+        vertex[4] = shade * 1.5f;
+    }
+    for (int i = 0; i < corners - 2; ++i)
+    {
+        indices[i * 3 + 0] = 0;
+        indices[i * 3 + 1] = (GLushort)(i + 1);
+        indices[i * 3 + 2] = (GLushort)(i + 2);
+    }
+    return pool.add(vertices, corners, indices, (corners - 2) * 3);
+}
+
+/* Offline block compression: the image and a generated mip chain go into one
+   DDS file. Colour formats are treated as sRGB. */
+static int writeCompressedTexture(const char* path, const char* formatName, BlockQuality quality)
+{
+    static const struct { const char* name; BlockFormat format; bool srgb; } kFormats[] = {
+        { "bc1", kBC1, true }, { "bc3", kBC3, true }, { "bc4", kBC4, false }, { "bc5", kBC5, false }, { "bc7", kBC7, true },
+    };
+    size_t f = 0;
+    while (f < sizeof(kFormats) / sizeof(kFormats[0]) && strcmp(kFormats[f].name, formatName) != 0)
+        ++f;
+    if (f == sizeof(kFormats) / sizeof(kFormats[0]))
+    {
+        fprintf(stderr, "unknown block format '%s', expected bc1, bc3, bc4, bc5 or bc7\n", formatName);
+        return 1;
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    const ImageOptions imageOptions = { false, false };
+    std::vector<Image> levels(1);
+    std::string log;
+    if (!loadImage(path, imageOptions, levels[0], log))
+    {
+        fprintf(stderr, "%s: %s\n", path, log.c_str());
+        return 1;
+    }
+
+    const double start = nowSeconds();
+    const MipOptions mipOptions = { kMipKaiser, kFormats[f].srgb, false };
+    std::vector<Image> mips;
+    generateMips(levels[0], mipOptions, pool, mips);
+    for (Image& mip : mips)
+        levels.push_back(std::move(mip));
+    const double mipped = nowSeconds();
+
+    CompressedTexture texture;
+    texture.format = kFormats[f].format;
+    texture.srgb = kFormats[f].srgb;
+    std::vector<uint8_t> blocks;
+    for (const Image& level : levels)
+    {
+        compressImage(level, texture.format, quality, pool, blocks);
+        texture.levels.push_back({ level.width, level.height, texture.data.size(), blocks.size() });
+        texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+    }
+    const double compressed = nowSeconds();
+    printf("%s: %dx%d %s, %zu levels, mips %.1f ms, compression %.1f ms on %u threads, %zu KiB\n", path,
+        levels[0].width, levels[0].height, formatName, levels.size(), (mipped - start) * 1000.0,
+        (compressed - mipped) * 1000.0, pool.size() + 1, texture.data.size() / 1024);
+
+    std::vector<uint8_t> dds;
+    encodeDds(texture, dds);
+    const std::string outputPath = std::string(path) + ".dds";
+    FILE* file = fopen(outputPath.c_str(), "wb");
+    bool written = file && fwrite(dds.data(), 1, dds.size(), file) == dds.size();
+    if (file && fclose(file) != 0)
+        written = false;
+    if (!written)
+    {
+        fprintf(stderr, "cannot write %s\n", outputPath.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/* Stand-in for an image decoder: rings and a checkerboard whose colours
+   depend on seed, with enough per-pixel work to take a moment. */
+static void makePatternImage(int seed, Image& image)
+{
+    image.width = 256;
+    image.height = 256;
+    image.pixels.resize((size_t)image.width * image.height * 4);
+    const float hue = seed * 0.618034f;
+    for (int y = 0; y < image.height; ++y)
+    {
+        for (int x = 0; x < image.width; ++x)
+        {
+            const float dx = x - 127.5f;
+            const float dy = y - 127.5f;
+            const float ring = 0.5f + 0.5f * std::sin(std::sqrt(dx * dx + dy * dy) * 0.15f + hue * 6.0f);
+            const bool check = ((x >> 5) + (y >> 5)) & 1;
+            uint8_t* pixel = &image.pixels[((size_t)y * image.width + x) * 4];
+            pixel[0] = (uint8_t)(255.0f * ring * (0.5f + 0.5f * std::sin(hue * 6.2831853f)));
+            pixel[1] = (uint8_t)(255.0f * ring * (0.5f + 0.5f * std::sin(hue * 6.2831853f + 2.1f)));
+            pixel[2] = (uint8_t)(check ? 255 : 255.0f * ring * (0.5f + 0.5f * std::sin(hue * 6.2831853f + 4.2f)));
+            pixel[3] = 255;
+        }
+    }
+}
+
+/* Command line switches. */
+struct Options
+{
+    const char* bench;  /* --bench <name>: run a microbenchmark instead of the demo */
+    const char* test;   /* --test <name|all>: run self-checks and exit */
+    bool qaCapture;     /* --qa-capture: print a hash of every rendered frame */
+    const char* record; /* --record <file>: write every frame to .y4m, or raw RGBA otherwise */
+    const char* mips;   /* --mips <image>: write its mip chain as <image>.mip<N>.png and exit */
+    bool boxMips;       /* --box-mips: use the box filter for --mips */
+    const char* compress;       /* --compress <image> <bc1|bc3|bc4|bc5|bc7>: write <image>.dds and exit */
+    const char* compressFormat;
+    bool fastCompress;          /* --fast: kBlockFast for --compress */
+    const char* pack;           /* --pack <directory> <output>: build an asset pack and exit */
+    const char* packOutput;
+    const char* atlas;          /* --atlas <directory> <output>: pack its images into atlas pages and exit */
+    const char* atlasOutput;
+};
+
+/* Offline asset packing: everything below directory goes into one mapped
+   archive, LZ4 compressed where that pays; see AssetPack.h. Reads the result
+   back serially and on the pool to report decompression throughput. */
+static int writeAssetPack(const char* directory, const char* output)
+{
+    ThreadPool& pool = ThreadPool::shared();
+    const double start = nowSeconds();
+    std::string log;
+    if (!buildAssetPack(directory, output, kPackDefaultAlignment, kPackLz4, pool, log))
+    {
+        fprintf(stderr, "%s\n", log.c_str());
+        return 1;
+    }
+    const double built = nowSeconds();
+
+    AssetPack pack;
+    if (!pack.open(output, log))
+    {
+        fprintf(stderr, "%s\n", log.c_str());
+        return 1;
+    }
+    uint64_t size = 0;
+    uint64_t storedSize = 0;
+    size_t compressedCount = 0;
+    for (size_t i = 0; i < pack.count(); ++i)
+    {
+        size += pack.entry(i).size;
+        storedSize += pack.entry(i).storedSize;
+        compressedCount += pack.compressed(pack.entry(i)) ? 1 : 0;
+    }
+    printf("%s: %zu assets (%zu compressed), %llu KiB -> %llu KiB, %.1f ms\n", output, pack.count(), compressedCount,
+        (unsigned long long)(size / 1024), (unsigned long long)(storedSize / 1024), (built - start) * 1000.0);
+
+    std::vector<uint8_t> contents;
+    for (int threaded = 0; threaded < 2; ++threaded)
+    {
+        const double readStart = nowSeconds();
+        for (size_t i = 0; i < pack.count(); ++i)
+        {
+            if (!pack.read(pack.entry(i), contents, threaded ? &pool : NULL, log))
+            {
+                fprintf(stderr, "%s\n", log.c_str());
+                return 1;
+            }
+        }
+        const double seconds = nowSeconds() - readStart;
+        printf("  read back on %u thread(s): %.1f ms, %.0f MB/s\n", threaded ? pool.size() + 1 : 1,
+            seconds * 1000.0, seconds > 0.0 ? size / seconds / 1e6 : 0.0);
+    }
+    return 0;
+}
+
+/* Offline atlas packing: every image directly in directory is placed with
+   MaxRects into as few kAtlasPageSize pages as possible, written as
+   <output>.<page>.png, and listed in <output>.txt as
+   "name page x y width height" in texels, padding excluded. */
+static int writeAtlas(const char* directory, const char* output)
+{
+    const int kAtlasPageSize = 2048;
+    const int kAtlasPadding = 1;
+
+    std::vector<std::string> names;
+    std::vector<Image> images;
+    std::vector<PackedRect> sizes;
+    const ImageOptions imageOptions = { false, false };
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        const std::string path = entry.path().string();
+        if (!entry.is_regular_file() || assetTypeFromPath(path) != kAssetImage)
+            continue;
+        Image image;
+        std::string log;
+        if (!loadImage(path, imageOptions, image, log))
+        {
+            fprintf(stderr, "%s: %s\n", path.c_str(), log.c_str());
+            return 1;
+        }
+        names.push_back(entry.path().filename().string());
+        sizes.push_back({ 0, 0, image.width + 2 * kAtlasPadding, image.height + 2 * kAtlasPadding });
+        images.push_back(std::move(image));
+    }
+    if (error || images.empty())
+    {
+        fprintf(stderr, "%s: no images\n", directory);
+        return 1;
+    }
+
+    const double start = nowSeconds();
+    std::vector<AtlasPlacement> placements;
+    const int pageCount = packAtlasPages(sizes, kAtlasPageSize, kAtlasPageSize, placements);
+    if (pageCount < 0)
+    {
+        fprintf(stderr, "%s: an image is larger than a %d x %d page\n", directory, kAtlasPageSize, kAtlasPageSize);
+        return 1;
+    }
+    const double packed = nowSeconds();
+
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<std::vector<uint8_t>> pages(pageCount, std::vector<uint8_t>((size_t)kAtlasPageSize * kAtlasPageSize * 4, 0));
+    size_t area = 0;
+    std::string manifest;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const AtlasPlacement& placement = placements[i];
+        const int x = placement.rect.x + kAtlasPadding;
+        const int y = placement.rect.y + kAtlasPadding;
+        blitWithPadding(images[i], pages[placement.page].data(), kAtlasPageSize, x, y, kAtlasPadding);
+        area += (size_t)sizes[i].width * sizes[i].height;
+        manifest += names[i] + " " + std::to_string(placement.page) + " " + std::to_string(x) + " " + std::to_string(y)
+            + " " + std::to_string(images[i].width) + " " + std::to_string(images[i].height) + "\n";
+    }
+
+    for (int page = 0; page < pageCount; ++page)
+    {
+        std::vector<uint8_t> png;
+        encodePng(pages[page].data(), (size_t)kAtlasPageSize * 4, kAtlasPageSize, kAtlasPageSize, false, true, 6, pool, png);
+        const std::string pagePath = std::string(output) + "." + std::to_string(page) + ".png";
+        FILE* file = fopen(pagePath.c_str(), "wb");
+        bool written = file && fwrite(png.data(), 1, png.size(), file) == png.size();
+        if (file && fclose(file) != 0)
+            written = false;
+        if (!written)
+        {
+            fprintf(stderr, "cannot write %s\n", pagePath.c_str());
+            return 1;
+        }
+    }
+    const std::string manifestPath = std::string(output) + ".txt";
+    FILE* file = fopen(manifestPath.c_str(), "wb");
+    bool written = file && fwrite(manifest.data(), 1, manifest.size(), file) == manifest.size();
+    if (file && fclose(file) != 0)
+        written = false;
+    if (!written)
+    {
+        fprintf(stderr, "cannot write %s\n", manifestPath.c_str());
+        return 1;
+    }
+
+    printf("%s: %zu images on %d page(s) of %d x %d, %.1f%% filled, packed in %.1f ms\n", output, images.size(), pageCount,
+        kAtlasPageSize, kAtlasPageSize, 100.0 * area / ((double)pageCount * kAtlasPageSize * kAtlasPageSize),
+        (packed - start) * 1000.0);
+    return 0;
+}
+
+/* Offline mip generation, for baking chains into the asset tree. Runs without
+   a window or GL context. */
+static int writeMipChain(const char* path, MipFilter filter)
+{
+    ThreadPool& pool = ThreadPool::shared();
+    const ImageOptions imageOptions = { false, false };
+    Image base;
+    std::string log;
+    if (!loadImage(path, imageOptions, base, log))
+    {
+        fprintf(stderr, "%s: %s\n", path, log.c_str());
+        return 1;
+    }
+
+    const MipOptions mipOptions = { filter, true, false };
+    const double start = nowSeconds();
+    std::vector<Image> levels;
+    generateMips(base, mipOptions, pool, levels);
+    printf("%s: %dx%d, %zu levels in %.1f ms on %u threads\n", path, base.width, base.height,
+        levels.size(), (nowSeconds() - start) * 1000.0, pool.size() + 1);
+
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const Image& level = levels[i];
+        std::vector<uint8_t> png;
+        encodePng(level.pixels.data(), (size_t)level.width * 4, level.width, level.height, false, true, 6, pool, png);
+
+        const std::string levelPath = std::string(path) + ".mip" + std::to_string(i + 1) + ".png";
+        FILE* file = fopen(levelPath.c_str(), "wb");
+        bool written = file && fwrite(png.data(), 1, png.size(), file) == png.size();
+        if (file && fclose(file) != 0)
+            written = false;
+        if (!written)
+        {
+            fprintf(stderr, "cannot write %s\n", levelPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* FNV-1a over the frame, for comparing runs in automated QA. */
+static void printFrameHash(const ReadbackFrame& frame)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int y = 0; y < frame.height; ++y)
+    {
+        const uint8_t* row = frame.pixels + frame.stride * y;
+        for (size_t x = 0; x < (size_t)frame.width * 4; ++x)
+            hash = (hash ^ row[x]) * 1099511628211ull;
+    }
+    printf("frame %llu %dx%d %016llx\n", (unsigned long long)frame.frameIndex,
+        frame.width, frame.height, (unsigned long long)hash);
+}
+
+/* Renders until the window is closed. */
+static void run(GLFWwindow* window, const Options& options)
+{
+    /* Upload a single triangle */
+    const float vertices[] = {
+        -0.5f, -0.5f,   1.0f, 0.0f, 0.0f,
+         0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+         0.0f,  0.5f,   0.0f, 0.0f, 1.0f,
+    };
+
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
+
+    /* Build the shader and keep it in sync with the files on disk */
+    ShaderHotReloader shader(window, "shaders/triangle.vert", "shaders/triangle.frag");
+    shader.setProgramSetup(setupUniformBlocks);
+    shader.start();
+
+    /* Per-frame and per-draw uniform blocks are streamed through one ring */
+    UniformBuffer uniforms(256 * 1024);
+    const int drawCount = 3;
+    bool uniformsOverflowed = false;
+
+    /* A grid of quads sharing one mesh and material goes through the instanced path */
+    const float quadVertices[] = {
+        -1.0f, -1.0f,   0.2f, 0.2f, 0.2f,
+         1.0f, -1.0f,   0.4f, 0.4f, 0.4f,
+         1.0f,  1.0f,   0.6f, 0.6f, 0.6f,
+        -1.0f,  1.0f,   0.4f, 0.4f, 0.4f,
+    };
+    const GLushort quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+    const VertexAttribute quadAttributes[] = {
+        { 0, 2, GL_FLOAT, GL_FALSE, 0 },
+        { 1, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(float) },
+    };
+    Mesh quad = createMesh(quadVertices, sizeof(quadVertices), 5 * sizeof(float),
+        quadAttributes, 2, quadIndices, 6, GL_UNSIGNED_SHORT);
+
+    ShaderHotReloader instancedShader(window, "shaders/instanced.vert", "shaders/triangle.frag");
+    instancedShader.setProgramSetup(setupUniformBlocks);
+    instancedShader.start();
+
+    /* Thousands of small static meshes share one VBO/IBO and go out in a single multi-draw */
+    MeshPool staticPool(5 * sizeof(float), quadAttributes, 2, 64 * 1024, 96 * 1024, GL_UNSIGNED_SHORT);
+    std::vector<MeshHandle> staticMeshes;
+    unsigned staticSeed = 12345;
+    for (int i = 0; i < 8000; ++i)
+        staticMeshes.push_back(addStaticShape(staticPool, staticSeed));
+    MultiDrawBatch staticBatch(staticPool);
+
+    ShaderHotReloader staticShader(window, "shaders/static.vert", "shaders/triangle.frag");
+    staticShader.setProgramSetup(setupUniformBlocks);
+    staticShader.start();
+
+    /* Hundreds of textures decode on the thread pool and upload a few bands per frame.
+       They come from textures/ in assets.pak when that exists, else from the loose
+       textures/ directory, else generated; .dds and .ktx files go up
+       block-compressed. Pack entries are fetched through the AssetReader, the
+       first screenful at visible priority and the rest as prefetches, and
+       decoded on the pool once read. */
+    const int thumbnailCount = 16;
+    TextureStreamer textureStreamer(ThreadPool::shared());
+    AssetReader reader(ThreadPool::shared());
+    std::vector<GLuint> textures;
+    AssetPack assets;
+    std::string packLog;
+    if (!assets.open("assets.pak", packLog) && std::filesystem::exists("assets.pak"))
+        fprintf(stderr, "%s\n", packLog.c_str());
+    const int packFile = assets.isOpen() ? reader.openFile("assets.pak") : -1;
+    for (size_t i = 0; packFile >= 0 && i < assets.count(); ++i)
+    {
+        const PackEntry entry = assets.entry(i);
+        if ((entry.type != kAssetImage && entry.type != kAssetCompressedTexture)
+            || assets.name(entry).compare(0, 9, "textures/") != 0)
+            continue;
+        const GLuint texture = textureStreamer.reserve();
+        const AssetReader::Priority priority = textures.size() < (size_t)thumbnailCount
+            ? AssetReader::kReadVisible : AssetReader::kReadPrefetch;
+        textures.push_back(texture);
+        const uint32_t blockSize = assets.blockSize();
+        reader.read(packFile, entry.offset, (size_t)entry.storedSize, priority,
+            [&textureStreamer, texture, entry, blockSize](bool ok, std::vector<uint8_t>& data, const std::string& readLog)
+        {
+            if (!ok)
+            {
+                textureStreamer.request(texture, [readLog](Image&, std::string& log)
+                {
+                    log = readLog;
+                    return false;
+                });
+                return;
+            }
+            std::shared_ptr<std::vector<uint8_t>> stored = std::make_shared<std::vector<uint8_t>>(std::move(data));
+            auto unpack = [stored, entry, blockSize](std::vector<uint8_t>& bytes, std::string& log)
+            {
+                if (entry.compression == kPackStored)
+                {
+                    bytes.swap(*stored);
+                    return true;
+                }
+                bytes.resize((size_t)entry.size);
+                return readPackPayload(entry, blockSize, stored->data(), 0, bytes.size(), bytes.data(), &ThreadPool::shared(), log);
+            };
+            if (entry.type == kAssetCompressedTexture)
+            {
+                textureStreamer.requestCompressed(texture, [unpack](CompressedTexture& compressed, std::string& log)
+                {
+                    std::vector<uint8_t> bytes;
+                    return unpack(bytes, log) && decodeTextureContainer(bytes.data(), bytes.size(), compressed, log);
+                });
+                return;
+            }
+            textureStreamer.request(texture, [unpack](Image& image, std::string& log)
+            {
+                const ImageOptions options = { false, false };
+                std::vector<uint8_t> bytes;
+                return unpack(bytes, log) && decodeImage(bytes.data(), bytes.size(), options, image, log);
+            });
+        });
+    }
+    if (packFile < 0)
+    {
+        std::error_code directoryError;
+        for (const auto& entry : std::filesystem::directory_iterator("textures", directoryError))
+        {
+            const std::string path = entry.path().string();
+            if (isCompressedTexturePath(path))
+            {
+                textures.push_back(textureStreamer.requestCompressed([path](CompressedTexture& texture, std::string& log)
+                {
+                    return loadCompressedTexture(path, texture, log);
+                }));
+                continue;
+            }
+            textures.push_back(textureStreamer.request([path](Image& image, std::string& log)
+            {
+                const ImageOptions options = { false, false };
+                return loadImage(path, options, image, log);
+            }));
+        }
+    }
+    const bool generate = textures.empty();
+    for (int i = 0; generate && i < 256; ++i)
+    {
+        textures.push_back(textureStreamer.request([i](Image& image, std::string&)
+        {
+            makePatternImage(i, image);
+            return true;
+        }));
+    }
+
+    /* Video memory of the streamed textures, estimated once they are all in */
+    TextureResidency textureMemory((size_t)-1);
+    bool texturesTracked = false;
+
+    ShaderHotReloader texturedShader(window, "shaders/textured.vert", "shaders/textured.frag");
+    texturedShader.setProgramSetup(setupUniformBlocks);
+    texturedShader.start();
+
+    InstancedRenderer renderer;
+    Material gridMaterial = { 0 };
+    const int gridSize = 24;
+    double statsTime = glfwGetTime();
+
+    /* Frames for QA and recording are read back through PBOs and delivered a few frames later */
+    VideoRecorder recorder;
+    if (options.record)
+    {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        const size_t length = strlen(options.record);
+        const bool y4m = length > 4 && strcmp(options.record + length - 4, ".y4m") == 0;
+        if (!recorder.open(options.record, y4m ? VideoRecorder::kY4M : VideoRecorder::kRawRGBA, width, height, 60))
+            fprintf(stderr, "cannot record to %s\n", options.record);
+    }
+
+    /* F12 saves the frame it was pressed on as a PNG, encoded off the render thread */
+    const uint64_t kNoScreenshot = ~0ull;
+    ScreenshotWriter screenshots(ThreadPool::shared());
+    uint64_t screenshotFrame = kNoScreenshot;
+    int screenshotCount = 0;
+    bool screenshotKeyDown = false;
+
+    AsyncReadback readback(4, [&](const ReadbackFrame& frame)
+    {
+        if (options.qaCapture)
+            printFrameHash(frame);
+        recorder.submit(frame);
+        if (frame.frameIndex == screenshotFrame)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "screenshot_%03d.png", screenshotCount++);
+            screenshots.save(frame, path);
+            screenshotFrame = kNoScreenshot;
+        }
+    });
+    readback.setWaitWhenFull(recorder.isOpen());
+    const bool capturing = options.qaCapture || recorder.isOpen();
+    uint64_t frameIndex = 0;
+
+    /* Loop until the user closes the window */
+    while (!glfwWindowShouldClose(window))
+    {
+        /* Pick up a freshly linked program if one is ready */
+        shader.poll();
+        instancedShader.poll();
+        staticShader.poll();
+        texturedShader.poll();
+
+        /* Hand finished reads to the decoders, then move at most 2 MiB of
+           decoded texels to the GPU this frame */
+        reader.poll();
+        textureStreamer.update(2 << 20);
+        if (!texturesTracked && textureStreamer.pending() == 0)
+        {
+            for (GLuint texture : textures)
+                textureMemory.track(texture);
+            texturesTracked = true;
+        }
+
+        /* Fill the uniform blocks for this frame */
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+
+        FrameUniforms frame = {};
+        makeTransform(0.0f, 1.0f, 0.0f, 0.0f, frame.projection.m);
+        frame.projection.m[0] = width > 0 ? (float)height / (float)width : 1.0f;
+        frame.time = (float)glfwGetTime();
+
+        uniforms.begin();
+        GLintptr frameOffset = uniforms.push(frame);
+        GLintptr drawOffsets[drawCount];
+        for (int i = 0; i < drawCount; ++i)
+        {
+            DrawUniforms draw = {};
+            makeTransform(frame.time * (i + 1) * 0.5f, 0.6f, (i - 1) * 0.6f, 0.0f, draw.model.m);
+            draw.tint = { i == 0 ? 1.0f : 0.5f, i == 1 ? 1.0f : 0.5f, i == 2 ? 1.0f : 0.5f, 1.0f };
+            drawOffsets[i] = uniforms.push(draw);
+        }
+        GLintptr thumbnailOffsets[thumbnailCount];
+        for (int i = 0; i < thumbnailCount; ++i)
+        {
+            const float step = 2.0f / thumbnailCount;
+            DrawUniforms draw = {};
+            makeTransform(0.0f, step * 0.45f, -1.0f + step * (i + 0.5f), 1.0f - step * 0.5f, draw.model.m);
+            draw.tint = { 1.0f, 1.0f, 1.0f, 1.0f };
+            thumbnailOffsets[i] = uniforms.push(draw);
+        }
+        uniforms.end();
+
+        /* push() returns -1 once the ring is full; draws whose blocks did not
+           fit are skipped, and without the frame block nothing is drawn. */
+        bool ringFull = frameOffset < 0;
+        for (int i = 0; i < drawCount; ++i)
+            ringFull = ringFull || drawOffsets[i] < 0;
+        for (int i = 0; i < thumbnailCount; ++i)
+            ringFull = ringFull || thumbnailOffsets[i] < 0;
+        if (ringFull && !uniformsOverflowed)
+            fprintf(stderr, "uniform ring full, skipping draws\n");
+        uniformsOverflowed = ringFull;
+        const bool frameBound = frameOffset >= 0;
+        if (frameBound)
+            uniforms.bind<FrameUniforms>(kFrameBinding, frameOffset);
+
+        /* Render here */
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        /* Stream some static meshes out and in, then let the pool compact a little */
+        for (int i = 0; i < 32; ++i)
+        {
+            staticSeed = staticSeed * 1664525u + 1013904223u;
+            MeshHandle& handle = staticMeshes[(staticSeed >> 8) % staticMeshes.size()];
+            staticPool.remove(handle);
+            handle = addStaticShape(staticPool, staticSeed);
+        }
+        staticPool.defragment(64 * 1024);
+
+        if (frameBound && staticShader.program())
+        {
+            staticBatch.clear();
+            for (MeshHandle handle : staticMeshes)
+                if (handle != kInvalidMesh)
+                    staticBatch.add(handle);
+            glUseProgram(staticShader.program());
+            staticBatch.submit();
+        }
+
+        if (frameBound && shader.program())
+        {
+            glUseProgram(shader.program());
+            glBindVertexArray(vao);
+            for (int i = 0; i < drawCount; ++i)
+            {
+                if (drawOffsets[i] < 0)
+                    continue;
+                uniforms.bind<DrawUniforms>(kDrawBinding, drawOffsets[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        }
+
+        gridMaterial.program = instancedShader.program();
+        if (frameBound && gridMaterial.program)
+        {
+            for (int y = 0; y < gridSize; ++y)
+            {
+                for (int x = 0; x < gridSize; ++x)
+                {
+                    const float step = 2.0f / gridSize;
+                    float model[16];
+                    makeTransform(frame.time + (x + y) * 0.1f, step * 0.3f,
+                        -1.0f + step * (x + 0.5f), -1.0f + step * (y + 0.5f), model);
+                    const float tint[4] = { (float)x / gridSize, (float)y / gridSize, 1.0f, 1.0f };
+                    renderer.submit(&quad, &gridMaterial, model, tint);
+                }
+            }
+            renderer.flush();
+        }
+
+        /* A row of thumbnails cycling through the streamed textures */
+        if (frameBound && texturedShader.program())
+        {
+            glUseProgram(texturedShader.program());
+            glBindVertexArray(quad.vao);
+            const size_t first = (size_t)(frame.time * 4.0f);
+            for (int i = 0; i < thumbnailCount; ++i)
+            {
+                if (thumbnailOffsets[i] < 0)
+                    continue;
+                glBindTexture(GL_TEXTURE_2D, textures[(first + i) % textures.size()]);
+                uniforms.bind<DrawUniforms>(kDrawBinding, thumbnailOffsets[i]);
+                glDrawElements(GL_TRIANGLES, quad.indexCount, quad.indexType, (void*)0);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        /* Report how many draws instancing collapsed */
+        if (frame.time - statsTime >= 1.0)
+        {
+            const InstancedRenderer::Stats& stats = renderer.stats();
+            char title[320];
+            const MeshPool::Stats pool = staticPool.stats();
+            snprintf(title, sizeof(title), "Hello World - %zu draws in %zu calls (%zu collapsed), %zu static in 1 multi-draw, "
+                "pool %.0f%% used, %.0f%% fragmented, %zu textures streaming, %.1f MB of textures",
+                stats.submitted, stats.drawCalls, stats.collapsed, staticBatch.size(),
+                100.0f * pool.vertices.used / pool.vertices.capacity, 100.0f * pool.vertices.fragmentation, textureStreamer.pending(),
+                textureMemory.stats().trackedBytes / 1e6);
+            glfwSetWindowTitle(window, title);
+            statsTime = frame.time;
+        }
+
+        const bool screenshotKey = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+        if (screenshotKey && !screenshotKeyDown)
+            screenshotFrame = frameIndex;
+        screenshotKeyDown = screenshotKey;
+
+        /* Queue this frame for capture and deliver the ones that have arrived */
+        if (capturing || screenshotFrame != kNoScreenshot)
+        {
+            readback.poll();
+            /* A dropped capture moves the screenshot to the next frame */
+            if (!readback.capture(width, height, frameIndex) && screenshotFrame == frameIndex)
+                screenshotFrame = frameIndex + 1;
+        }
+        frameIndex++;
+
+        /* Swap front and back buffers */
+        glfwSwapBuffers(window);
+
+        /* Poll for and process events */
+        glfwPollEvents();
+    }
+
+    readback.drain();
+    screenshots.wait();
+    if (recorder.isOpen())
+    {
+        recorder.close();
+        const VideoRecorder::Stats stats = recorder.stats();
+        fprintf(stderr, "recorded %llu frames (%llu skipped, writer behind %llu times, %s I/O)\n",
+            (unsigned long long)stats.framesWritten, (unsigned long long)stats.framesSkipped,
+            (unsigned long long)stats.producerWaits, stats.unbuffered ? "direct" : "buffered");
+    }
+    shader.stop();
+    instancedShader.stop();
+    staticShader.stop();
+    texturedShader.stop();
+    glDeleteTextures((GLsizei)textures.size(), textures.data());
+    destroyMesh(quad);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+}
+
+int main(int argc, char** argv)
 {
     GLFWwindow* window;
+    Options options = {};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            options.bench = argv[++i];
+        else if (strcmp(argv[i], "--test") == 0 && i + 1 < argc)
+            options.test = argv[++i];
+        else if (strcmp(argv[i], "--qa-capture") == 0)
+            options.qaCapture = true;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            options.record = argv[++i];
+        else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc)
+            options.mips = argv[++i];
+        else if (strcmp(argv[i], "--box-mips") == 0)
+            options.boxMips = true;
+        else if (strcmp(argv[i], "--compress") == 0 && i + 2 < argc)
+        {
+            options.compress = argv[++i];
+            options.compressFormat = argv[++i];
+        }
+        else if (strcmp(argv[i], "--fast") == 0)
+            options.fastCompress = true;
+        else if (strcmp(argv[i], "--pack") == 0 && i + 2 < argc)
+        {
+            options.pack = argv[++i];
+            options.packOutput = argv[++i];
+        }
+        else if (strcmp(argv[i], "--atlas") == 0 && i + 2 < argc)
+        {
+            options.atlas = argv[++i];
+            options.atlasOutput = argv[++i];
+        }
+    }
+
+    if (options.test)
+        return runTests(options.test);
+    if (options.mips)
+        return writeMipChain(options.mips, options.boxMips ? kMipBox : kMipKaiser);
+    if (options.compress)
+        return writeCompressedTexture(options.compress, options.compressFormat, options.fastCompress ? kBlockFast : kBlockHigh);
+    if (options.pack)
+        return writeAssetPack(options.pack, options.packOutput);
+    if (options.atlas)
+        return writeAtlas(options.atlas, options.atlasOutput);
 
     /* Initialize the library */
     if (!glfwInit())
         return -1;
 
+    /* Request a 3.3 core context to match the glad loader */
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
     /* Create a windowed mode window and its OpenGL context */
     window = glfwCreateWindow(640, 480, "Hello World", NULL, NULL);
     if (!window)
@@ -19,19 +845,20 @@ int main(void)
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
 
-    /* Loop until the user closes the window */
-    while (!glfwWindowShouldClose(window))
+    /* Load the OpenGL entry points */
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
-        /* Render here */
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        /* Swap front and back buffers */
-        glfwSwapBuffers(window);
-
-        /* Poll for and process events */
-        glfwPollEvents();
+        glfwTerminate();
+        return -1;
     }
 
+    /* Run the renderer; its GL objects are released before the context goes away */
+    int result = 0;
+    if (options.bench)
+        result = runBenchmark(options.bench, window);
+    else
+        run(window, options);
+
     glfwTerminate();
-    return 0;
-}
\ No newline at end of file
+    return result;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+layout(std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec3 aColor;
+
+/* Per-instance stream, see InstancedRenderer::kInstanceLocation */
+layout(location = 4) in mat4 iModel;
+layout(location = 8) in vec4 iTint;
+
+out vec3 vColor;
+
+void main()
+{
+    vColor = aColor * iTint.rgb;
+    gl_Position = projection * iModel * vec4(aPosition, 0.0, 1.0);
+}
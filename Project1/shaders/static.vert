@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+
+/* Pooled static geometry is stored in world space. */
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec3 aColor;
+
+out vec3 vColor;
+
+void main()
+{
+    vColor = aColor;
+    gl_Position = projection * vec4(aPosition, 0.0, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+uniform sampler2D uTexture;
+
+in vec2 vUv;
+in vec4 vTint;
+
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = texture(uTexture, vUv) * vTint;
+}
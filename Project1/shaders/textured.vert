@@ -0,0 +1,26 @@
+#version 330 core
+
+layout(std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+
+layout(std140) uniform Draw
+{
+    mat4 model;
+    vec4 tint;
+};
+
+layout(location = 0) in vec2 aPosition;
+
+out vec2 vUv;
+out vec4 vTint;
+
+void main()
+{
+    /* Images are stored top row first, so v runs downwards. */
+    vUv = vec2(aPosition.x * 0.5 + 0.5, 0.5 - aPosition.y * 0.5);
+    vTint = tint;
+    gl_Position = projection * model * vec4(aPosition, 0.0, 1.0);
+}
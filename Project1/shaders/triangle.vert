@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+
+layout(std140) uniform Draw
+{
+    mat4 model;
+    vec4 tint;
+};
+
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec3 aColor;
+
+out vec3 vColor;
+
+void main()
+{
+    vColor = aColor * tint.rgb;
+    gl_Position = projection * model * vec4(aPosition, 0.0, 1.0);
+}